@@ -0,0 +1,170 @@
+#include "chain_contraction.h"
+#include "node_locations.h"
+
+#include <cstring>
+
+#include "routing_core/flat_hash_map.h"
+#include "routing_core/trace.h"
+
+namespace {
+
+// Не больше точек на ребро: shape_count в тайле — uint16.
+constexpr size_t kMaxChainPoints = 4096;
+
+struct Segment {
+  uint32_t way;
+  uint32_t idx;  // shape[idx-1] -> shape[idx]
+};
+
+// Сегмент цепочки с направлением обхода.
+struct Step {
+  uint32_t seg;
+  bool reversed;
+};
+
+struct Incidence {
+  uint32_t count {0};
+  uint32_t seg[2] {0, 0};
+};
+
+bool sameAttributes(const RoadWay& a, const RoadWay& b) {
+  return a.oneway == b.oneway && a.road_class == b.road_class &&
+         a.car_access == b.car_access && a.foot_access == b.foot_access;
+}
+
+long long tileCode(const TileKey& k) {
+  return (static_cast<long long>(k.x) << 32) | static_cast<long long>(static_cast<uint32_t>(k.y));
+}
+
+} // namespace
+
+RoadWay roadWayFor(const char* highway, bool oneway) {
+  // Простейший маппинг классов
+  int road_class = 3; // RESIDENTIAL default
+  if (std::strcmp(highway, "motorway") == 0) road_class = 0;
+  else if (std::strcmp(highway, "primary") == 0) road_class = 1;
+  else if (std::strcmp(highway, "secondary") == 0) road_class = 2;
+  else if (std::strcmp(highway, "footway") == 0) road_class = 4;
+  else if (std::strcmp(highway, "path") == 0) road_class = 5;
+  else if (std::strcmp(highway, "steps") == 0) road_class = 6;
+
+  RoadWay rw;
+  rw.oneway = oneway;
+  rw.road_class = road_class;
+  rw.car_access = !(road_class >= 4); // нет для чисто пешеходных
+  rw.foot_access = true;
+  return rw;
+}
+
+void resolveWayShapes(std::vector<RoadWay>& ways, const NodeLocationStore& locations) {
+  for (auto& rw : ways) {
+    size_t out = 0;
+    for (const auto& n : rw.shape) {
+      double lat, lon;
+      if (locations.get(n.id, lat, lon)) rw.shape[out++] = SimpleNode{n.id, lat, lon};
+    }
+    rw.shape.resize(out);
+  }
+  std::erase_if(ways, [](const RoadWay& rw) { return rw.shape.size() < 2; });
+}
+
+TileKey edgeTileKey(const SimpleEdge& e, int zoom) {
+  const SimpleNode& a = e.shape[0];
+  const SimpleNode& b = e.shape[1];
+  return tileKeyFor(0.5 * (a.lat + b.lat), 0.5 * (a.lon + b.lon), zoom);
+}
+
+void forEachRoadEdge(const std::vector<RoadWay>& ways, int zoom, bool contract,
+                     const std::function<void(SimpleEdge&&)>& sink, ContractionStats* stats) {
+  ROUTING_TRACE_SCOPE_ARG("converter", "buildRoadEdges", "ways", ways.size());
+  std::vector<Segment> segs;
+  for (uint32_t w = 0; w < ways.size(); ++w) {
+    const auto& shape = ways[w].shape;
+    for (uint32_t s = 1; s < shape.size(); ++s) {
+      if (shape[s - 1].id != shape[s].id) segs.push_back(Segment{w, s});
+    }
+  }
+  auto from = [&](uint32_t s) -> const SimpleNode& { return ways[segs[s].way].shape[segs[s].idx - 1]; };
+  auto to = [&](uint32_t s) -> const SimpleNode& { return ways[segs[s].way].shape[segs[s].idx]; };
+  auto start = [&](const Step& st) -> const SimpleNode& { return st.reversed ? to(st.seg) : from(st.seg); };
+  auto end = [&](const Step& st) -> const SimpleNode& { return st.reversed ? from(st.seg) : to(st.seg); };
+  auto way = [&](uint32_t s) -> const RoadWay& { return ways[segs[s].way]; };
+
+  std::vector<long long> segTile(segs.size());
+  for (uint32_t s = 0; s < segs.size(); ++s) {
+    segTile[s] = tileCode(tileKeyFor(0.5 * (from(s).lat + to(s).lat), 0.5 * (from(s).lon + to(s).lon), zoom));
+  }
+
+  routing_core::FlatHashMap<int64_t, Incidence> inc;
+  if (contract) {
+    inc.reserve(segs.size() * 2);
+    for (uint32_t s = 0; s < segs.size(); ++s) {
+      for (int64_t id : {from(s).id, to(s).id}) {
+        auto& n = inc[id];
+        if (n.count < 2) n.seg[n.count] = s;
+        ++n.count;
+      }
+    }
+  }
+  // Следующий сегмент цепочки через узел node после сегмента cur (ориентирован так,
+  // чтобы начинаться в node, если outgoing, иначе заканчиваться в нём); false — узел
+  // не сворачивается.
+  auto through = [&](int64_t node, uint32_t cur, bool outgoing, Step& next) {
+    if (!contract) return false;
+    const auto it = inc.find(node);
+    if (it == inc.end() || it->second.count != 2) return false;
+    const uint32_t o = it->second.seg[0] == cur ? it->second.seg[1] : it->second.seg[0];
+    if (o == cur || segTile[o] != segTile[cur] || !sameAttributes(way(o), way(cur))) return false;
+    const bool naturalOk = outgoing ? from(o).id == node : to(o).id == node;
+    if (way(o).oneway && !naturalOk) return false;  // встречные oneway не склеиваем
+    next = Step{o, !naturalOk};
+    return true;
+  };
+
+  size_t edgeCount = 0;
+  std::vector<char> visited(segs.size(), 0);
+  for (uint32_t i = 0; i < segs.size(); ++i) {
+    if (visited[i]) continue;
+    // назад до начала цепочки (перекрёсток, смена атрибутов или уже пройденный сегмент)
+    Step head{i, false};
+    for (size_t guard = 0; guard < segs.size(); ++guard) {
+      Step prev;
+      if (!through(start(head).id, head.seg, /*outgoing*/false, prev) || prev.seg == i || visited[prev.seg]) break;
+      head = prev;
+    }
+    // вперёд, собирая форму
+    SimpleEdge e;
+    const RoadWay& w = way(head.seg);
+    e.oneway = w.oneway;
+    e.road_class = w.road_class;
+    e.car_access = w.car_access;
+    e.foot_access = w.foot_access;
+    e.shape.push_back(start(head));
+    Step cur = head;
+    while (true) {
+      visited[cur.seg] = 1;
+      e.shape.push_back(end(cur));
+      Step next;
+      if (e.shape.size() >= kMaxChainPoints || !through(end(cur).id, cur.seg, /*outgoing*/true, next) ||
+          visited[next.seg]) {
+        break;
+      }
+      cur = next;
+    }
+    e.from_node_id = e.shape.front().id;
+    e.to_node_id = e.shape.back().id;
+    sink(std::move(e));
+    ++edgeCount;
+  }
+  if (stats) {
+    stats->segments = segs.size();
+    stats->edges = edgeCount;
+  }
+}
+
+std::vector<SimpleEdge> buildRoadEdges(const std::vector<RoadWay>& ways, int zoom, bool contract,
+                                       ContractionStats* stats) {
+  std::vector<SimpleEdge> edges;
+  forEachRoadEdge(ways, zoom, contract, [&](SimpleEdge&& e) { edges.push_back(std::move(e)); }, stats);
+  return edges;
+}
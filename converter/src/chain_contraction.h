@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "pbf_reader.h"
+
+// Дорога (OSM way с highway=*): точки по порядку и атрибуты, общие для всех её сегментов.
+struct RoadWay {
+  std::vector<SimpleNode> shape;
+  bool oneway {false};
+  int road_class {3};
+  bool car_access {true};
+  bool foot_access {true};
+};
+
+// Атрибуты дороги по тегам highway=* и oneway=yes (форма пустая).
+RoadWay roadWayFor(const char* highway, bool oneway);
+
+class NodeLocationStore;
+
+// Координаты из locations в формы дорог (в форме пока только ID узлов). Узлы без
+// координат (обрезка выгрузки) выпадают, дороги короче двух точек удаляются.
+void resolveWayShapes(std::vector<RoadWay>& ways, const NodeLocationStore& locations);
+
+// Рёбра графа по дорогам. С contract цепочки узлов степени 2 сворачиваются в одно ребро
+// между перекрёстками (промежуточные узлы остаются точками формы). Цепочка не проходит
+// через узел, где меняются oneway/класс/доступ, где oneway-потоки не стыкуются по
+// направлению, и не выходит за тайл (каждый сегмент относится к тайлу своей середины,
+// как и без сжатия). Без contract — по ребру на сегмент, как раньше.
+std::vector<SimpleEdge> buildRoadEdges(const std::vector<RoadWay>& ways, int zoom, bool contract,
+                                       ContractionStats* stats = nullptr);
+// То же потоком: каждое ребро отдаётся в sink сразу, без накопления.
+void forEachRoadEdge(const std::vector<RoadWay>& ways, int zoom, bool contract,
+                     const std::function<void(SimpleEdge&&)>& sink, ContractionStats* stats = nullptr);
+
+// Тайл ребра: по середине его первого сегмента (все сегменты ребра в одном тайле).
+TileKey edgeTileKey(const SimpleEdge& e, int zoom);
@@ -0,0 +1,204 @@
+#include "delta_builder.h"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include "sqlite_writer.h"
+#include "routing_core/tile_delta.h"
+#include "routing_core/tile_pack.h"
+#include "routing_core/trace.h"
+
+namespace {
+
+// Соединение только для чтения
+class ReadOnlyDb {
+public:
+  explicit ReadOnlyDb(const std::string& path) {
+    if (sqlite3_open_v2(path.c_str(), &db_, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+      std::string msg = "Failed to open SQLite DB: ";
+      msg += sqlite3_errmsg(db_);
+      sqlite3_close(db_);
+      throw SqliteError(msg);
+    }
+  }
+  ~ReadOnlyDb() { sqlite3_close(db_); }
+  ReadOnlyDb(const ReadOnlyDb&) = delete;
+  ReadOnlyDb& operator=(const ReadOnlyDb&) = delete;
+
+  sqlite3_stmt* prepare(const char* sql) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+      std::string msg = "Failed to prepare statement: ";
+      msg += sqlite3_errmsg(db_);
+      throw SqliteError(msg);
+    }
+    return stmt;
+  }
+
+  bool hasTable(const char* name) {
+    sqlite3_stmt* stmt = prepare("SELECT 1 FROM sqlite_master WHERE type='table' AND name=?;");
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    const bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+  }
+
+  std::map<std::string, std::string> metadata() {
+    std::map<std::string, std::string> out;
+    sqlite3_stmt* stmt = prepare("SELECT key, value FROM metadata;");
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      const auto* k = sqlite3_column_text(stmt, 0);
+      const auto* v = sqlite3_column_text(stmt, 1);
+      out[k ? reinterpret_cast<const char*>(k) : ""] = v ? reinterpret_cast<const char*>(v) : "";
+    }
+    sqlite3_finalize(stmt);
+    return out;
+  }
+
+private:
+  sqlite3* db_ {nullptr};
+};
+
+// Строка land_tiles / land_geometry по порядку (z,x,y)
+struct Row {
+  int z {0}, x {0}, y {0};
+  uint32_t version {0};
+  uint32_t profileMask {0};
+  double bbox[4] {0, 0, 0, 0};
+  std::string checksum;
+  std::vector<uint8_t> data;
+};
+
+class RowCursor {
+public:
+  RowCursor(ReadOnlyDb& db, bool geometry) : geometry_(geometry) {
+    if (geometry && !db.hasTable("land_geometry")) return;
+    stmt_ = db.prepare(geometry
+        ? "SELECT z,x,y,data FROM land_geometry ORDER BY z,x,y;"
+        : "SELECT z,x,y,data,version,checksum,profile_mask,lat_min,lon_min,lat_max,lon_max FROM land_tiles ORDER BY z,x,y;");
+    next();
+  }
+  ~RowCursor() { sqlite3_finalize(stmt_); }
+
+  bool valid() const { return valid_; }
+  const Row& row() const { return row_; }
+  std::tuple<int, int, int> key() const { return {row_.z, row_.x, row_.y}; }
+
+  void next() {
+    valid_ = stmt_ && sqlite3_step(stmt_) == SQLITE_ROW;
+    if (!valid_) return;
+    row_.z = sqlite3_column_int(stmt_, 0);
+    row_.x = sqlite3_column_int(stmt_, 1);
+    row_.y = sqlite3_column_int(stmt_, 2);
+    const auto* blob = static_cast<const uint8_t*>(sqlite3_column_blob(stmt_, 3));
+    row_.data.assign(blob, blob + sqlite3_column_bytes(stmt_, 3));
+    if (geometry_) return;
+    row_.version = static_cast<uint32_t>(sqlite3_column_int64(stmt_, 4));
+    const auto* checksum = sqlite3_column_text(stmt_, 5);
+    row_.checksum = checksum ? reinterpret_cast<const char*>(checksum) : "";
+    row_.profileMask = static_cast<uint32_t>(sqlite3_column_int64(stmt_, 6));
+    for (int k = 0; k < 4; ++k) row_.bbox[k] = sqlite3_column_double(stmt_, 7 + k);
+  }
+
+private:
+  sqlite3_stmt* stmt_ {nullptr};
+  bool geometry_;
+  bool valid_ {false};
+  Row row_;
+};
+
+bool sameBlob(const Row& a, const Row& b) {
+  if (!a.checksum.empty() && !b.checksum.empty()) return a.checksum == b.checksum;
+  return a.data == b.data;
+}
+
+} // namespace
+
+DeltaBuildStats buildTileDelta(const std::string& oldDb, const std::string& newDb, const std::string& outPath,
+                               bool binaryDiff) {
+  ROUTING_TRACE_SCOPE("converter", "buildTileDelta");
+  ReadOnlyDb before(oldDb);
+  ReadOnlyDb after(newDb);
+
+  // Формат блобов должен совпадать: диф и сами блобы читаются со старым словарём/схемой
+  const auto oldMeta = before.metadata();
+  const auto newMeta = after.metadata();
+  auto value = [](const std::map<std::string, std::string>& m, const char* key) {
+    auto it = m.find(key);
+    return it == m.end() ? std::string() : it->second;
+  };
+  // tile_checksum: контрольные суммы неизменённых тайлов остаются от старой БД
+  for (const char* key : {"schema_version", "geometry_layer", "tile_compression", "zstd_dict", "tile_checksum"}) {
+    if (value(oldMeta, key) != value(newMeta, key)) {
+      throw std::runtime_error(std::string("routingdb format differs (") + key +
+                               "): a delta package cannot update it, a full download is required");
+    }
+  }
+
+  routing_core::TileDeltaWriter writer(outPath);
+  for (const auto& [key, v] : newMeta) {
+    auto it = oldMeta.find(key);
+    if (it == oldMeta.end() || it->second != v) writer.setMetadata(key, v);
+  }
+
+  DeltaBuildStats stats;
+  for (bool geometry : {false, true}) {
+    const int layerBit = geometry ? routing_core::kGeometryLayerBit : 0;
+    RowCursor a(before, geometry);
+    RowCursor b(after, geometry);
+    while (a.valid() || b.valid()) {
+      routing_core::TileDeltaEntry e;
+      if (!b.valid() || (a.valid() && a.key() < b.key())) {
+        // Есть только в старой: удалить
+        e.op = routing_core::TileDeltaOp::Remove;
+        e.z = a.row().z | layerBit;
+        e.x = a.row().x;
+        e.y = a.row().y;
+        writer.add(e);
+        ++stats.removed;
+        a.next();
+        continue;
+      }
+      const Row& nr = b.row();
+      stats.newBytes += nr.data.size();
+      const bool inBoth = a.valid() && a.key() == b.key();
+      if (inBoth && sameBlob(a.row(), nr)) {
+        ++stats.unchanged;
+      } else {
+        e.op = routing_core::TileDeltaOp::Put;
+        e.z = nr.z | layerBit;
+        e.x = nr.x;
+        e.y = nr.y;
+        e.version = nr.version;
+        e.profileMask = nr.profileMask;
+        std::copy(std::begin(nr.bbox), std::end(nr.bbox), e.bbox);
+        e.checksum = nr.checksum;
+        e.payload = nr.data;
+        if (inBoth && binaryDiff) {
+          const Row& orow = a.row();
+          auto diff = routing_core::makeBlobDiff(orow.data, nr.data);
+          // Диф заметно меньше блоба — иначе проще передать блоб целиком
+          if (diff.size() * 10 < nr.data.size() * 9) {
+            e.op = routing_core::TileDeltaOp::Patch;
+            e.baseHash = routing_core::deltaBlobHash(orow.data.data(), orow.data.size());
+            e.baseSize = static_cast<uint32_t>(orow.data.size());
+            e.payload = std::move(diff);
+            ++stats.patched;
+          }
+        }
+        writer.add(e);
+        ++(inBoth ? stats.changed : stats.added);
+      }
+      if (inBoth) a.next();
+      b.next();
+    }
+  }
+  writer.finish();
+  stats.deltaBytes = writer.bytesWritten();
+  return stats;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct DeltaBuildStats {
+  size_t unchanged {0};
+  size_t added {0};
+  size_t changed {0};   // из них patched — бинарным дифом
+  size_t patched {0};
+  size_t removed {0};
+  uint64_t newBytes {0};    // блобов в новой БД (полная загрузка)
+  uint64_t deltaBytes {0};  // размер пакета
+};
+
+// Пакет изменений (routing_core/tile_delta.h) от oldDb к newDb: тайлы и блобы геометрии
+// сравниваются по (z,x,y) слиянием двух упорядоченных выборок — по checksum, если он
+// заполнен в обеих БД, иначе по байтам. В пакет идут добавленные, изменённые и удалённые
+// блобы и изменённые значения metadata; с binaryDiff изменённый блоб кладётся дифом к
+// старому, если тот заметно меньше. Разные форматы блобов (схема, слой геометрии, сжатие,
+// zstd-словарь) пакетом не обновить — исключение, нужна полная загрузка.
+DeltaBuildStats buildTileDelta(const std::string& oldDb, const std::string& newDb, const std::string& outPath,
+                               bool binaryDiff);
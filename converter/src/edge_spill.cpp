@@ -0,0 +1,277 @@
+#include "edge_spill.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+#include "routing_core/trace.h"
+
+namespace {
+
+constexpr size_t kHeaderSize = 14;     // x, y, флаги, класс дороги, число точек
+constexpr size_t kPointSize = 24;      // id, lat, lon
+constexpr size_t kReadChunk = 1 << 16;    // наибольшая порция чтения прогона при слиянии
+constexpr size_t kMinReadChunk = 1 << 12; // наименьшая; меньше — слишком мелкие чтения
+
+// Индекс точки (x, y) на кривой Гильберта в квадрате n x n (n — степень двойки)
+uint64_t hilbertIndex(uint32_t n, uint32_t x, uint32_t y) {
+  uint64_t d = 0;
+  for (uint32_t s = n / 2; s > 0; s /= 2) {
+    const uint32_t rx = (x & s) ? 1 : 0;
+    const uint32_t ry = (y & s) ? 1 : 0;
+    d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+    if (ry == 0) {
+      if (rx == 1) {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+template <class T>
+void put(std::vector<uint8_t>& out, T v) {
+  const size_t at = out.size();
+  out.resize(at + sizeof(T));
+  std::memcpy(out.data() + at, &v, sizeof(T));
+}
+
+template <class T>
+T get(const uint8_t*& p, const uint8_t* end) {
+  if (static_cast<size_t>(end - p) < sizeof(T)) throw std::runtime_error("Edge spill record is truncated");
+  T v;
+  std::memcpy(&v, p, sizeof(T));
+  p += sizeof(T);
+  return v;
+}
+
+}  // namespace
+
+EdgeSpill::EdgeSpill(std::string filePath, int zoom, size_t memoryBudget)
+  : filePath_(std::move(filePath)), zoom_(zoom), budget_(std::max<size_t>(memoryBudget, 1 << 20)) {
+  file_.open(filePath_, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+  if (!file_) throw std::runtime_error("Failed to create temp file: " + filePath_);
+}
+
+EdgeSpill::~EdgeSpill() {
+  file_.close();
+  std::remove(filePath_.c_str());
+}
+
+uint64_t EdgeSpill::keyOf(int x, int y) const {
+  return hilbertIndex(1u << zoom_, static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+}
+
+void EdgeSpill::add(const TileKey& tile, const SimpleEdge& e) {
+  if (finished_) throw std::runtime_error("EdgeSpill: add after finish");
+  if (tile.z != zoom_) throw std::runtime_error("EdgeSpill: tile zoom mismatch");
+  // Запись: x, y, флаги, класс дороги, число точек, точки (id, lat, lon); концы ребра —
+  // первая и последняя точки формы
+  const size_t at = buffer_.size();
+  put<int32_t>(buffer_, tile.x);
+  put<int32_t>(buffer_, tile.y);
+  put<uint8_t>(buffer_, static_cast<uint8_t>((e.oneway ? 1 : 0) | (e.car_access ? 2 : 0) | (e.foot_access ? 4 : 0)));
+  put<uint8_t>(buffer_, static_cast<uint8_t>(e.road_class));
+  put<uint32_t>(buffer_, static_cast<uint32_t>(e.shape.size()));
+  for (const auto& n : e.shape) {
+    put<int64_t>(buffer_, n.id);
+    put<double>(buffer_, n.lat);
+    put<double>(buffer_, n.lon);
+  }
+  records_.push_back(Record{keyOf(tile.x, tile.y), at, buffer_.size() - at});
+  ++edges_;
+  if (buffer_.size() + records_.size() * sizeof(Record) > budget_ / 4) writeRun();
+}
+
+void EdgeSpill::writeRun() {
+  if (records_.empty()) return;
+  ROUTING_TRACE_SCOPE_ARG("converter", "edgeSpill.writeRun", "records", records_.size());
+  std::stable_sort(records_.begin(), records_.end(), [](const Record& a, const Record& b) { return a.key < b.key; });
+  file_.seekp(static_cast<std::streamoff>(fileSize_));
+  for (const Record& r : records_) {
+    file_.write(reinterpret_cast<const char*>(buffer_.data() + r.offset), static_cast<std::streamsize>(r.size));
+  }
+  if (!file_) throw std::runtime_error("Failed to write edge spill: " + filePath_);
+  Run run;
+  run.offset = fileSize_;
+  run.end = fileSize_ + buffer_.size();
+  runs_.push_back(std::move(run));
+  fileSize_ += buffer_.size();
+  spilledBytes_ += buffer_.size();
+  buffer_.clear();
+  records_.clear();
+}
+
+void EdgeSpill::finish() {
+  if (finished_) return;
+  writeRun();
+  buffer_.shrink_to_fit();
+  records_.shrink_to_fit();
+  file_.flush();
+  finished_ = true;
+  // На буферы чтения слияния — четверть бюджета. Если прогонов столько, что порция каждого
+  // меньше kMinReadChunk, соседние прогоны сливаются в один (порядок прогонов сохраняется,
+  // поэтому слияние остаётся устойчивым), пока их не станет не больше fanIn
+  const size_t mergeBudget = budget_ / 4;
+  const size_t fanIn = std::max<size_t>(2, mergeBudget / kMinReadChunk - 1);  // -1: буфер записи
+  while (runs_.size() > fanIn) {
+    ROUTING_TRACE_SCOPE_ARG("converter", "edgeSpill.mergePass", "runs", runs_.size());
+    readChunk_ = mergeBudget / (fanIn + 1);
+    std::vector<Run> merged;
+    merged.reserve((runs_.size() + fanIn - 1) / fanIn);
+    for (size_t first = 0; first < runs_.size(); first += fanIn) {
+      const size_t last = std::min(runs_.size(), first + fanIn);
+      if (last - first == 1) merged.push_back(std::move(runs_[first]));
+      else merged.push_back(mergeRuns(first, last));
+    }
+    runs_ = std::move(merged);
+  }
+  readChunk_ = std::clamp(mergeBudget / std::max<size_t>(runs_.size(), 1), kMinReadChunk, kReadChunk);
+  for (size_t r = 0; r < runs_.size(); ++r) {
+    if (advance(runs_[r])) heap_.push_back(r);
+  }
+  std::make_heap(heap_.begin(), heap_.end(), [&](size_t a, size_t b) { return later(a, b); });
+}
+
+bool EdgeSpill::later(size_t a, size_t b) const {
+  // Куча по (ключ, номер прогона): прогоны записаны по порядку add(), поэтому при равном
+  // ключе раньше идут более ранние рёбра
+  return std::tie(runs_[a].key, a) > std::tie(runs_[b].key, b);
+}
+
+EdgeSpill::Run EdgeSpill::mergeRuns(size_t first, size_t last) {
+  Run out;
+  out.offset = fileSize_;
+  std::vector<uint8_t> pending;  // буфер записи, до readChunk_ байт
+  pending.reserve(readChunk_);
+  auto flush = [&] {
+    file_.seekp(static_cast<std::streamoff>(fileSize_));
+    file_.write(reinterpret_cast<const char*>(pending.data()), static_cast<std::streamsize>(pending.size()));
+    if (!file_) throw std::runtime_error("Failed to write edge spill: " + filePath_);
+    fileSize_ += pending.size();
+    pending.clear();
+  };
+  auto cmp = [&](size_t a, size_t b) { return later(a, b); };
+  std::vector<size_t> heap;
+  for (size_t r = first; r < last; ++r) {
+    if (advance(runs_[r])) heap.push_back(r);
+  }
+  std::make_heap(heap.begin(), heap.end(), cmp);
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), cmp);
+    const size_t r = heap.back();
+    heap.pop_back();
+    Run& run = runs_[r];
+    const uint8_t* rec = run.buffer.data() + run.pos;
+    pending.insert(pending.end(), rec, rec + run.recordSize);
+    if (pending.size() >= readChunk_) flush();
+    run.pos += run.recordSize;
+    if (advance(run)) {
+      heap.push_back(r);
+      std::push_heap(heap.begin(), heap.end(), cmp);
+    }
+  }
+  flush();
+  file_.flush();
+  out.end = fileSize_;
+  return out;
+}
+
+bool EdgeSpill::fill(Run& run, size_t bytes) {
+  const size_t avail = run.buffer.size() - run.pos;
+  if (avail >= bytes) return true;
+  const uint64_t left = run.end - run.offset;
+  if (avail + left < bytes) {
+    if (avail == 0 && left == 0) return false;
+    throw std::runtime_error("Edge spill record is truncated");
+  }
+  run.buffer.erase(run.buffer.begin(), run.buffer.begin() + static_cast<std::ptrdiff_t>(run.pos));
+  run.pos = 0;
+  const size_t toRead = static_cast<size_t>(std::min<uint64_t>(left, std::max(bytes - avail, readChunk_)));
+  run.buffer.resize(avail + toRead);
+  file_.seekg(static_cast<std::streamoff>(run.offset));
+  file_.read(reinterpret_cast<char*>(run.buffer.data() + avail), static_cast<std::streamsize>(toRead));
+  if (!file_) throw std::runtime_error("Failed to read edge spill: " + filePath_);
+  run.offset += toRead;
+  return true;
+}
+
+bool EdgeSpill::advance(Run& run) {
+  run.recordSize = 0;
+  if (!fill(run, kHeaderSize)) {
+    run.buffer.clear();
+    run.buffer.shrink_to_fit();
+    return false;
+  }
+  const uint8_t* p = run.buffer.data() + run.pos;
+  const uint8_t* end = p + kHeaderSize;
+  const int32_t x = get<int32_t>(p, end);
+  const int32_t y = get<int32_t>(p, end);
+  p += 2;
+  const uint32_t count = get<uint32_t>(p, end);
+  const size_t size = kHeaderSize + count * kPointSize;
+  if (!fill(run, size)) throw std::runtime_error("Edge spill record is truncated");
+  run.key = keyOf(x, y);
+  run.recordSize = size;
+  return true;
+}
+
+bool EdgeSpill::nextGroup(std::unordered_map<long long, TileData>& out) {
+  if (!finished_) throw std::runtime_error("EdgeSpill: nextGroup before finish");
+  ROUTING_TRACE_SCOPE("converter", "edgeSpill.nextGroup");
+  out.clear();
+  auto cmp = [&](size_t a, size_t b) { return later(a, b); };
+  const size_t limit = budget_ / 4;
+  size_t bytes = 0;
+  uint64_t lastKey = 0;
+  while (!heap_.empty()) {
+    const size_t r = heap_.front();
+    Run& run = runs_[r];
+    if (bytes >= limit && run.key != lastKey) break;  // группа набрана, следующий тайл — в новую
+    std::pop_heap(heap_.begin(), heap_.end(), cmp);
+    heap_.pop_back();
+
+    const uint8_t* p = run.buffer.data() + run.pos;
+    const uint8_t* end = p + run.recordSize;
+    TileKey tk{zoom_, get<int32_t>(p, end), 0};
+    tk.y = get<int32_t>(p, end);
+    const uint8_t flags = get<uint8_t>(p, end);
+    SimpleEdge e;
+    e.road_class = get<uint8_t>(p, end);
+    e.oneway = flags & 1;
+    e.car_access = flags & 2;
+    e.foot_access = flags & 4;
+    const uint32_t count = get<uint32_t>(p, end);
+    e.shape.reserve(count);
+    for (uint32_t k = 0; k < count; ++k) {
+      SimpleNode n;
+      n.id = get<int64_t>(p, end);
+      n.lat = get<double>(p, end);
+      n.lon = get<double>(p, end);
+      e.shape.push_back(n);
+    }
+    if (e.shape.size() < 2) throw std::runtime_error("Edge spill record has fewer than 2 points");
+    e.from_node_id = e.shape.front().id;
+    e.to_node_id = e.shape.back().id;
+
+    auto& td = out[packTileKey(tk)];
+    td.key = tk;
+    td.bbox = tileBounds(tk);
+    td.nodes.push_back(e.shape.front());
+    td.nodes.push_back(e.shape.back());
+    td.edges.push_back(std::move(e));
+
+    bytes += run.recordSize;
+    lastKey = run.key;
+    run.pos += run.recordSize;
+    if (advance(run)) {
+      heap_.push_back(r);
+      std::push_heap(heap_.begin(), heap_.end(), cmp);
+    }
+  }
+  return !out.empty();
+}
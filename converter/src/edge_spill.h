@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pbf_reader.h"
+
+// Внешняя память для нарезки на тайлы: рёбра не копятся в одной карте тайлов, а
+// сортируются во временном файле (внешняя сортировка по индексу Гильберта тайла).
+//
+// add() дописывает ребро в буфер; когда буфер превышает четверть бюджета, записи
+// сортируются по ключу Гильберта (x, y) тайла и буфер уходит в файл отдельным прогоном.
+// После finish() nextGroup() сливает прогоны и отдаёт тайлы группами: подряд по кривой
+// Гильберта (соседние на карте тайлы — в одной группе), пока объём записей группы не
+// превысит четверть бюджета; тайл между группами не делится. В памяти одновременно
+// буферы чтения прогонов (вместе — около четверти бюджета) и одна группа (в TileData она
+// примерно вдвое больше, чем на диске), а не весь граф. Если прогонов больше, чем буферов
+// по kMinReadChunk в этой четверти, finish() сперва сливает соседние прогоны в более
+// длинные (ещё один проход по файлу). Слияние устойчиво: рёбра тайла идут в порядке add(),
+// так что тайлы совпадают с PbfReader::readAndTile.
+class EdgeSpill {
+public:
+  // filePath — временный файл (удаляется в деструкторе); memoryBudget — байт на буферы
+  // рёбер и группы тайлов (не на весь конвертер: дороги и узлы сюда не входят)
+  EdgeSpill(std::string filePath, int zoom, size_t memoryBudget);
+  ~EdgeSpill();
+  EdgeSpill(const EdgeSpill&) = delete;
+  EdgeSpill& operator=(const EdgeSpill&) = delete;
+
+  void add(const TileKey& tile, const SimpleEdge& e);
+  // Записать последний прогон; после этого add недоступен.
+  void finish();
+
+  // Следующая группа тайлов (ключ packTileKey -> данные) в out; false, когда рёбра кончились
+  bool nextGroup(std::unordered_map<long long, TileData>& out);
+
+  size_t edgeCount() const { return edges_; }
+  size_t runCount() const { return runs_.size(); }  // после finish() — прогонов в последнем слиянии
+  uint64_t spilledBytes() const { return spilledBytes_; }
+
+private:
+  struct Record { uint64_t key; size_t offset; size_t size; };
+  // Прогон в файле и курсор слияния по нему
+  struct Run {
+    uint64_t offset;  // следующий непрочитанный байт в файле
+    uint64_t end;
+    std::vector<uint8_t> buffer;  // прочитанное, но не разобранное
+    size_t pos {0};
+    uint64_t key {0};         // ключ текущей записи
+    size_t recordSize {0};    // 0 — прогон исчерпан
+  };
+
+  uint64_t keyOf(int x, int y) const;
+  void writeRun();
+  bool fill(Run& run, size_t bytes);  // дочитать, чтобы в буфере было bytes байт
+  bool advance(Run& run);  // перейти к следующей записи прогона
+  bool later(size_t a, size_t b) const;  // порядок мин-кучи прогонов
+  Run mergeRuns(size_t first, size_t last);  // слить runs_[first, last) в новый прогон в конце файла
+
+  std::string filePath_;
+  std::fstream file_;
+  int zoom_;
+  size_t budget_;
+  std::vector<uint8_t> buffer_;
+  std::vector<Record> records_;
+  std::vector<Run> runs_;
+  std::vector<size_t> heap_;  // прогоны с записями, мин-куча по (key, номер прогона)
+  size_t readChunk_ {0};      // порция чтения прогона при слиянии
+  uint64_t fileSize_ {0};
+  uint64_t spilledBytes_ {0};  // записано add(), без промежуточных слияний
+  size_t edges_ {0};
+  bool finished_ {false};
+};
@@ -1,21 +1,52 @@
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <string>
 #include <vector>
 #include <filesystem>
-#include <vector>
-#if __APPLE__
-#  include <CommonCrypto/CommonDigest.h>
-#endif
+#include <memory>
+#include <optional>
+#include <thread>
+#include <tuple>
 
+#include "delta_builder.h"
+#include "edge_spill.h"
+#include "ordered_pipeline.h"
+#include "osc_update.h"
 #include "sqlite_writer.h"
 #include "pbf_reader.h"
 #include "serializer.h"
+#include "tile_compressor.h"
+#include "routing_core/base64.h"
+#include "routing_core/tile_pack.h"
+#include "routing_core/trace.h"
 
 namespace fs = std::filesystem;
 
 static void printUsage(const char* argv0) {
-  std::fprintf(stderr, "Usage: %s [--z ZOOM] input.osm.pbf output.routingdb\n", argv0);
+  std::fprintf(stderr,
+    "Usage: %s [--z ZOOM] [--format sqlite|pack] [--schema 1|2] [--zstd] [--zstd-level N]\n"
+    "          [--zstd-dict-size BYTES] [--no-contract] [--threads N] [--node-store FILE]\n"
+    "          [--edge-spill-budget MB] [--apply-osc changes.osc]\n"
+    "          [--trace trace.json]\n"
+    "          input.osm.pbf output.routingdb\n"
+    "       %s --make-delta out.routingdelta [--binary-diff] old.routingdb new.routingdb\n"
+    "  --format pack : write an mmap-friendly tile pack (.routingpack) instead of SQLite\n"
+    "  --schema      : tile schema version (default 2: fixed-size structs; 1: legacy tables)\n"
+    "  --zstd        : compress tile blobs with zstd using a dictionary trained on the tiles\n"
+    "                  (level default 12, dictionary default 112640 bytes, 0 = no dictionary)\n"
+    "  --no-contract : keep one edge per way segment (no degree-2 chain contraction)\n"
+    "  --threads     : worker threads for PBF decoding and tile serialisation (default: all cores)\n"
+    "  --node-store  : keep road node locations in an mmap-ed temporary FILE instead of RAM\n"
+    "  --edge-spill-budget : spill tiled edges to a temporary file and serialise tiles in\n"
+    "                  groups, keeping the edge/tile buffers within about MB megabytes; ways and\n"
+    "                  node locations are not covered (use --node-store for the latter);\n"
+    "                  --memory-budget is an old alias\n"
+    "  --apply-osc   : update an existing SQLite output in place: re-serialise only the tiles\n"
+    "                  touched by the OSM change file (input.osm.pbf is the PBF it was built from)\n"
+    "  --make-delta  : write a package of tiles added, changed or removed between two routingdbs\n"
+    "                  (applied in place by Router::applyDelta); --binary-diff ships changed\n"
+    "                  blobs as diffs against the old ones when that is smaller\n", argv0, argv0);
 }
 
 int main(int argc, char** argv) {
@@ -25,6 +56,19 @@ int main(int argc, char** argv) {
   }
 
   int zoom = 14;
+  std::string tracePath;
+  bool packOutput = false;
+  int schemaVersion = 2;
+  bool zstd = false;
+  int zstdLevel = 12;
+  size_t zstdDictSize = 110 * 1024;
+  bool contractChains = true;
+  int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  std::string nodeStorePath;
+  size_t edgeSpillBudgetMb = 0;  // 0 — все рёбра в памяти
+  std::string oscPath;
+  std::string deltaPath;
+  bool binaryDiff = false;
   std::vector<std::string> args;
   for (int i = 1; i < argc; ++i) args.emplace_back(argv[i]);
   for (size_t i = 0; i < args.size();) {
@@ -32,6 +76,60 @@ int main(int argc, char** argv) {
       if (i + 1 >= args.size()) { printUsage(argv[0]); return 1; }
       zoom = std::stoi(args[i + 1]);
       args.erase(args.begin() + i, args.begin() + i + 2);
+    } else if (args[i] == "--format") {
+      if (i + 1 >= args.size()) { printUsage(argv[0]); return 1; }
+      if (args[i + 1] == "pack") packOutput = true;
+      else if (args[i + 1] != "sqlite") { printUsage(argv[0]); return 1; }
+      args.erase(args.begin() + i, args.begin() + i + 2);
+    } else if (args[i] == "--schema") {
+      if (i + 1 >= args.size()) { printUsage(argv[0]); return 1; }
+      schemaVersion = std::stoi(args[i + 1]);
+      if (schemaVersion != 1 && schemaVersion != 2) { printUsage(argv[0]); return 1; }
+      args.erase(args.begin() + i, args.begin() + i + 2);
+    } else if (args[i] == "--zstd") {
+      zstd = true;
+      args.erase(args.begin() + i);
+    } else if (args[i] == "--zstd-level" || args[i] == "--zstd-dict-size") {
+      if (i + 1 >= args.size()) { printUsage(argv[0]); return 1; }
+      if (args[i] == "--zstd-level") zstdLevel = std::stoi(args[i + 1]);
+      else zstdDictSize = static_cast<size_t>(std::stoul(args[i + 1]));
+      zstd = true;
+      args.erase(args.begin() + i, args.begin() + i + 2);
+    } else if (args[i] == "--threads") {
+      if (i + 1 >= args.size()) { printUsage(argv[0]); return 1; }
+      threads = std::max(1, std::stoi(args[i + 1]));
+      args.erase(args.begin() + i, args.begin() + i + 2);
+    } else if (args[i] == "--node-store") {
+      if (i + 1 >= args.size()) { printUsage(argv[0]); return 1; }
+      nodeStorePath = args[i + 1];
+      args.erase(args.begin() + i, args.begin() + i + 2);
+    } else if (args[i] == "--edge-spill-budget" || args[i] == "--memory-budget") {
+      if (i + 1 >= args.size()) { printUsage(argv[0]); return 1; }
+      // бюджет только рёбер и тайлов; старое имя обещало больше, чем ограничивает
+      if (args[i] == "--memory-budget") {
+        std::fprintf(stderr, "--memory-budget is deprecated, use --edge-spill-budget "
+                             "(it bounds edges and tiles only, not ways or node locations)\n");
+      }
+      edgeSpillBudgetMb = static_cast<size_t>(std::stoul(args[i + 1]));
+      args.erase(args.begin() + i, args.begin() + i + 2);
+    } else if (args[i] == "--apply-osc") {
+      if (i + 1 >= args.size()) { printUsage(argv[0]); return 1; }
+      oscPath = args[i + 1];
+      args.erase(args.begin() + i, args.begin() + i + 2);
+    } else if (args[i] == "--make-delta") {
+      if (i + 1 >= args.size()) { printUsage(argv[0]); return 1; }
+      deltaPath = args[i + 1];
+      args.erase(args.begin() + i, args.begin() + i + 2);
+    } else if (args[i] == "--binary-diff") {
+      binaryDiff = true;
+      args.erase(args.begin() + i);
+    } else if (args[i] == "--no-contract") {
+      contractChains = false;
+      args.erase(args.begin() + i);
+    } else if (args[i] == "--trace") {
+      if (i + 1 >= args.size()) { printUsage(argv[0]); return 1; }
+      tracePath = args[i + 1];
+      args.erase(args.begin() + i, args.begin() + i + 2);
     } else {
       ++i;
     }
@@ -41,7 +139,44 @@ int main(int argc, char** argv) {
   const std::string inputPbfPath = args[0];
   const std::string outputDbPath = args[1];
 
+  // Трассировка: --trace путь или LOXX_TRACE=путь (дамп при выходе)
+  if (!tracePath.empty()) routing_core::trace::enable();
+  else routing_core::trace::enableFromEnv();
+
   try {
+    // Пакет изменений между двумя готовыми БД: позиционные аргументы — старая и новая
+    if (!deltaPath.empty()) {
+      const DeltaBuildStats stats = buildTileDelta(args[0], args[1], deltaPath, binaryDiff);
+      std::printf("Blobs: %zu unchanged, %zu added, %zu changed (%zu as diffs), %zu removed\n",
+                  stats.unchanged, stats.added, stats.changed, stats.patched, stats.removed);
+      std::printf("Delta package: %llu bytes (full download: %llu bytes)\n",
+                  static_cast<unsigned long long>(stats.deltaBytes), static_cast<unsigned long long>(stats.newBytes));
+      return 0;
+    }
+
+    // Инкрементальное обновление: БД не пересоздаётся, переписываются только тайлы
+    // с изменёнными узлами и дорогами
+    if (!oscPath.empty()) {
+      if (packOutput) throw std::runtime_error("--apply-osc updates SQLite output only");
+      if (!fs::exists(outputDbPath)) throw std::runtime_error("No routingdb to update: " + outputDbPath);
+      OscUpdateOptions options;
+      options.oscPath = oscPath;
+      options.pbfPath = inputPbfPath;
+      options.dbPath = outputDbPath;
+      options.zoom = zoom;
+      options.contractChains = contractChains;
+      options.threads = threads;
+      options.nodeStorePath = nodeStorePath;
+      options.zstdLevel = zstdLevel;
+      const OscUpdateStats stats = applyOscUpdate(options);
+      std::printf("Touched nodes: %zu\n", stats.touchedNodes);
+      std::printf("Updated tiles: %zu, deleted tiles: %zu\n", stats.tilesUpdated, stats.tilesDeleted);
+      if (!tracePath.empty() && !routing_core::trace::dump(tracePath)) {
+        std::fprintf(stderr, "Failed to write trace to %s\n", tracePath.c_str());
+      }
+      return 0;
+    }
+
     // Ensure output directory exists
     const fs::path outPath(outputDbPath);
     if (outPath.has_parent_path()) {
@@ -51,50 +186,168 @@ int main(int argc, char** argv) {
       fs::remove(outPath);
     }
 
-    RoutingDbWriter writer(outputDbPath);
-    writer.createSchemaIfNeeded();
+    // Выход: SQLite (по умолчанию) либо пак тайлов
+    std::optional<RoutingDbWriter> writer;
+    std::optional<routing_core::TilePackWriter> pack;
+    if (packOutput) {
+      pack.emplace(outputDbPath);
+    } else {
+      writer.emplace(outputDbPath);
+      writer->createSchemaIfNeeded();
+      writer->beginBulkLoad();
+    }
 
-    PbfReader reader(inputPbfPath, zoom);
-    auto tiles = reader.readAndTile();
+    PbfReader reader(inputPbfPath, zoom, contractChains, threads, nodeStorePath);
+    // С --edge-spill-budget рёбра уходят во временный файл по корзинам тайлов и читаются
+    // обратно группами (EdgeSpill); иначе весь граф — одна карта тайлов
+    std::unordered_map<long long, TileData> tiles;
+    std::optional<EdgeSpill> spill;
+    if (edgeSpillBudgetMb > 0) {
+      spill.emplace(outputDbPath + ".edges.tmp", zoom, edgeSpillBudgetMb << 20);
+      reader.readEdges([&](const TileKey& tk, SimpleEdge&& e) { spill->add(tk, e); });
+      spill->finish();
+    } else {
+      tiles = reader.readAndTile();
+    }
+    std::printf("Road nodes: %zu (%.1f MiB in memory)\n", reader.nodeCount(),
+                static_cast<double>(reader.nodeStoreBytes()) / (1 << 20));
+    std::printf("Road segments: %zu, edges: %zu\n", reader.segmentCount(), reader.edgeCount());
 
     // Пока только пишем metadata, чтобы DB был валиден
-    writer.writeMetadata("schema_version", "1");
-    writer.writeMetadata("source", inputPbfPath);
+    // В v2 геометрия рёбер — отдельный слой, роутер читает его только для сборки результата
+    const std::string schemaStr = std::to_string(schemaVersion);
+    const bool geometryLayer = schemaVersion == 2;
+    if (pack) {
+      pack->setMetadata("schema_version", schemaStr);
+      pack->setMetadata("source", inputPbfPath);
+      if (geometryLayer) pack->setMetadata("geometry_layer", "separate");
+    } else {
+      writer->writeMetadata("schema_version", schemaStr);
+      writer->writeMetadata("source", inputPbfPath);
+      writer->writeMetadata("tile_checksum", "xxh64");  // land_tiles.checksum, см. blobChecksum
+      if (geometryLayer) writer->writeMetadata("geometry_layer", "separate");
+    }
 
-    std::printf("Parsed tiles: %zu\n", tiles.size());
+    if (spill) {
+      std::printf("Spilled edges: %zu (%.1f MiB in %zu sorted runs)\n", spill->edgeCount(),
+                  static_cast<double>(spill->spilledBytes()) / (1 << 20), spill->runCount());
+    } else {
+      std::printf("Parsed tiles: %zu\n", tiles.size());
+    }
     // Serialize and write
     const uint32_t version = 1;
     const uint32_t profile_mask = 0x3; // car|foot
-    int count_written = 0;
-    for (auto& [key, t] : tiles) {
-      auto blob = buildLandTileBlob(t, version, profile_mask);
-
-      // checksum
-      std::string checksum_hex;
-#if __APPLE__
-      unsigned char digest[CC_SHA256_DIGEST_LENGTH];
-      CC_SHA256(blob.data(), static_cast<CC_LONG>(blob.size()), digest);
-      static const char* hex = "0123456789abcdef";
-      checksum_hex.resize(CC_SHA256_DIGEST_LENGTH * 2);
-      for (int i = 0; i < CC_SHA256_DIGEST_LENGTH; ++i) {
-        checksum_hex[2*i] = hex[(digest[i] >> 4) & 0xF];
-        checksum_hex[2*i+1] = hex[digest[i] & 0xF];
+    auto buildBlob = [&](const TileData& t, std::vector<uint8_t>* geometry = nullptr) {
+      return schemaVersion == 2 ? buildLandTileBlobV2(t, version, profile_mask, geometry)
+                                : buildLandTileBlob(t, version, profile_mask);
+    };
+
+    // Тайлы в порядке ключа: выход не зависит от порядка хэш-таблицы и числа потоков
+    std::vector<const TileData*> ordered;
+    auto orderTiles = [&] {
+      ordered.clear();
+      ordered.reserve(tiles.size());
+      for (const auto& [key, t] : tiles) ordered.push_back(&t);
+      std::sort(ordered.begin(), ordered.end(), [](const TileData* a, const TileData* b) {
+        return std::tie(a->key.z, a->key.x, a->key.y) < std::tie(b->key.z, b->key.x, b->key.y);
+      });
+    };
+    if (spill) spill->nextGroup(tiles);
+    orderTiles();
+
+    // zstd: словарь обучается на каждом k-м тайле (выборка ограничена, чтобы обучение
+    // не занимало больше самого сжатия), затем все блобы сжимаются с ним. В режиме
+    // внешней памяти выборка — из первой группы тайлов
+    std::vector<std::unique_ptr<TileCompressor>> compressors;  // по одному на поток (свой контекст zstd)
+    if (zstd) {
+      std::vector<std::vector<uint8_t>> samples;
+      const size_t maxSamples = std::max<size_t>(1000, zstdDictSize / 1024 * 100);
+      const size_t step = std::max<size_t>(1, ordered.size() / maxSamples);
+      for (size_t idx = 0; idx < ordered.size(); idx += step) samples.push_back(buildBlob(*ordered[idx]));
+      auto dict = TileCompressor::trainDictionary(samples, zstdDictSize);
+      if (zstdDictSize > 0 && dict.empty()) {
+        std::fprintf(stderr, "zstd dictionary training failed (too few samples?), compressing without dictionary\n");
+      }
+      for (int w = 0; w < std::max(1, threads); ++w) {
+        compressors.push_back(std::make_unique<TileCompressor>(dict, zstdLevel));
+      }
+      const std::string dictB64 = routing_core::base64Encode(dict.data(), dict.size());
+      if (pack) {
+        pack->setMetadata("tile_compression", "zstd");
+        if (!dict.empty()) pack->setMetadata("zstd_dict", dictB64);
+      } else {
+        writer->writeMetadata("tile_compression", "zstd");
+        if (!dict.empty()) writer->writeMetadata("zstd_dict", dictB64);
       }
-#else
-      checksum_hex = "";
-#endif
+      std::printf("zstd dictionary: %zu bytes from %zu samples\n", dict.size(), samples.size());
+    }
 
-      // Use real WebMercator z/x/y
-      int z = t.key.z;
-      int x = t.key.x;
-      int y = t.key.y;
+    // Сериализация и сжатие — в пуле потоков, запись — в этом потоке по порядку тайлов
+    struct BuiltTile {
+      std::vector<uint8_t> blob;
+      std::vector<uint8_t> geometry;
+      size_t rawSize {0};
+      std::string checksum;
+    };
+    auto build = [&](size_t i, int worker) {
+      ROUTING_TRACE_SCOPE("converter", "buildTile");
+      const TileData& t = *ordered[i];
+      BuiltTile out;
+      out.blob = buildBlob(t, geometryLayer ? &out.geometry : nullptr);
+      out.rawSize = out.blob.size();
+      if (!compressors.empty()) {
+        out.blob = compressors[static_cast<size_t>(worker)]->compress(out.blob);
+        // Геометрия сжимается тем же компрессором (словарь обучен на тайлах, но varint-поток
+        // обычно всё равно ужимается; несжимаемый блоб остаётся как есть)
+        if (geometryLayer) out.geometry = compressors[static_cast<size_t>(worker)]->compress(out.geometry);
+      }
+      out.checksum = blobChecksum(out.blob);
+      return out;
+    };
 
-      writer.insertLandTile(z, x, y, t.bbox, version, checksum_hex, profile_mask,
-                            blob.data(), blob.size());
+    int count_written = 0;
+    size_t rawBytes = 0, storedBytes = 0, geometryBytes = 0;
+    auto write = [&](size_t i, BuiltTile&& b) {
+      ROUTING_TRACE_SCOPE("converter", "writeTile");
+      const TileData& t = *ordered[i];
+      // Use real WebMercator z/x/y
+      const int z = t.key.z, x = t.key.x, y = t.key.y;
+      rawBytes += b.rawSize;
+      storedBytes += b.blob.size();
+      if (pack) {
+        pack->addTile(z, x, y, version, b.blob.data(), b.blob.size());
+      } else {
+        writer->insertLandTile(z, x, y, t.bbox, version, b.checksum, profile_mask,
+                               b.blob.data(), b.blob.size());
+      }
+      if (geometryLayer) {
+        geometryBytes += b.geometry.size();
+        if (pack) {
+          pack->addTile(z | routing_core::kGeometryLayerBit, x, y, version, b.geometry.data(), b.geometry.size());
+        } else {
+          writer->insertGeometry(z, x, y, b.geometry.data(), b.geometry.size());
+        }
+      }
       ++count_written;
-    }
+    };
+    size_t groups = 0;
+    do {
+      if (groups > 0) orderTiles();
+      runOrderedPipeline<BuiltTile>(ordered.size(), threads, static_cast<size_t>(std::max(1, threads)) * 4,
+                                    build, write);
+      ++groups;
+    } while (spill && spill->nextGroup(tiles));
+    if (pack) pack->finish();
+    else writer->finishBulkLoad();
     std::printf("Written tiles: %d\n", count_written);
-    std::puts("Created routing SQLite container with schema (metadata + land_tiles)");
+    if (spill) std::printf("Tile groups: %zu\n", groups);
+    if (!compressors.empty()) std::printf("Tile bytes: %zu raw, %zu stored\n", rawBytes, storedBytes);
+    if (geometryLayer) std::printf("Geometry layer bytes: %zu\n", geometryBytes);
+    if (!tracePath.empty() && !routing_core::trace::dump(tracePath)) {
+      std::fprintf(stderr, "Failed to write trace to %s\n", tracePath.c_str());
+    }
+    std::puts(pack ? "Created routing tile pack (index + page-aligned blobs)"
+                   : "Created routing SQLite container with schema (metadata + land_tiles)");
     return 0;
   } catch (const std::exception& ex) {
     std::fprintf(stderr, "Error: %s\n", ex.what());
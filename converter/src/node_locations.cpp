@@ -0,0 +1,82 @@
+#include "node_locations.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "routing_core/trace.h"
+
+NodeLocationStore::NodeLocationStore(std::string filePath) : filePath_(std::move(filePath)) {}
+
+NodeLocationStore::~NodeLocationStore() {
+  if (map_) {
+    ::munmap(map_, mapSize_);
+    ::unlink(filePath_.c_str());
+  }
+}
+
+void NodeLocationStore::finalize() {
+  ROUTING_TRACE_SCOPE_ARG("converter", "nodeLocations.finalize", "refs", pending_.size());
+  std::sort(pending_.begin(), pending_.end());
+  pending_.erase(std::unique(pending_.begin(), pending_.end()), pending_.end());
+  count_ = pending_.size();
+
+  if (filePath_.empty()) {
+    pending_.shrink_to_fit();
+    idsHeap_ = std::move(pending_);
+    locsHeap_.assign(count_, Location{kUndefined, kUndefined});
+    ids_ = idsHeap_.data();
+    locs_ = locsHeap_.data();
+  } else {
+    const size_t idsBytes = count_ * sizeof(int64_t);
+    mapSize_ = std::max<size_t>(1, idsBytes + count_ * sizeof(Location));
+    const int fd = ::open(filePath_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("Failed to create node store: " + filePath_ + ": " + std::strerror(errno));
+    if (::ftruncate(fd, static_cast<off_t>(mapSize_)) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Failed to size node store: " + filePath_ + ": " + std::strerror(errno));
+    }
+    void* p = ::mmap(nullptr, mapSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) throw std::runtime_error("Failed to mmap node store: " + filePath_ + ": " + std::strerror(errno));
+    map_ = p;
+    auto* ids = static_cast<int64_t*>(map_);
+    std::copy(pending_.begin(), pending_.end(), ids);
+    locs_ = reinterpret_cast<Location*>(static_cast<char*>(map_) + idsBytes);
+    std::fill(locs_, locs_ + count_, Location{kUndefined, kUndefined});
+    ids_ = ids;
+    pending_.clear();
+    pending_.shrink_to_fit();
+  }
+}
+
+size_t NodeLocationStore::find(int64_t id) const {
+  const int64_t* it = std::lower_bound(ids_, ids_ + count_, id);
+  return (it != ids_ + count_ && *it == id) ? static_cast<size_t>(it - ids_) : count_;
+}
+
+bool NodeLocationStore::set(int64_t id, double lat, double lon) {
+  const size_t i = find(id);
+  if (i == count_) return false;
+  locs_[i] = Location{static_cast<int32_t>(std::lround(lat * 1e7)), static_cast<int32_t>(std::lround(lon * 1e7))};
+  return true;
+}
+
+bool NodeLocationStore::get(int64_t id, double& lat, double& lon) const {
+  const size_t i = find(id);
+  if (i == count_ || locs_[i].lat == kUndefined) return false;
+  lat = locs_[i].lat / 1e7;
+  lon = locs_[i].lon / 1e7;
+  return true;
+}
+
+size_t NodeLocationStore::memoryBytes() const {
+  return pending_.capacity() * sizeof(int64_t) + idsHeap_.capacity() * sizeof(int64_t) +
+         locsHeap_.capacity() * sizeof(Location);
+}
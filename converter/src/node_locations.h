@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Координаты узлов, на которые ссылаются дороги.
+//
+// Проход по way собирает ID нужных узлов (addId), finalize() сортирует их; проход по
+// узлам записывает координаты только этих узлов (set). Хранение — два параллельных
+// массива: отсортированные ID (8 байт) и координаты в 1e-7 градуса, как в OSM (8 байт),
+// поиск — двоичный. С filePath массивы лежат в отображённом в память файле (удаляется
+// в деструкторе): страницы вытесняет ОС, в RAM остаётся только рабочее множество.
+class NodeLocationStore {
+public:
+  explicit NodeLocationStore(std::string filePath = {});
+  ~NodeLocationStore();
+  NodeLocationStore(const NodeLocationStore&) = delete;
+  NodeLocationStore& operator=(const NodeLocationStore&) = delete;
+
+  void addId(int64_t id) { pending_.push_back(id); }
+  // Зафиксировать множество ID; после этого addId недоступен.
+  void finalize();
+
+  // Запомнить координаты узла; узлы вне множества пропускаются. Возвращает, нужен ли узел.
+  bool set(int64_t id, double lat, double lon);
+  // Координаты узла; false, если узел не нужен или его координат не было во входе.
+  bool get(int64_t id, double& lat, double& lon) const;
+
+  size_t size() const { return count_; }
+  // Байт в куче (без отображённого файла).
+  size_t memoryBytes() const;
+
+private:
+  struct Location { int32_t lat; int32_t lon; };
+  static constexpr int32_t kUndefined = INT32_MIN;
+
+  size_t find(int64_t id) const;  // индекс или count_
+
+  std::string filePath_;
+  std::vector<int64_t> pending_;
+  // в куче, если без файла
+  std::vector<int64_t> idsHeap_;
+  std::vector<Location> locsHeap_;
+  // отображение файла
+  void* map_ {nullptr};
+  size_t mapSize_ {0};
+
+  const int64_t* ids_ {nullptr};
+  Location* locs_ {nullptr};
+  size_t count_ {0};
+};
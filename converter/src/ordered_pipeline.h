@@ -0,0 +1,97 @@
+#pragma once
+
+// Конвейер «пул потоков → один писатель» с сохранением порядка.
+//
+// Рабочие потоки берут индексы 0..count-1 по порядку и вызывают produce(index, worker);
+// вызывающий поток — единственный писатель — получает результаты строго по возрастанию
+// индекса и передаёт их в consume(index, result). Между писателем и рабочими — окно из
+// window слотов: поток не начинает индекс, пока писатель не забрал index - window, так что
+// в памяти одновременно не больше window готовых результатов, а выход детерминирован
+// независимо от числа потоков.
+//
+// Исключение из produce или consume останавливает конвейер и пробрасывается писателю.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "routing_core/trace.h"
+
+template <class Result, class Produce, class Consume>
+void runOrderedPipeline(size_t count, int threads, size_t window, Produce&& produce, Consume&& consume) {
+  window = std::max<size_t>(1, window);
+  if (threads <= 1) {
+    for (size_t i = 0; i < count; ++i) consume(i, produce(i, 0));
+    return;
+  }
+
+  std::mutex mu;
+  std::condition_variable slotFree;   // писатель забрал результат — окно сдвинулось
+  std::condition_variable resultReady;
+  std::vector<std::optional<Result>> slots(window);
+  size_t next = 0;     // следующий индекс для рабочих
+  size_t written = 0;  // сколько результатов забрал писатель
+  bool abort = false;
+  std::exception_ptr error;
+
+  auto worker = [&](int w) {
+    while (true) {
+      size_t i;
+      {
+        std::unique_lock<std::mutex> lock(mu);
+        slotFree.wait(lock, [&] { return abort || next >= count || next < written + window; });
+        if (abort || next >= count) return;
+        i = next++;
+      }
+      try {
+        Result r = produce(i, w);
+        std::lock_guard<std::mutex> lock(mu);
+        slots[i % window].emplace(std::move(r));
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mu);
+        if (!error) error = std::current_exception();
+        abort = true;
+        slotFree.notify_all();
+      }
+      resultReady.notify_one();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(static_cast<size_t>(threads));
+  for (int w = 0; w < threads; ++w) pool.emplace_back(worker, w);
+
+  try {
+    for (size_t i = 0; i < count; ++i) {
+      std::optional<Result> r;
+      {
+        ROUTING_TRACE_SCOPE("converter", "pipeline.wait");
+        std::unique_lock<std::mutex> lock(mu);
+        resultReady.wait(lock, [&] { return abort || slots[i % window].has_value(); });
+        if (abort) break;
+        r = std::move(slots[i % window]);
+        slots[i % window].reset();
+        ++written;
+      }
+      slotFree.notify_all();
+      consume(i, std::move(*r));
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mu);
+    if (!error) error = std::current_exception();
+    abort = true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mu);
+    if (error) abort = true;
+  }
+  slotFree.notify_all();
+  for (auto& t : pool) t.join();
+  if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,159 @@
+#include "osc_update.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include "serializer.h"
+#include "sqlite_writer.h"
+#include "tile_compressor.h"
+#include "routing_core/base64.h"
+#include "routing_core/trace.h"
+
+#ifdef HAVE_LIBOSMIUM
+#  include <osmium/io/any_input.hpp>
+#  include <osmium/osm/node.hpp>
+#  include <osmium/osm/way.hpp>
+#endif
+
+OscChanges readOscChanges(const std::string& path) {
+  ROUTING_TRACE_SCOPE("converter", "readOscChanges");
+  OscChanges changes;
+#ifdef HAVE_LIBOSMIUM
+  // В .osc один объект может встречаться несколько раз — берётся старшая версия
+  std::unordered_map<int64_t, uint32_t> nodeVersions, wayVersions;
+  osmium::io::Reader reader{path, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way};
+  while (osmium::memory::Buffer buffer = reader.read()) {
+    for (const osmium::OSMEntity& entity : buffer) {
+      if (entity.type() == osmium::item_type::node) {
+        const auto& n = static_cast<const osmium::Node&>(entity);
+        auto [it, inserted] = nodeVersions.emplace(n.id(), n.version());
+        if (!inserted && it->second > n.version()) continue;
+        it->second = n.version();
+        if (n.deleted() || !n.location().valid()) changes.nodes[n.id()] = std::nullopt;
+        else changes.nodes[n.id()] = OscChanges::Location{n.location().lat(), n.location().lon()};
+      } else if (entity.type() == osmium::item_type::way) {
+        const auto& w = static_cast<const osmium::Way&>(entity);
+        auto [it, inserted] = wayVersions.emplace(w.id(), w.version());
+        if (!inserted && it->second > w.version()) continue;
+        it->second = w.version();
+        const char* highway = w.tags().get_value_by_key("highway");
+        if (w.deleted() || !highway) {
+          changes.ways[w.id()] = std::nullopt;
+          continue;
+        }
+        RoadWay rw = roadWayFor(highway, w.tags().has_tag("oneway", "yes"));
+        rw.shape.reserve(w.nodes().size());
+        for (const auto& nd_ref : w.nodes()) rw.shape.push_back(SimpleNode{nd_ref.positive_ref(), 0.0, 0.0});
+        changes.ways[w.id()] = std::move(rw);
+      }
+    }
+  }
+  reader.close();
+#else
+  (void)path;
+  throw std::runtime_error("Reading OSM change files requires libosmium");
+#endif
+  return changes;
+}
+
+namespace {
+
+bool touches(const SimpleEdge& e, const std::unordered_set<int64_t>& touched) {
+  return std::any_of(e.shape.begin(), e.shape.end(), [&](const SimpleNode& n) { return touched.count(n.id) > 0; });
+}
+
+} // namespace
+
+OscUpdateStats applyOscUpdate(const OscUpdateOptions& options) {
+  ROUTING_TRACE_SCOPE("converter", "applyOscUpdate");
+  OscUpdateStats stats;
+  const OscChanges changes = readOscChanges(options.oscPath);
+
+  RoutingDbWriter db(options.dbPath);
+  const int schemaVersion = std::stoi(db.readMetadata("schema_version").value_or("1"));
+  const bool geometryLayer = db.readMetadata("geometry_layer").value_or("") == "separate";
+  std::unique_ptr<TileCompressor> compressor;
+  if (db.readMetadata("tile_compression").value_or("") == "zstd") {
+    std::vector<uint8_t> dict;
+    if (auto b64 = db.readMetadata("zstd_dict")) {
+      auto decoded = routing_core::base64Decode(*b64);
+      if (!decoded) throw std::runtime_error("Invalid zstd_dict in metadata: " + options.dbPath);
+      dict = std::move(*decoded);
+    }
+    compressor = std::make_unique<TileCompressor>(dict, options.zstdLevel);
+  }
+
+  // Затронутые тайлы: рёбра через затронутые узлы в старом графе...
+  std::unordered_map<long long, TileKey> affected;
+  {
+    ROUTING_TRACE_SCOPE("converter", "applyOscUpdate.oldGraph");
+    PbfReader before(options.pbfPath, options.zoom, options.contractChains, options.threads, options.nodeStorePath);
+    before.setChanges(&changes, false);
+    before.readWays();
+    stats.touchedNodes = before.touchedNodes().size();
+    before.forEachEdge([&](const TileKey& tk, SimpleEdge&& e) {
+      if (touches(e, before.touchedNodes())) affected.emplace(packTileKey(tk), tk);
+    });
+  }
+
+  // ...и в новом; затем все рёбра нового графа в этих тайлах
+  std::unordered_map<long long, TileData> tiles;
+  {
+    ROUTING_TRACE_SCOPE("converter", "applyOscUpdate.newGraph");
+    PbfReader after(options.pbfPath, options.zoom, options.contractChains, options.threads, options.nodeStorePath);
+    after.setChanges(&changes, true);
+    after.readWays();
+    after.forEachEdge([&](const TileKey& tk, SimpleEdge&& e) {
+      if (touches(e, after.touchedNodes())) affected.emplace(packTileKey(tk), tk);
+    });
+    after.forEachEdge([&](const TileKey& tk, SimpleEdge&& e) {
+      const long long key = packTileKey(tk);
+      if (!affected.count(key)) return;
+      auto& td = tiles[key];
+      td.key = tk;
+      td.bbox = tileBounds(tk);
+      td.nodes.push_back(e.shape.front());
+      td.nodes.push_back(e.shape.back());
+      td.edges.push_back(std::move(e));
+    });
+  }
+
+  // Порядок ключей — детерминированный выход
+  std::vector<TileKey> ordered;
+  ordered.reserve(affected.size());
+  for (const auto& [key, tk] : affected) ordered.push_back(tk);
+  std::sort(ordered.begin(), ordered.end(), [](const TileKey& a, const TileKey& b) {
+    return std::tie(a.z, a.x, a.y) < std::tie(b.z, b.x, b.y);
+  });
+
+  const uint32_t profile_mask = 0x3; // car|foot, как при конвертации
+  db.beginTransaction();
+  for (const TileKey& tk : ordered) {
+    auto it = tiles.find(packTileKey(tk));
+    if (it == tiles.end()) {
+      db.deleteTile(tk.z, tk.x, tk.y);
+      ++stats.tilesDeleted;
+      continue;
+    }
+    ROUTING_TRACE_SCOPE("converter", "applyOscUpdate.tile");
+    const uint32_t version = static_cast<uint32_t>(db.tileVersion(tk.z, tk.x, tk.y).value_or(0) + 1);
+    std::vector<uint8_t> geometry;
+    std::vector<uint8_t> blob = schemaVersion == 2
+        ? buildLandTileBlobV2(it->second, version, profile_mask, geometryLayer ? &geometry : nullptr)
+        : buildLandTileBlob(it->second, version, profile_mask);
+    if (compressor) {
+      blob = compressor->compress(blob);
+      if (geometryLayer) geometry = compressor->compress(geometry);
+    }
+    db.upsertLandTile(tk.z, tk.x, tk.y, it->second.bbox, static_cast<int>(version), blobChecksum(blob),
+                      profile_mask, blob.data(), blob.size());
+    if (geometryLayer) db.upsertGeometry(tk.z, tk.x, tk.y, geometry.data(), geometry.size());
+    ++stats.tilesUpdated;
+  }
+  db.commitTransaction();
+  return stats;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "chain_contraction.h"
+
+// Изменения OSM из файла .osc (osmChange): последняя версия каждого узла и way.
+struct OscChanges {
+  struct Location { double lat; double lon; };
+  // Новые координаты; nullopt — узел удалён
+  std::unordered_map<int64_t, std::optional<Location>> nodes;
+  // Новая версия way как дороги (в форме только ID узлов); nullopt — удалён или больше
+  // не дорога
+  std::unordered_map<int64_t, std::optional<RoadWay>> ways;
+};
+
+OscChanges readOscChanges(const std::string& path);
+
+struct OscUpdateOptions {
+  std::string oscPath;
+  std::string pbfPath;  // PBF, из которого собрана БД (до изменений)
+  std::string dbPath;   // routingdb (SQLite), обновляется на месте
+  int zoom {14};
+  bool contractChains {true};
+  int threads {1};
+  std::string nodeStorePath;
+  int zstdLevel {12};
+};
+
+struct OscUpdateStats {
+  size_t touchedNodes {0};
+  size_t tilesUpdated {0};
+  size_t tilesDeleted {0};
+};
+
+// Переписать только тайлы, затронутые изменениями.
+//
+// Затронутые узлы — узлы из .osc и узлы старых и новых версий изменённых ways. Ребро,
+// не проходящее ни через один затронутый узел, одинаково в старом и новом графе (его
+// концы и атрибуты не менялись), поэтому затронуты ровно тайлы рёбер с затронутыми
+// узлами — в старом графе (исходный PBF) и в новом (PBF + .osc); сюда же попадают
+// соседние тайлы, чьи рёбра кончаются в общем с изменённой дорогой узле. Эти тайлы
+// сериализуются заново из нового графа с version + 1 и заменяют прежние в land_tiles
+// (и land_geometry); тайлы, где рёбер не осталось, удаляются. Всё — одной транзакцией.
+OscUpdateStats applyOscUpdate(const OscUpdateOptions& options);
@@ -1,9 +1,14 @@
 #include "pbf_reader.h"
+#include "chain_contraction.h"
+#include "node_locations.h"
+#include "osc_update.h"
 
 #include <cmath>
 #include <stdexcept>
 #include <unordered_map>
 
+#include "routing_core/trace.h"
+
 #ifdef HAVE_LIBOSMIUM
 #  include <osmium/io/any_input.hpp>
 #  include <osmium/handler.hpp>
@@ -11,100 +16,132 @@
 #  include <osmium/osm/types.hpp>
 #  include <osmium/osm/way.hpp>
 #  include <osmium/osm/node.hpp>
+#  include <osmium/osm/entity_bits.hpp>
+#  include <osmium/thread/pool.hpp>
 #endif
 
-PbfReader::PbfReader(std::string input_path, int zoom)
-  : input_path_(std::move(input_path)), zoom_(zoom) {}
-
-static inline long long make_key(const TileKey& k) {
-  return (static_cast<long long>(k.z) << 58) ^ (static_cast<long long>(k.x) << 29) ^ static_cast<long long>(k.y);
+PbfReader::PbfReader(std::string input_path, int zoom, bool contractChains, int threads,
+                     std::string nodeStorePath)
+  : input_path_(std::move(input_path)), zoom_(zoom), contractChains_(contractChains), threads_(threads),
+    nodeStorePath_(std::move(nodeStorePath)) {}
+
+PbfReader::~PbfReader() = default;
+
+void PbfReader::setChanges(const OscChanges* changes, bool apply) {
+  changes_ = changes;
+  applyChanges_ = apply;
+  touched_.clear();
+  if (!changes_) return;
+  for (const auto& [id, loc] : changes_->nodes) touched_.insert(id);
+  for (const auto& [id, rw] : changes_->ways) {
+    if (!rw) continue;
+    for (const auto& n : rw->shape) touched_.insert(n.id);
+  }
 }
 
 std::unordered_map<long long, TileData> PbfReader::readAndTile() {
+  ROUTING_TRACE_SCOPE("converter", "readAndTile");
   std::unordered_map<long long, TileData> result;
+  readEdges([&](const TileKey& tk, SimpleEdge&& e) {
+    auto& td = result[packTileKey(tk)];
+    td.key = tk;
+    td.bbox = tileBounds(tk);
+
+    // Добавить вершины (уникальность по id в будущем, пока просто пушим)
+    td.nodes.push_back(e.shape.front());
+    td.nodes.push_back(e.shape.back());
+    td.edges.push_back(std::move(e));
+  });
+  return result;
+}
 
-#ifdef HAVE_LIBOSMIUM
-  osmium::io::Reader reader{input_path_};
+void PbfReader::readEdges(const std::function<void(const TileKey&, SimpleEdge&&)>& sink) {
+  readWays();
+  forEachEdge(sink);
+  ways_.clear();
+  ways_.shrink_to_fit();
+}
 
-  std::unordered_map<osmium::object_id_type, SimpleNode> node_index;
+void PbfReader::readWays() {
+  ways_.clear();
 
-  // Первый проход: собрать узлы
+#ifdef HAVE_LIBOSMIUM
+  // Блоки PBF распаковываются и декодируются параллельно в пуле osmium; каждый проход
+  // декодирует только нужный тип объектов и без метаданных (версии, авторы)
+  osmium::thread::Pool pool{threads_};
+
+  // Первый проход: ways c highway=* и ID их узлов (координаты — на втором проходе)
+  NodeLocationStore locations(nodeStorePath_);
+  routing_core::trace::Span waysPass("converter", "readWays.ways");
+  osmium::io::Reader reader{input_path_, osmium::osm_entity_bits::way, osmium::io::read_meta::no, pool};
   while (osmium::memory::Buffer buffer = reader.read()) {
-    for (const osmium::OSMEntity& entity : buffer) {
-      if (entity.type() == osmium::item_type::node) {
-        const auto& n = static_cast<const osmium::Node&>(entity);
-        SimpleNode sn{n.id(), n.location().lat(), n.location().lon()};
-        node_index[sn.id] = sn;
-      }
-    }
-  }
-  reader.close();
-
-  // Второй проход: собрать ways c highway=*
-  osmium::io::Reader reader2{input_path_};
-  while (osmium::memory::Buffer buffer = reader2.read()) {
     for (const osmium::OSMEntity& entity : buffer) {
       if (entity.type() == osmium::item_type::way) {
         const auto& w = static_cast<const osmium::Way&>(entity);
+        // Way, изменённый в .osc: узлы старой версии затронуты; с apply старая версия
+        // заменяется новой (ниже)
+        if (changes_) {
+          auto changed = changes_->ways.find(w.id());
+          if (changed != changes_->ways.end()) {
+            for (const auto& nd_ref : w.nodes()) touched_.insert(nd_ref.positive_ref());
+            if (applyChanges_) continue;
+          }
+        }
         const char* highway = w.tags().get_value_by_key("highway");
         if (!highway) continue;
 
-        // Простейший маппинг классов
-        int road_class = 3; // RESIDENTIAL default
-        if (std::strcmp(highway, "motorway") == 0) road_class = 0;
-        else if (std::strcmp(highway, "primary") == 0) road_class = 1;
-        else if (std::strcmp(highway, "secondary") == 0) road_class = 2;
-        else if (std::strcmp(highway, "footway") == 0) road_class = 4;
-        else if (std::strcmp(highway, "path") == 0) road_class = 5;
-        else if (std::strcmp(highway, "steps") == 0) road_class = 6;
-
-        const bool oneway = w.tags().has_tag("oneway", "yes");
-
-        std::vector<SimpleNode> shape;
-        shape.reserve(w.nodes().size());
+        RoadWay rw = roadWayFor(highway, w.tags().has_tag("oneway", "yes"));
+        rw.shape.reserve(w.nodes().size());
         for (const auto& nd_ref : w.nodes()) {
-          auto it = node_index.find(nd_ref.positive_ref());
-          if (it == node_index.end()) continue;
-          shape.push_back(it->second);
-        }
-        if (shape.size() < 2) continue;
-
-        // Разложить по сегментам между последовательными точками
-        for (size_t s = 1; s < shape.size(); ++s) {
-          const SimpleNode& a = shape[s - 1];
-          const SimpleNode& b = shape[s];
-          // Тайл по центру сегмента
-          const double lat_c = 0.5 * (a.lat + b.lat);
-          const double lon_c = 0.5 * (a.lon + b.lon);
-          TileKey tk = tileKeyFor(lat_c, lon_c, zoom_);
-          long long key = make_key(tk);
-          auto& td = result[key];
-          td.key = tk;
-          td.bbox = tileBounds(tk);
-
-          // Добавить вершины (уникальность по id в будущем, пока просто пушим)
-          td.nodes.push_back(a);
-          td.nodes.push_back(b);
-
-          SimpleEdge e;
-          e.from_node_id = a.id;
-          e.to_node_id = b.id;
-          e.shape = {a, b};
-          e.oneway = oneway;
-          e.road_class = road_class;
-          e.car_access = !(road_class >= 4); // нет для чисто пешеходных
-          e.foot_access = true;
-          td.edges.push_back(std::move(e));
+          rw.shape.push_back(SimpleNode{nd_ref.positive_ref(), 0.0, 0.0});
+          locations.addId(nd_ref.positive_ref());
         }
+        if (rw.shape.size() < 2) continue;
+        ways_.push_back(std::move(rw));
+      }
+    }
+  }
+  reader.close();
+  if (changes_ && applyChanges_) {
+    for (const auto& [id, rw] : changes_->ways) {
+      if (!rw || rw->shape.size() < 2) continue;
+      for (const auto& n : rw->shape) locations.addId(n.id);
+      ways_.push_back(*rw);
+    }
+  }
+  waysPass.end();
+  locations.finalize();
+
+  // Второй проход: координаты только тех узлов, что нужны дорогам
+  ROUTING_TRACE_SCOPE("converter", "readWays.nodes");
+  osmium::io::Reader reader2{input_path_, osmium::osm_entity_bits::node, osmium::io::read_meta::no, pool};
+  while (osmium::memory::Buffer buffer = reader2.read()) {
+    for (const osmium::OSMEntity& entity : buffer) {
+      if (entity.type() == osmium::item_type::node) {
+        const auto& n = static_cast<const osmium::Node&>(entity);
+        if (changes_ && applyChanges_ && changes_->nodes.count(n.id())) continue;  // версия из .osc
+        if (n.location().valid()) locations.set(n.id(), n.location().lat(), n.location().lon());
       }
     }
   }
   reader2.close();
-#else
-  (void)result; // подавить предупреждения в окружении без libosmium
-#endif
+  if (changes_ && applyChanges_) {
+    for (const auto& [id, loc] : changes_->nodes) {
+      if (loc) locations.set(id, loc->lat, loc->lon);
+    }
+  }
+  nodeCount_ = locations.size();
+  nodeStoreBytes_ = locations.memoryBytes();
 
-  return result;
+  // Координаты в формы дорог; узлы без координат (обрезка выгрузки) пропускаются
+  resolveWayShapes(ways_, locations);
+#endif
 }
 
-
+void PbfReader::forEachEdge(const std::function<void(const TileKey&, SimpleEdge&&)>& sink) {
+  // Рёбра (цепочки узлов степени 2 свёрнуты) — по тайлам: тайл по центру первого сегмента
+  forEachRoadEdge(ways_, zoom_, contractChains_, [&](SimpleEdge&& e) {
+    const TileKey tk = edgeTileKey(e, zoom_);
+    sink(tk, std::move(e));
+  }, &stats_);
+}
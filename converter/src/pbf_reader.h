@@ -1,7 +1,9 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <optional>
 
@@ -39,15 +41,60 @@ struct TileData {
   BBox bbox;
 };
 
+// Сколько рёбер дало сжатие цепочек (chain_contraction.h)
+struct ContractionStats {
+  size_t segments {0};  // рёбер без сжатия (по сегменту на пару соседних точек)
+  size_t edges {0};
+};
+
+struct RoadWay;     // chain_contraction.h
+struct OscChanges;  // osc_update.h
+
 class PbfReader {
 public:
-  explicit PbfReader(std::string input_path, int zoom);
+  // contractChains: сворачивать цепочки узлов степени 2 в рёбра между перекрёстками;
+  // threads — потоков декодирования блоков PBF; nodeStorePath — файл для координат
+  // узлов (mmap, см. NodeLocationStore), пусто — в памяти
+  explicit PbfReader(std::string input_path, int zoom, bool contractChains = true, int threads = 1,
+                     std::string nodeStorePath = {});
+  ~PbfReader();
   // Возвращает карту тайл-ключ -> данные тайла
   std::unordered_map<long long, TileData> readAndTile();
+  // То же без накопления: каждое ребро с его тайлом отдаётся в sink (режим внешней
+  // памяти, см. EdgeSpill). Дороги и координаты узлов при этом всё ещё в памяти.
+  void readEdges(const std::function<void(const TileKey&, SimpleEdge&&)>& sink);
+
+  // По шагам: readWays() читает дороги и координаты их узлов, forEachEdge() сжимает
+  // цепочки и отдаёт рёбра (можно вызывать несколько раз по тем же дорогам).
+  void readWays();
+  void forEachEdge(const std::function<void(const TileKey&, SimpleEdge&&)>& sink);
+
+  // Изменения из .osc (до readWays). apply — читать PBF с наложенными изменениями,
+  // иначе — исходный PBF. В обоих случаях собираются затронутые узлы: узлы из .osc,
+  // узлы старых и новых версий изменённых ways.
+  void setChanges(const OscChanges* changes, bool apply);
+  const std::unordered_set<int64_t>& touchedNodes() const { return touched_; }
+
+  // Сегментов дорог и рёбер после сжатия цепочек (после readAndTile/readEdges)
+  size_t segmentCount() const { return stats_.segments; }
+  size_t edgeCount() const { return stats_.edges; }
+  // Узлов, на которые ссылаются дороги, и память под их координаты (без mmap-файла)
+  size_t nodeCount() const { return nodeCount_; }
+  size_t nodeStoreBytes() const { return nodeStoreBytes_; }
 
 private:
   std::string input_path_;
   int zoom_ {14};
+  bool contractChains_ {true};
+  int threads_ {1};
+  std::string nodeStorePath_;
+  size_t nodeCount_ {0};
+  size_t nodeStoreBytes_ {0};
+  ContractionStats stats_;
+  std::vector<RoadWay> ways_;
+  const OscChanges* changes_ {nullptr};
+  bool applyChanges_ {false};
+  std::unordered_set<int64_t> touched_;
 };
 
 
@@ -1,49 +1,146 @@
 #include "serializer.h"
 
+#include <algorithm>
 #include <cmath>
-#include <unordered_map>
+#include <numeric>
 #include <flatbuffers/flatbuffers.h>
 #include "land_tile_generated.h"
+#include "routing_core/flat_hash_map.h"
+#include "routing_core/trace.h"
+#include "routing_core/xxhash64.h"
 
 using namespace Routing;
 
+namespace {
+
+float haversine(double lat1, double lon1, double lat2, double lon2) {
+  constexpr double R = 6371000.0;
+  const double phi1 = lat1 * M_PI / 180.0;
+  const double phi2 = lat2 * M_PI / 180.0;
+  const double dphi = (lat2 - lat1) * M_PI / 180.0;
+  const double dl = (lon2 - lon1) * M_PI / 180.0;
+  const double a = std::sin(dphi/2)*std::sin(dphi/2) + std::cos(phi1)*std::cos(phi2)*std::sin(dl/2)*std::sin(dl/2);
+  const double c = 2 * std::atan2(std::sqrt(a), std::sqrt(1-a));
+  return static_cast<float>(R * c);
+}
+
+float car_speed_for_class(int road_class) {
+  switch (road_class) {
+    case 0: return 27.78f; // MOTORWAY ~100 km/h
+    case 1: return 22.22f; // PRIMARY ~80
+    case 2: return 16.67f; // SECONDARY ~60
+    case 3: return 13.89f; // RESIDENTIAL ~50
+    default: return 0.0f;  // foot-only
+  }
+}
+
+// Длина ребра по всей форме (после сжатия цепочек ребро — ломаная через промежуточные узлы)
+float shapeLength(const SimpleEdge& e) {
+  double len = 0.0;
+  for (size_t k = 1; k < e.shape.size(); ++k) {
+    len += haversine(e.shape[k - 1].lat, e.shape[k - 1].lon, e.shape[k].lat, e.shape[k].lon);
+  }
+  return static_cast<float>(len);
+}
+
+int quantize(double deg) { return static_cast<int>(std::lround(deg * 1e6)); }
+
+// Локальные индексы узлов тайла: концы рёбер в порядке первого появления.
+struct LocalNodes {
+  routing_core::FlatHashMap<long long, uint32_t> idOf;
+  std::vector<SimpleNode> nodes;
+
+  explicit LocalNodes(const TileData& tile) {
+    nodes.reserve(tile.nodes.size());
+    idOf.reserve(tile.nodes.size());
+    for (const auto& e : tile.edges) {
+      if (!e.shape.empty()) {
+        add(e.shape.front());
+        add(e.shape.back());
+      }
+    }
+  }
+  uint32_t add(const SimpleNode& n) {
+    auto [it, inserted] = idOf.try_emplace(n.id, static_cast<uint32_t>(nodes.size()));
+    if (inserted) nodes.push_back(n);
+    return it->second;
+  }
+};
+
+// Смежность тайла: порядок рёбер по from_node (CSR first), обратная смежность по to_node.
+// Индексы рёбер — позиции в order, т.е. в тайле.
+struct Adjacency {
+  std::vector<size_t> order;      // индексы tile.edges в порядке записи
+  std::vector<uint32_t> first;    // N+1: исходящие рёбра узла n — [first[n], first[n+1])
+  std::vector<uint32_t> inFirst;  // N+1
+  std::vector<uint32_t> inEdges;  // рёбра по узлу назначения (внутри узла — по индексу)
+
+  Adjacency(const TileData& tile, const LocalNodes& local) {
+    const size_t N = local.nodes.size();
+    order.reserve(tile.edges.size());
+    for (size_t i = 0; i < tile.edges.size(); ++i) {
+      if (!tile.edges[i].shape.empty()) order.push_back(i);
+    }
+    auto fromOf = [&](size_t i) { return local.idOf.at(tile.edges[i].shape.front().id); };
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return fromOf(a) < fromOf(b); });
+
+    first.assign(N + 1, 0);
+    inFirst.assign(N + 1, 0);
+    std::vector<uint32_t> to(order.size());
+    for (size_t k = 0; k < order.size(); ++k) {
+      ++first[fromOf(order[k]) + 1];
+      to[k] = local.idOf.at(tile.edges[order[k]].shape.back().id);
+      ++inFirst[to[k] + 1];
+    }
+    std::partial_sum(first.begin(), first.end(), first.begin());
+    std::partial_sum(inFirst.begin(), inFirst.end(), inFirst.begin());
+    inEdges.resize(order.size());
+    std::vector<uint32_t> fill(inFirst.begin(), inFirst.end() - 1);
+    for (size_t k = 0; k < order.size(); ++k) inEdges[fill[to[k]]++] = static_cast<uint32_t>(k);
+  }
+  uint16_t outCount(size_t n) const {
+    return static_cast<uint16_t>(std::min<uint32_t>(first[n + 1] - first[n], 0xFFFF));
+  }
+};
+
+void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<uint8_t>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+void putZigzag(std::vector<uint8_t>& out, int32_t v) {
+  putVarint(out, (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31));
+}
+
+} // namespace
+
 std::vector<uint8_t> buildLandTileBlob(const TileData& tile,
                                        uint32_t version,
                                        uint32_t profile_mask) {
+  ROUTING_TRACE_SCOPE_ARG("converter", "buildLandTileBlob", "edges", tile.edges.size());
   flatbuffers::FlatBufferBuilder fbb(1024);
 
   // Build local node index used by edges
-  std::unordered_map<long long, uint32_t> node_id_to_local;
-  std::vector<SimpleNode> local_nodes;
-  local_nodes.reserve(tile.nodes.size());
-  auto add_node = [&](const SimpleNode& n) {
-    auto it = node_id_to_local.find(n.id);
-    if (it != node_id_to_local.end()) return it->second;
-    uint32_t idx = static_cast<uint32_t>(local_nodes.size());
-    node_id_to_local.emplace(n.id, idx);
-    local_nodes.push_back(n);
-    return idx;
-  };
-
-  for (const auto& e : tile.edges) {
-    if (!e.shape.empty()) {
-      add_node(e.shape.front());
-      add_node(e.shape.back());
-    }
-  }
+  LocalNodes local(tile);
+  auto& node_id_to_local = local.idOf;
+  const auto& local_nodes = local.nodes;
+  const Adjacency adj(tile, local);
 
   std::vector<flatbuffers::Offset<Node>> node_offsets;
   node_offsets.reserve(local_nodes.size());
   for (uint32_t local_id = 0; local_id < local_nodes.size(); ++local_id) {
     const auto& n = local_nodes[local_id];
-    int lat_q = static_cast<int>(std::lround(n.lat * 1e6));
-    int lon_q = static_cast<int>(std::lround(n.lon * 1e6));
+    int lat_q = quantize(n.lat);
+    int lon_q = quantize(n.lon);
     node_offsets.push_back(CreateNode(fbb,
                                       local_id, // id внутри тайла
                                       lat_q,
                                       lon_q,
-                                      0u,
-                                      0));
+                                      adj.first[local_id],
+                                      adj.outCount(local_id)));
   }
   auto nodes_vec = fbb.CreateVector(node_offsets);
 
@@ -53,31 +150,10 @@ std::vector<uint8_t> buildLandTileBlob(const TileData& tile,
 
   // Edges
   std::vector<flatbuffers::Offset<Edge>> fb_edges;
-  fb_edges.reserve(tile.edges.size());
-  auto haversine = [](double lat1, double lon1, double lat2, double lon2) -> float {
-    constexpr double R = 6371000.0;
-    const double phi1 = lat1 * M_PI / 180.0;
-    const double phi2 = lat2 * M_PI / 180.0;
-    const double dphi = (lat2 - lat1) * M_PI / 180.0;
-    const double dl = (lon2 - lon1) * M_PI / 180.0;
-    const double a = std::sin(dphi/2)*std::sin(dphi/2) + std::cos(phi1)*std::cos(phi2)*std::sin(dl/2)*std::sin(dl/2);
-    const double c = 2 * std::atan2(std::sqrt(a), std::sqrt(1-a));
-    return static_cast<float>(R * c);
-  };
-
-  auto car_speed_for_class = [](int road_class) -> float {
-    switch (road_class) {
-      case 0: return 27.78f; // MOTORWAY ~100 km/h
-      case 1: return 22.22f; // PRIMARY ~80
-      case 2: return 16.67f; // SECONDARY ~60
-      case 3: return 13.89f; // RESIDENTIAL ~50
-      default: return 0.0f;  // foot-only
-    }
-  };
-
-  for (const auto& e : tile.edges) {
-    float length_m = haversine(e.shape.front().lat, e.shape.front().lon,
-                               e.shape.back().lat,  e.shape.back().lon);
+  fb_edges.reserve(adj.order.size());
+  for (size_t i : adj.order) {
+    const auto& e = tile.edges[i];
+    float length_m = shapeLength(e);
     float speed_mps = e.car_access ? car_speed_for_class(e.road_class) : 0.0f;
     float foot_speed_mps = e.foot_access ? 1.4f : 0.0f; // ~5 km/h
     uint16_t access_mask = (e.car_access ? 0x1 : 0) | (e.foot_access ? 0x2 : 0);
@@ -85,9 +161,7 @@ std::vector<uint8_t> buildLandTileBlob(const TileData& tile,
     // shapes
     uint32_t shape_start = static_cast<uint32_t>(shape_offsets.size());
     for (const auto& sp : e.shape) {
-      int lat_q = static_cast<int>(std::lround(sp.lat * 1e6));
-      int lon_q = static_cast<int>(std::lround(sp.lon * 1e6));
-      shape_offsets.push_back(CreateShapePoint(fbb, lat_q, lon_q));
+      shape_offsets.push_back(CreateShapePoint(fbb, quantize(sp.lat), quantize(sp.lon)));
     }
     uint16_t shape_count = static_cast<uint16_t>(shape_offsets.size() - shape_start);
 
@@ -111,6 +185,8 @@ std::vector<uint8_t> buildLandTileBlob(const TileData& tile,
   }
   auto edges_vec = fbb.CreateVector(fb_edges);
   auto shapes_vec = fbb.CreateVector(shape_offsets);
+  auto in_first_vec = fbb.CreateVector(adj.inFirst);
+  auto in_edges_vec = fbb.CreateVector(adj.inEdges);
 
   auto checksum_str = fbb.CreateString("");
   auto land = CreateLandTile(fbb,
@@ -122,7 +198,9 @@ std::vector<uint8_t> buildLandTileBlob(const TileData& tile,
                              shapes_vec,
                              version,
                              checksum_str,
-                             profile_mask);
+                             profile_mask,
+                             in_first_vec,
+                             in_edges_vec);
   fbb.Finish(land);
 
   auto ptr = fbb.GetBufferPointer();
@@ -130,4 +208,98 @@ std::vector<uint8_t> buildLandTileBlob(const TileData& tile,
   return std::vector<uint8_t>(ptr, ptr + sz);
 }
 
+std::vector<uint8_t> buildLandTileBlobV2(const TileData& tile,
+                                         uint32_t version,
+                                         uint32_t profile_mask,
+                                         std::vector<uint8_t>* geometryOut) {
+  ROUTING_TRACE_SCOPE_ARG("converter", "buildLandTileBlobV2", "edges", tile.edges.size());
+  LocalNodes local(tile);
+
+  // Топология: рёбра упорядочены по from_node, узел хранит свой диапазон (CSR)
+  const Adjacency adj(tile, local);
+  const auto& order = adj.order;
+  std::vector<NodeV2> nodes(local.nodes.size());
+  for (size_t n = 0; n < local.nodes.size(); ++n) {
+    nodes[n] = NodeV2(quantize(local.nodes[n].lat), quantize(local.nodes[n].lon), adj.first[n], adj.outCount(n));
+  }
+
+  // Геометрия: только промежуточные точки, концы ребра — его узлы.
+  // С geometryOut — в отдельный слой (varint-приращения), иначе в shapes тайла.
+  std::vector<EdgeV2> edges;
+  std::vector<ShapePointV2> shapes;
+  std::vector<uint32_t> geomOffsets;
+  std::vector<uint8_t> geomPoints;
+  edges.reserve(order.size());
+  for (size_t i : order) {
+    const auto& e = tile.edges[i];
+    const uint32_t shape_start = static_cast<uint32_t>(shapes.size());
+    if (geometryOut) {
+      geomOffsets.push_back(static_cast<uint32_t>(geomPoints.size()));
+      int32_t lat = quantize(e.shape.front().lat), lon = quantize(e.shape.front().lon);
+      for (size_t k = 1; k + 1 < e.shape.size(); ++k) {
+        const int32_t la = quantize(e.shape[k].lat), lo = quantize(e.shape[k].lon);
+        putZigzag(geomPoints, la - lat);
+        putZigzag(geomPoints, lo - lon);
+        lat = la;
+        lon = lo;
+      }
+    } else {
+      for (size_t k = 1; k + 1 < e.shape.size(); ++k) {
+        shapes.emplace_back(quantize(e.shape[k].lat), quantize(e.shape[k].lon));
+      }
+    }
+    const uint16_t access_mask = (e.car_access ? 0x1 : 0) | (e.foot_access ? 0x2 : 0);
+    edges.emplace_back(local.idOf.at(e.shape.front().id),
+                       local.idOf.at(e.shape.back().id),
+                       shapeLength(e),
+                       e.car_access ? car_speed_for_class(e.road_class) : 0.0f,
+                       e.foot_access ? 1.4f : 0.0f,
+                       shape_start,
+                       static_cast<uint16_t>(shapes.size() - shape_start),
+                       access_mask,
+                       static_cast<RoadClass>(e.road_class),
+                       e.oneway);
+  }
+
+  flatbuffers::FlatBufferBuilder fbb(1024 + nodes.size() * sizeof(NodeV2) +
+                                     edges.size() * sizeof(EdgeV2) + shapes.size() * sizeof(ShapePointV2));
+  auto nodes_vec = fbb.CreateVectorOfStructs(nodes);
+  auto edges_vec = fbb.CreateVectorOfStructs(edges);
+  // при отдельном слое поле shapes не пишется: по его отсутствию TileView понимает,
+  // что формы нужно подгрузить (TileView::hasGeometry)
+  decltype(fbb.CreateVectorOfStructs(shapes)) shapes_vec;
+  if (!geometryOut) shapes_vec = fbb.CreateVectorOfStructs(shapes);
+  auto in_first_vec = fbb.CreateVector(adj.inFirst);
+  auto in_edges_vec = fbb.CreateVector(adj.inEdges);
+  auto checksum_str = fbb.CreateString("");
+  auto land = CreateLandTileV2(fbb,
+                               static_cast<uint16_t>(tile.key.z),
+                               static_cast<uint32_t>(tile.key.x),
+                               static_cast<uint32_t>(tile.key.y),
+                               version,
+                               checksum_str,
+                               profile_mask,
+                               nodes_vec,
+                               edges_vec,
+                               shapes_vec,
+                               in_first_vec,
+                               in_edges_vec);
+  fbb.Finish(land);
+
+  if (geometryOut) {
+    geomOffsets.push_back(static_cast<uint32_t>(geomPoints.size()));
+    flatbuffers::FlatBufferBuilder gb(64 + geomOffsets.size() * 4 + geomPoints.size());
+    auto offs = gb.CreateVector(geomOffsets);
+    auto pts = gb.CreateVector(geomPoints);
+    gb.Finish(CreateTileGeometry(gb, offs, pts));
+    geometryOut->assign(gb.GetBufferPointer(), gb.GetBufferPointer() + gb.GetSize());
+  }
+
+  auto ptr = fbb.GetBufferPointer();
+  auto sz = fbb.GetSize();
+  return std::vector<uint8_t>(ptr, ptr + sz);
+}
 
+std::string blobChecksum(const std::vector<uint8_t>& blob) {
+  return routing_core::xxh64Hex(blob.data(), blob.size());
+}
@@ -2,13 +2,26 @@
 
 #include <vector>
 #include <cstdint>
+#include <string>
 #include <unordered_map>
 
 #include "pbf_reader.h"
 
-// Возвращает FlatBuffers blob для одного тайла
+// Возвращает FlatBuffers blob для одного тайла (схема v1, таблицы LandTile)
 std::vector<uint8_t> buildLandTileBlob(const TileData& tile,
                                        uint32_t version,
                                        uint32_t profile_mask);
 
+// То же в схеме v2 (LandTileV2: векторы структур, рёбра по from_node, геометрия отдельно).
+// С geometryOut промежуточные точки рёбер уходят в отдельный блоб слоя геометрии
+// (TileGeometry, varint-приращения), а shapes тайла остаётся пустым.
+std::vector<uint8_t> buildLandTileBlobV2(const TileData& tile,
+                                         uint32_t version,
+                                         uint32_t profile_mask,
+                                         std::vector<uint8_t>* geometryOut = nullptr);
+
+// Контрольная сумма блоба для land_tiles.checksum: xxh64 хранимых байт (после сжатия), 16 hex
+// (metadata tile_checksum = xxh64, см. routing_core/xxhash64.h)
+std::string blobChecksum(const std::vector<uint8_t>& blob);
+
 
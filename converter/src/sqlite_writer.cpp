@@ -1,11 +1,18 @@
 #include "sqlite_writer.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <string>
 #include "tiler.h"
+#include "routing_core/trace.h"
 
 static int noop_callback(void*, int, char**, char**) { return 0; }
 
+static const char* kCreateTilesIndex =
+    "CREATE UNIQUE INDEX IF NOT EXISTS idx_land_tiles_zxy ON land_tiles(z,x,y);";
+static const char* kCreateGeometryIndex =
+    "CREATE UNIQUE INDEX IF NOT EXISTS idx_land_geometry_zxy ON land_geometry(z,x,y);";
+
 RoutingDbWriter::RoutingDbWriter(const std::string& dbPath) {
   if (sqlite3_open(dbPath.c_str(), &db_) != SQLITE_OK) {
     std::string msg = "Failed to open SQLite DB: ";
@@ -18,6 +25,10 @@ RoutingDbWriter::RoutingDbWriter(const std::string& dbPath) {
 }
 
 RoutingDbWriter::~RoutingDbWriter() {
+  sqlite3_finalize(tileInsert_);
+  sqlite3_finalize(geometryInsert_);
+  sqlite3_finalize(tileUpsert_);
+  sqlite3_finalize(geometryUpsert_);
   if (db_) {
     sqlite3_close(db_);
     db_ = nullptr;
@@ -52,8 +63,14 @@ void RoutingDbWriter::createSchemaIfNeeded() {
       "  data BLOB NOT NULL\n"
       ");";
 
-  const char* create_idx =
-      "CREATE UNIQUE INDEX IF NOT EXISTS idx_land_tiles_zxy ON land_tiles(z,x,y);";
+  // Слой геометрии (схема v2): формы рёбер отдельно от топологии, читаются лениво
+  const char* create_geometry =
+      "CREATE TABLE IF NOT EXISTS land_geometry (\n"
+      "  z INTEGER NOT NULL,\n"
+      "  x INTEGER NOT NULL,\n"
+      "  y INTEGER NOT NULL,\n"
+      "  data BLOB NOT NULL\n"
+      ");";
 
   const char* create_meta =
       "CREATE TABLE IF NOT EXISTS metadata (\n"
@@ -63,7 +80,9 @@ void RoutingDbWriter::createSchemaIfNeeded() {
 
   exec("BEGIN TRANSACTION;");
   exec(create_tiles);
-  exec(create_idx);
+  exec(kCreateTilesIndex);
+  exec(create_geometry);
+  exec(kCreateGeometryIndex);
   exec(create_meta);
   exec("COMMIT;");
 }
@@ -98,6 +117,92 @@ void RoutingDbWriter::writeMetadata(const std::string& key, const std::string& v
   sqlite3_finalize(stmt);
 }
 
+sqlite3_stmt* RoutingDbWriter::prepare(sqlite3_stmt*& cached, const char* sql, const char* what) {
+  if (cached) return cached;
+  if (sqlite3_prepare_v2(db_, sql, -1, &cached, nullptr) != SQLITE_OK) {
+    std::string msg = "Failed to prepare ";
+    msg += what;
+    msg += ": ";
+    msg += sqlite3_errmsg(db_);
+    throw SqliteError(msg);
+  }
+  return cached;
+}
+
+void RoutingDbWriter::step(sqlite3_stmt* stmt, const char* what) {
+  const int rc = sqlite3_step(stmt);
+  // Блобы привязаны без копирования (SQLITE_STATIC): после шага привязки сбрасываются
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  if (rc != SQLITE_DONE) {
+    std::string msg = "Failed to insert ";
+    msg += what;
+    msg += ": ";
+    msg += sqlite3_errmsg(db_);
+    throw SqliteError(msg);
+  }
+}
+
+void RoutingDbWriter::afterInsert(size_t bytes) {
+  if (!bulk_) return;
+  ++pendingTiles_;
+  pendingBytes_ += bytes;
+  if (pendingTiles_ >= commitTiles_ || pendingBytes_ >= commitBytes_) {
+    ROUTING_TRACE_SCOPE_ARG("converter", "sqlite.commit", "tiles", pendingTiles_);
+    exec("COMMIT;");
+    exec("BEGIN TRANSACTION;");
+    pendingTiles_ = 0;
+    pendingBytes_ = 0;
+  }
+}
+
+void RoutingDbWriter::beginBulkLoad(size_t commitTiles, size_t commitBytes) {
+  if (bulk_) return;
+  commitTiles_ = std::max<size_t>(1, commitTiles);
+  commitBytes_ = std::max<size_t>(1, commitBytes);
+  // Индексы строятся одним проходом после загрузки — дешевле, чем поддерживать их на
+  // каждой вставке. Уникальность (z,x,y) проверит их создание в finishBulkLoad
+  exec("DROP INDEX IF EXISTS idx_land_tiles_zxy;");
+  exec("DROP INDEX IF EXISTS idx_land_geometry_zxy;");
+  exec("PRAGMA journal_mode = OFF;");
+  exec("PRAGMA synchronous = OFF;");
+  exec("PRAGMA locking_mode = EXCLUSIVE;");
+  exec("BEGIN TRANSACTION;");
+  bulk_ = true;
+  pendingTiles_ = 0;
+  pendingBytes_ = 0;
+}
+
+void RoutingDbWriter::finishBulkLoad() {
+  if (!bulk_) return;
+  ROUTING_TRACE_SCOPE("converter", "sqlite.finishBulkLoad");
+  exec("COMMIT;");
+  bulk_ = false;
+  exec("BEGIN TRANSACTION;");
+  exec(kCreateTilesIndex);
+  exec(kCreateGeometryIndex);
+  exec("COMMIT;");
+  exec("PRAGMA locking_mode = NORMAL;");
+  exec("PRAGMA synchronous = NORMAL;");
+  exec("PRAGMA journal_mode = WAL;");
+}
+
+void RoutingDbWriter::bindLandTile(sqlite3_stmt* stmt, int z, int x, int y, const BBox& bbox, int version,
+                                   const std::string& checksum, int profile_mask,
+                                   const void* blob_data, size_t blob_size) {
+  sqlite3_bind_int(stmt, 1, z);
+  sqlite3_bind_int(stmt, 2, x);
+  sqlite3_bind_int(stmt, 3, y);
+  sqlite3_bind_double(stmt, 4, bbox.lat_min);
+  sqlite3_bind_double(stmt, 5, bbox.lon_min);
+  sqlite3_bind_double(stmt, 6, bbox.lat_max);
+  sqlite3_bind_double(stmt, 7, bbox.lon_max);
+  sqlite3_bind_int(stmt, 8, version);
+  sqlite3_bind_text(stmt, 9, checksum.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 10, profile_mask);
+  sqlite3_bind_blob(stmt, 11, blob_data, static_cast<int>(blob_size), SQLITE_STATIC);
+}
+
 void RoutingDbWriter::insertLandTile(int z, int x, int y,
                                      const BBox& bbox,
                                      int version,
@@ -105,34 +210,104 @@ void RoutingDbWriter::insertLandTile(int z, int x, int y,
                                      int profile_mask,
                                      const void* blob_data,
                                      size_t blob_size) {
-  const char* sql =
+  ROUTING_TRACE_SCOPE_ARG("converter", "insertLandTile", "bytes", blob_size);
+  sqlite3_stmt* stmt = prepare(tileInsert_,
+      "INSERT INTO land_tiles(z,x,y,lat_min,lon_min,lat_max,lon_max,version,checksum,profile_mask,data)\n"
+      "VALUES(?,?,?,?,?,?,?,?,?,?,?);", "tile insert");
+  bindLandTile(stmt, z, x, y, bbox, version, checksum, profile_mask, blob_data, blob_size);
+  step(stmt, "tile");
+  afterInsert(blob_size);
+}
+
+void RoutingDbWriter::upsertLandTile(int z, int x, int y, const BBox& bbox, int version,
+                                     const std::string& checksum, int profile_mask,
+                                     const void* blob_data, size_t blob_size) {
+  ROUTING_TRACE_SCOPE_ARG("converter", "upsertLandTile", "bytes", blob_size);
+  sqlite3_stmt* stmt = prepare(tileUpsert_,
       "INSERT INTO land_tiles(z,x,y,lat_min,lon_min,lat_max,lon_max,version,checksum,profile_mask,data)\n"
-      "VALUES(?,?,?,?,?,?,?,?,?,?,?);";
+      "VALUES(?,?,?,?,?,?,?,?,?,?,?)\n"
+      "ON CONFLICT(z,x,y) DO UPDATE SET lat_min=excluded.lat_min, lon_min=excluded.lon_min,\n"
+      "  lat_max=excluded.lat_max, lon_max=excluded.lon_max, version=excluded.version,\n"
+      "  checksum=excluded.checksum, profile_mask=excluded.profile_mask, data=excluded.data;", "tile upsert");
+  bindLandTile(stmt, z, x, y, bbox, version, checksum, profile_mask, blob_data, blob_size);
+  step(stmt, "tile");
+}
+
+void RoutingDbWriter::insertGeometry(int z, int x, int y, const void* blob_data, size_t blob_size) {
+  ROUTING_TRACE_SCOPE_ARG("converter", "insertGeometry", "bytes", blob_size);
+  sqlite3_stmt* stmt = prepare(geometryInsert_, "INSERT INTO land_geometry(z,x,y,data) VALUES(?,?,?,?);",
+                               "geometry insert");
+  sqlite3_bind_int(stmt, 1, z);
+  sqlite3_bind_int(stmt, 2, x);
+  sqlite3_bind_int(stmt, 3, y);
+  sqlite3_bind_blob(stmt, 4, blob_data, static_cast<int>(blob_size), SQLITE_STATIC);
+  step(stmt, "geometry");
+  afterInsert(blob_size);
+}
+
+void RoutingDbWriter::upsertGeometry(int z, int x, int y, const void* blob_data, size_t blob_size) {
+  ROUTING_TRACE_SCOPE_ARG("converter", "upsertGeometry", "bytes", blob_size);
+  sqlite3_stmt* stmt = prepare(geometryUpsert_,
+      "INSERT INTO land_geometry(z,x,y,data) VALUES(?,?,?,?)\n"
+      "ON CONFLICT(z,x,y) DO UPDATE SET data=excluded.data;", "geometry upsert");
+  sqlite3_bind_int(stmt, 1, z);
+  sqlite3_bind_int(stmt, 2, x);
+  sqlite3_bind_int(stmt, 3, y);
+  sqlite3_bind_blob(stmt, 4, blob_data, static_cast<int>(blob_size), SQLITE_STATIC);
+  step(stmt, "geometry");
+}
+
+void RoutingDbWriter::deleteTile(int z, int x, int y) {
+  for (const char* sql : {"DELETE FROM land_tiles WHERE z=? AND x=? AND y=?;",
+                          "DELETE FROM land_geometry WHERE z=? AND x=? AND y=?;"}) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+      std::string msg = "Failed to prepare tile delete: ";
+      msg += sqlite3_errmsg(db_);
+      throw SqliteError(msg);
+    }
+    sqlite3_bind_int(stmt, 1, z);
+    sqlite3_bind_int(stmt, 2, x);
+    sqlite3_bind_int(stmt, 3, y);
+    const int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+      std::string msg = "Failed to delete tile: ";
+      msg += sqlite3_errmsg(db_);
+      throw SqliteError(msg);
+    }
+  }
+}
+
+std::optional<int> RoutingDbWriter::tileVersion(int z, int x, int y) {
   sqlite3_stmt* stmt = nullptr;
-  if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-    std::string msg = "Failed to prepare tile insert: ";
+  if (sqlite3_prepare_v2(db_, "SELECT version FROM land_tiles WHERE z=? AND x=? AND y=?;", -1, &stmt, nullptr) != SQLITE_OK) {
+    std::string msg = "Failed to prepare version query: ";
     msg += sqlite3_errmsg(db_);
     throw SqliteError(msg);
   }
   sqlite3_bind_int(stmt, 1, z);
   sqlite3_bind_int(stmt, 2, x);
   sqlite3_bind_int(stmt, 3, y);
-  sqlite3_bind_double(stmt, 4, bbox.lat_min);
-  sqlite3_bind_double(stmt, 5, bbox.lon_min);
-  sqlite3_bind_double(stmt, 6, bbox.lat_max);
-  sqlite3_bind_double(stmt, 7, bbox.lon_max);
-  sqlite3_bind_int(stmt, 8, version);
-  sqlite3_bind_text(stmt, 9, checksum.c_str(), -1, SQLITE_TRANSIENT);
-  sqlite3_bind_int(stmt, 10, profile_mask);
-  sqlite3_bind_blob(stmt, 11, blob_data, static_cast<int>(blob_size), SQLITE_TRANSIENT);
+  std::optional<int> version;
+  if (sqlite3_step(stmt) == SQLITE_ROW) version = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+  return version;
+}
 
-  if (sqlite3_step(stmt) != SQLITE_DONE) {
-    std::string msg = "Failed to insert tile: ";
+std::optional<std::string> RoutingDbWriter::readMetadata(const std::string& key) {
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v2(db_, "SELECT value FROM metadata WHERE key=?;", -1, &stmt, nullptr) != SQLITE_OK) {
+    std::string msg = "Failed to prepare metadata query: ";
     msg += sqlite3_errmsg(db_);
-    sqlite3_finalize(stmt);
     throw SqliteError(msg);
   }
+  sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+  std::optional<std::string> value;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    const unsigned char* text = sqlite3_column_text(stmt, 0);
+    value = text ? std::string(reinterpret_cast<const char*>(text)) : std::string();
+  }
   sqlite3_finalize(stmt);
+  return value;
 }
-
-
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <sqlite3.h>
+#include <optional>
 #include <stdexcept>
 #include <string>
 
@@ -28,9 +29,48 @@ public:
                       const void* blob_data,
                       size_t blob_size);
 
+  // Блоб слоя геометрии тайла (TileGeometry, схема v2)
+  void insertGeometry(int z, int x, int y, const void* blob_data, size_t blob_size);
+
+  // Обновление существующей БД (--apply-osc): тайл заменяется целиком по (z,x,y)
+  void upsertLandTile(int z, int x, int y, const BBox& bbox, int version, const std::string& checksum,
+                      int profile_mask, const void* blob_data, size_t blob_size);
+  void upsertGeometry(int z, int x, int y, const void* blob_data, size_t blob_size);
+  // Удалить тайл и его геометрию (в тайле не осталось рёбер)
+  void deleteTile(int z, int x, int y);
+  std::optional<int> tileVersion(int z, int x, int y);
+  std::optional<std::string> readMetadata(const std::string& key);
+  void beginTransaction() { exec("BEGIN TRANSACTION;"); }
+  void commitTransaction() { exec("COMMIT;"); }
+
+  // Массовая загрузка в новую БД: без журнала, с эксклюзивной блокировкой, вставки
+  // (тайлы и блобы геометрии) идут транзакциями по commitTiles строк или commitBytes
+  // байт, индексы по (z,x,y)
+  // снимаются и строятся заново в finishBulkLoad. Сбой посреди загрузки может оставить
+  // файл испорченным — режим только для файла, который конвертер создаёт с нуля.
+  void beginBulkLoad(size_t commitTiles = 10000, size_t commitBytes = 64u << 20);
+  // Зафиксировать последнюю транзакцию, построить индексы, вернуть WAL.
+  void finishBulkLoad();
+
 private:
   sqlite3* db_ {nullptr};
+  // Подготовленные один раз вставки (reset между тайлами)
+  sqlite3_stmt* tileInsert_ {nullptr};
+  sqlite3_stmt* geometryInsert_ {nullptr};
+  sqlite3_stmt* tileUpsert_ {nullptr};
+  sqlite3_stmt* geometryUpsert_ {nullptr};
+  bool bulk_ {false};
+  size_t commitTiles_ {0};
+  size_t commitBytes_ {0};
+  size_t pendingTiles_ {0};
+  size_t pendingBytes_ {0};
+
   void exec(const char* sql);
+  sqlite3_stmt* prepare(sqlite3_stmt*& cached, const char* sql, const char* what);
+  void step(sqlite3_stmt* stmt, const char* what);
+  void afterInsert(size_t bytes);
+  void bindLandTile(sqlite3_stmt* stmt, int z, int x, int y, const BBox& bbox, int version,
+                    const std::string& checksum, int profile_mask, const void* blob_data, size_t blob_size);
 };
 
 
@@ -0,0 +1,78 @@
+#include "tile_compressor.h"
+
+#include <stdexcept>
+
+#include "routing_core/trace.h"
+
+#ifdef ROUTING_CORE_HAVE_ZSTD
+#  include <zstd.h>
+#  include <zdict.h>
+#endif
+
+#ifdef ROUTING_CORE_HAVE_ZSTD
+
+std::vector<uint8_t> TileCompressor::trainDictionary(const std::vector<std::vector<uint8_t>>& samples,
+                                                     size_t dictSize) {
+  ROUTING_TRACE_SCOPE_ARG("converter", "trainDictionary", "samples", samples.size());
+  if (dictSize == 0 || samples.empty()) return {};
+  std::vector<uint8_t> joined;
+  std::vector<size_t> sizes;
+  sizes.reserve(samples.size());
+  for (const auto& s : samples) {
+    joined.insert(joined.end(), s.begin(), s.end());
+    sizes.push_back(s.size());
+  }
+  std::vector<uint8_t> dict(dictSize);
+  const size_t n = ZDICT_trainFromBuffer(dict.data(), dict.size(), joined.data(), sizes.data(),
+                                         static_cast<unsigned>(sizes.size()));
+  if (ZDICT_isError(n)) return {};
+  dict.resize(n);
+  return dict;
+}
+
+TileCompressor::TileCompressor(const std::vector<uint8_t>& dict, int level) : level_(level) {
+  cctx_ = ZSTD_createCCtx();
+  if (!cctx_) throw std::runtime_error("Failed to create zstd context");
+  if (!dict.empty()) {
+    cdict_ = ZSTD_createCDict(dict.data(), dict.size(), level);
+    if (!cdict_) throw std::runtime_error("Failed to load zstd dictionary");
+  }
+}
+
+TileCompressor::~TileCompressor() {
+  ZSTD_freeCDict(static_cast<ZSTD_CDict*>(cdict_));
+  ZSTD_freeCCtx(static_cast<ZSTD_CCtx*>(cctx_));
+}
+
+std::vector<uint8_t> TileCompressor::compress(const std::vector<uint8_t>& blob) {
+  ROUTING_TRACE_SCOPE_ARG("converter", "compressTile", "bytes", blob.size());
+  std::vector<uint8_t> out(ZSTD_compressBound(blob.size()));
+  auto* cctx = static_cast<ZSTD_CCtx*>(cctx_);
+  // размер содержимого в заголовке кадра нужен ядру для аллокации при распаковке
+  const size_t n = cdict_
+      ? ZSTD_compress_usingCDict(cctx, out.data(), out.size(), blob.data(), blob.size(),
+                                 static_cast<const ZSTD_CDict*>(cdict_))
+      : ZSTD_compressCCtx(cctx, out.data(), out.size(), blob.data(), blob.size(), level_);
+  if (ZSTD_isError(n)) throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(n));
+  if (n >= blob.size()) return blob;
+  out.resize(n);
+  return out;
+}
+
+#else
+
+std::vector<uint8_t> TileCompressor::trainDictionary(const std::vector<std::vector<uint8_t>>&, size_t) {
+  return {};
+}
+
+TileCompressor::TileCompressor(const std::vector<uint8_t>&, int level) : level_(level) {
+  throw std::runtime_error("converter was built without zstd; --zstd is unavailable");
+}
+
+TileCompressor::~TileCompressor() = default;
+
+std::vector<uint8_t> TileCompressor::compress(const std::vector<uint8_t>& blob) {
+  return blob;
+}
+
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Сжатие блобов тайлов zstd со словарём (--zstd).
+// Словарь обучается на выборке сериализованных тайлов и кладётся в metadata
+// (zstd_dict, base64), TileStore распаковывает блобы при загрузке.
+class TileCompressor {
+public:
+  // Обучить словарь на выборке; пустой результат — выборка слишком мала/однообразна.
+  static std::vector<uint8_t> trainDictionary(const std::vector<std::vector<uint8_t>>& samples,
+                                              size_t dictSize);
+
+  TileCompressor(const std::vector<uint8_t>& dict, int level);
+  ~TileCompressor();
+  TileCompressor(const TileCompressor&) = delete;
+  TileCompressor& operator=(const TileCompressor&) = delete;
+
+  // Сжатый блоб; если сжатие не выигрывает — исходный (ядро различает по магии zstd).
+  std::vector<uint8_t> compress(const std::vector<uint8_t>& blob);
+
+private:
+  void* cctx_ {nullptr};   // ZSTD_CCtx*
+  void* cdict_ {nullptr};  // ZSTD_CDict*
+  int level_;
+};
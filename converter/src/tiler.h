@@ -27,6 +27,11 @@ inline TileKey tileKeyFor(double lat_deg, double lon_deg, int z = 14) {
   return {z, x, y};
 }
 
+// Ключ тайла для хэш-карт (z, x, y в одном 64-битном числе)
+inline long long packTileKey(const TileKey& k) {
+  return (static_cast<long long>(k.z) << 58) ^ (static_cast<long long>(k.x) << 29) ^ static_cast<long long>(k.y);
+}
+
 inline BBox tileBounds(const TileKey& key) {
   const int n = 1 << key.z;
   const double unit = 1.0 / static_cast<double>(n);
@@ -0,0 +1,83 @@
+// Внешняя сортировка рёбер по тайлам (EdgeSpill): собирается без libosmium.
+
+#include "edge_spill.h"
+
+#include <cstdio>
+#include <unistd.h>
+#include <filesystem>
+#include <map>
+#include <set>
+
+#include "test_check.h"
+
+namespace {
+
+constexpr int kZoom = 14;
+
+std::string spillPath() {
+  return (std::filesystem::temp_directory_path() /
+          ("converter_tests_" + std::to_string(::getpid()) + ".edges.tmp")).string();
+}
+
+// Ребро с points точками; номер в порядке add() — в id первой точки
+SimpleEdge edgeOf(int64_t index, size_t points) {
+  SimpleEdge e;
+  for (size_t k = 0; k < points; ++k) e.shape.push_back(SimpleNode{index * 1000 + static_cast<int64_t>(k), 0.0, 0.0});
+  e.oneway = index % 3 == 0;
+  e.road_class = static_cast<int>(index % 7);
+  return e;
+}
+
+// Добавить count рёбер по tiles тайлам, слить и проверить: каждое ребро ровно один раз,
+// тайл не делится между группами, внутри тайла — порядок add()
+void roundTrip(size_t count, size_t points, int tiles, size_t budget, size_t* runs) {
+  EdgeSpill spill(spillPath(), kZoom, budget);
+  std::map<long long, std::vector<int64_t>> expected;
+  for (size_t i = 0; i < count; ++i) {
+    // перемешанные тайлы: соседние рёбра попадают в разные тайлы
+    const int t = static_cast<int>((i * 7919) % static_cast<size_t>(tiles));
+    const TileKey tk{kZoom, 8000 + t % 16, 5000 + t / 16};
+    spill.add(tk, edgeOf(static_cast<int64_t>(i), points));
+    expected[packTileKey(tk)].push_back(static_cast<int64_t>(i));
+  }
+  spill.finish();
+  *runs = spill.runCount();
+
+  std::map<long long, std::vector<int64_t>> seen;
+  std::set<long long> done;  // тайлы из прошлых групп
+  std::unordered_map<long long, TileData> group;
+  while (spill.nextGroup(group)) {
+    for (const auto& [key, td] : group) {
+      CHECK(!done.count(key));
+      for (const auto& e : td.edges) {
+        REQUIRE(e.shape.size() == points);
+        const int64_t index = e.shape.front().id / 1000;
+        CHECK(e.from_node_id == index * 1000);
+        CHECK(e.road_class == static_cast<int>(index % 7));
+        CHECK(e.oneway == (index % 3 == 0));
+        seen[key].push_back(index);
+      }
+    }
+    for (const auto& [key, td] : group) done.insert(key);
+  }
+  CHECK(seen == expected);
+}
+
+} // namespace
+
+TEST(single_merge_keeps_add_order_within_tile) {
+  size_t runs = 0;
+  roundTrip(3000, 4, 40, 1 << 20, &runs);
+  CHECK(runs > 1);
+}
+
+TEST(many_runs_are_merged_in_passes) {
+  // 1 MiB: прогон — около 256 KiB, буферов слияния по 4 KiB — не больше 63. Рёбер на
+  // ~19 MiB дают больше 63 прогонов, и finish() сливает их в промежуточном проходе
+  size_t runs = 0;
+  roundTrip(8000, 100, 60, 1 << 20, &runs);
+  CHECK(runs > 1);
+  CHECK(runs <= 63);
+}
+
+int main() { return routing_test::runAll(); }
@@ -0,0 +1,66 @@
+// Координаты в формах дорог (resolveWayShapes): собирается без libosmium.
+
+#include "chain_contraction.h"
+#include "node_locations.h"
+
+#include "test_check.h"
+
+namespace {
+
+RoadWay wayOf(std::initializer_list<int64_t> ids) {
+  RoadWay rw = roadWayFor("residential", false);
+  for (int64_t id : ids) rw.shape.push_back(SimpleNode{id, 0.0, 0.0});
+  return rw;
+}
+
+// Узлы 1..n с координатами (lat = id, lon = -id), кроме skip.
+void fillLocations(NodeLocationStore& store, int64_t n, std::initializer_list<int64_t> skip = {}) {
+  for (int64_t id = 1; id <= n; ++id) store.addId(id);
+  store.finalize();
+  for (int64_t id = 1; id <= n; ++id) {
+    bool skipped = false;
+    for (int64_t s : skip) skipped |= s == id;
+    if (!skipped) store.set(id, static_cast<double>(id) * 1e-3, -static_cast<double>(id) * 1e-3);
+  }
+}
+
+} // namespace
+
+TEST(keeps_shapes_when_nothing_dropped) {
+  NodeLocationStore store;
+  fillLocations(store, 6);
+  std::vector<RoadWay> ways{wayOf({1, 2, 3}), wayOf({3, 4}), wayOf({4, 5, 6})};
+  resolveWayShapes(ways, store);
+  REQUIRE(ways.size() == 3);
+  REQUIRE(ways[0].shape.size() == 3);
+  CHECK(ways[1].shape.size() == 2);
+  REQUIRE(ways[2].shape.size() == 3);
+  CHECK(ways[0].shape[2].id == 3);
+  CHECK(ways[0].shape[2].lat > 0.0029 && ways[0].shape[2].lat < 0.0031);
+  CHECK(ways[2].shape[0].lon < -0.0039 && ways[2].shape[0].lon > -0.0041);
+}
+
+TEST(drops_missing_nodes_and_short_ways) {
+  NodeLocationStore store;
+  fillLocations(store, 8, {2, 5});
+  std::vector<RoadWay> ways{wayOf({1, 2, 3}), wayOf({4, 5}), wayOf({6, 7, 8}), wayOf({2, 5})};
+  ways[2].oneway = true;
+  resolveWayShapes(ways, store);
+  REQUIRE(ways.size() == 2);
+  REQUIRE(ways[0].shape.size() == 2);
+  CHECK(ways[0].shape[0].id == 1);
+  CHECK(ways[0].shape[1].id == 3);
+  REQUIRE(ways[1].shape.size() == 3);
+  CHECK(ways[1].oneway);  // атрибуты переезжают вместе с формой
+}
+
+TEST(resolved_ways_produce_edges) {
+  NodeLocationStore store;
+  fillLocations(store, 4);
+  std::vector<RoadWay> ways{wayOf({1, 2, 3, 4})};
+  resolveWayShapes(ways, store);
+  const auto edges = buildRoadEdges(ways, 14, true);
+  CHECK(!edges.empty());
+}
+
+int main() { return routing_test::runAll(); }
@@ -0,0 +1,213 @@
+#pragma once
+
+// Минимальный харнесс для микробенчмарков routing_core.
+// Каждый кейс калибруется до min_time на сэмпл, затем снимается N сэмплов;
+// в отчёт идут медиана, минимум, p95 по сэмплам и MAD (median absolute deviation)
+// в нс/операцию.
+// Результаты можно сохранить в JSON Lines и сравнить с базовой линией (--baseline),
+// чтобы гейтить изменения по регрессиям.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#  include <sched.h>
+#endif
+
+namespace routing_bench {
+
+// Не даём компилятору выбросить результат вычислений.
+template <class T>
+inline void doNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct BenchOptions {
+  double minSampleTimeSec {0.05};  // минимальная длительность одного сэмпла
+  int samples {15};                // число сэмплов (медиана по ним)
+  int warmupSamples {2};
+  std::string filter;              // подстрока имени кейса
+  std::string jsonOut;             // JSON Lines с результатами
+  std::string baseline;            // JSON Lines базовой линии для сравнения
+  double threshold {0.10};         // допустимая регрессия медианы (доля)
+  int pinCpu {-1};                 // привязка к ядру (Linux)
+};
+
+struct BenchResult {
+  std::string name;
+  uint64_t itersPerSample {0};
+  double medianNs {0.0};
+  double minNs {0.0};
+  double p95Ns {0.0};
+  double madNs {0.0};
+};
+
+// Тело кейса: выполнить `iters` операций.
+using BenchFn = std::function<void(uint64_t iters)>;
+
+class BenchRunner {
+public:
+  explicit BenchRunner(BenchOptions opt) : opt_(std::move(opt)) {
+#ifdef __linux__
+    if (opt_.pinCpu >= 0) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(opt_.pinCpu, &set);
+      sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+  }
+
+  bool selected(const std::string& name) const {
+    return opt_.filter.empty() || name.find(opt_.filter) != std::string::npos;
+  }
+
+  void run(const std::string& name, const BenchFn& fn) {
+    if (!selected(name)) return;
+    using clock = std::chrono::steady_clock;
+    auto timeIters = [&](uint64_t n) {
+      auto t0 = clock::now();
+      fn(n);
+      auto t1 = clock::now();
+      return std::chrono::duration<double>(t1 - t0).count();
+    };
+
+    // калибровка: удваиваем число итераций, пока сэмпл не станет достаточно длинным
+    uint64_t iters = 1;
+    for (;;) {
+      double t = timeIters(iters);
+      if (t >= opt_.minSampleTimeSec || iters >= (1ull << 40)) break;
+      double scale = (t > 0.0) ? (opt_.minSampleTimeSec / t) * 1.2 : 10.0;
+      uint64_t next = static_cast<uint64_t>(static_cast<double>(iters) * std::clamp(scale, 2.0, 100.0));
+      iters = std::max<uint64_t>(next, iters + 1);
+    }
+
+    for (int i = 0; i < opt_.warmupSamples; ++i) timeIters(iters);
+
+    std::vector<double> ns;
+    ns.reserve(static_cast<size_t>(opt_.samples));
+    for (int i = 0; i < opt_.samples; ++i) {
+      ns.push_back(timeIters(iters) * 1e9 / static_cast<double>(iters));
+    }
+
+    BenchResult r;
+    r.name = name;
+    r.itersPerSample = iters;
+    r.medianNs = median(ns);
+    r.minNs = *std::min_element(ns.begin(), ns.end());
+    r.p95Ns = quantile(ns, 0.95);
+    std::vector<double> dev;
+    dev.reserve(ns.size());
+    for (double v : ns) dev.push_back(std::fabs(v - r.medianNs));
+    r.madNs = median(dev);
+    results_.push_back(r);
+
+    std::printf("%-44s %14.1f ns/op  (min %.1f, p95 %.1f, mad %.1f%%, %llu iters x %d)\n",
+                r.name.c_str(), r.medianNs, r.minNs, r.p95Ns,
+                r.medianNs > 0.0 ? 100.0 * r.madNs / r.medianNs : 0.0,
+                static_cast<unsigned long long>(r.itersPerSample), opt_.samples);
+    std::fflush(stdout);
+  }
+
+  // Записывает JSON Lines и сравнивает с базовой линией. Возвращает код выхода.
+  int finish() const {
+    if (!opt_.jsonOut.empty()) {
+      std::ofstream out(opt_.jsonOut);
+      for (const auto& r : results_) {
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "{\"name\":\"%s\",\"median_ns\":%.3f,\"min_ns\":%.3f,\"p95_ns\":%.3f,\"mad_ns\":%.3f,\"iters\":%llu}\n",
+                      r.name.c_str(), r.medianNs, r.minNs, r.p95Ns, r.madNs,
+                      static_cast<unsigned long long>(r.itersPerSample));
+        out << line;
+      }
+    }
+    if (opt_.baseline.empty()) return 0;
+
+    auto base = loadJsonLines(opt_.baseline);
+    if (base.empty()) {
+      std::fprintf(stderr, "baseline %s is empty or unreadable\n", opt_.baseline.c_str());
+      return 2;
+    }
+    int regressions = 0;
+    std::printf("\n%-44s %12s %12s %8s\n", "compare", "base ns", "new ns", "delta");
+    for (const auto& r : results_) {
+      auto it = base.find(r.name);
+      if (it == base.end()) continue;
+      const BenchResult& b = it->second;
+      double delta = (b.medianNs > 0.0) ? (r.medianNs - b.medianNs) / b.medianNs : 0.0;
+      // регрессией считаем рост медианы сверх порога и сверх шума обоих прогонов
+      double noise = 2.0 * std::max(r.madNs, b.madNs);
+      bool regressed = delta > opt_.threshold && (r.medianNs - b.medianNs) > noise;
+      if (regressed) ++regressions;
+      std::printf("%-44s %12.1f %12.1f %+7.1f%%%s\n", r.name.c_str(), b.medianNs, r.medianNs,
+                  100.0 * delta, regressed ? "  REGRESSION" : "");
+    }
+    if (regressions > 0) {
+      std::fprintf(stderr, "%d benchmark(s) regressed by more than %.0f%%\n",
+                   regressions, 100.0 * opt_.threshold);
+      return 1;
+    }
+    return 0;
+  }
+
+private:
+  static double median(std::vector<double> v) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return (n % 2) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+  }
+
+  // Квантиль с линейной интерполяцией между соседними порядковыми статистиками.
+  static double quantile(std::vector<double> v, double q) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    double pos = q * static_cast<double>(v.size() - 1);
+    size_t lo = static_cast<size_t>(pos);
+    size_t hi = std::min(lo + 1, v.size() - 1);
+    return v[lo] + (v[hi] - v[lo]) * (pos - static_cast<double>(lo));
+  }
+
+  static double numberField(const std::string& line, const char* key) {
+    auto pos = line.find(std::string("\"") + key + "\":");
+    if (pos == std::string::npos) return 0.0;
+    return std::atof(line.c_str() + pos + std::strlen(key) + 3);
+  }
+
+  static std::map<std::string, BenchResult> loadJsonLines(const std::string& path) {
+    std::map<std::string, BenchResult> out;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+      auto p = line.find("\"name\":\"");
+      if (p == std::string::npos) continue;
+      p += 8;
+      auto e = line.find('"', p);
+      if (e == std::string::npos) continue;
+      BenchResult r;
+      r.name = line.substr(p, e - p);
+      r.medianNs = numberField(line, "median_ns");
+      r.minNs = numberField(line, "min_ns");
+      r.p95Ns = numberField(line, "p95_ns");
+      r.madNs = numberField(line, "mad_ns");
+      out[r.name] = r;
+    }
+    return out;
+  }
+
+  BenchOptions opt_;
+  std::vector<BenchResult> results_;
+};
+
+} // namespace routing_bench
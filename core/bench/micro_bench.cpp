@@ -0,0 +1,583 @@
+// Микробенчмарки горячих примитивов routing_core на синтетических тайлах.
+//
+//   routing_bench [--grid N] [--tiles K] [--shape S] [--filter substr]
+//                 [--samples N] [--min-time SEC] [--pin-cpu CPU]
+//                 [--json out.jsonl] [--baseline base.jsonl] [--threshold 0.1]
+//
+// Для гейтинга: снять базовую линию (--json base.jsonl) до изменения и
+// сравнить после (--baseline base.jsonl); код выхода 1 при регрессии медианы.
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench_harness.h"
+#include "synthetic_tiles.h"
+
+#include "routing_core/route_geometry.h"
+#include "routing_core/router.h"
+#include "routing_core/tile_view.h"
+#include "routing_core/trace.h"
+#include "router_impl.h"
+
+using namespace routing_core;
+using namespace routing_bench;
+
+using RouterImpl = RouterInternals::Impl;
+
+static void printUsage(const char* argv0) {
+  std::fprintf(stderr,
+    "Usage: %s [--grid N] [--tiles K] [--shape S] [--filter substr]\n"
+    "          [--samples N] [--min-time SEC] [--pin-cpu CPU]\n"
+    "          [--json out.jsonl] [--baseline base.jsonl] [--threshold 0.1]\n",
+    argv0);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions bopt;
+  SyntheticSpec spec;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() -> const char* {
+      if (i + 1 >= argc) { printUsage(argv[0]); std::exit(1); }
+      return argv[++i];
+    };
+    if (arg == "--grid") spec.gridN = std::atoi(next());
+    else if (arg == "--tiles") { spec.tilesX = spec.tilesY = std::atoi(next()); }
+    else if (arg == "--shape") spec.shapePointsPerEdge = std::atoi(next());
+    else if (arg == "--filter") bopt.filter = next();
+    else if (arg == "--samples") bopt.samples = std::atoi(next());
+    else if (arg == "--min-time") bopt.minSampleTimeSec = std::atof(next());
+    else if (arg == "--pin-cpu") bopt.pinCpu = std::atoi(next());
+    else if (arg == "--json") bopt.jsonOut = next();
+    else if (arg == "--baseline") bopt.baseline = next();
+    else if (arg == "--threshold") bopt.threshold = std::atof(next());
+    else { printUsage(argv[0]); return 1; }
+  }
+
+  std::printf("synthetic: %dx%d tiles, grid %dx%d, %d shape points/edge\n",
+              spec.tilesX, spec.tilesY, spec.gridN, spec.gridN, spec.shapePointsPerEdge);
+
+  auto tiles = makeSyntheticTiles(spec);
+  SyntheticSpec encSpec = spec;
+  encSpec.tilesX = encSpec.tilesY = 1;
+  encSpec.encodedPolylineOnly = true;
+  auto encTiles = makeSyntheticTiles(encSpec);
+
+  const auto dbPath = (std::filesystem::temp_directory_path() /
+                       ("routing_bench_" + std::to_string(::getpid()) + ".routingdb")).string();
+  writeSyntheticRoutingDb(dbPath, tiles);
+  const auto packPath = (std::filesystem::temp_directory_path() /
+                         ("routing_bench_" + std::to_string(::getpid()) + ".routingpack")).string();
+  writeSyntheticRoutingPack(packPath, tiles);
+  std::string zstdDbPath;
+#ifdef ROUTING_CORE_HAVE_ZSTD
+  {
+    // те же тайлы, сжатые zstd со словарём (как конвертер с --zstd)
+    auto [ztiles, zmeta] = compressSyntheticTiles(tiles);
+    size_t raw = 0, stored = 0;
+    for (size_t i = 0; i < tiles.size(); ++i) {
+      raw += tiles[i].buffer->size();
+      stored += ztiles[i].buffer->size();
+    }
+    zstdDbPath = (std::filesystem::temp_directory_path() /
+                  ("routing_bench_" + std::to_string(::getpid()) + "_zstd.routingdb")).string();
+    writeSyntheticRoutingDb(zstdDbPath, ztiles, zmeta);
+    std::printf("zstd: %zu -> %zu tile bytes (%.1fx)\n", raw, stored,
+                stored ? static_cast<double>(raw) / static_cast<double>(stored) : 0.0);
+  }
+#endif
+
+  BenchRunner runner(bopt);
+  const auto& center = tiles[tiles.size() / 2];
+  TileView view(center.buffer);
+  const int N = view.nodeCount();
+  const int E = view.edgeCount();
+  std::printf("tile: %d nodes, %d edges, %zu bytes\n", N, E, center.buffer->size());
+
+  // те же тайлы в схеме v2 (структуры вместо таблиц)
+  SyntheticSpec v2Spec = spec;
+  v2Spec.schemaVersion = 2;
+  auto tilesV2 = makeSyntheticTiles(v2Spec);
+  const auto& centerV2 = tilesV2[tilesV2.size() / 2];
+  TileView viewV2(centerV2.buffer, 2);
+  std::printf("tile v2: %d nodes, %d edges, %zu bytes\n", viewV2.nodeCount(), viewV2.edgeCount(),
+              centerV2.buffer->size());
+  const auto dbPathV2 = (std::filesystem::temp_directory_path() /
+                         ("routing_bench_" + std::to_string(::getpid()) + "_v2.routingdb")).string();
+  writeSyntheticRoutingDb(dbPathV2, tilesV2, {{"schema_version", "2"}});
+  // v2 с отдельным слоем геометрии: формы читаются только для снапа и сборки пути
+  SyntheticSpec geomSpec = v2Spec;
+  geomSpec.separateGeometry = true;
+  auto tilesGeom = makeSyntheticTiles(geomSpec);
+  std::printf("tile v2 + geometry layer: %zu + %zu bytes\n\n", tilesGeom[tilesGeom.size() / 2].buffer->size(),
+              tilesGeom[tilesGeom.size() / 2].geometry->size());
+  const auto dbPathGeom = (std::filesystem::temp_directory_path() /
+                           ("routing_bench_" + std::to_string(::getpid()) + "_v2geom.routingdb")).string();
+  writeSyntheticRoutingDb(dbPathGeom, tilesGeom, {{"schema_version", "2"}});
+
+  // --- TileView: аксессоры (v1 — имена без суффикса, v2 — с _v2) ---
+  auto viewCases = [&](const std::string& sfx, const TileView& tv, const std::shared_ptr<std::vector<uint8_t>>& buf) {
+    runner.run("tileview/node_lat_lon" + sfx, [&](uint64_t iters) {
+      double acc = 0.0;
+      int i = 0;
+      for (uint64_t k = 0; k < iters; ++k) {
+        acc += tv.nodeLat(i) + tv.nodeLon(i);
+        if (++i == N) i = 0;
+      }
+      doNotOptimize(acc);
+    });
+    runner.run("tileview/first_edge_count" + sfx, [&](uint64_t iters) {
+      uint64_t acc = 0;
+      int i = 0;
+      for (uint64_t k = 0; k < iters; ++k) {
+        acc += tv.firstEdge(i) + tv.edgeCountFrom(i);
+        if (++i == N) i = 0;
+      }
+      doNotOptimize(acc);
+    });
+    runner.run("tileview/edge_at_fields" + sfx, [&](uint64_t iters) {
+      double acc = 0.0;
+      uint32_t ei = 0;
+      for (uint64_t k = 0; k < iters; ++k) {
+        const auto e = tv.edgeAt(ei);
+        acc += e.length_m() + e.to_node() + e.access_mask() + static_cast<int>(e.road_class());
+        if (++ei == static_cast<uint32_t>(E)) ei = 0;
+      }
+      doNotOptimize(acc);
+    });
+    runner.run("tileview/ensure_in_adj_built" + sfx, [&](uint64_t iters) {
+      for (uint64_t k = 0; k < iters; ++k) {
+        TileView fresh(buf, tv.schemaVersion());
+        doNotOptimize(fresh.inEdgesOf(0).size());
+      }
+    });
+    runner.run("tileview/in_edges_of" + sfx, [&](uint64_t iters) {
+      uint64_t acc = 0;
+      int i = 0;
+      for (uint64_t k = 0; k < iters; ++k) {
+        for (auto ei : tv.inEdgesOf(i)) acc += ei;
+        if (++i == N) i = 0;
+      }
+      doNotOptimize(acc);
+    });
+  };
+  viewCases("", view, center.buffer);
+  viewCases("_v2", viewV2, centerV2.buffer);
+  // тайл без сохранённой обратной смежности: индекс строится при первом inEdgesOf
+  SyntheticSpec noInSpec = encSpec;
+  noInSpec.encodedPolylineOnly = false;
+  noInSpec.storeInAdjacency = false;
+  auto noInBuf = std::make_shared<std::vector<uint8_t>>(buildSyntheticTileBlob(noInSpec, center.key.x, center.key.y));
+  runner.run("tileview/ensure_in_adj_built_computed", [&](uint64_t iters) {
+    for (uint64_t k = 0; k < iters; ++k) {
+      TileView fresh(noInBuf);
+      doNotOptimize(fresh.inEdgesOf(0).size());
+    }
+  });
+
+  // --- геометрия рёбер ---
+  std::vector<std::pair<double,double>> pts;
+  pts.reserve(64);
+  auto shapeCase = [&](const std::string& name, const TileView& tv) {
+    runner.run(name, [&](uint64_t iters) {
+      uint32_t ei = 0;
+      for (uint64_t k = 0; k < iters; ++k) {
+        pts.clear();
+        tv.appendEdgeShape(ei, pts, /*skipFirst*/false);
+        doNotOptimize(pts.data());
+        if (++ei == static_cast<uint32_t>(E)) ei = 0;
+      }
+    });
+  };
+  shapeCase("shape/append_edge_shape", view);
+  shapeCase("shape/append_edge_shape_v2", viewV2);
+  TileView encView(encTiles.front().buffer);
+  runner.run("shape/decode_encoded_polyline", [&](uint64_t iters) {
+    uint32_t ei = 0;
+    const auto encE = static_cast<uint32_t>(encView.edgeCount());
+    for (uint64_t k = 0; k < iters; ++k) {
+      pts.clear();
+      encView.appendEdgeShape(ei, pts, /*skipFirst*/false);
+      doNotOptimize(pts.data());
+      if (++ei == encE) ei = 0;
+    }
+  });
+
+  // --- снап ---
+  const auto car = makeCarProfile();
+  std::vector<std::pair<double,double>> probes;
+  {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    auto bb = syntheticTileBounds(spec.z, center.key.x, center.key.y);
+    for (int k = 0; k < 64; ++k) {
+      probes.emplace_back(bb.lat_min + (bb.lat_max - bb.lat_min) * uni(rng),
+                          bb.lon_min + (bb.lon_max - bb.lon_min) * uni(rng));
+    }
+  }
+  runner.run("snap/snap_to_edge", [&](uint64_t iters) {
+    size_t p = 0;
+    for (uint64_t k = 0; k < iters; ++k) {
+      auto s = RouterImpl::snapToEdge(view, probes[p].first, probes[p].second, car);
+      doNotOptimize(s);
+      if (++p == probes.size()) p = 0;
+    }
+  });
+
+  // --- TileStore: чтение тайла из SQLite (копия BLOB) и из пака (mmap, без копирования) ---
+  // uncached — кэш на 0 тайлов, каждое обращение идёт в бэкенд; cached — попадание в LRU.
+  auto storeCase = [&](const char* name, const std::string& path, size_t capacity) {
+    TileStore store(path, capacity);
+    runner.run(name, [&](uint64_t iters) {
+      size_t i = 0;
+      for (uint64_t k = 0; k < iters; ++k) {
+        const auto& key = tiles[i].key;
+        auto b = store.load(key.z, key.x, key.y);
+        TileView v(b, b->data, b->size);
+        doNotOptimize(v.nodeCount());
+        if (++i == tiles.size()) i = 0;
+      }
+    });
+  };
+  storeCase("tile_store/load_uncached_sqlite", dbPath, 0);
+  storeCase("tile_store/load_uncached_pack", packPath, 0);
+  storeCase("tile_store/load_cached_sqlite", dbPath, 128);
+  storeCase("tile_store/load_cached_pack", packPath, 128);
+  if (!zstdDbPath.empty()) {
+    storeCase("tile_store/load_uncached_sqlite_zstd", zstdDbPath, 0);
+    storeCase("tile_store/load_cached_sqlite_zstd", zstdDbPath, 128);
+  }
+  {
+    // бюджет на ~3 тайла при обходе 9: каждое обращение — промах с вытеснением по байтам
+    TileStore store(dbPath, 128, 3 * center.buffer->size());
+    runner.run("tile_store/load_byte_budget_evict", [&](uint64_t iters) {
+      size_t i = 0;
+      for (uint64_t k = 0; k < iters; ++k) {
+        const auto& key = tiles[i].key;
+        auto b = store.load(key.z, key.x, key.y);
+        doNotOptimize(b->size);
+        if (++i == tiles.size()) i = 0;
+      }
+    });
+  }
+
+  // --- холодный диск: файл пака вытеснен из page cache (posix_fadvise DONTNEED входит в замер) ---
+  // Копия пака: страницы, отображённые другими кейсами, из page cache не вытесняются.
+  const std::string coldPackPath = packPath + ".cold";
+  std::filesystem::copy_file(packPath, coldPackPath, std::filesystem::copy_options::overwrite_existing);
+  auto dropPageCache = [](const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+  };
+  std::vector<TileKey> allKeys;
+  for (const auto& t : tiles) allKeys.push_back(t.key);
+  // все тайлы пака: по одному через load() или одним пакетом (io_uring / pread-пул)
+  auto coldDiskStoreCase = [&](const char* name, bool batch, bool ioUring) {
+    runner.run(name, [&](uint64_t iters) {
+      for (uint64_t k = 0; k < iters; ++k) {
+        dropPageCache(coldPackPath);
+        TileStore store(coldPackPath, 128);
+        store.setChecksumVerification(true);
+        if (batch) {
+          store.enableBatchReads(4, ioUring);
+          doNotOptimize(store.loadBatch(allKeys).size());
+        } else {
+          for (const auto& key : allKeys) doNotOptimize(store.load(key.z, key.x, key.y)->size);
+        }
+      }
+    });
+  };
+  coldDiskStoreCase("tile_store/load_all_cold_disk_pack", false, false);
+  coldDiskStoreCase("tile_store/load_batch_cold_disk_pack", true, true);
+  coldDiskStoreCase("tile_store/load_batch_cold_disk_pack_pread", true, false);
+
+  // --- склейка глобального графа ---
+  RouterOptions ropt;
+  ropt.tileZoom = spec.z;
+  RouterImpl impl(dbPath, ropt);
+  std::vector<std::pair<TileKey,TileView>> views;
+  views.reserve(tiles.size());
+  for (const auto& t : tiles) views.emplace_back(t.key, TileView(t.buffer));
+
+  RouterImpl::GlobalNodes gnodes;
+  RouterImpl::GlobalAdj adj;
+  RouterImpl::GlobalRevAdj revAdj;
+  RouterImpl::NodeIndex q2node;
+  runner.run("graph/build_global_graph", [&](uint64_t iters) {
+    for (uint64_t k = 0; k < iters; ++k) {
+      impl.buildGlobalGraph(car, views, gnodes, adj, revAdj, q2node);
+      doNotOptimize(gnodes.size());
+    }
+  });
+  {
+    std::vector<std::pair<TileKey,TileView>> viewsV2;
+    for (const auto& t : tilesV2) viewsV2.emplace_back(t.key, TileView(t.buffer, 2));
+    runner.run("graph/build_global_graph_v2", [&](uint64_t iters) {
+      for (uint64_t k = 0; k < iters; ++k) {
+        impl.buildGlobalGraph(car, viewsV2, gnodes, adj, revAdj, q2node);
+        doNotOptimize(gnodes.size());
+      }
+    });
+  }
+
+  // --- bi-A* по склеенному графу: из угла в угол набора ---
+  impl.buildGlobalGraph(car, views, gnodes, adj, revAdj, q2node);
+  auto nearest = [&](double lat, double lon) {
+    int best = 0;
+    double bestD = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < static_cast<int>(gnodes.size()); ++i) {
+      if (adj[i].empty() || revAdj[i].empty()) continue;
+      double d = RouterImpl::haversine(lat, lon, gnodes[i].lat, gnodes[i].lon);
+      if (d < bestD) { bestD = d; best = i; }
+    }
+    return best;
+  };
+  auto pa = syntheticPoint(spec, 0.1, 0.1);
+  auto pb = syntheticPoint(spec, 0.9, 0.9);
+  const int s = nearest(pa.first, pa.second);
+  const int t = nearest(pb.first, pb.second);
+  std::vector<int> meetPath;
+  std::vector<uint64_t> usedEdges;
+  std::printf("graph: %zu nodes; search %d -> %d\n", gnodes.size(), s, t);
+  runner.run("search/astar_global_bi", [&](uint64_t iters) {
+    for (uint64_t k = 0; k < iters; ++k) {
+      bool ok = impl.astarGlobalBi(gnodes, adj, revAdj, s, t, meetPath, usedEdges);
+      doNotOptimize(ok);
+    }
+  });
+  // направления в двух потоках (RouterOptions::parallelSearchMinNodes); выигрыш — только при свободном ядре
+  RouterOptions popt = ropt;
+  popt.parallelSearchMinNodes = 1;
+  RouterImpl pimpl(dbPath, popt);
+  runner.run("search/astar_global_bi_parallel", [&](uint64_t iters) {
+    RouterImpl::QueryStats<false> none;
+    for (uint64_t k = 0; k < iters; ++k) {
+      bool ok = pimpl.astarGlobalBiParallel(gnodes, adj, revAdj, s, t, meetPath, usedEdges, none);
+      doNotOptimize(ok);
+    }
+  });
+
+  // --- полный запрос с тёплым кэшем тайлов ---
+  Router router(dbPath, ropt);
+  const std::vector<Coord> wps{{pa.first, pa.second}, {pb.first, pb.second}};
+  auto probe = router.route(car, wps);
+  std::printf("route: status=%d distance=%.0fm points=%zu\n",
+              static_cast<int>(probe.status), probe.distance_m, probe.polyline.size());
+  runner.run("route/end_to_end_warm", [&](uint64_t iters) {
+    for (uint64_t k = 0; k < iters; ++k) {
+      auto rr = router.route(car, wps);
+      doNotOptimize(rr.duration_s);
+    }
+  });
+
+  // --- выдача геометрии: текст координат (как в JSON-ответе) vs упрощение и кодирование ---
+  {
+    const auto& full = probe.polyline;
+    auto coordsText = [](const std::vector<Coord>& pts) {
+      std::string out;
+      out.reserve(pts.size() * 24);
+      char buf[48];
+      for (const auto& p : pts) {
+        int n = std::snprintf(buf, sizeof(buf), "[%.6f,%.6f],", p.lon, p.lat);
+        out.append(buf, static_cast<size_t>(n));
+      }
+      return out;
+    };
+    RouteOutputOptions z15;
+    z15.format = GeometryFormat::Polyline;
+    z15.simplifyZoom = 15;
+    const auto simplified = simplifyPolyline(full, pixelSizeM(15, full.empty() ? 0.0 : full.front().lat));
+    std::printf("output: coords %zu pts / %zu text bytes; polyline %zu bytes; z15 %zu pts / %zu bytes; "
+                "flatbuffers %zu bytes\n",
+                full.size(), coordsText(full).size(), encodePolyline(full).size(), simplified.size(),
+                encodePolyline(simplified).size(),
+                encodeRouteGeometry(simplified, probe.distance_m, probe.duration_s).size());
+    runner.run("output/coords_text", [&](uint64_t iters) {
+      for (uint64_t k = 0; k < iters; ++k) doNotOptimize(coordsText(full).size());
+    });
+    runner.run("output/polyline_z15", [&](uint64_t iters) {
+      for (uint64_t k = 0; k < iters; ++k) {
+        RouteResult rr;
+        rr.polyline = full;
+        applyRouteOutput(rr, z15);
+        doNotOptimize(rr.encoded_polyline.size());
+      }
+    });
+    runner.run("output/flatbuffers_z15", [&](uint64_t iters) {
+      RouteOutputOptions fb = z15;
+      fb.format = GeometryFormat::FlatBuffers;
+      for (uint64_t k = 0; k < iters; ++k) {
+        RouteResult rr;
+        rr.polyline = full;
+        applyRouteOutput(rr, fb);
+        doNotOptimize(rr.geometry_buffer.size());
+      }
+    });
+  }
+
+  Router v2Router(dbPathV2, ropt);
+  auto probeV2 = v2Router.route(car, wps);
+  std::printf("route v2: status=%d distance=%.0fm points=%zu\n",
+              static_cast<int>(probeV2.status), probeV2.distance_m, probeV2.polyline.size());
+  runner.run("route/end_to_end_warm_v2", [&](uint64_t iters) {
+    for (uint64_t k = 0; k < iters; ++k) {
+      auto rr = v2Router.route(car, wps);
+      doNotOptimize(rr.duration_s);
+    }
+  });
+
+  Router geomRouter(dbPathGeom, ropt);
+  auto probeGeom = geomRouter.route(car, wps);
+  std::printf("route v2 geometry layer: status=%d distance=%.0fm points=%zu\n",
+              static_cast<int>(probeGeom.status), probeGeom.distance_m, probeGeom.polyline.size());
+  runner.run("route/end_to_end_warm_v2geom", [&](uint64_t iters) {
+    for (uint64_t k = 0; k < iters; ++k) {
+      auto rr = geomRouter.route(car, wps);
+      doNotOptimize(rr.duration_s);
+    }
+  });
+
+  Router packRouter(packPath, ropt);
+  runner.run("route/end_to_end_warm_pack", [&](uint64_t iters) {
+    for (uint64_t k = 0; k < iters; ++k) {
+      auto rr = packRouter.route(car, wps);
+      doNotOptimize(rr.duration_s);
+    }
+  });
+
+  // --- холодный запрос: пустой кэш тайлов, синхронное чтение vs фоновая подгрузка ---
+  auto coldCase = [&](const char* name, const std::string& path, int prefetchThreads, bool verify = false,
+                      int graphThreads = 0) {
+    RouterOptions copt = ropt;
+    copt.prefetchThreads = prefetchThreads;
+    copt.verifyTileChecksums = verify;
+    copt.graphThreads = graphThreads;
+    runner.run(name, [&](uint64_t iters) {
+      for (uint64_t k = 0; k < iters; ++k) {
+        Router cold(path, copt);
+        auto rr = cold.route(car, wps);
+        doNotOptimize(rr.duration_s);
+      }
+    });
+  };
+  coldCase("route/end_to_end_cold_sync", dbPath, 0);
+  // цена проверки xxh64 при первой загрузке тайлов
+  coldCase("route/end_to_end_cold_sync_verify", dbPath, 0, true);
+  coldCase("route/end_to_end_cold_sync_pack", packPath, 0);
+  coldCase("route/end_to_end_cold_sync_pack_verify", packPath, 0, true);
+  coldCase("route/end_to_end_cold_prefetch", dbPath, 2);
+  // чтение, распаковка и подготовка тайлов в пуле, склейка — в потоке запроса
+  coldCase("route/end_to_end_cold_graph_pool", dbPath, 0, false, 3);
+  coldCase("route/end_to_end_cold_sync_v2", dbPathV2, 0);
+  coldCase("route/end_to_end_cold_sync_v2geom", dbPathGeom, 0);
+  // сколько байт читает холодный запрос: тайлы целиком vs тайлы без форм + слой геометрии
+  for (const auto& [label, path] : {std::pair<const char*, std::string>{"v2", dbPathV2}, {"v2geom", dbPathGeom}}) {
+    RouterOptions copt = ropt;
+    copt.collectStats = true;
+    Router cold(path, copt);
+    auto rr = cold.route(car, wps);
+    if (rr.stats) {
+      std::printf("cold %s: tiles %u, %llu bytes; geometry tiles %u, %llu bytes\n", label,
+                  rr.stats->tiles_requested, static_cast<unsigned long long>(rr.stats->bytes_read),
+                  rr.stats->geometry_tiles, static_cast<unsigned long long>(rr.stats->geometry_bytes_read));
+    }
+  }
+  if (!zstdDbPath.empty()) coldCase("route/end_to_end_cold_sync_zstd", zstdDbPath, 0);
+  // холодный диск: тайлы по одному, впереди запроса в префетчере, одним пакетом (RouterOptions::batchTileReads)
+  auto coldDiskCase = [&](const char* name, bool batch, int prefetchThreads) {
+    RouterOptions copt = ropt;
+    copt.batchTileReads = batch;
+    copt.prefetchThreads = prefetchThreads;
+    runner.run(name, [&](uint64_t iters) {
+      for (uint64_t k = 0; k < iters; ++k) {
+        dropPageCache(coldPackPath);
+        Router cold(coldPackPath, copt);
+        auto rr = cold.route(car, wps);
+        doNotOptimize(rr.duration_s);
+      }
+    });
+  };
+  coldDiskCase("route/end_to_end_cold_disk_pack", false, 0);
+  coldDiskCase("route/end_to_end_cold_disk_pack_prefetch", false, 2);
+  coldDiskCase("route/end_to_end_cold_disk_pack_batch", true, 0);
+
+  runner.run("route/end_to_end_after_trim", [&](uint64_t iters) {
+    for (uint64_t k = 0; k < iters; ++k) {
+      router.trimMemory(MemoryTrimLevel::Critical);
+      auto rr = router.route(car, wps);
+      doNotOptimize(rr.duration_s);
+    }
+  });
+
+  // --- кэш результатов: повтор тех же координат и соседние точки с той же привязкой ---
+  RouterOptions cacheOpt = ropt;
+  cacheOpt.resultCacheEntries = 256;
+  Router cachedRouter(dbPath, cacheOpt);
+  cachedRouter.route(car, wps);
+  runner.run("route/end_to_end_cached_exact", [&](uint64_t iters) {
+    for (uint64_t k = 0; k < iters; ++k) {
+      auto rr = cachedRouter.route(car, wps);
+      doNotOptimize(rr.duration_s);
+    }
+  });
+  // Привязка общая, только если проекция совпадает точно: точки за углами решётки
+  // проецируются в угловые узлы (t зажат в 0 или 1), как подъезды к одному хабу.
+  const auto ca = syntheticPoint(spec, -0.002, -0.002);
+  const auto cb = syntheticPoint(spec, 1.002, 1.002);
+  cachedRouter.route(car, {{ca.first, ca.second}, {cb.first, cb.second}});
+  uint64_t jitter = 0;
+  runner.run("route/end_to_end_cached_snapped", [&](uint64_t iters) {
+    for (uint64_t k = 0; k < iters; ++k, ++jitter) {
+      // 1024 разных пары координат (больше ёмкости кэша), все дальше от углов
+      const auto a = syntheticPoint(spec, -0.002 - 1e-5 * static_cast<double>(jitter % 32), -0.002);
+      const auto b = syntheticPoint(spec, 1.002, 1.002 + 1e-5 * static_cast<double>(jitter / 32 % 32));
+      auto rr = cachedRouter.route(car, {{a.first, a.second}, {b.first, b.second}});
+      doNotOptimize(rr.duration_s);
+    }
+  });
+
+  RouterOptions sopt = ropt;
+  sopt.collectStats = true;
+  Router statsRouter(dbPath, sopt);
+  runner.run("route/end_to_end_warm_stats", [&](uint64_t iters) {
+    for (uint64_t k = 0; k < iters; ++k) {
+      auto rr = statsRouter.route(car, wps);
+      doNotOptimize(rr.duration_s);
+    }
+  });
+
+  // --- цена спана трассировки (выключена / включена); последним, т.к. флаг глобальный ---
+  runner.run("trace/span_disabled", [&](uint64_t iters) {
+    for (uint64_t k = 0; k < iters; ++k) {
+      ROUTING_TRACE_SCOPE("bench", "span");
+      doNotOptimize(k);
+    }
+  });
+  if (runner.selected("trace/span_enabled")) {
+    trace::enable(1u << 12);
+    runner.run("trace/span_enabled", [&](uint64_t iters) {
+      for (uint64_t k = 0; k < iters; ++k) {
+        ROUTING_TRACE_SCOPE("bench", "span");
+        doNotOptimize(k);
+      }
+    });
+    trace::disable();
+  }
+
+  int rc = runner.finish();
+  std::filesystem::remove(dbPath);
+  std::filesystem::remove(dbPathV2);
+  std::filesystem::remove(dbPathGeom);
+  std::filesystem::remove(packPath);
+  std::filesystem::remove(coldPackPath);
+  if (!zstdDbPath.empty()) std::filesystem::remove(zstdDbPath);
+  return rc;
+}
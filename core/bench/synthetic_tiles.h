@@ -0,0 +1,461 @@
+#pragma once
+
+// Синтетические тайлы управляемого размера для бенчмарков.
+// Тайл — решётка gridN x gridN узлов по границам WebMercator-тайла; узлы на общих
+// границах соседних тайлов совпадают по lat_q/lon_q, поэтому склейка между тайлами
+// работает так же, как на данных конвертера.
+
+#include <flatbuffers/flatbuffers.h>
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef ROUTING_CORE_HAVE_ZSTD
+#  include <zdict.h>
+#  include <zstd.h>
+#endif
+
+#include "land_tile_generated.h"
+#include "routing_core/base64.h"
+#include "routing_core/tile_pack.h"
+#include "routing_core/tile_store.h"
+#include "routing_core/tiler.h"
+#include "routing_core/xxhash64.h"
+
+namespace routing_bench {
+
+struct SyntheticSpec {
+  int z {14};
+  double originLat {47.14};     // левый верхний тайл набора
+  double originLon {9.52};
+  int tilesX {3};
+  int tilesY {3};
+  int gridN {32};               // узлов на сторону тайла
+  int shapePointsPerEdge {2};   // промежуточные точки формы ребра
+  bool encodedPolylineOnly {false}; // геометрия в encoded_polyline вместо shapes (только v1)
+  int schemaVersion {1};        // 1 — таблицы LandTile, 2 — структуры LandTileV2
+  bool separateGeometry {false}; // v2: промежуточные точки в отдельном слое (TileGeometry)
+  bool storeInAdjacency {true}; // обратная смежность в тайле (in_first/in_edges), как у конвертера
+  double onewayShare {0.1};
+  uint32_t seed {42};
+};
+
+struct SyntheticTile {
+  routing_core::TileKey key;
+  std::shared_ptr<std::vector<uint8_t>> buffer;
+  std::shared_ptr<std::vector<uint8_t>> geometry; // блоб TileGeometry (SyntheticSpec::separateGeometry)
+};
+
+struct SyntheticBBox { double lat_min, lon_min, lat_max, lon_max; };
+
+inline SyntheticBBox syntheticTileBounds(int z, int x, int y) {
+  const double n = static_cast<double>(1 << z);
+  const double lon_min = x / n * 360.0 - 180.0;
+  const double lon_max = (x + 1) / n * 360.0 - 180.0;
+  const double lat_max = std::atan(std::sinh(M_PI * (1.0 - 2.0 * y / n))) * 180.0 / M_PI;
+  const double lat_min = std::atan(std::sinh(M_PI * (1.0 - 2.0 * (y + 1) / n))) * 180.0 / M_PI;
+  return {lat_min, lon_min, lat_max, lon_max};
+}
+
+inline double syntheticHaversine(double lat1, double lon1, double lat2, double lon2) {
+  constexpr double R = 6371000.0;
+  const double p1 = lat1 * M_PI / 180.0;
+  const double p2 = lat2 * M_PI / 180.0;
+  const double dphi = (lat2 - lat1) * M_PI / 180.0;
+  const double dl = (lon2 - lon1) * M_PI / 180.0;
+  const double a = std::sin(dphi/2)*std::sin(dphi/2) + std::cos(p1)*std::cos(p2)*std::sin(dl/2)*std::sin(dl/2);
+  return R * 2 * std::atan2(std::sqrt(a), std::sqrt(1-a));
+}
+
+// Google encoded polyline (точность 1e-5), как читает TileView::decodeEncodedPolyline.
+inline std::string encodePolyline(const std::vector<std::pair<double,double>>& pts) {
+  std::string out;
+  int prevLat = 0, prevLon = 0;
+  auto put = [&](int v) {
+    unsigned int u = static_cast<unsigned int>(v < 0 ? ~(v << 1) : (v << 1));
+    while (u >= 0x20) {
+      out.push_back(static_cast<char>((0x20 | (u & 0x1f)) + 63));
+      u >>= 5;
+    }
+    out.push_back(static_cast<char>(u + 63));
+  };
+  for (const auto& p : pts) {
+    int lat = static_cast<int>(std::lround(p.first * 1e5));
+    int lon = static_cast<int>(std::lround(p.second * 1e5));
+    put(lat - prevLat);
+    put(lon - prevLon);
+    prevLat = lat;
+    prevLon = lon;
+  }
+  return out;
+}
+
+// zigzag-varint, как в слое геометрии конвертера
+inline void putGeometryDelta(std::vector<uint8_t>& out, int32_t v) {
+  uint32_t u = (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+  while (u >= 0x80) {
+    out.push_back(static_cast<uint8_t>(u | 0x80));
+    u >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(u));
+}
+
+inline std::vector<uint8_t> buildSyntheticTileBlob(const SyntheticSpec& spec, int tx, int ty,
+                                                   std::vector<uint8_t>* geometryOut = nullptr) {
+  using namespace Routing;
+  const int N = std::max(2, spec.gridN);
+  const auto bb = syntheticTileBounds(spec.z, tx, ty);
+  std::mt19937 rng(spec.seed ^ (static_cast<uint32_t>(tx) * 73856093u) ^ (static_cast<uint32_t>(ty) * 19349663u));
+  std::uniform_real_distribution<double> uni(0.0, 1.0);
+
+  // узлы решётки; внутренние слегка «шумим», граничные — строго на границе тайла
+  std::vector<std::pair<double,double>> coords(static_cast<size_t>(N * N));
+  const double dLat = (bb.lat_max - bb.lat_min) / (N - 1);
+  const double dLon = (bb.lon_max - bb.lon_min) / (N - 1);
+  for (int j = 0; j < N; ++j) {
+    for (int i = 0; i < N; ++i) {
+      double lat = (j == N - 1) ? bb.lat_min : bb.lat_max - j * dLat;
+      double lon = (i == N - 1) ? bb.lon_max : bb.lon_min + i * dLon;
+      if (i > 0 && i < N - 1 && j > 0 && j < N - 1) {
+        lat += (uni(rng) - 0.5) * 0.3 * dLat;
+        lon += (uni(rng) - 0.5) * 0.3 * dLon;
+      }
+      coords[static_cast<size_t>(j * N + i)] = {lat, lon};
+    }
+  }
+
+  struct E { uint32_t from, to; bool oneway; RoadClass rc; };
+  std::vector<E> edges;
+  edges.reserve(static_cast<size_t>(2 * N * N));
+  auto pickClass = [&]() {
+    double r = uni(rng);
+    if (r < 0.05) return RoadClass::PRIMARY;
+    if (r < 0.15) return RoadClass::SECONDARY;
+    if (r < 0.90) return RoadClass::RESIDENTIAL;
+    return RoadClass::FOOTWAY;
+  };
+  auto addEdge = [&](uint32_t a, uint32_t b) {
+    bool oneway = uni(rng) < spec.onewayShare;
+    if (oneway && uni(rng) < 0.5) std::swap(a, b);
+    edges.push_back(E{a, b, oneway, pickClass()});
+  };
+  for (int j = 0; j < N; ++j) {
+    for (int i = 0; i < N; ++i) {
+      uint32_t u = static_cast<uint32_t>(j * N + i);
+      if (i + 1 < N) addEdge(u, u + 1);
+      if (j + 1 < N) addEdge(u, u + static_cast<uint32_t>(N));
+    }
+  }
+  // CSR: рёбра отсортированы по from_node
+  std::stable_sort(edges.begin(), edges.end(), [](const E& a, const E& b) { return a.from < b.from; });
+  std::vector<uint32_t> firstEdge(static_cast<size_t>(N * N), 0);
+  std::vector<uint16_t> edgeCount(static_cast<size_t>(N * N), 0);
+  for (size_t k = edges.size(); k-- > 0;) {
+    firstEdge[edges[k].from] = static_cast<uint32_t>(k);
+    ++edgeCount[edges[k].from];
+  }
+  std::vector<uint32_t> inFirst, inEdges;
+  if (spec.storeInAdjacency) {
+    inFirst.assign(static_cast<size_t>(N * N) + 1, 0);
+    for (const auto& e : edges) ++inFirst[e.to + 1];
+    for (size_t n = 0; n + 1 < inFirst.size(); ++n) inFirst[n + 1] += inFirst[n];
+    inEdges.resize(edges.size());
+    std::vector<uint32_t> fill(inFirst.begin(), inFirst.end() - 1);
+    for (size_t k = 0; k < edges.size(); ++k) inEdges[fill[edges[k].to]++] = static_cast<uint32_t>(k);
+  }
+
+  const bool v2 = spec.schemaVersion >= 2;
+  auto q = [](double deg) { return static_cast<int32_t>(std::lround(deg * 1e6)); };
+  flatbuffers::FlatBufferBuilder fbb(1 << 16);
+  std::vector<flatbuffers::Offset<Node>> nodeOffs;
+  std::vector<NodeV2> nodesV2;
+  for (uint32_t k = 0; k < coords.size(); ++k) {
+    if (v2) {
+      nodesV2.emplace_back(q(coords[k].first), q(coords[k].second), firstEdge[k], edgeCount[k]);
+    } else {
+      nodeOffs.push_back(CreateNode(fbb, k, q(coords[k].first), q(coords[k].second),
+                                    firstEdge[k], edgeCount[k]));
+    }
+  }
+  auto nodesVec = fbb.CreateVector(nodeOffs);
+
+  std::vector<EdgeV2> edgesV2;
+  std::vector<ShapePointV2> shapesV2;
+  const bool separate = v2 && spec.separateGeometry && geometryOut;
+  std::vector<uint32_t> geomOffsets;
+  std::vector<uint8_t> geomPoints;
+  std::vector<flatbuffers::Offset<ShapePoint>> shapeOffs;
+  std::vector<flatbuffers::Offset<Edge>> edgeOffs;
+  edgeOffs.reserve(edges.size());
+  std::vector<std::pair<double,double>> pts;
+  for (const auto& e : edges) {
+    const auto& a = coords[e.from];
+    const auto& b = coords[e.to];
+    pts.clear();
+    pts.push_back(a);
+    for (int s = 1; s <= spec.shapePointsPerEdge; ++s) {
+      double t = static_cast<double>(s) / (spec.shapePointsPerEdge + 1);
+      double wob = (uni(rng) - 0.5) * 0.1;
+      pts.emplace_back(a.first + (b.first - a.first) * t + wob * dLat,
+                       a.second + (b.second - a.second) * t + wob * dLon);
+    }
+    pts.push_back(b);
+    double len = 0.0;
+    for (size_t k = 1; k < pts.size(); ++k) {
+      len += syntheticHaversine(pts[k-1].first, pts[k-1].second, pts[k].first, pts[k].second);
+    }
+
+    const bool footOnly = e.rc == RoadClass::FOOTWAY;
+    if (v2) {
+      // v2: только промежуточные точки
+      const auto start = static_cast<uint32_t>(shapesV2.size());
+      if (separate) {
+        geomOffsets.push_back(static_cast<uint32_t>(geomPoints.size()));
+        int32_t lat = q(a.first), lon = q(a.second);
+        for (size_t k = 1; k + 1 < pts.size(); ++k) {
+          putGeometryDelta(geomPoints, q(pts[k].first) - lat);
+          putGeometryDelta(geomPoints, q(pts[k].second) - lon);
+          lat = q(pts[k].first);
+          lon = q(pts[k].second);
+        }
+      } else {
+        for (size_t k = 1; k + 1 < pts.size(); ++k) shapesV2.emplace_back(q(pts[k].first), q(pts[k].second));
+      }
+      edgesV2.emplace_back(e.from, e.to, static_cast<float>(len), footOnly ? 0.0f : 13.89f, 1.4f,
+                           start, static_cast<uint16_t>(shapesV2.size() - start),
+                           static_cast<uint16_t>(footOnly ? 0x2 : 0x3), e.rc, e.oneway);
+      continue;
+    }
+    uint32_t shapeStart = 0;
+    uint16_t shapeCount = 0;
+    flatbuffers::Offset<flatbuffers::String> enc;
+    if (spec.encodedPolylineOnly) {
+      enc = fbb.CreateString(encodePolyline(pts));
+    } else {
+      shapeStart = static_cast<uint32_t>(shapeOffs.size());
+      for (const auto& p : pts) shapeOffs.push_back(CreateShapePoint(fbb, q(p.first), q(p.second)));
+      shapeCount = static_cast<uint16_t>(pts.size());
+    }
+    edgeOffs.push_back(CreateEdge(fbb, e.from, e.to,
+      static_cast<float>(len),
+      footOnly ? 0.0f : 13.89f,
+      1.4f,
+      e.oneway,
+      e.rc,
+      static_cast<uint16_t>(footOnly ? 0x2 : 0x3),
+      shapeStart,
+      shapeCount,
+      enc));
+  }
+  if (v2) {
+    auto nv = fbb.CreateVectorOfStructs(nodesV2);
+    auto ev = fbb.CreateVectorOfStructs(edgesV2);
+    decltype(fbb.CreateVectorOfStructs(shapesV2)) sv;
+    if (!separate) sv = fbb.CreateVectorOfStructs(shapesV2);
+    flatbuffers::Offset<flatbuffers::Vector<uint32_t>> inFirstVec, inEdgesVec;
+    if (spec.storeInAdjacency) {
+      inFirstVec = fbb.CreateVector(inFirst);
+      inEdgesVec = fbb.CreateVector(inEdges);
+    }
+    auto checksum = fbb.CreateString("");
+    fbb.Finish(CreateLandTileV2(fbb, static_cast<uint16_t>(spec.z),
+                                static_cast<uint32_t>(tx), static_cast<uint32_t>(ty),
+                                1u, checksum, 0x3u, nv, ev, sv, inFirstVec, inEdgesVec));
+    if (separate) {
+      geomOffsets.push_back(static_cast<uint32_t>(geomPoints.size()));
+      flatbuffers::FlatBufferBuilder gb(1 << 12);
+      auto ov = gb.CreateVector(geomOffsets);
+      auto pv = gb.CreateVector(geomPoints);
+      gb.Finish(CreateTileGeometry(gb, ov, pv));
+      geometryOut->assign(gb.GetBufferPointer(), gb.GetBufferPointer() + gb.GetSize());
+    }
+    return std::vector<uint8_t>(fbb.GetBufferPointer(), fbb.GetBufferPointer() + fbb.GetSize());
+  }
+  auto edgesVec = fbb.CreateVector(edgeOffs);
+  flatbuffers::Offset<flatbuffers::Vector<flatbuffers::Offset<ShapePoint>>> shapesVec;
+  if (!shapeOffs.empty()) shapesVec = fbb.CreateVector(shapeOffs);
+  flatbuffers::Offset<flatbuffers::Vector<uint32_t>> inFirstVec, inEdgesVec;
+  if (spec.storeInAdjacency) {
+    inFirstVec = fbb.CreateVector(inFirst);
+    inEdgesVec = fbb.CreateVector(inEdges);
+  }
+  auto checksum = fbb.CreateString("");
+  auto root = CreateLandTile(fbb, static_cast<uint16_t>(spec.z),
+                             static_cast<uint32_t>(tx), static_cast<uint32_t>(ty),
+                             nodesVec, edgesVec, shapesVec, 1u, checksum, 0x3u, inFirstVec, inEdgesVec);
+  fbb.Finish(root);
+  return std::vector<uint8_t>(fbb.GetBufferPointer(), fbb.GetBufferPointer() + fbb.GetSize());
+}
+
+inline routing_core::WebTileKey syntheticOriginTile(const SyntheticSpec& spec) {
+  return routing_core::webTileKeyFor(spec.originLat, spec.originLon, spec.z);
+}
+
+inline std::vector<SyntheticTile> makeSyntheticTiles(const SyntheticSpec& spec) {
+  auto origin = syntheticOriginTile(spec);
+  std::vector<SyntheticTile> out;
+  out.reserve(static_cast<size_t>(spec.tilesX * spec.tilesY));
+  for (int dy = 0; dy < spec.tilesY; ++dy) {
+    for (int dx = 0; dx < spec.tilesX; ++dx) {
+      int x = origin.x + dx, y = origin.y + dy;
+      std::shared_ptr<std::vector<uint8_t>> geometry;
+      if (spec.separateGeometry) geometry = std::make_shared<std::vector<uint8_t>>();
+      auto blob = buildSyntheticTileBlob(spec, x, y, geometry.get());
+      out.push_back(SyntheticTile{routing_core::TileKey{spec.z, x, y},
+                                  std::make_shared<std::vector<uint8_t>>(std::move(blob)),
+                                  std::move(geometry)});
+    }
+  }
+  return out;
+}
+
+// Точка внутри набора тайлов: fx, fy в [0..1] по ширине/высоте всего набора.
+inline std::pair<double,double> syntheticPoint(const SyntheticSpec& spec, double fx, double fy) {
+  auto origin = syntheticOriginTile(spec);
+  auto tl = syntheticTileBounds(spec.z, origin.x, origin.y);
+  auto br = syntheticTileBounds(spec.z, origin.x + spec.tilesX - 1, origin.y + spec.tilesY - 1);
+  return {tl.lat_max + (br.lat_min - tl.lat_max) * fy,
+          tl.lon_min + (br.lon_max - tl.lon_min) * fx};
+}
+
+using SyntheticMetadata = std::vector<std::pair<std::string, std::string>>;
+
+// Пишет routingdb той же схемы, что и конвертер (metadata + land_tiles [+ land_geometry]).
+inline void writeSyntheticRoutingDb(const std::string& path, const std::vector<SyntheticTile>& tiles,
+                                    const SyntheticMetadata& extraMetadata = {}) {
+  std::remove(path.c_str());
+  sqlite3* db = nullptr;
+  if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+    std::string msg = std::string("Failed to open ") + path + ": " + sqlite3_errmsg(db);
+    sqlite3_close(db);
+    throw std::runtime_error(msg);
+  }
+  const char* ddl =
+      "CREATE TABLE land_tiles (z INTEGER NOT NULL, x INTEGER NOT NULL, y INTEGER NOT NULL,"
+      " lat_min REAL NOT NULL, lon_min REAL NOT NULL, lat_max REAL NOT NULL, lon_max REAL NOT NULL,"
+      " version INTEGER NOT NULL, checksum TEXT NOT NULL, profile_mask INTEGER NOT NULL, data BLOB NOT NULL);"
+      "CREATE UNIQUE INDEX idx_land_tiles_zxy ON land_tiles(z,x,y);"
+      "CREATE TABLE metadata (key TEXT PRIMARY KEY, value TEXT);"
+      "INSERT INTO metadata(key, value) VALUES('schema_version', '1');"
+      "INSERT INTO metadata(key, value) VALUES('tile_checksum', 'xxh64');"
+      "CREATE TABLE land_geometry (z INTEGER NOT NULL, x INTEGER NOT NULL, y INTEGER NOT NULL, data BLOB NOT NULL);"
+      "CREATE UNIQUE INDEX idx_land_geometry_zxy ON land_geometry(z,x,y);";
+  sqlite3_exec(db, ddl, nullptr, nullptr, nullptr);
+  sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+  sqlite3_stmt* stmt = nullptr;
+  sqlite3_prepare_v2(db,
+      "INSERT INTO land_tiles(z,x,y,lat_min,lon_min,lat_max,lon_max,version,checksum,profile_mask,data)"
+      " VALUES(?,?,?,?,?,?,?,1,?,3,?);", -1, &stmt, nullptr);
+  for (const auto& t : tiles) {
+    auto bb = syntheticTileBounds(t.key.z, t.key.x, t.key.y);
+    const std::string checksum = routing_core::xxh64Hex(t.buffer->data(), t.buffer->size());
+    sqlite3_bind_int(stmt, 1, t.key.z);
+    sqlite3_bind_int(stmt, 2, t.key.x);
+    sqlite3_bind_int(stmt, 3, t.key.y);
+    sqlite3_bind_double(stmt, 4, bb.lat_min);
+    sqlite3_bind_double(stmt, 5, bb.lon_min);
+    sqlite3_bind_double(stmt, 6, bb.lat_max);
+    sqlite3_bind_double(stmt, 7, bb.lon_max);
+    sqlite3_bind_text(stmt, 8, checksum.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 9, t.buffer->data(), static_cast<int>(t.buffer->size()), SQLITE_STATIC);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  bool hasGeometry = false;
+  sqlite3_prepare_v2(db, "INSERT INTO land_geometry(z,x,y,data) VALUES(?,?,?,?);", -1, &stmt, nullptr);
+  for (const auto& t : tiles) {
+    if (!t.geometry) continue;
+    hasGeometry = true;
+    sqlite3_bind_int(stmt, 1, t.key.z);
+    sqlite3_bind_int(stmt, 2, t.key.x);
+    sqlite3_bind_int(stmt, 3, t.key.y);
+    sqlite3_bind_blob(stmt, 4, t.geometry->data(), static_cast<int>(t.geometry->size()), SQLITE_STATIC);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  if (hasGeometry) {
+    sqlite3_exec(db, "INSERT OR REPLACE INTO metadata(key, value) VALUES('geometry_layer', 'separate');",
+                 nullptr, nullptr, nullptr);
+  }
+  sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO metadata(key, value) VALUES(?, ?);", -1, &stmt, nullptr);
+  for (const auto& [k, v] : extraMetadata) {
+    sqlite3_bind_text(stmt, 1, k.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, v.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+  sqlite3_close(db);
+}
+
+#ifdef ROUTING_CORE_HAVE_ZSTD
+// Сжимает блобы так же, как конвертер с --zstd: словарь на всех тайлах, кадр с размером
+// содержимого. Возвращает сжатые тайлы и metadata (tile_compression, zstd_dict).
+inline std::pair<std::vector<SyntheticTile>, SyntheticMetadata>
+compressSyntheticTiles(const std::vector<SyntheticTile>& tiles, size_t dictSize = 110 * 1024, int level = 12) {
+  std::vector<uint8_t> joined;
+  std::vector<size_t> sizes;
+  for (const auto& t : tiles) {
+    joined.insert(joined.end(), t.buffer->begin(), t.buffer->end());
+    sizes.push_back(t.buffer->size());
+  }
+  std::vector<uint8_t> dict(dictSize);
+  size_t n = ZDICT_trainFromBuffer(dict.data(), dict.size(), joined.data(), sizes.data(),
+                                   static_cast<unsigned>(sizes.size()));
+  dict.resize(ZDICT_isError(n) ? 0 : n);
+
+  ZSTD_CCtx* cctx = ZSTD_createCCtx();
+  ZSTD_CDict* cdict = dict.empty() ? nullptr : ZSTD_createCDict(dict.data(), dict.size(), level);
+  std::vector<SyntheticTile> out;
+  out.reserve(tiles.size());
+  for (const auto& t : tiles) {
+    auto buf = std::make_shared<std::vector<uint8_t>>(ZSTD_compressBound(t.buffer->size()));
+    size_t c = cdict
+        ? ZSTD_compress_usingCDict(cctx, buf->data(), buf->size(), t.buffer->data(), t.buffer->size(), cdict)
+        : ZSTD_compressCCtx(cctx, buf->data(), buf->size(), t.buffer->data(), t.buffer->size(), level);
+    if (ZSTD_isError(c)) throw std::runtime_error("zstd compression failed");
+    buf->resize(c);
+    SyntheticTile ct = t;
+    ct.buffer = std::move(buf);
+    out.push_back(std::move(ct));
+  }
+  ZSTD_freeCDict(cdict);
+  ZSTD_freeCCtx(cctx);
+
+  SyntheticMetadata meta {{"tile_compression", "zstd"}};
+  if (!dict.empty()) meta.emplace_back("zstd_dict", routing_core::base64Encode(dict.data(), dict.size()));
+  return {std::move(out), std::move(meta)};
+}
+#endif
+
+// Те же тайлы в виде пака тайлов (.routingpack).
+inline void writeSyntheticRoutingPack(const std::string& path, const std::vector<SyntheticTile>& tiles,
+                                      const SyntheticMetadata& extraMetadata = {}) {
+  std::remove(path.c_str());
+  routing_core::TilePackWriter w(path);
+  w.setMetadata("schema_version", "1");
+  for (const auto& [k, v] : extraMetadata) w.setMetadata(k, v);
+  for (const auto& t : tiles) {
+    w.addTile(t.key.z, t.key.x, t.key.y, 1, t.buffer->data(), t.buffer->size());
+    if (t.geometry) {
+      w.setMetadata("geometry_layer", "separate");
+      w.addTile(t.key.z | routing_core::kGeometryLayerBit, t.key.x, t.key.y, 1,
+                t.geometry->data(), t.geometry->size());
+    }
+  }
+  w.finish();
+}
+
+} // namespace routing_bench
@@ -14,9 +14,11 @@ using namespace routing_core;
 int main(int argc, char** argv) {
   if (argc < 6) {
     std::fprintf(stderr,
-      "Usage: %s routingdb lat1 lon1 lat2 lon2 [profile] [--dump]\n"
+      "Usage: %s routingdb lat1 lon1 lat2 lon2 [profile] [--dump] [--stats] [--polyline [Z]]\n"
       "profile: car|foot (default car)\n"
-      "--dump  : dump info about tile edges\n",
+      "--dump  : dump info about tile edges\n"
+      "--stats : print per-query statistics\n"
+      "--polyline [Z] : print encoded polyline (simplified for zoom Z)\n",
       argv[0]);
     return 1;
   }
@@ -25,19 +27,27 @@ int main(int argc, char** argv) {
   Coord b{std::stod(argv[4]), std::stod(argv[5])};
   auto profile = makeCarProfile();
   bool dump = false;
+  bool stats = false;
   int zoomOpt = 14;
+  RouteOutputOptions output;
   // простенький парсер дополнительных флагов
   for (int i = 6; i < argc; ++i) {
     std::string arg = argv[i];
     if (arg == "car") profile = makeCarProfile();
     else if (arg == "foot") profile = makeFootProfile();
     else if (arg == "--dump") dump = true;
+    else if (arg == "--stats") stats = true;
     else if (arg == "--z" && i+1 < argc) { zoomOpt = std::atoi(argv[++i]); }
+    else if (arg == "--polyline") {
+      output.format = GeometryFormat::Polyline;
+      if (i+1 < argc && argv[i+1][0] != '-') output.simplifyZoom = std::atoi(argv[++i]);
+    }
   }
 
   RouterOptions opt;
   opt.tileZoom = zoomOpt;     // можно менять
   opt.tileCacheCapacity = 128;
+  opt.collectStats = stats;
   Router r(db, opt);
 
   // Покажем тайлы обеих точек
@@ -52,17 +62,17 @@ int main(int argc, char** argv) {
   TileStore store(db, 1);
   auto blob = store.load(keyA.z, keyA.x, keyA.y);
   if (blob) {
-    TileView view(blob->buffer);
+    TileView view(blob, blob->data, blob->size, nullptr, blob->schemaVersion);
     std::fprintf(stderr, "Tile nodes=%d edges=%d\n",
                  view.nodeCount(), view.edgeCount());
     if (dump) {
       for (int ei = 0; ei < view.edgeCount(); ++ei) {
-        auto* e = view.edgeAt(ei);
+        const auto e = view.edgeAt(ei);
         std::fprintf(stderr,
           "edge %d from=%u to=%u len=%.1fm speed=%.1fm/s foot=%.1fm/s access_mask=%u oneway=%d\n",
-          ei, e->from_node(), e->to_node(),
-          e->length_m(), e->speed_mps(), e->foot_speed_mps(),
-          e->access_mask(), e->oneway());
+          ei, e.from_node(), e.to_node(),
+          e.length_m(), e.speed_mps(), e.foot_speed_mps(),
+          e.access_mask(), e.oneway());
       }
     }
   } else {
@@ -70,7 +80,24 @@ int main(int argc, char** argv) {
   }
 
   // Вызываем роутер
-  auto res = r.route(profile, {a, b});
+  auto res = r.route(profile, {a, b}, output);
+  if (res.stats) {
+    const auto& s = *res.stats;
+    std::fprintf(stderr,
+      "stats: total=%.2fms io=%.2fms graph=%.2fms snap=%.2fms search=%.2fms assemble=%.2fms\n"
+      "       tiles=%u (hit %u, miss %u) bytes=%llu graph=%u nodes/%llu edges\n"
+      "       fwd push/pop/settled=%llu/%llu/%llu bwd=%llu/%llu/%llu\n",
+      s.total_ms, s.tile_io_ms, s.graph_build_ms, s.snap_ms, s.search_ms, s.assemble_ms,
+      s.tiles_requested, s.tiles_hit, s.tiles_missed,
+      static_cast<unsigned long long>(s.bytes_read), s.graph_nodes,
+      static_cast<unsigned long long>(s.graph_edges),
+      static_cast<unsigned long long>(s.forward.heap_pushes),
+      static_cast<unsigned long long>(s.forward.heap_pops),
+      static_cast<unsigned long long>(s.forward.settled),
+      static_cast<unsigned long long>(s.backward.heap_pushes),
+      static_cast<unsigned long long>(s.backward.heap_pops),
+      static_cast<unsigned long long>(s.backward.settled));
+  }
   if (res.status != RouteStatus::OK) {
     const char* st = "";
     switch (res.status) {
@@ -85,6 +112,11 @@ int main(int argc, char** argv) {
     return 2;
   }
 
+  if (output.format == GeometryFormat::Polyline) {
+    std::printf("distance_m=%.2f duration_s=%.2f edges=%zu\n%s\n", res.distance_m, res.duration_s,
+                res.edge_ids.size(), res.encoded_polyline.c_str());
+    return 0;
+  }
   std::printf("distance_m=%.2f duration_s=%.2f points=%zu edges=%zu\n",
               res.distance_m, res.duration_s,
               res.polyline.size(), res.edge_ids.size());
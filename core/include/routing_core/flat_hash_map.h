@@ -0,0 +1,233 @@
+#pragma once
+
+// Хэш-таблица с открытой адресацией (линейное пробирование) для горячих таблиц:
+// склейка узлов графа запроса (q2node), кэш тайлов, локальные индексы узлов конвертера.
+//
+// Записи лежат одним массивом, без узла в куче на каждую; поиск идёт по соседним
+// ячейкам. Удаление — обратным сдвигом, без надгробий. Вставка и удаление инвалидируют
+// итераторы и ссылки (в отличие от std::unordered_map). Ёмкость — степень двойки,
+// заполнение не выше 3/4. Ключ хэшируется FlatHash<K>: для целых — финализатор
+// splitmix64, иначе упакованные координаты и коды тайлов ложатся кластерами.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace routing_core {
+
+// Финализатор splitmix64: все биты ключа влияют на младшие биты хэша.
+inline uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ull;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBull;
+  x ^= x >> 31;
+  return x;
+}
+
+template <class K, class Enable = void>
+struct FlatHash;
+
+template <class K>
+struct FlatHash<K, std::enable_if_t<std::is_integral_v<K>>> {
+  size_t operator()(K k) const noexcept { return static_cast<size_t>(mix64(static_cast<uint64_t>(k))); }
+};
+
+// K и V — перемещаемые и конструируемые по умолчанию (пустые ячейки хранят значения по умолчанию).
+template <class K, class V, class Hash = FlatHash<K>, class Eq = std::equal_to<K>,
+          class Alloc = std::allocator<std::pair<K, V>>>
+class FlatHashMap {
+public:
+  using key_type = K;
+  using mapped_type = V;
+  using value_type = std::pair<K, V>;  // ключ менять нельзя
+  using allocator_type = Alloc;
+
+private:
+  using FlagAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<uint8_t>;
+
+  template <bool Const>
+  class Iter {
+    using Map = std::conditional_t<Const, const FlatHashMap, FlatHashMap>;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = FlatHashMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+    using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+    Iter() = default;
+    Iter(Map* map, size_t pos) : map_(map), pos_(pos) {}
+    template <bool C = Const, class = std::enable_if_t<!C>>
+    operator Iter<true>() const { return Iter<true>(map_, pos_); }
+
+    reference operator*() const { return map_->slots_[pos_]; }
+    pointer operator->() const { return &map_->slots_[pos_]; }
+    Iter& operator++() {
+      pos_ = map_->nextUsed(pos_ + 1);
+      return *this;
+    }
+    Iter operator++(int) {
+      Iter t = *this;
+      ++*this;
+      return t;
+    }
+    bool operator==(const Iter& o) const { return pos_ == o.pos_; }
+    bool operator!=(const Iter& o) const { return pos_ != o.pos_; }
+
+  private:
+    friend class FlatHashMap;
+    Map* map_ {nullptr};
+    size_t pos_ {0};
+  };
+
+public:
+  using iterator = Iter<false>;
+  using const_iterator = Iter<true>;
+
+  FlatHashMap() = default;
+  explicit FlatHashMap(const Alloc& alloc) : slots_(alloc), used_(FlagAlloc(alloc)) {}
+
+  allocator_type get_allocator() const { return slots_.get_allocator(); }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  iterator begin() { return iterator(this, nextUsed(0)); }
+  iterator end() { return iterator(this, slots_.size()); }
+  const_iterator begin() const { return const_iterator(this, nextUsed(0)); }
+  const_iterator end() const { return const_iterator(this, slots_.size()); }
+
+  void clear() {
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      if (used_[i]) {
+        slots_[i] = value_type{};
+        used_[i] = 0;
+      }
+    }
+    size_ = 0;
+  }
+
+  // Ёмкость под n записей без перестроения.
+  void reserve(size_t n) {
+    size_t cap = 16;
+    while (cap * 3 / 4 < n) cap *= 2;
+    if (cap > slots_.size()) rehash(cap);
+  }
+
+  iterator find(const K& key) { return iterator(this, findPos(key)); }
+  const_iterator find(const K& key) const { return const_iterator(this, findPos(key)); }
+  size_t count(const K& key) const { return findPos(key) != slots_.size() ? 1 : 0; }
+  bool contains(const K& key) const { return count(key) != 0; }
+
+  V& at(const K& key) {
+    const size_t pos = findPos(key);
+    if (pos == slots_.size()) throw std::out_of_range("FlatHashMap::at");
+    return slots_[pos].second;
+  }
+  const V& at(const K& key) const {
+    const size_t pos = findPos(key);
+    if (pos == slots_.size()) throw std::out_of_range("FlatHashMap::at");
+    return slots_[pos].second;
+  }
+
+  // Вставить V(args...), если ключа нет; иначе вернуть существующую запись.
+  // Таблица растёт только при настоящей вставке: найденный ключ ссылок не инвалидирует.
+  template <class... Args>
+  std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+    size_t i = 0;
+    if (!slots_.empty()) {
+      const size_t mask = slots_.size() - 1;
+      for (i = hash_(key) & mask; used_[i]; i = (i + 1) & mask) {
+        if (eq_(slots_[i].first, key)) return {iterator(this, i), false};
+      }
+    }
+    if ((size_ + 1) * 4 > slots_.size() * 3) {
+      rehash(slots_.empty() ? 16 : slots_.size() * 2);
+      const size_t mask = slots_.size() - 1;
+      for (i = hash_(key) & mask; used_[i]; i = (i + 1) & mask) {}
+    }
+    slots_[i] = value_type(key, V(std::forward<Args>(args)...));
+    used_[i] = 1;
+    ++size_;
+    return {iterator(this, i), true};
+  }
+  template <class M>
+  std::pair<iterator, bool> emplace(const K& key, M&& value) {
+    return try_emplace(key, std::forward<M>(value));
+  }
+  V& operator[](const K& key) { return try_emplace(key).first->second; }
+
+  void erase(const_iterator it) { eraseAt(it.pos_); }
+  size_t erase(const K& key) {
+    const size_t pos = findPos(key);
+    if (pos == slots_.size()) return 0;
+    eraseAt(pos);
+    return 1;
+  }
+
+private:
+  size_t nextUsed(size_t i) const {
+    while (i < slots_.size() && !used_[i]) ++i;
+    return i;
+  }
+
+  size_t findPos(const K& key) const {
+    if (size_ == 0) return slots_.size();
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = hash_(key) & mask; used_[i]; i = (i + 1) & mask) {
+      if (eq_(slots_[i].first, key)) return i;
+    }
+    return slots_.size();
+  }
+
+  // Обратный сдвиг: следующие записи кластера, чей «дом» не между дыркой и ими,
+  // переезжают в дырку — цепочки поиска не рвутся.
+  void eraseAt(size_t hole) {
+    const size_t mask = slots_.size() - 1;
+    slots_[hole] = value_type{};
+    used_[hole] = 0;
+    --size_;
+    for (size_t j = (hole + 1) & mask; used_[j]; j = (j + 1) & mask) {
+      const size_t home = hash_(slots_[j].first) & mask;
+      // дом записи j циклически в (hole, j] — запись на месте
+      const bool stays = hole < j ? (home > hole && home <= j) : (home > hole || home <= j);
+      if (stays) continue;
+      slots_[hole] = std::move(slots_[j]);
+      used_[hole] = 1;
+      slots_[j] = value_type{};
+      used_[j] = 0;
+      hole = j;
+    }
+  }
+
+  void rehash(size_t cap) {
+    std::vector<value_type, Alloc> slots(cap, slots_.get_allocator());
+    std::vector<uint8_t, FlagAlloc> used(cap, 0, used_.get_allocator());
+    const size_t mask = cap - 1;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+      if (!used_[i]) continue;
+      size_t j = hash_(slots_[i].first) & mask;
+      while (used[j]) j = (j + 1) & mask;
+      slots[j] = std::move(slots_[i]);
+      used[j] = 1;
+    }
+    slots_.swap(slots);
+    used_.swap(used);
+  }
+
+  std::vector<value_type, Alloc> slots_;
+  std::vector<uint8_t, FlagAlloc> used_;
+  size_t size_ {0};
+  [[no_unique_address]] Hash hash_;
+  [[no_unique_address]] Eq eq_;
+};
+
+} // namespace routing_core
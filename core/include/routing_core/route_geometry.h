@@ -0,0 +1,34 @@
+#pragma once
+
+// Геометрия маршрута для передачи клиенту: упрощение Дугласа — Пекера и компактные
+// кодировки (Google encoded polyline, FlatBuffers RouteGeometry из land_tile.fbs).
+// Router::route применяет их по RouteOutputOptions; функции доступны и отдельно.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "routing_core/router.h"
+
+namespace routing_core {
+
+// Упрощение Дугласа — Пекера: точки, отклоняющиеся от упрощённой линии не больше чем
+// на toleranceM метров, выбрасываются; концы сохраняются. Расстояния — в локальной
+// равнопромежуточной проекции у средней широты маршрута.
+std::vector<Coord> simplifyPolyline(const std::vector<Coord>& points, double toleranceM);
+
+// Размер пикселя тайла 256 px на зуме zoom и широте lat, м.
+double pixelSizeM(int zoom, double lat);
+
+// Google encoded polyline: приращения координат * 10^precision, zigzag, 5-битные группы.
+std::string encodePolyline(const std::vector<Coord>& points, int precision = 5);
+// Обратное преобразование; пустой результат для некорректной строки.
+std::vector<Coord> decodePolyline(const std::string& encoded, int precision = 5);
+
+// Буфер FlatBuffers с корнем Routing::RouteGeometry.
+std::vector<uint8_t> encodeRouteGeometry(const std::vector<Coord>& points, double distanceM, double durationS);
+
+// Привести полную геометрию rr.polyline к виду из options (упрощение, кодирование).
+void applyRouteOutput(RouteResult& rr, const RouteOutputOptions& options);
+
+} // namespace routing_core
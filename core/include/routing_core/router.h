@@ -4,8 +4,10 @@
 #include <vector>
 #include <cstdint>
 #include <memory>
+#include <optional>
 
 #include "routing_core/profile.h"
+#include "routing_core/tile_delta.h"
 
 namespace routing_core {
 
@@ -22,18 +24,90 @@ struct Coord {
   double lon{};
 };
 
+// Статистика одного запроса (заполняется при RouterOptions::collectStats).
+struct RouteStats {
+  // время по фазам, мс
+  double tile_io_ms {0.0};            // загрузка тайлов из TileStore (с graphThreads — сумма по потокам)
+  double graph_build_ms {0.0};        // подготовка тайлов и склейка глобального графа (то же)
+  double snap_ms {0.0};               // привязка точек к рёбрам
+  double search_ms {0.0};             // bi-A*
+  double assemble_ms {0.0};           // сборка polyline и метрик
+  double total_ms {0.0};
+
+  // TileStore
+  uint32_t tiles_requested {0};
+  uint32_t tiles_hit {0};             // из LRU-кэша
+  uint32_t tiles_missed {0};          // чтение из БД (включая отсутствующие тайлы)
+  uint64_t bytes_read {0};            // байт BLOB, прочитанных из БД
+  uint32_t geometry_tiles {0};        // тайлов, для которых запрошен слой геометрии
+  uint64_t geometry_bytes_read {0};   // байт слоя геометрии, прочитанных из БД
+
+  // склеенный граф
+  uint32_t graph_nodes {0};
+  uint64_t graph_edges {0};
+
+  bool result_cache_hit {false};      // ответ из кэша результатов (RouterOptions::resultCacheEntries)
+
+  // поиск, по направлениям
+  struct Search {
+    uint64_t heap_pushes {0};
+    uint64_t heap_pops {0};
+    uint64_t settled {0};             // pop актуальной (не устаревшей) записи
+  };
+  Search forward;
+  Search backward;
+};
+
+// Форма геометрии в RouteResult (кодировки — route_geometry.h).
+enum class GeometryFormat {
+  Coords,       // RouteResult::polyline
+  Polyline,     // RouteResult::encoded_polyline — Google encoded polyline
+  FlatBuffers,  // RouteResult::geometry_buffer — таблица RouteGeometry (land_tile.fbs)
+  None          // без геометрии: только метрики и edge_ids
+};
+
+// Что отдать из Router::route. distance_m при любых настройках считается по полной
+// геометрии; упрощение и кодирование — уже после.
+struct RouteOutputOptions {
+  GeometryFormat format = GeometryFormat::Coords;
+  double simplifyToleranceM = 0.0;    // допуск Дугласа — Пекера, м (0 — без упрощения)
+  int simplifyZoom = -1;              // или допуск в пиксель тайла 256 px на этом зуме (-1 — нет)
+  int polylinePrecision = 5;          // знаков после запятой в encoded polyline (5 или 6)
+};
+
 struct RouteResult {
   RouteStatus status {RouteStatus::INTERNAL_ERROR};
-  std::vector<Coord> polyline;        // геометрия маршрута
+  std::vector<Coord> polyline;        // геометрия маршрута (GeometryFormat::Coords)
+  std::string encoded_polyline;       // GeometryFormat::Polyline
+  std::vector<uint8_t> geometry_buffer; // GeometryFormat::FlatBuffers
   double distance_m {0.0};            // суммарная длина
   double duration_s {0.0};            // суммарное время (сек)
   std::vector<uint64_t> edge_ids;     // идентификаторы реальных рёбер маршрута (без виртуальных)
   std::string error_message;          // описание ошибки (опц.)
+  std::optional<RouteStats> stats;    // статистика запроса (если включена)
+};
+
+// Уровень нехватки памяти для Router::trimMemory.
+// iOS: didReceiveMemoryWarning → Critical.
+// Android onTrimMemory: RUNNING_LOW / BACKGROUND → Moderate; RUNNING_CRITICAL / COMPLETE → Critical.
+enum class MemoryTrimLevel {
+  Moderate,  // ужать кэш тайлов до четверти бюджета
+  Critical   // сбросить кэш тайлов и отдать память бэкенда (страницы пака, SQLite)
 };
 
 struct RouterOptions {
   int tileZoom = 14;                  // уровень тайла (совпадает с конвертером)
-  size_t tileCacheCapacity = 128;     // LRU-кэш тайлов
+  size_t tileCacheCapacity = 128;     // LRU-кэш тайлов: максимум записей
+  size_t tileCacheBytes = 64u << 20;  // и бюджет в байтах (блобы + производные индексы)
+  bool collectStats = false;          // заполнять RouteResult::stats
+  int prefetchThreads = 2;            // фоновая подгрузка тайлов (0 — выключена)
+  bool trace = false;                 // включить трассировку спанами (см. trace.h; также LOXX_TRACE)
+  bool verifyTileChecksums = false;   // сверять xxh64 тайла при первой загрузке (если он есть в БД)
+  size_t resultCacheEntries = 0;      // кэш результатов по привязке концов: маршрутов (0 — выключен)
+  size_t parallelSearchMinNodes = 0;  // bi-A* в двух потоках на графах от стольких узлов (0 — всегда в одном)
+  int graphThreads = 0;               // пул для чтения и подготовки тайлов запроса (0 — в потоке запроса)
+  size_t queryArenaBytes = 1u << 20;  // потолок буфера арены запроса, по буферу на одновременный запрос (0 — без буфера; сверх — куча)
+  bool batchTileReads = true;         // холодные тайлы пака — одним пакетом чтений io_uring (нет io_uring — префетчер)
 };
 
 class Router {
@@ -41,11 +115,26 @@ public:
   explicit Router(const std::string& db_path, RouterOptions opt = {});
   ~Router();
 
-  // Маршрут через start..waypoints..end (в v1 — все точки в одном тайле)
-  RouteResult route(const ProfileSettings& profile, const std::vector<Coord>& waypoints);
+  // Маршрут через start..waypoints..end (в v1 — все точки в одном тайле).
+  // output — форма геометрии в результате (упрощение, кодирование, без геометрии).
+  RouteResult route(const ProfileSettings& profile, const std::vector<Coord>& waypoints,
+                    const RouteOutputOptions& output = {});
+
+  // Заранее подгрузить в фоне тайлы, нужные маршруту по этим точкам (например, как только
+  // пользователь выбрал старт и финиш). Не блокирует; без префетчера — no-op.
+  void prefetch(const std::vector<Coord>& waypoints);
+
+  // Освободить память по сигналу ОС. Потокобезопасно относительно фоновой подгрузки.
+  void trimMemory(MemoryTrimLevel level);
+
+  // Применить пакет изменений (.routingdelta) к своей SQLite routingdb, не останавливая
+  // маршрутизацию: пакет пишется одной транзакцией, затем изменённые тайлы выходят из
+  // кэша. Запрос, идущий во время применения, может увидеть часть тайлов старыми.
+  TileDeltaStats applyDelta(const std::string& deltaPath);
 
 private:
-  struct Impl;
+  struct Impl;                    // src/router_impl.h
+  friend struct RouterInternals;  // доступ бенчмарков и модульных тестов к Impl (там же)
   std::unique_ptr<Impl> impl_;
 };
 
@@ -0,0 +1,120 @@
+#pragma once
+
+// Пакет изменений routingdb (.routingdelta) — обновление без повторной загрузки всей БД.
+//
+// Раскладка файла (little-endian):
+//   [DeltaHeader]
+//   [метаданные]             — пары "key\0value\0": новые значения ключей metadata
+//   [записи x entryCount]    — DeltaEntryHeader, затем checksum и payload
+//
+// Запись меняет один блоб: тайл (land_tiles) или его геометрию (land_geometry, z |
+// kGeometryLayerBit, см. tile_pack.h). Put — блоб целиком, Patch — бинарный диф к текущему
+// блобу (применяется, только если текущий блоб совпадает с базой по размеру и хэшу),
+// Remove — удалить. Формат блобов (схема, zstd-словарь) у старой и новой БД совпадает:
+// пакет не меняет format-метаданные.
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "routing_core/tile_store.h"
+
+namespace routing_core {
+
+inline constexpr char kTileDeltaMagic[8] = {'L','X','D','E','L','T','0','1'};
+inline constexpr uint32_t kTileDeltaFormatVersion = 1;
+
+enum class TileDeltaOp : uint8_t { Put = 1, Patch = 2, Remove = 3 };
+
+struct DeltaHeader {
+  char magic[8];
+  uint32_t formatVersion;
+  uint32_t entryCount;
+  uint32_t metaSize;      // байт метаданных
+  uint32_t reserved;
+};
+static_assert(sizeof(DeltaHeader) == 24, "DeltaHeader layout");
+
+struct DeltaEntryHeader {
+  uint32_t z;             // | kGeometryLayerBit для слоя геометрии
+  uint32_t x;
+  uint32_t y;
+  uint32_t version;
+  uint32_t profileMask;
+  uint32_t payloadSize;
+  uint64_t baseHash;      // Patch: хэш блоба, к которому построен диф (deltaBlobHash)
+  uint32_t baseSize;      // Patch: его размер
+  uint16_t checksumSize;
+  uint8_t op;             // TileDeltaOp
+  uint8_t reserved;
+  double bbox[4];         // lat_min, lon_min, lat_max, lon_max
+};
+static_assert(sizeof(DeltaEntryHeader) == 72, "DeltaEntryHeader layout");
+
+struct TileDeltaEntry {
+  TileDeltaOp op {TileDeltaOp::Put};
+  int z {0};
+  int x {0};
+  int y {0};
+  uint32_t version {0};
+  uint32_t profileMask {0};
+  double bbox[4] {0, 0, 0, 0};
+  std::string checksum;
+  uint64_t baseHash {0};
+  uint32_t baseSize {0};
+  std::vector<uint8_t> payload;  // блоб (Put) или диф (Patch)
+};
+
+// Хэш блоба для проверки базы диффа (FNV-1a, 64 бита).
+uint64_t deltaBlobHash(const uint8_t* data, size_t size);
+
+// Бинарный диф newer относительно base: копии блоков base и вставки новых байт.
+// Совпадения ищутся по блокам base фиксированной длины, так что размер диффа
+// пропорционален изменённым байтам, а не размеру блоба.
+std::vector<uint8_t> makeBlobDiff(const std::vector<uint8_t>& base, const std::vector<uint8_t>& newer);
+// Применить диф; исключение, если диф не сходится с base.
+std::vector<uint8_t> applyBlobDiff(const uint8_t* base, size_t baseSize, const std::vector<uint8_t>& diff);
+
+// Последовательная запись пакета: метаданные, затем записи; число записей — в finish().
+class TileDeltaWriter {
+public:
+  explicit TileDeltaWriter(std::string path);
+  ~TileDeltaWriter();
+  TileDeltaWriter(const TileDeltaWriter&) = delete;
+  TileDeltaWriter& operator=(const TileDeltaWriter&) = delete;
+
+  // Только до первой записи
+  void setMetadata(const std::string& key, const std::string& value);
+  void add(const TileDeltaEntry& entry);
+  void finish();
+
+  uint32_t entryCount() const { return count_; }
+  uint64_t bytesWritten() const { return bytes_; }
+
+private:
+  void writeHeader();
+
+  std::string path_;
+  std::ofstream out_;
+  std::string meta_;
+  bool headerWritten_ {false};
+  bool finished_ {false};
+  uint32_t count_ {0};
+  uint64_t bytes_ {0};
+};
+
+struct TileDeltaStats {
+  size_t put {0};
+  size_t patched {0};
+  size_t removed {0};
+};
+
+// Применить пакет к SQLite routingdb на месте одной транзакцией (при ошибке — откат).
+// Читатели в WAL-режиме (Router) продолжают работать и видят либо старую БД, либо новую.
+// changed (опц.) — ключи изменённых блобов для сброса кэша (TileStore::invalidate).
+TileDeltaStats applyTileDelta(const std::string& dbPath, const std::string& deltaPath,
+                              std::vector<TileKey>* changed = nullptr);
+
+} // namespace routing_core
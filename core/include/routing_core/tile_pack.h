@@ -0,0 +1,109 @@
+#pragma once
+
+// Пак тайлов (.routingpack) — альтернатива SQLite-контейнеру для чтения через mmap.
+//
+// Раскладка файла (little-endian):
+//   [PackHeader]
+//   [PackEntry x tileCount]          — индекс, отсортирован по (z, x, y)
+//   [метаданные]                     — пары "key\0value\0", аналог таблицы metadata
+//   [выравнивание до страницы]
+//   [блобы тайлов]                   — каждый FlatBuffers-блоб начинается с границы страницы
+//
+// Блоб отдаётся TileView прямо из отображения (без копирования); выравнивание по странице
+// позволяет подгружать/вытеснять тайлы целыми страницами.
+// Блобы слоя геометрии (TileGeometry, схема v2) лежат в том же индексе с z | kGeometryLayerBit.
+// В записи индекса — младшие 32 бита xxh64 блоба (metadata tile_checksum = xxh64); в паках
+// без этого ключа поле нулевое и не проверяется.
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace routing_core {
+
+inline constexpr char kTilePackMagic[8] = {'L','X','P','A','C','K','0','1'};
+inline constexpr uint32_t kTilePackFormatVersion = 1;
+inline constexpr int kGeometryLayerBit = 1 << 8;
+
+struct PackHeader {
+  char magic[8];
+  uint32_t formatVersion;
+  uint32_t pageSize;
+  uint32_t tileCount;
+  uint32_t metaSize;      // байт метаданных
+  uint64_t indexOffset;
+  uint64_t metaOffset;
+  uint64_t dataOffset;    // начало первого блоба (кратно pageSize)
+  uint64_t fileSize;
+};
+static_assert(sizeof(PackHeader) == 56, "PackHeader layout");
+
+struct PackEntry {
+  uint32_t z;
+  uint32_t x;
+  uint32_t y;
+  uint32_t version;
+  uint64_t offset;        // от начала файла
+  uint32_t length;
+  uint32_t checksum;      // младшие 32 бита xxh64 блоба (см. выше)
+};
+static_assert(sizeof(PackEntry) == 32, "PackEntry layout");
+
+// Проверяет сигнатуру пака в начале файла.
+bool isTilePack(const std::string& path);
+
+// Только чтение: mmap всего файла, бинарный поиск по индексу.
+class TilePackReader {
+public:
+  explicit TilePackReader(const std::string& path);
+  ~TilePackReader();
+  TilePackReader(const TilePackReader&) = delete;
+  TilePackReader& operator=(const TilePackReader&) = delete;
+
+  // Запись индекса тайла или nullptr.
+  const PackEntry* find(int z, int x, int y) const;
+  const uint8_t* data(const PackEntry& e) const { return base_ + e.offset; }
+  // Подсказка ядру подгрузить страницы блоба (асинхронно).
+  void willNeed(const PackEntry& e) const;
+  // Отдать резидентные страницы отображения (при нехватке памяти); данные перечитаются с диска.
+  void releasePages() const;
+
+  std::optional<std::string> metadata(const std::string& key) const;
+  uint32_t tileCount() const { return header_->tileCount; }
+  size_t mappedSize() const { return size_; }
+
+private:
+  const uint8_t* base_ {nullptr};
+  size_t size_ {0};
+  const PackHeader* header_ {nullptr};
+  const PackEntry* entries_ {nullptr};
+};
+
+// Потоковая запись пака: блобы сначала пишутся во временный файл (их число заранее
+// неизвестно), finish() собирает заголовок, индекс, метаданные и копирует блобы.
+class TilePackWriter {
+public:
+  explicit TilePackWriter(std::string path, uint32_t pageSize = 4096);
+  ~TilePackWriter();
+  TilePackWriter(const TilePackWriter&) = delete;
+  TilePackWriter& operator=(const TilePackWriter&) = delete;
+
+  void addTile(int z, int x, int y, uint32_t version, const void* data, size_t size);
+  void setMetadata(const std::string& key, const std::string& value);
+  void finish();
+
+private:
+  std::string path_;
+  std::string tmpPath_;
+  uint32_t pageSize_;
+  std::ofstream data_;
+  uint64_t dataSize_ {0};
+  std::vector<PackEntry> entries_;  // offset — относительно начала области блобов
+  std::vector<std::pair<std::string, std::string>> meta_;
+  bool finished_ {false};
+};
+
+} // namespace routing_core
@@ -2,10 +2,16 @@
 
 #include <sqlite3.h>
 #include <string>
-#include <unordered_map>
 #include <memory>
 #include <vector>
 #include <list>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_set>
+#include <optional>
+#include <stdexcept>
+
+#include "routing_core/flat_hash_map.h"
 
 namespace routing_core {
 
@@ -15,24 +21,119 @@ inline bool operator==(const TileKey& a, const TileKey& b) {
 }
 struct TileKeyHash {
   size_t operator()(const TileKey& k) const {
-    return (static_cast<size_t>(k.z) << 28) ^ (static_cast<size_t>(k.x) << 14) ^ static_cast<size_t>(k.y);
+    // z (с битом слоя геометрии) | x | y без перекрытия, затем перемешивание
+    const uint64_t packed = (static_cast<uint64_t>(static_cast<uint16_t>(k.z)) << 48) ^
+                            (static_cast<uint64_t>(static_cast<uint32_t>(k.x) & 0xFFFFFFu) << 24) ^
+                            (static_cast<uint32_t>(k.y) & 0xFFFFFFu);
+    return static_cast<size_t>(mix64(packed));
   }
 };
 
+// Счётчики загрузок для статистики запроса (RouteStats).
+struct TileLoadStats {
+  uint32_t requested {0};
+  uint32_t hits {0};
+  uint32_t misses {0};
+  uint64_t bytesRead {0};
+};
+
+struct TileInIndex;
+
+// Повреждённый тайл: не сошлась контрольная сумма или не распаковался блоб.
+// Router::route отдаёт её как RouteStatus::DATA_ERROR, а не исключением.
+class TileDataError : public std::runtime_error {
+public:
+  explicit TileDataError(const std::string& message) : std::runtime_error(message) {}
+};
+
+// Байты тайла. data/size указывают либо в собственный буфер (SQLite),
+// либо прямо в отображение пака тайлов; owner держит память живой.
 struct TileBlob {
   TileKey key;
-  std::shared_ptr<std::vector<uint8_t>> buffer; // владеем памятью
+  const uint8_t* data {nullptr};
+  size_t size {0};
+  std::shared_ptr<const void> owner;
+  bool mapped {false};  // данные в mmap пака: чистые страницы файла, в бюджет кэша не входят
+  size_t storedSize {0}; // байт в хранилище (для сжатых тайлов меньше size)
+  int schemaVersion {1}; // версия схемы тайла (metadata.schema_version), передаётся в TileView
+  // Производные индексы, построенные по тайлу; живут в кэше вместе с блобом и учитываются в его бюджете.
+  std::shared_ptr<const TileInIndex> inIndex;
 };
 
+class TilePackReader;
+class TileDecompressor;
+class BatchFileReader;
+struct PackEntry;
+
+// Бюджет кэша тайлов по умолчанию (байты блобов + производных индексов).
+inline constexpr size_t kDefaultTileCacheBytes = 64u << 20;
+
 class TileStore {
 public:
-  TileStore(const std::string& db_path, size_t cacheCapacity);
+  // db_path — SQLite routingdb (по умолчанию) или пак тайлов .routingpack
+  // (определяется по сигнатуре файла, см. tile_pack.h).
+  // Кэш ограничен бюджетом cacheBytes (блобы в своей памяти + производные индексы)
+  // и числом тайлов cacheCapacity; вытесняются давно не использованные записи.
+  TileStore(const std::string& db_path, size_t cacheCapacity, size_t cacheBytes = kDefaultTileCacheBytes);
   ~TileStore();
 
   // Загружает BLOB тайла по ключу (LRU-кэш). nullptr при отсутствии.
-  std::shared_ptr<TileBlob> load(int z, int x, int y);
+  // stats (опц.) накапливает попадания/промахи и прочитанные байты.
+  // Потокобезопасно: параллельные запросы одного тайла дедуплицируются — второй
+  // поток ждёт чтения первого (так запрос маршрута подхватывает тайлы префетчера).
+  // Отсутствующие тайлы тоже кэшируются (как nullptr), чтобы не ходить за ними повторно.
+  std::shared_ptr<TileBlob> load(int z, int x, int y, TileLoadStats* stats = nullptr);
+
+  // Блобы тайлов keys в том же порядке (nullptr — тайла нет), кэш и статистика — как у load().
+  // С пакетным чтением промахи кэша пака читаются одним пакетом. Тайлы, которые уже
+  // читает другой поток, дожидаются его после пакета. Без пакетного чтения — load() по очереди.
+  std::vector<std::shared_ptr<TileBlob>> loadBatch(const std::vector<TileKey>& keys, TileLoadStats* stats = nullptr);
+  // Включить пакетное чтение пака: io_uring, иначе pread в пуле из fallbackThreads потоков
+  // (ioUring = false — сразу pread). Для SQLite — no-op. Вызывать до первых загрузок.
+  void enableBatchReads(int fallbackThreads, bool ioUring = true);
+  // То же, но только через io_uring: без него ничего не включается (и потоков не заводится).
+  // true — пакетное чтение включено.
+  bool enableIoUringBatchReads();
+  bool readsInBatches() const { return batch_ != nullptr; }
+
+  // Блоб слоя геометрии тайла (TileGeometry) через тот же кэш; nullptr, если у хранилища
+  // нет отдельного слоя (схема v1 или v2 со встроенными shapes) или тайла нет.
+  std::shared_ptr<TileBlob> loadGeometry(int z, int x, int y, TileLoadStats* stats = nullptr);
+  bool hasGeometryLayer() const { return geometryLayer_; }
+
+  // Тайл уже в кэше или читается другим потоком.
+  bool cachedOrLoading(int z, int x, int y) const;
+
+  // Сохранить построенный по тайлу индекс входящих рёбер в кэше (учитывается в бюджете).
+  void attachInIndex(const TileKey& key, std::shared_ptr<const TileInIndex> index);
+
+  // Сбросить кэш тайлов, изменённых в хранилище (ключи слоя геометрии — с kGeometryLayerBit).
+  // Чтения, начатые до сброса, свой результат в кэш уже не кладут.
+  void invalidate(const std::vector<TileKey>& keys);
+  // Поколение данных: +1 на каждый invalidate (для кэшей поверх хранилища).
+  uint64_t generation() const;
+
+  // Вытеснить записи, пока кэш не уложится в targetBytes.
+  void trimCache(size_t targetBytes);
+  // Отдать память бэкенда: страницы пака, простаивающие SQLite-соединения и их кэши.
+  void releaseBackendMemory();
+  size_t cachedBytes() const;
+  size_t cacheBudget() const { return budget_; }
+
+  // Значение из метаданных контейнера (таблица metadata / блок метаданных пака).
+  std::optional<std::string> metadata(const std::string& key) const;
+  bool isPack() const { return pack_ != nullptr; }
+
+  // Проверять контрольную сумму блоба (metadata tile_checksum = xxh64: land_tiles.checksum или
+  // поле индекса пака) при первой загрузке тайла; несовпадение — исключение. Результат
+  // запоминается по ключу: повторные чтения после вытеснения из кэша не пересчитывают хэш.
+  // Без контрольных сумм в хранилище — no-op. Вызывать до первых загрузок.
+  void setChecksumVerification(bool on) { verify_ = on && hasChecksums_; }
+  bool verifiesChecksums() const { return verify_; }
+  const std::string& dbPath() const { return dbPath_; }  // пусто для пака
 
   int zoom() const { return zoom_; }
+  int schemaVersion() const { return schemaVersion_; }
   void setZoom(int z) { zoom_ = z; }
 
 private:
@@ -41,18 +142,54 @@ private:
   struct CacheEntry {
     std::shared_ptr<TileBlob> blob;
     ListIt it;
+    size_t cost;
+  };
+  static size_t entryCost(const TileBlob* blob);
+  void evictOverBudget(size_t targetBytes, size_t targetCount);
+
+  // Соединение только для чтения тайлов с подготовленным запросом; по одному на
+  // параллельно читающий поток (префетчер), чтобы чтения не сериализовались на db_.
+  struct Reader {
+    sqlite3* db {nullptr};
+    sqlite3_stmt* stmt {nullptr};
+    sqlite3_stmt* geomStmt {nullptr};  // land_geometry, если есть слой геометрии
   };
+  Reader acquireReader();
+  void releaseReader(Reader r);
 
-  std::shared_ptr<TileBlob> loadFromDb(int z, int x, int y);
+  std::shared_ptr<TileBlob> loadKey(const TileKey& key, TileLoadStats* stats);
+  std::shared_ptr<TileBlob> loadFromDb(int z, int x, int y, bool verify);
+  std::shared_ptr<TileBlob> loadFromPack(int z, int x, int y, bool verify);
+  std::shared_ptr<TileBlob> packBlob(const TileKey& key, const PackEntry& e, const uint8_t* stored, bool verify);
+  void initFormat();
+  std::shared_ptr<TileBlob> makeBlob(int z, int x, int y, const uint8_t* data, size_t size);
   void insertLRU(const TileKey& key, std::shared_ptr<TileBlob> blob);
 
 private:
   sqlite3* db_ {nullptr};
+  std::string dbPath_;
+  std::mutex readersMu_;
+  std::vector<Reader> readers_;    // свободные
+  std::shared_ptr<TilePackReader> pack_;
+  std::string packPath_;
+  std::unique_ptr<BatchFileReader> batch_;  // пакетное чтение пака (enableBatchReads)
+  std::unique_ptr<TileDecompressor> codec_;  // если блобы сжаты (metadata tile_compression)
   int zoom_ {14};
+  int schemaVersion_ {1};
+  bool geometryLayer_ {false};  // metadata.geometry_layer = separate
+  bool hasChecksums_ {false};   // metadata.tile_checksum = xxh64
+  bool verify_ {false};
 
   size_t capacity_;
+  size_t budget_;
+  size_t bytes_ {0};               // сумма cost по записям кэша
+  mutable std::mutex mu_;          // кэш и inflight_; чтение из бэкенда — вне блокировки
+  std::condition_variable loaded_;
   std::list<TileKey> lru_; // front = most recent
-  std::unordered_map<TileKey, CacheEntry, TileKeyHash> map_;
+  FlatHashMap<TileKey, CacheEntry, TileKeyHash> map_;
+  std::unordered_set<TileKey, TileKeyHash> inflight_;
+  std::unordered_set<TileKey, TileKeyHash> verified_;  // контрольная сумма уже сверена
+  uint64_t generation_ {0};        // +1 на каждый invalidate
 };
 
 } // namespace routing_core
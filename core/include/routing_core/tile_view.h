@@ -1,74 +1,175 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <vector>
+#include <string_view>
 #include <optional>
 
 #include "land_tile_generated.h"
 
 namespace routing_core {
 
+// Индекс входящих рёбер тайла (CSR): рёбра, входящие в узел n, —
+// edges[first[n] .. first[n+1]). Нужен только для тайлов без сохранённой обратной
+// смежности (in_first/in_edges): строится лениво и может жить в кэше тайлов
+// вместе с блобом (TileBlob::inIndex), чтобы не перестраиваться на каждый запрос.
+struct TileInIndex {
+  std::vector<uint32_t> first;
+  std::vector<uint32_t> edges;
+  size_t bytes() const { return sizeof(*this) + (first.capacity() + edges.capacity()) * sizeof(uint32_t); }
+};
+
+// Диапазон индексов рёбер.
+struct EdgeIdRange {
+  const uint32_t* first {nullptr};
+  const uint32_t* last {nullptr};
+  const uint32_t* begin() const { return first; }
+  const uint32_t* end() const { return last; }
+  size_t size() const { return static_cast<size_t>(last - first); }
+  bool empty() const { return first == last; }
+};
+
+// Ребро тайла независимо от версии схемы: v1 — таблица FlatBuffers, v2 — структура.
+// Лёгкое значение (два указателя), передаётся по значению.
+class EdgeRef {
+public:
+  EdgeRef(const Routing::Edge* t) : t_(t) {}
+  EdgeRef(const Routing::EdgeV2* s) : s_(s) {}
+
+  uint32_t from_node() const { return s_ ? s_->from_node() : t_->from_node(); }
+  uint32_t to_node() const { return s_ ? s_->to_node() : t_->to_node(); }
+  float length_m() const { return s_ ? s_->length_m() : t_->length_m(); }
+  float speed_mps() const { return s_ ? s_->speed_mps() : t_->speed_mps(); }
+  float foot_speed_mps() const { return s_ ? s_->foot_speed_mps() : t_->foot_speed_mps(); }
+  bool oneway() const { return s_ ? s_->oneway() : t_->oneway(); }
+  Routing::RoadClass road_class() const { return s_ ? s_->road_class() : t_->road_class(); }
+  uint16_t access_mask() const { return s_ ? s_->access_mask() : t_->access_mask(); }
+  uint32_t shape_start() const { return s_ ? s_->shape_start() : t_->shape_start(); }
+  uint16_t shape_count() const { return s_ ? s_->shape_count() : t_->shape_count(); }
+
+private:
+  const Routing::EdgeV2* s_ {nullptr};
+  const Routing::Edge* t_ {nullptr};
+};
+
 // Обёртка для FlatBuffers-тайла с ленивыми индексами входящих рёбер.
+// Читает обе версии схемы (metadata.schema_version): v1 — таблицы LandTile,
+// v2 — векторы структур LandTileV2 (см. land_tile.fbs). Геометрия v2 может лежать
+// в отдельном слое (TileGeometry): его подключают attachGeometry() только там, где
+// нужны формы рёбер; без него ребро рисуется отрезком from→to.
 class TileView {
 public:
-  explicit TileView(std::shared_ptr<std::vector<uint8_t>> buffer)
-      : buffer_(std::move(buffer)) {
-    root_ = flatbuffers::GetRoot<Routing::LandTile>(buffer_->data());
+  explicit TileView(std::shared_ptr<std::vector<uint8_t>> buffer, int schemaVersion = 1)
+      : data_(buffer->data()), size_(buffer->size()), owner_(std::move(buffer)) {
+    init(schemaVersion);
+  }
+  // Zero-copy: данные принадлежат owner (например, mmap пака тайлов).
+  // inIndex — уже построенный индекс входящих рёбер (из кэша), если есть.
+  TileView(std::shared_ptr<const void> owner, const uint8_t* data, size_t size,
+           std::shared_ptr<const TileInIndex> inIndex = nullptr, int schemaVersion = 1)
+      : data_(data), size_(size), owner_(std::move(owner)), inIdx_(std::move(inIndex)) {
+    init(schemaVersion);
   }
 
-  inline bool valid() const { return root_ != nullptr; }
+  inline bool valid() const { return root_ != nullptr || root2_ != nullptr; }
+  inline int schemaVersion() const { return root2_ ? 2 : 1; }
 
   // Размеры
   inline int nodeCount() const {
+    if (root2_) return static_cast<int>(nodeCount2_);
     return root_->nodes() ? static_cast<int>(root_->nodes()->size()) : 0;
   }
   inline int edgeCount() const {
+    if (root2_) return static_cast<int>(edgeCount2_);
     return root_->edges() ? static_cast<int>(root_->edges()->size()) : 0;
   }
 
   // Координаты узла (квантованные в схеме)
-  inline double nodeLat(int idx) const {
-    const auto* n = root_->nodes()->Get(static_cast<flatbuffers::uoffset_t>(idx));
-    return static_cast<double>(n->lat_q()) / 1e6;
-  }
-  inline double nodeLon(int idx) const {
-    const auto* n = root_->nodes()->Get(static_cast<flatbuffers::uoffset_t>(idx));
-    return static_cast<double>(n->lon_q()) / 1e6;
-  }
+  inline double nodeLat(int idx) const { return static_cast<double>(nodeLatQ(idx)) / 1e6; }
+  inline double nodeLon(int idx) const { return static_cast<double>(nodeLonQ(idx)) / 1e6; }
   inline int32_t nodeLatQ(int idx) const {
-    const auto* n = root_->nodes()->Get(static_cast<flatbuffers::uoffset_t>(idx));
-    return n->lat_q();
+    if (nodes2_) return nodes2_[idx].lat_q();
+    return root_->nodes()->Get(static_cast<flatbuffers::uoffset_t>(idx))->lat_q();
   }
   inline int32_t nodeLonQ(int idx) const {
-    const auto* n = root_->nodes()->Get(static_cast<flatbuffers::uoffset_t>(idx));
-    return n->lon_q();
+    if (nodes2_) return nodes2_[idx].lon_q();
+    return root_->nodes()->Get(static_cast<flatbuffers::uoffset_t>(idx))->lon_q();
   }
 
   // Смежность (out-edges) из узла
   inline uint32_t firstEdge(int nodeIdx) const {
-    const auto* n = root_->nodes()->Get(static_cast<flatbuffers::uoffset_t>(nodeIdx));
-    return n->first_edge();
+    if (nodes2_) return nodes2_[nodeIdx].first_edge();
+    return root_->nodes()->Get(static_cast<flatbuffers::uoffset_t>(nodeIdx))->first_edge();
   }
   inline uint16_t edgeCountFrom(int nodeIdx) const {
-    const auto* n = root_->nodes()->Get(static_cast<flatbuffers::uoffset_t>(nodeIdx));
-    return n->edge_count();
+    if (nodes2_) return nodes2_[nodeIdx].edge_count();
+    return root_->nodes()->Get(static_cast<flatbuffers::uoffset_t>(nodeIdx))->edge_count();
   }
-  inline const Routing::Edge* edgeAt(uint32_t edgeIdx) const {
-    return root_->edges()->Get(static_cast<flatbuffers::uoffset_t>(edgeIdx));
+  inline EdgeRef edgeAt(uint32_t edgeIdx) const {
+    if (edges2_) return EdgeRef(&edges2_[edgeIdx]);
+    return EdgeRef(root_->edges()->Get(static_cast<flatbuffers::uoffset_t>(edgeIdx)));
   }
 
+  // Слой геометрии (блоб TileGeometry из TileStore::loadGeometry); owner держит память.
+  void attachGeometry(std::shared_ptr<const void> owner, const uint8_t* data) {
+    const auto* g = flatbuffers::GetRoot<Routing::TileGeometry>(data);
+    if (!g || !g->edge_offsets() || !g->points()) return;
+    geomOffsets_ = reinterpret_cast<const uint32_t*>(g->edge_offsets()->Data());
+    geomOffsetCount_ = g->edge_offsets()->size();
+    geomPoints_ = g->points()->Data();
+    geomPointsSize_ = g->points()->size();
+    geomOwner_ = std::move(owner);
+  }
+  // Формы рёбер доступны (v1, v2 со встроенными shapes или подключённый слой).
+  bool hasGeometry() const { return !root2_ || shapes2_ != nullptr || geomOffsets_ != nullptr; }
+
   // Входящие рёбра (для обратного фронта bi-A*)
-  const std::vector<uint32_t>& inEdgesOf(int nodeIdx) const {
+  EdgeIdRange inEdgesOf(int nodeIdx) const {
+    if (inFirst_) {
+      const auto n = static_cast<size_t>(nodeIdx);
+      return EdgeIdRange{inEdges_ + inFirst_[n], inEdges_ + inFirst_[n + 1]};
+    }
     ensureInAdjBuilt();
-    return (*inAdj_)[static_cast<size_t>(nodeIdx)];
+    const auto n = static_cast<size_t>(nodeIdx);
+    const uint32_t* base = inIdx_->edges.data();
+    return EdgeIdRange{base + inIdx_->first[n], base + inIdx_->first[n + 1]};
   }
+  // Индекс входящих рёбер, если уже построен (для сохранения в кэше тайлов);
+  // nullptr и для тайлов с сохранённой обратной смежностью — там строить нечего.
+  const std::shared_ptr<const TileInIndex>& inIndex() const { return inIdx_; }
 
-  // Геометрия ребра: получить shape-точки
+  // Геометрия ребра: получить shape-точки. Points — вектор пар (lat, lon), в том числе
+  // std::pmr::vector из арены запроса.
+  template <class Points>
   void appendEdgeShape(uint32_t edgeIdx,
-                       std::vector<std::pair<double,double>>& out,
+                       Points& out,
                        bool skipFirst=true) const {
-    const auto* e = edgeAt(edgeIdx);
+    if (edges2_) {
+      // v2: концы из узлов, между ними промежуточные точки
+      const auto& e = edges2_[edgeIdx];
+      const int from = static_cast<int>(e.from_node());
+      const int to = static_cast<int>(e.to_node());
+      if (!skipFirst || out.empty()) out.emplace_back(nodeLat(from), nodeLon(from));
+      if (geomOffsets_) {
+        if (edgeIdx + 1 < geomOffsetCount_) {
+          appendGeometryPoints(geomOffsets_[edgeIdx], geomOffsets_[edgeIdx + 1],
+                               nodeLatQ(from), nodeLonQ(from), out);
+        }
+        out.emplace_back(nodeLat(to), nodeLon(to));
+        return;
+      }
+      const uint32_t start = e.shape_start();
+      const uint32_t end = std::min<uint32_t>(start + e.shape_count(), shapeCount2_);
+      for (uint32_t k = start; k < end; ++k) {
+        out.emplace_back(static_cast<double>(shapes2_[k].lat_q()) / 1e6,
+                         static_cast<double>(shapes2_[k].lon_q()) / 1e6);
+      }
+      out.emplace_back(nodeLat(to), nodeLon(to));
+      return;
+    }
+    const auto* e = root_->edges()->Get(static_cast<flatbuffers::uoffset_t>(edgeIdx));
     if (root_->shapes() && e->shape_count() > 0) {
       auto start = e->shape_start();
       auto cnt   = e->shape_count();
@@ -81,7 +182,8 @@ public:
       return;
     }
     if (e->encoded_polyline()) {
-      decodeEncodedPolyline(e->encoded_polyline()->str(), out, skipFirst);
+      const auto* enc = e->encoded_polyline();
+      decodeEncodedPolyline(std::string_view(enc->c_str(), enc->size()), out, skipFirst);
       return;
     }
     // fallback: from→to
@@ -91,11 +193,72 @@ public:
     out.emplace_back(nodeLat(to), nodeLon(to));
   }
 
+  // Корень v1 (nullptr для тайлов v2).
   const Routing::LandTile* root() const { return root_; }
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
 
 private:
-  static void decodeEncodedPolyline(const std::string& s,
-                                    std::vector<std::pair<double,double>>& out,
+  void init(int schemaVersion) {
+    if (schemaVersion >= 2) {
+      root2_ = flatbuffers::GetRoot<Routing::LandTileV2>(data_);
+      if (const auto* v = root2_->nodes()) {
+        nodes2_ = reinterpret_cast<const Routing::NodeV2*>(v->Data());
+        nodeCount2_ = v->size();
+      }
+      if (const auto* v = root2_->edges()) {
+        edges2_ = reinterpret_cast<const Routing::EdgeV2*>(v->Data());
+        edgeCount2_ = v->size();
+      }
+      if (const auto* v = root2_->shapes()) {
+        shapes2_ = reinterpret_cast<const Routing::ShapePointV2*>(v->Data());
+        shapeCount2_ = v->size();
+      }
+      initInAdjacency(root2_->in_first(), root2_->in_edges());
+    } else {
+      root_ = flatbuffers::GetRoot<Routing::LandTile>(data_);
+      initInAdjacency(root_->in_first(), root_->in_edges());
+    }
+  }
+
+  // Сохранённая конвертером обратная смежность; берётся, только если согласована с тайлом.
+  void initInAdjacency(const flatbuffers::Vector<uint32_t>* first, const flatbuffers::Vector<uint32_t>* edges) {
+    if (!first || !edges) return;
+    const auto N = static_cast<uint32_t>(nodeCount());
+    const auto E = static_cast<uint32_t>(edgeCount());
+    if (first->size() != N + 1 || edges->size() != E || first->Get(N) != E) return;
+    inFirst_ = reinterpret_cast<const uint32_t*>(first->Data());
+    inEdges_ = reinterpret_cast<const uint32_t*>(edges->Data());
+  }
+
+  // Промежуточные точки ребра из слоя геометрии: zigzag-varint приращения от узла from.
+  template <class Points>
+  void appendGeometryPoints(uint32_t pos, uint32_t end, int32_t lat, int32_t lon,
+                            Points& out) const {
+    end = std::min(end, geomPointsSize_);
+    auto next = [&](int32_t& v) {
+      uint32_t raw = 0;
+      int shift = 0;
+      while (pos < end && shift < 35) {
+        const uint8_t b = geomPoints_[pos++];
+        raw |= static_cast<uint32_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+          v += static_cast<int32_t>((raw >> 1) ^ (0u - (raw & 1)));
+          return true;
+        }
+        shift += 7;
+      }
+      return false;
+    };
+    while (pos < end) {
+      if (!next(lat) || !next(lon)) break;
+      out.emplace_back(static_cast<double>(lat) / 1e6, static_cast<double>(lon) / 1e6);
+    }
+  }
+
+  template <class Points>
+  static void decodeEncodedPolyline(std::string_view s,
+                                    Points& out,
                                     bool skipFirst) {
     int index = 0, len = static_cast<int>(s.size());
     int lat = 0, lon = 0;
@@ -120,23 +283,49 @@ private:
   }
 
   void ensureInAdjBuilt() const {
-    if (inAdj_) return;
-    size_t N = static_cast<size_t>(nodeCount());
-    inAdj_ = std::make_unique<std::vector<std::vector<uint32_t>>>(N);
-    int E = edgeCount();
+    if (inIdx_ || inFirst_) return;
+    const size_t N = static_cast<size_t>(nodeCount());
+    const int E = edgeCount();
+    auto idx = std::make_shared<TileInIndex>();
+    idx->first.assign(N + 1, 0);
+    // подсчёт по узлу назначения, префиксные суммы, раскладка (порядок рёбер сохраняется)
     for (int ei = 0; ei < E; ++ei) {
-      const auto* e = edgeAt(static_cast<uint32_t>(ei));
-      auto to = static_cast<size_t>(e->to_node());
-      if (to < N) {
-        (*inAdj_)[to].push_back(static_cast<uint32_t>(ei));
-      }
+      auto to = static_cast<size_t>(edgeAt(static_cast<uint32_t>(ei)).to_node());
+      if (to < N) ++idx->first[to + 1];
+    }
+    for (size_t n = 0; n < N; ++n) idx->first[n + 1] += idx->first[n];
+    idx->edges.resize(idx->first[N]);
+    std::vector<uint32_t> fill(idx->first.begin(), idx->first.end() - 1);
+    for (int ei = 0; ei < E; ++ei) {
+      auto to = static_cast<size_t>(edgeAt(static_cast<uint32_t>(ei)).to_node());
+      if (to < N) idx->edges[fill[to]++] = static_cast<uint32_t>(ei);
     }
+    inIdx_ = std::move(idx);
   }
 
 private:
-  std::shared_ptr<std::vector<uint8_t>> buffer_;
+  const uint8_t* data_ {nullptr};
+  size_t size_ {0};
+  std::shared_ptr<const void> owner_;
   const Routing::LandTile* root_ {nullptr};
-  mutable std::unique_ptr<std::vector<std::vector<uint32_t>>> inAdj_;
+  // v2: векторы структур напрямую
+  const Routing::LandTileV2* root2_ {nullptr};
+  const Routing::NodeV2* nodes2_ {nullptr};
+  const Routing::EdgeV2* edges2_ {nullptr};
+  const Routing::ShapePointV2* shapes2_ {nullptr};
+  uint32_t nodeCount2_ {0};
+  uint32_t edgeCount2_ {0};
+  uint32_t shapeCount2_ {0};
+  // v2: подключённый слой геометрии
+  std::shared_ptr<const void> geomOwner_;
+  const uint32_t* geomOffsets_ {nullptr};
+  const uint8_t* geomPoints_ {nullptr};
+  uint32_t geomOffsetCount_ {0};
+  uint32_t geomPointsSize_ {0};
+  // сохранённая обратная смежность (in_first/in_edges тайла)
+  const uint32_t* inFirst_ {nullptr};
+  const uint32_t* inEdges_ {nullptr};
+  mutable std::shared_ptr<const TileInIndex> inIdx_;
 };
 
 } // namespace routing_core
@@ -17,4 +17,21 @@ inline WebTileKey webTileKeyFor(double lat_deg, double lon_deg, int z) {
   return {z, x, y};
 }
 
+// Дробные координаты точки в сетке тайлов уровня z (целая часть — x/y тайла).
+inline void webTileXY(double lat_deg, double lon_deg, int z, double& fx, double& fy) {
+  const double lat_rad = lat_deg * M_PI / 180.0;
+  const int n = 1 << z;
+  fx = (lon_deg + 180.0) / 360.0 * n;
+  fy = (1.0 - std::log(std::tan(lat_rad) + 1.0 / std::cos(lat_rad)) / M_PI) / 2.0 * n;
+}
+
+// Границы тайла в градусах.
+inline void webTileBounds(int z, int x, int y, double& latMin, double& lonMin, double& latMax, double& lonMax) {
+  const double n = static_cast<double>(1 << z);
+  lonMin = x / n * 360.0 - 180.0;
+  lonMax = (x + 1) / n * 360.0 - 180.0;
+  latMax = std::atan(std::sinh(M_PI * (1.0 - 2.0 * y / n))) * 180.0 / M_PI;
+  latMin = std::atan(std::sinh(M_PI * (1.0 - 2.0 * (y + 1) / n))) * 180.0 / M_PI;
+}
+
 } // namespace routing_core
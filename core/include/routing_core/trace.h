@@ -0,0 +1,83 @@
+#pragma once
+
+// Лёгкая трассировка scoped-спанами в формате Chrome trace-event JSON
+// (открывается в chrome://tracing или ui.perfetto.dev).
+//
+// По умолчанию выключена. Включение:
+//   - программно: trace::enable() / RouterOptions::trace;
+//   - переменной окружения LOXX_TRACE=путь.json (enableFromEnv(); дамп при выходе).
+// События пишутся в кольцевой буфер фиксированного размера (старые затираются),
+// выгрузка — trace::dump(path).
+//
+// Цена выключенной трассировки — одна relaxed-загрузка флага и ветка в конструкторе спана.
+// Имена и категории спанов должны жить всё время работы программы (строковые литералы).
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace routing_core::trace {
+
+namespace detail {
+extern std::atomic<bool> g_enabled;
+uint64_t nowNs();
+void record(const char* cat, const char* name, uint64_t startNs, uint64_t durNs,
+            const char* argName, int64_t argValue);
+} // namespace detail
+
+inline bool enabled() { return detail::g_enabled.load(std::memory_order_relaxed); }
+
+// Включает запись; capacity — число событий в кольцевом буфере (округляется до степени двойки).
+// Буфер выделяется при первом включении и далее не переаллоцируется.
+void enable(size_t capacity = 1u << 16);
+void disable();
+
+// LOXX_TRACE=путь: включает трассировку и регистрирует дамп в этот файл при выходе.
+// Возвращает true, если переменная задана.
+bool enableFromEnv();
+
+// Пишет накопленные события в Chrome JSON. Вызывать, когда спаны не пишутся конкурентно
+// (иначе возможны частично записанные события). false при ошибке записи.
+bool dump(const std::string& path);
+
+// Сбрасывает накопленные события (без изменения флага).
+void clear();
+
+// Спан: [конструктор, end()/деструктор). Один необязательный целочисленный аргумент.
+class Span {
+public:
+  Span(const char* cat, const char* name, const char* argName = nullptr, int64_t argValue = 0) {
+    if (enabled()) {
+      cat_ = cat; name_ = name; argName_ = argName; arg_ = argValue;
+      t0_ = detail::nowNs();
+    }
+  }
+  ~Span() { end(); }
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+
+  void setArg(int64_t v) { arg_ = v; }
+  void end() {
+    if (!name_) return;
+    detail::record(cat_, name_, t0_, detail::nowNs() - t0_, argName_, arg_);
+    name_ = nullptr;
+  }
+
+private:
+  const char* cat_ {nullptr};
+  const char* name_ {nullptr};
+  const char* argName_ {nullptr};
+  int64_t arg_ {0};
+  uint64_t t0_ {0};
+};
+
+} // namespace routing_core::trace
+
+#define ROUTING_TRACE_CONCAT_(a, b) a##b
+#define ROUTING_TRACE_CONCAT(a, b) ROUTING_TRACE_CONCAT_(a, b)
+// Спан до конца текущей области видимости.
+#define ROUTING_TRACE_SCOPE(cat, name) \
+  ::routing_core::trace::Span ROUTING_TRACE_CONCAT(routing_trace_span_, __LINE__)(cat, name)
+#define ROUTING_TRACE_SCOPE_ARG(cat, name, argName, argValue) \
+  ::routing_core::trace::Span ROUTING_TRACE_CONCAT(routing_trace_span_, __LINE__)(cat, name, argName, static_cast<int64_t>(argValue))
@@ -0,0 +1,75 @@
+#pragma once
+
+// XXH64 — быстрая некриптографическая контрольная сумма блобов тайлов
+// (land_tiles.checksum, индекс пака; см. metadata tile_checksum). Совместима с эталонной
+// реализацией xxHash (XXH64, seed 0), одинакова на всех платформах (little-endian).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace routing_core {
+
+namespace xxh64_detail {
+
+inline constexpr uint64_t kP1 = 0x9E3779B185EBCA87ull;
+inline constexpr uint64_t kP2 = 0xC2B2AE3D27D4EB4Full;
+inline constexpr uint64_t kP3 = 0x165667B19E3779F9ull;
+inline constexpr uint64_t kP4 = 0x85EBCA77C2B2AE63ull;
+inline constexpr uint64_t kP5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t rotl(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+inline uint64_t read64(const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+inline uint32_t read32(const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+inline uint64_t round(uint64_t acc, uint64_t input) { return rotl(acc + input * kP2, 31) * kP1; }
+inline uint64_t merge(uint64_t acc, uint64_t v) { return (acc ^ round(0, v)) * kP1 + kP4; }
+
+} // namespace xxh64_detail
+
+inline uint64_t xxh64(const void* data, size_t size, uint64_t seed = 0) {
+  using namespace xxh64_detail;
+  const auto* p = static_cast<const uint8_t*>(data);
+  const uint8_t* const end = p + size;
+  uint64_t h;
+  if (size >= 32) {
+    uint64_t v1 = seed + kP1 + kP2, v2 = seed + kP2, v3 = seed, v4 = seed - kP1;
+    for (const uint8_t* limit = end - 32; p <= limit; p += 32) {
+      v1 = round(v1, read64(p));
+      v2 = round(v2, read64(p + 8));
+      v3 = round(v3, read64(p + 16));
+      v4 = round(v4, read64(p + 24));
+    }
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = merge(h, v1);
+    h = merge(h, v2);
+    h = merge(h, v3);
+    h = merge(h, v4);
+  } else {
+    h = seed + kP5;
+  }
+  h += static_cast<uint64_t>(size);
+  for (; p + 8 <= end; p += 8) h = rotl(h ^ round(0, read64(p)), 27) * kP1 + kP4;
+  if (p + 4 <= end) {
+    h = rotl(h ^ (static_cast<uint64_t>(read32(p)) * kP1), 23) * kP2 + kP3;
+    p += 4;
+  }
+  for (; p < end; ++p) h = rotl(h ^ (*p * kP5), 11) * kP1;
+  h ^= h >> 33;
+  h *= kP2;
+  h ^= h >> 29;
+  h *= kP3;
+  h ^= h >> 32;
+  return h;
+}
+
+// 16 hex-символов (старшие разряды первыми) — формат land_tiles.checksum.
+inline std::string xxh64Hex(const void* data, size_t size) {
+  static const char* hex = "0123456789abcdef";
+  const uint64_t h = xxh64(data, size);
+  std::string out(16, '0');
+  for (int k = 0; k < 16; ++k) out[15 - k] = hex[(h >> (4 * k)) & 0xF];
+  return out;
+}
+
+} // namespace routing_core
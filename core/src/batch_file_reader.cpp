@@ -0,0 +1,287 @@
+#include "batch_file_reader.h"
+#include "task_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define ROUTING_CORE_IO_URING 1
+#endif
+
+namespace routing_core {
+
+namespace {
+
+constexpr int kEndOfFile = -1;   // код ошибки чтения: файл короче диапазона
+constexpr int kRingFailed = -2;  // сломался сам io_uring_enter: пакет дочитывается через pread
+
+[[noreturn]] void throwReadError(const std::string& path, int err) {
+  if (err == kEndOfFile) throw std::runtime_error("Tile pack is truncated: " + path);
+  throw std::runtime_error("Failed to read tile pack: " + path + ": " + std::strerror(err));
+}
+
+} // namespace
+
+#ifdef ROUTING_CORE_IO_URING
+
+// Кольца подачи и завершения io_uring, отображённые в память процесса.
+struct BatchFileReader::Ring {
+  static constexpr unsigned kEntries = 64;  // чтений в полёте на кольцо
+
+  int fd {-1};
+  unsigned entries {0};
+  void* sqMap {nullptr};
+  size_t sqMapSize {0};
+  void* cqMap {nullptr};  // == sqMap при IORING_FEAT_SINGLE_MMAP
+  size_t cqMapSize {0};
+  io_uring_sqe* sqes {nullptr};
+  size_t sqesSize {0};
+  unsigned* sqHead {nullptr};
+  unsigned* sqTail {nullptr};
+  unsigned* sqArray {nullptr};
+  unsigned sqMask {0};
+  unsigned* cqHead {nullptr};
+  unsigned* cqTail {nullptr};
+  io_uring_cqe* cqes {nullptr};
+  unsigned cqMask {0};
+
+  ~Ring() {
+    if (sqes) ::munmap(sqes, sqesSize);
+    if (cqMap && cqMap != sqMap) ::munmap(cqMap, cqMapSize);
+    if (sqMap) ::munmap(sqMap, sqMapSize);
+    if (fd >= 0) ::close(fd);
+  }
+
+  // Снять pending завершений, ничего не подавая. io_uring_enter может и дальше
+  // падать — тогда ждём, пока ядро само допишет завершения в кольцо.
+  void drain(unsigned pending) {
+    while (pending > 0) {
+      const unsigned head = *cqHead;
+      const unsigned tail = std::atomic_ref<unsigned>(*cqTail).load(std::memory_order_acquire);
+      pending -= std::min(pending, tail - head);
+      std::atomic_ref<unsigned>(*cqHead).store(tail, std::memory_order_release);
+      if (pending == 0) break;
+      if (::syscall(__NR_io_uring_enter, fd, 0u, 1u, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+    }
+  }
+
+  // nullptr, если ядро не даёт io_uring (ENOSYS, EPERM, лимиты).
+  static std::unique_ptr<Ring> create() {
+    io_uring_params p {};
+    const long fd = ::syscall(__NR_io_uring_setup, kEntries, &p);
+    if (fd < 0) return nullptr;
+    auto r = std::make_unique<Ring>();
+    r->fd = static_cast<int>(fd);
+    r->entries = p.sq_entries;
+    r->sqMapSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cqMapSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) r->sqMapSize = r->cqMapSize = std::max(r->sqMapSize, r->cqMapSize);
+    auto map = [&](size_t size, off_t offset) -> void* {
+      void* m = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, offset);
+      return m == MAP_FAILED ? nullptr : m;
+    };
+    if (!(r->sqMap = map(r->sqMapSize, IORING_OFF_SQ_RING))) return nullptr;
+    r->cqMap = single ? r->sqMap : map(r->cqMapSize, IORING_OFF_CQ_RING);
+    if (!r->cqMap) return nullptr;
+    r->sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+    r->sqes = static_cast<io_uring_sqe*>(map(r->sqesSize, IORING_OFF_SQES));
+    if (!r->sqes) return nullptr;
+
+    auto* sq = static_cast<uint8_t*>(r->sqMap);
+    auto* cq = static_cast<uint8_t*>(r->cqMap);
+    r->sqHead = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    r->sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    r->sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    r->sqMask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    r->cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    r->cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    r->cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    r->cqMask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    return r;
+  }
+};
+
+#else
+
+struct BatchFileReader::Ring {};
+
+#endif
+
+BatchFileReader::BatchFileReader(const std::string& path, int fallbackThreads, bool ioUring) : path_(path) {
+  fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0) throw std::runtime_error("Failed to open tile pack: " + path + ": " + std::strerror(errno));
+#ifdef ROUTING_CORE_IO_URING
+  if (ioUring) {
+    if (auto ring = Ring::create()) {
+      uring_ = true;
+      rings_.push_back(std::move(ring));
+    }
+  }
+#else
+  (void)ioUring;
+#endif
+  if (!uring_ && fallbackThreads > 0) pool_ = std::make_unique<TaskPool>(fallbackThreads);
+}
+
+BatchFileReader::~BatchFileReader() {
+  pool_.reset();
+  rings_.clear();
+  if (fd_ >= 0) ::close(fd_);
+}
+
+std::unique_ptr<BatchFileReader::Ring> BatchFileReader::acquireRing() {
+  {
+    std::lock_guard<std::mutex> lock(ringsMu_);
+    if (!rings_.empty()) {
+      auto ring = std::move(rings_.back());
+      rings_.pop_back();
+      return ring;
+    }
+  }
+#ifdef ROUTING_CORE_IO_URING
+  return Ring::create();
+#else
+  return nullptr;
+#endif
+}
+
+void BatchFileReader::releaseRing(std::unique_ptr<Ring> ring) {
+  std::lock_guard<std::mutex> lock(ringsMu_);
+  rings_.push_back(std::move(ring));
+}
+
+void BatchFileReader::read(const std::vector<FileReadRequest>& requests) {
+  if (requests.empty()) return;
+  if (uring_) {
+    // кольцо не создалось (лимит памяти колец) — этот пакет читаем через pread
+    if (auto ring = acquireRing()) {
+      const int err = readRing(*ring, requests);
+      if (err != kRingFailed) {
+        releaseRing(std::move(ring));
+        if (err != 0) throwReadError(path_, err);
+        return;
+      }
+      // ядро уже не пишет в dst; кольцо не переиспользуем, пакет — целиком через pread
+      ring.reset();
+    }
+  }
+  readPool(requests);
+}
+
+#ifdef ROUTING_CORE_IO_URING
+
+int BatchFileReader::readRing(Ring& ring, const std::vector<FileReadRequest>& requests) {
+  const size_t n = requests.size();
+  std::vector<size_t> done(n, 0);
+  std::vector<iovec> iov(n);      // живут, пока чтение в полёте
+  std::vector<size_t> resubmit;   // короткие чтения и EAGAIN: дочитать остаток
+  size_t next = 0;
+  unsigned inflight = 0;          // в кольце подачи или у ядра
+  unsigned unsubmitted = 0;       // в кольце подачи, ещё не принято io_uring_enter
+  int error = 0;
+  // После ошибки новых чтений не подаём, но дожидаемся поданных: ядро пишет в dst.
+  while (inflight > 0 || (error == 0 && (next < n || !resubmit.empty()))) {
+    unsigned tail = *ring.sqTail;  // хвост подачи пишет только этот поток
+    while (error == 0 && inflight < ring.entries && (next < n || !resubmit.empty())) {
+      size_t i;
+      if (!resubmit.empty()) {
+        i = resubmit.back();
+        resubmit.pop_back();
+      } else {
+        i = next++;
+      }
+      const FileReadRequest& r = requests[i];
+      if (done[i] == r.length) continue;
+      iov[i].iov_base = r.dst + done[i];
+      iov[i].iov_len = r.length - done[i];
+      const unsigned slot = tail & ring.sqMask;
+      io_uring_sqe& sqe = ring.sqes[slot];
+      std::memset(&sqe, 0, sizeof(sqe));
+      sqe.opcode = IORING_OP_READV;  // READV, а не READ: работает с ядра 5.1
+      sqe.fd = fd_;
+      sqe.addr = reinterpret_cast<uint64_t>(&iov[i]);
+      sqe.len = 1;
+      sqe.off = r.offset + done[i];
+      sqe.user_data = i;
+      ring.sqArray[slot] = slot;
+      ++tail;
+      ++inflight;
+      ++unsubmitted;
+    }
+    std::atomic_ref<unsigned>(*ring.sqTail).store(tail, std::memory_order_release);
+    if (inflight == 0) continue;
+
+    const long got = ::syscall(__NR_io_uring_enter, ring.fd, unsubmitted, 1u, IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (got < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+      // Кольцо сломано, а принятые ядром чтения ещё пишут в dst: дождаться их завершений.
+      // Не принятые ядром записи подачи так и остаются в кольце — его выбросят.
+      const unsigned queued = tail - std::atomic_ref<unsigned>(*ring.sqHead).load(std::memory_order_acquire);
+      ring.drain(inflight - std::min(queued, inflight));
+      return kRingFailed;
+    }
+    unsubmitted -= static_cast<unsigned>(got);
+
+    unsigned head = *ring.cqHead;
+    const unsigned cqTail = std::atomic_ref<unsigned>(*ring.cqTail).load(std::memory_order_acquire);
+    for (; head != cqTail; ++head) {
+      const io_uring_cqe& cqe = ring.cqes[head & ring.cqMask];
+      const auto i = static_cast<size_t>(cqe.user_data);
+      --inflight;
+      if (cqe.res < 0) {
+        if (cqe.res == -EAGAIN || cqe.res == -EINTR) resubmit.push_back(i);
+        else if (error == 0) error = -cqe.res;
+      } else if (cqe.res == 0) {
+        if (error == 0) error = kEndOfFile;
+      } else {
+        done[i] += static_cast<size_t>(cqe.res);
+        if (done[i] < requests[i].length) resubmit.push_back(i);
+      }
+    }
+    std::atomic_ref<unsigned>(*ring.cqHead).store(head, std::memory_order_release);
+  }
+  return error;
+}
+
+#else
+
+int BatchFileReader::readRing(Ring&, const std::vector<FileReadRequest>&) { return ENOSYS; }
+
+#endif
+
+void BatchFileReader::readPool(const std::vector<FileReadRequest>& requests) {
+  auto readOne = [&](size_t i) {
+    const FileReadRequest& r = requests[i];
+    for (size_t done = 0; done < r.length;) {
+      const ssize_t got = ::pread(fd_, r.dst + done, r.length - done, static_cast<off_t>(r.offset + done));
+      if (got < 0) {
+        if (errno == EINTR) continue;
+        throwReadError(path_, errno);
+      }
+      if (got == 0) throwReadError(path_, kEndOfFile);
+      done += static_cast<size_t>(got);
+    }
+  };
+  if (!pool_) {
+    for (size_t i = 0; i < requests.size(); ++i) readOne(i);
+    return;
+  }
+  pool_->orderedFor(requests.size(), readOne, [](size_t) {});
+}
+
+} // namespace routing_core
@@ -0,0 +1,63 @@
+#pragma once
+
+// Пакетное чтение диапазонов файла (не публичный API, TileStore::loadBatch).
+//
+// Холодному запросу нужны десятки тайлов пака, и все они известны заранее. Если читать
+// их по одному (промахи страниц mmap), ожидания диска идут подряд. Здесь все диапазоны
+// отдаются ядру сразу, и устройство обслуживает их параллельно.
+//   - Linux: io_uring на прямых системных вызовах (без liburing). Пакет уходит одним
+//     io_uring_enter, пока не заполнится кольцо. Короткие чтения дочитываются.
+//   - Иначе (другая ОС, старое ядро, io_uring запрещён seccomp или
+//     kernel.io_uring_disabled) — pread в пуле потоков; поток вызова тоже читает.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace routing_core {
+
+class TaskPool;
+
+struct FileReadRequest {
+  uint64_t offset {0};
+  size_t length {0};
+  uint8_t* dst {nullptr};  // length байт
+};
+
+class BatchFileReader {
+public:
+  // fallbackThreads — потоки pread, если io_uring недоступен (0 — pread в потоке вызова);
+  // ioUring = false — сразу pread (сравнение в бенчмарках).
+  BatchFileReader(const std::string& path, int fallbackThreads, bool ioUring = true);
+  ~BatchFileReader();
+  BatchFileReader(const BatchFileReader&) = delete;
+  BatchFileReader& operator=(const BatchFileReader&) = delete;
+
+  // Прочитать все диапазоны целиком. Ошибка или конец файла — исключение; к этому
+  // моменту ядро уже не пишет в dst. Отказ самого io_uring — не ошибка: пакет
+  // перечитывается через pread. Потокобезопасно.
+  void read(const std::vector<FileReadRequest>& requests);
+
+  bool usesIoUring() const { return uring_; }
+
+private:
+  struct Ring;
+  std::unique_ptr<Ring> acquireRing();
+  void releaseRing(std::unique_ptr<Ring> ring);
+  // 0, код ошибки чтения или kRingFailed (сломан io_uring_enter: кольцо не переиспользовать,
+  // пакет дочитать через pread); к возврату все поданные чтения завершены.
+  int readRing(Ring& ring, const std::vector<FileReadRequest>& requests);
+  void readPool(const std::vector<FileReadRequest>& requests);
+
+  int fd_ {-1};
+  std::string path_;
+  bool uring_ {false};
+  std::mutex ringsMu_;
+  std::vector<std::unique_ptr<Ring>> rings_;  // свободные кольца: по одному на читающий поток
+  std::unique_ptr<TaskPool> pool_;            // только без io_uring
+};
+
+} // namespace routing_core
@@ -0,0 +1,64 @@
+#include "query_arena.h"
+
+#include <algorithm>
+
+namespace routing_core {
+
+namespace {
+
+constexpr size_t kGrowStep = 64u << 10;
+
+}  // namespace
+
+void* QueryArenaPool::Lease::Upstream::do_allocate(size_t n, size_t align) {
+  bytes += n;
+  return std::pmr::new_delete_resource()->allocate(n, align);
+}
+
+void QueryArenaPool::Lease::Upstream::do_deallocate(void* p, size_t n, size_t align) {
+  std::pmr::new_delete_resource()->deallocate(p, n, align);
+}
+
+QueryArenaPool::Lease::Lease(QueryArenaPool& pool, Buffer buffer) : pool_(pool), buffer_(std::move(buffer)) {
+  if (buffer_.size > 0) arena_.emplace(buffer_.data.get(), buffer_.size, &upstream_);
+  else arena_.emplace(&upstream_);
+}
+
+QueryArenaPool::Lease::~Lease() {
+  arena_.reset();  // блоки сверх буфера уходят в кучу
+  if (pool_.maxBytes_ == 0) return;
+  if (upstream_.bytes > 0 && buffer_.size < pool_.maxBytes_) {
+    // запрос не уместился: следующему хватит одного буфера размером с пик этого
+    size_t want = buffer_.size + upstream_.bytes;
+    want = std::min(pool_.maxBytes_, (want + kGrowStep - 1) / kGrowStep * kGrowStep);
+    buffer_.data.reset();  // старый буфер не держим во время выделения нового
+    buffer_.data = std::make_unique_for_overwrite<std::byte[]>(want);
+    buffer_.size = want;
+  }
+  std::lock_guard<std::mutex> lock(pool_.mu_);
+  pool_.free_.push_back(std::move(buffer_));
+}
+
+QueryArenaPool::Lease QueryArenaPool::acquire() {
+  Lease::Buffer buffer;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (!free_.empty()) {
+      // самый большой свободный буфер
+      auto it = std::max_element(free_.begin(), free_.end(),
+                                 [](const Lease::Buffer& a, const Lease::Buffer& b) { return a.size < b.size; });
+      buffer = std::move(*it);
+      *it = std::move(free_.back());
+      free_.pop_back();
+    }
+  }
+  return Lease(*this, std::move(buffer));
+}
+
+void QueryArenaPool::release() {
+  std::vector<Lease::Buffer> drop;
+  std::lock_guard<std::mutex> lock(mu_);
+  drop.swap(free_);
+}
+
+} // namespace routing_core
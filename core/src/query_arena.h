@@ -0,0 +1,67 @@
+#pragma once
+
+// Арена временных структур запроса (не публичный API, RouterOptions::queryArenaBytes).
+//
+// Граф запроса (узлы, списки смежности, индекс q2node), метки поиска, очереди и
+// промежуточные буферы берутся из std::pmr::monotonic_buffer_resource и освобождаются
+// разом в конце запроса. Ресурс стоит на буфере из пула: буфер переживает запрос, а
+// если запрос в него не уместился, при возврате он вырастает до пика запроса (в пределах
+// потолка). Тёплые запросы поэтому не зовут malloc для временных структур, и параллельные
+// запросы не соревнуются за кучу.
+//
+// Монотонный ресурс не потокобезопасен: из арены выделяет только поток запроса.
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace routing_core {
+
+class QueryArenaPool {
+public:
+  // maxBytes — потолок буфера, который сохраняется между запросами (0 — без буферов:
+  // арена берёт блоки у кучи и отдаёт их в конце запроса).
+  explicit QueryArenaPool(size_t maxBytes) : maxBytes_(maxBytes) {}
+
+  class Lease {
+  public:
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+    ~Lease();
+    std::pmr::memory_resource* resource() { return &*arena_; }
+
+  private:
+    friend class QueryArenaPool;
+    struct Buffer {
+      std::unique_ptr<std::byte[]> data;
+      size_t size {0};
+    };
+    // Считает, сколько арена взяла сверх буфера.
+    struct Upstream : std::pmr::memory_resource {
+      size_t bytes {0};
+      void* do_allocate(size_t n, size_t align) override;
+      void do_deallocate(void* p, size_t n, size_t align) override;
+      bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override { return this == &o; }
+    };
+    Lease(QueryArenaPool& pool, Buffer buffer);
+
+    QueryArenaPool& pool_;
+    Buffer buffer_;
+    Upstream upstream_;
+    std::optional<std::pmr::monotonic_buffer_resource> arena_;
+  };
+
+  Lease acquire();
+  // Освободить свободные буферы (Router::trimMemory).
+  void release();
+
+private:
+  size_t maxBytes_;
+  std::mutex mu_;
+  std::vector<Lease::Buffer> free_;
+};
+
+} // namespace routing_core
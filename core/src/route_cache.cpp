@@ -0,0 +1,97 @@
+#include "route_cache.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace routing_core {
+
+uint64_t RouteResultCache::profileHash(const ProfileSettings& profile) {
+  const uint64_t speeds = xxh64(profile.speeds_mps.data(), sizeof(double) * profile.speeds_mps.size());
+  return xxh64(&profile.access_mask, sizeof(profile.access_mask), speeds);
+}
+
+WaypointCacheKey RouteResultCache::waypointKey(uint64_t profile, const Coord& a, const Coord& b) {
+  WaypointCacheKey k;
+  k.profile = profile;
+  k.lat[0] = std::llround(a.lat * 1e7);
+  k.lon[0] = std::llround(a.lon * 1e7);
+  k.lat[1] = std::llround(b.lat * 1e7);
+  k.lon[1] = std::llround(b.lon * 1e7);
+  return k;
+}
+
+uint64_t RouteResultCache::snapPosition(int segIndex, bool toEnd) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(segIndex)) << 1) | (toEnd ? 1u : 0u);
+}
+
+uint64_t RouteResultCache::snapT(double t) {
+  // +0.0 вместо -0.0: одна и та же точка — один ключ
+  return std::bit_cast<uint64_t>(std::clamp(t, 0.0, 1.0) + 0.0);
+}
+
+template <class K, class V>
+V* RouteResultCache::Lru<K, V>::find(const K& key) {
+  auto it = map.find(key);
+  if (it == map.end()) return nullptr;
+  order.splice(order.begin(), order, it->second.second);
+  return &it->second.first;
+}
+
+template <class K, class V>
+void RouteResultCache::Lru<K, V>::put(const K& key, V value, size_t capacity) {
+  auto it = map.find(key);
+  if (it != map.end()) {
+    it->second.first = std::move(value);
+    order.splice(order.begin(), order, it->second.second);
+    return;
+  }
+  while (map.size() >= capacity && !order.empty()) {
+    map.erase(order.back());
+    order.pop_back();
+  }
+  order.push_front(key);
+  map.emplace(key, std::make_pair(std::move(value), order.begin()));
+}
+
+bool RouteResultCache::syncLocked(uint64_t generation) {
+  if (generation == generation_) return true;
+  if (generation < generation_) return false;  // запрос начался до смены данных
+  results_.clear();
+  aliases_.clear();
+  generation_ = generation;
+  return true;
+}
+
+std::optional<RouteResult> RouteResultCache::find(const WaypointCacheKey& key, uint64_t generation) {
+  std::lock_guard<std::mutex> lock(mu_);
+  if (!syncLocked(generation)) return std::nullopt;
+  const RouteCacheKey* snapped = aliases_.find(key);
+  if (!snapped) return std::nullopt;
+  if (RouteResult* r = results_.find(*snapped)) return *r;
+  return std::nullopt;
+}
+
+std::optional<RouteResult> RouteResultCache::find(const RouteCacheKey& key, uint64_t generation) {
+  std::lock_guard<std::mutex> lock(mu_);
+  if (!syncLocked(generation)) return std::nullopt;
+  if (RouteResult* r = results_.find(key)) return *r;
+  return std::nullopt;
+}
+
+void RouteResultCache::insert(const WaypointCacheKey& wp, const RouteCacheKey& key, const RouteResult& result,
+                              uint64_t generation) {
+  if (capacity_ == 0) return;
+  std::lock_guard<std::mutex> lock(mu_);
+  if (!syncLocked(generation)) return;
+  results_.put(key, result, capacity_);
+  aliases_.put(wp, key, capacity_);
+}
+
+void RouteResultCache::alias(const WaypointCacheKey& wp, const RouteCacheKey& key, uint64_t generation) {
+  std::lock_guard<std::mutex> lock(mu_);
+  if (!syncLocked(generation)) return;
+  aliases_.put(wp, key, capacity_);
+}
+
+} // namespace routing_core
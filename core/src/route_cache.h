@@ -0,0 +1,97 @@
+#pragma once
+
+// Кэш результатов маршрутизации (не публичный API, RouterOptions::resultCacheEntries).
+//
+// Основной ключ — привязка концов: ребро (edge_id), сегмент формы, точное положение на
+// нём и выбранный конец ребра для старта и финиша, плюс хэш профиля. Запросы из соседних
+// точек, привязанных к тому же месту графа (проекция в ту же вершину формы или в конец
+// ребра у популярного хаба), получают готовый маршрут без поиска. Положение не
+// округляется: от него зависят веса полурёбер, а с ними и найденный путь. Привязка для
+// ключа ищется до загрузки коридора, по тайлам у концов (Router::Impl::knownTileBox).
+//
+// Второй уровень — точные координаты концов → ключ привязки: повтор того же запроса
+// (ретраи клиента) не читает тайлы и не ищет привязку.
+//
+// Записи верны для одного поколения данных (TileStore::generation): после изменения
+// тайлов (пакет изменений) кэш сбрасывается целиком при первом обращении.
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+#include "routing_core/profile.h"
+#include "routing_core/router.h"
+#include "routing_core/xxhash64.h"
+
+namespace routing_core {
+
+struct RouteCacheKey {
+  uint64_t profile {0};
+  uint64_t startEdge {0};  // edge_id
+  uint64_t endEdge {0};
+  uint64_t startPos {0};   // [сегмент формы:32][конец ребра:1]
+  uint64_t endPos {0};
+  uint64_t startT {0};     // биты double: параметр t на сегменте
+  uint64_t endT {0};
+  bool operator==(const RouteCacheKey& o) const {
+    return profile == o.profile && startEdge == o.startEdge && endEdge == o.endEdge &&
+           startPos == o.startPos && endPos == o.endPos && startT == o.startT && endT == o.endT;
+  }
+};
+
+struct WaypointCacheKey {
+  uint64_t profile {0};
+  int64_t lat[2] {0, 0};   // градусы * 1e7
+  int64_t lon[2] {0, 0};
+  bool operator==(const WaypointCacheKey& o) const {
+    return profile == o.profile && lat[0] == o.lat[0] && lat[1] == o.lat[1] && lon[0] == o.lon[0] &&
+           lon[1] == o.lon[1];
+  }
+};
+
+class RouteResultCache {
+public:
+  explicit RouteResultCache(size_t capacity) : capacity_(capacity) {}
+
+  static uint64_t profileHash(const ProfileSettings& profile);
+  static WaypointCacheKey waypointKey(uint64_t profile, const Coord& a, const Coord& b);
+  // pos и t для RouteCacheKey: сегмент и выбранный конец ребра (0 — from); t — без округления
+  static uint64_t snapPosition(int segIndex, bool toEnd);
+  static uint64_t snapT(double t);
+
+  // Поиск; generation — текущее поколение данных хранилища.
+  std::optional<RouteResult> find(const WaypointCacheKey& key, uint64_t generation);
+  std::optional<RouteResult> find(const RouteCacheKey& key, uint64_t generation);
+  // generation — поколение, на котором начинался запрос: устаревший результат не кладётся.
+  void insert(const WaypointCacheKey& wp, const RouteCacheKey& key, const RouteResult& result, uint64_t generation);
+  // Запомнить координаты для уже закэшированной привязки.
+  void alias(const WaypointCacheKey& wp, const RouteCacheKey& key, uint64_t generation);
+
+private:
+  // ключи — POD без паддинга
+  struct BytesHash {
+    template <class K> size_t operator()(const K& k) const { return static_cast<size_t>(xxh64(&k, sizeof(K))); }
+  };
+  template <class K, class V> struct Lru {
+    std::list<K> order;  // front — свежие
+    std::unordered_map<K, std::pair<V, typename std::list<K>::iterator>, BytesHash> map;
+    V* find(const K& key);
+    void put(const K& key, V value, size_t capacity);
+    void clear() { order.clear(); map.clear(); }
+  };
+
+  // под mu_: сбросить всё, если данные хранилища сменились
+  bool syncLocked(uint64_t generation);
+
+  size_t capacity_;
+  std::mutex mu_;
+  uint64_t generation_ {0};
+  Lru<RouteCacheKey, RouteResult> results_;
+  Lru<WaypointCacheKey, RouteCacheKey> aliases_;
+};
+
+} // namespace routing_core
@@ -0,0 +1,169 @@
+#include "routing_core/route_geometry.h"
+#include "routing_core/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include <flatbuffers/flatbuffers.h>
+#include "land_tile_generated.h"
+
+namespace routing_core {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kMetersPerDegree = 6371000.0 * kPi / 180.0;  // тот же радиус, что в haversine
+constexpr double kEquatorM = 2.0 * kPi * 6378137.0;           // WebMercator
+
+double midLatitude(const std::vector<Coord>& points) {
+  if (points.empty()) return 0.0;
+  auto [lo, hi] = std::minmax_element(points.begin(), points.end(),
+                                      [](const Coord& a, const Coord& b) { return a.lat < b.lat; });
+  return (lo->lat + hi->lat) / 2.0;
+}
+
+// Квадрат расстояния от p до отрезка ab (плоские координаты, м)
+double segmentDist2(double px, double py, double ax, double ay, double bx, double by) {
+  const double dx = bx - ax, dy = by - ay;
+  const double len2 = dx * dx + dy * dy;
+  double t = len2 > 0.0 ? ((px - ax) * dx + (py - ay) * dy) / len2 : 0.0;
+  t = std::clamp(t, 0.0, 1.0);
+  const double ex = ax + t * dx - px, ey = ay + t * dy - py;
+  return ex * ex + ey * ey;
+}
+
+void putVarint(std::string& out, int64_t v) {
+  uint64_t u = (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);  // zigzag
+  while (u >= 0x20) {
+    out.push_back(static_cast<char>((0x20 | (u & 0x1f)) + 63));
+    u >>= 5;
+  }
+  out.push_back(static_cast<char>(u + 63));
+}
+
+bool getVarint(const std::string& s, size_t& pos, int64_t& v) {
+  uint64_t u = 0;
+  for (int shift = 0; pos < s.size() && shift < 64; shift += 5) {
+    const int c = static_cast<unsigned char>(s[pos++]) - 63;
+    if (c < 0 || c > 0x3f) return false;
+    u |= static_cast<uint64_t>(c & 0x1f) << shift;
+    if (c < 0x20) {
+      v = static_cast<int64_t>(u >> 1) ^ -static_cast<int64_t>(u & 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+std::vector<Coord> simplifyPolyline(const std::vector<Coord>& points, double toleranceM) {
+  const size_t n = points.size();
+  if (n < 3 || toleranceM <= 0.0) return points;
+  const double kx = kMetersPerDegree * std::cos(midLatitude(points) * kPi / 180.0);
+  std::vector<std::pair<double, double>> xy(n);
+  for (size_t i = 0; i < n; ++i) xy[i] = {points[i].lon * kx, points[i].lat * kMetersPerDegree};
+
+  // Итеративно, со своим стеком: на длинных маршрутах рекурсия была бы глубокой
+  const double tol2 = toleranceM * toleranceM;
+  std::vector<uint8_t> keep(n, 0);
+  keep.front() = keep.back() = 1;
+  std::vector<std::pair<size_t, size_t>> stack{{0, n - 1}};
+  while (!stack.empty()) {
+    const auto [a, b] = stack.back();
+    stack.pop_back();
+    if (b <= a + 1) continue;
+    double maxD2 = -1.0;
+    size_t idx = a;
+    for (size_t i = a + 1; i < b; ++i) {
+      const double d2 = segmentDist2(xy[i].first, xy[i].second, xy[a].first, xy[a].second, xy[b].first, xy[b].second);
+      if (d2 > maxD2) { maxD2 = d2; idx = i; }
+    }
+    if (maxD2 <= tol2) continue;
+    keep[idx] = 1;
+    stack.emplace_back(a, idx);
+    stack.emplace_back(idx, b);
+  }
+  std::vector<Coord> out;
+  out.reserve(static_cast<size_t>(std::count(keep.begin(), keep.end(), 1)));
+  for (size_t i = 0; i < n; ++i) {
+    if (keep[i]) out.push_back(points[i]);
+  }
+  return out;
+}
+
+double pixelSizeM(int zoom, double lat) {
+  return kEquatorM * std::cos(lat * kPi / 180.0) / (256.0 * std::ldexp(1.0, zoom));
+}
+
+std::string encodePolyline(const std::vector<Coord>& points, int precision) {
+  const double scale = std::pow(10.0, precision);
+  std::string out;
+  out.reserve(points.size() * 8);
+  int64_t prevLat = 0, prevLon = 0;
+  for (const auto& p : points) {
+    const int64_t lat = std::llround(p.lat * scale);
+    const int64_t lon = std::llround(p.lon * scale);
+    putVarint(out, lat - prevLat);
+    putVarint(out, lon - prevLon);
+    prevLat = lat;
+    prevLon = lon;
+  }
+  return out;
+}
+
+std::vector<Coord> decodePolyline(const std::string& encoded, int precision) {
+  const double scale = std::pow(10.0, precision);
+  std::vector<Coord> out;
+  int64_t lat = 0, lon = 0;
+  size_t pos = 0;
+  while (pos < encoded.size()) {
+    int64_t dLat = 0, dLon = 0;
+    if (!getVarint(encoded, pos, dLat) || !getVarint(encoded, pos, dLon)) return {};
+    lat += dLat;
+    lon += dLon;
+    out.push_back(Coord{static_cast<double>(lat) / scale, static_cast<double>(lon) / scale});
+  }
+  return out;
+}
+
+std::vector<uint8_t> encodeRouteGeometry(const std::vector<Coord>& points, double distanceM, double durationS) {
+  std::vector<Routing::ShapePointV2> q;
+  q.reserve(points.size());
+  for (const auto& p : points) {
+    q.emplace_back(static_cast<int32_t>(std::lround(p.lat * 1e6)), static_cast<int32_t>(std::lround(p.lon * 1e6)));
+  }
+  flatbuffers::FlatBufferBuilder fbb(q.size() * sizeof(Routing::ShapePointV2) + 64);
+  auto pts = fbb.CreateVectorOfStructs(q);
+  fbb.Finish(Routing::CreateRouteGeometry(fbb, distanceM, durationS, pts));
+  return std::vector<uint8_t>(fbb.GetBufferPointer(), fbb.GetBufferPointer() + fbb.GetSize());
+}
+
+void applyRouteOutput(RouteResult& rr, const RouteOutputOptions& options) {
+  ROUTING_TRACE_SCOPE("route", "output_geometry");
+  if (options.format == GeometryFormat::None) {
+    std::vector<Coord>().swap(rr.polyline);
+    return;
+  }
+  double tolerance = options.simplifyToleranceM;
+  if (options.simplifyZoom >= 0) {
+    tolerance = std::max(tolerance, pixelSizeM(options.simplifyZoom, midLatitude(rr.polyline)));
+  }
+  if (tolerance > 0.0) rr.polyline = simplifyPolyline(rr.polyline, tolerance);
+  switch (options.format) {
+    case GeometryFormat::Coords:
+      return;
+    case GeometryFormat::Polyline:
+      rr.encoded_polyline = encodePolyline(rr.polyline, options.polylinePrecision);
+      break;
+    case GeometryFormat::FlatBuffers:
+      rr.geometry_buffer = encodeRouteGeometry(rr.polyline, rr.distance_m, rr.duration_s);
+      break;
+    case GeometryFormat::None:
+      break;
+  }
+  std::vector<Coord>().swap(rr.polyline);
+}
+
+} // namespace routing_core
@@ -1,648 +1,303 @@
 #include "routing_core/router.h"
+#include "routing_core/route_geometry.h"
 #include "routing_core/tile_store.h"
+#include "routing_core/trace.h"
 
-#include <flatbuffers/flatbuffers.h>
-#include <cmath>
-#include <memory>
-#include <stdexcept>
-#include <queue>
 #include <algorithm>
+#include <cmath>
 #include <limits>
 #include <optional>
-#include <unordered_map>
-#include <map>
+#include <stdexcept>
+#include <tuple>
 
-#include "land_tile_generated.h"
-#include "routing_core/tile_view.h"
-#include "routing_core/tiler.h"
-#include "routing_core/edge_id.h"
-#include "routing_core/profile.h"
+#include "router_impl.h"
 
 namespace routing_core {
 
-struct Router::Impl {
-  TileStore store;
-  int tileZoom;
+Router::Router(const std::string& db_path, RouterOptions opt)
+  : impl_(std::make_unique<Impl>(db_path, opt)) {
+  if (opt.trace) trace::enable();
+  else trace::enableFromEnv();
+}
 
-  explicit Impl(const std::string& db, const RouterOptions& opt)
-    : store(db, opt.tileCacheCapacity), tileZoom(opt.tileZoom) {
-    store.setZoom(tileZoom);
-  }
+Router::~Router() = default;
 
-  // --- геодезия ---
-  static double haversine(double lat1, double lon1, double lat2, double lon2) {
-    constexpr double R = 6371000.0;
-    const double p1 = lat1 * M_PI/180.0;
-    const double p2 = lat2 * M_PI/180.0;
-    const double dphi = (lat2 - lat1) * M_PI/180.0;
-    const double dl = (lon2 - lon1) * M_PI/180.0;
-    const double a = std::sin(dphi/2)*std::sin(dphi/2) + std::cos(p1)*std::cos(p2)*std::sin(dl/2)*std::sin(dl/2);
-    const double c = 2 * std::atan2(std::sqrt(a), std::sqrt(1-a));
-    return R * c;
+RouteResult Router::route(const ProfileSettings& profile, const std::vector<Coord>& waypoints,
+                          const RouteOutputOptions& output) {
+  ROUTING_TRACE_SCOPE_ARG("route", "route", "waypoints", waypoints.size());
+  try {
+    // Статистика включается выбором инстанцирования: без неё сборщик пустой и вырезается компилятором.
+    if (impl_->collectStats) {
+      Impl::QueryStats<true> stats;
+      auto rr = impl_->routeMulti(profile, waypoints, output, stats);
+      stats.attach(rr);
+      return rr;
+    }
+    Impl::QueryStats<false> stats;
+    return impl_->routeMulti(profile, waypoints, output, stats);
+  } catch (const TileDataError& e) {
+    // повреждённый тайл — ответ, а не исключение (docs/it_1_task_2.md, «Ошибки»)
+    RouteResult rr;
+    rr.status = RouteStatus::DATA_ERROR;
+    rr.error_message = e.what();
+    return rr;
   }
+}
 
-  // --- упаковка/распаковка edge_id: 64 бита = [z:8][x:20][y:20][ei:16]
-  static uint64_t makeEdgeId(int z, uint32_t x, uint32_t y, uint32_t edgeIdx) { return edgeid::make(z,x,y,edgeIdx); }
-  static void parseEdgeId(uint64_t id, int& z, uint32_t& x, uint32_t& y, uint32_t& edgeIdx) { edgeid::parse(id,z,x,y,edgeIdx); }
-
-  // --- снап к ребру ---
-  struct EdgeSnap {
-    uint32_t edgeIdx{0};
-    int fromNode{-1};
-    int toNode{-1};
-    int segIndex{-1};           // индекс сегмента внутри формы (если форма есть)
-    double t{0.0};              // параметр проекции на сегмент [0..1]
-    double projLat{0.0};
-    double projLon{0.0};
-    double dist_m{std::numeric_limits<double>::infinity()};
-  };
+void Router::prefetch(const std::vector<Coord>& waypoints) {
+  if (!impl_->prefetcher || waypoints.size() < 2) return;
+  std::vector<TileKey> trefs; std::vector<std::pair<TileKey,double>> order;
+  impl_->planTiles(waypoints.front(), waypoints.back(), trefs, order);
+  impl_->prefetcher->schedule(order);
+}
 
-  static void projectPointToSegment(double ax, double ay, double bx, double by,
-                                    double px, double py, double& outX, double& outY, double& t) {
-    // проекция в евклидовой метрике; для малых сегментов ок
-    const double vx = bx - ax, vy = by - ay;
-    const double wx = px - ax, wy = py - ay;
-    double c1 = vx*wx + vy*wy;
-    double c2 = vx*vx + vy*vy;
-    t = (c2 <= 1e-12) ? 0.0 : std::max(0.0, std::min(1.0, c1 / c2));
-    outX = ax + t*vx;
-    outY = ay + t*vy;
+void Router::trimMemory(MemoryTrimLevel level) {
+  ROUTING_TRACE_SCOPE("route", "trimMemory");
+  if (level == MemoryTrimLevel::Critical) {
+    if (impl_->prefetcher) impl_->prefetcher->cancel();
+    impl_->store.trimCache(0);
+    impl_->store.releaseBackendMemory();
+    impl_->arenas.release();
+  } else {
+    impl_->store.trimCache(impl_->store.cacheBudget() / 4);
   }
+}
 
-  static std::optional<EdgeSnap> snapToEdge(const TileView& view, double lat, double lon, const ProfileSettings& profile) {
-    if (!view.valid() || view.edgeCount() == 0) return std::nullopt;
-    EdgeSnap best;
-    bool has = false;
-
-    std::vector<std::pair<double,double>> tmp;
-    tmp.reserve(64);
-
-    for (int ei = 0; ei < view.edgeCount(); ++ei) {
-      tmp.clear();
-      const auto* e = view.edgeAt(static_cast<uint32_t>(ei));
-      // профильная доступность: должна быть скорость > 0 и доступен профиль
-      auto rc = static_cast<int>(e->road_class());
-      double sp = profile.speeds_mps[rc];
-      bool allowed = (profile.access_mask & e->access_mask()) != 0;
-      if (!allowed || sp <= 0.0) continue;
-      view.appendEdgeShape(static_cast<uint32_t>(ei), tmp, /*skipFirst*/false);
-      if (tmp.size() < 2) continue;
-      for (int k = 0; k+1 < static_cast<int>(tmp.size()); ++k) {
-        // Работать в плоскости (lon=x, lat=y), затем обратно
-        double projLon, projLat, t;
-        projectPointToSegment(
-          /*ax=*/tmp[k].second,      /*ay=*/tmp[k].first,
-          /*bx=*/tmp[k+1].second,    /*by=*/tmp[k+1].first,
-          /*px=*/lon,                /*py=*/lat,
-          /*outX=*/projLon,          /*outY=*/projLat,
-          t);
-        double d = haversine(lat, lon, projLat, projLon);
-        if (d < best.dist_m) {
-          has = true;
-          best.edgeIdx = static_cast<uint32_t>(ei);
-          best.fromNode = static_cast<int>(e->from_node());
-          best.toNode   = static_cast<int>(e->to_node());
-          best.segIndex = k;
-          best.t = t;
-          best.projLat = projLat;
-          best.projLon = projLon;
-          best.dist_m = d;
-        }
-      }
-    }
-    if (!has) return std::nullopt;
-    return best;
-  }
+TileDeltaStats Router::applyDelta(const std::string& deltaPath) {
+  ROUTING_TRACE_SCOPE("route", "applyDelta");
+  if (impl_->store.isPack()) throw std::runtime_error("Tile delta packages apply to SQLite routingdb only");
+  std::vector<TileKey> changed;
+  const TileDeltaStats stats = applyTileDelta(impl_->store.dbPath(), deltaPath, &changed);
+  impl_->store.invalidate(changed);
+  return stats;
+}
 
-  // --- утилиты доступа/веса ---
-  static bool edgeAllowed(const Routing::Edge* e, const ProfileSettings& profile, int fromNode) {
-    if ((profile.access_mask & e->access_mask()) == 0) return false;
-    bool oneway = e->oneway();
-    if (oneway && fromNode != static_cast<int>(e->from_node())) return false;
-    return true;
+template <bool kStats>
+RouteResult Router::Impl::routeMulti(const ProfileSettings& profile,
+                                     const std::vector<Coord>& waypoints,
+                                     const RouteOutputOptions& output,
+                                     QueryStats<kStats>& stats) {
+  RouteResult rr;
+  if (waypoints.size() < 2) {
+    rr.status = RouteStatus::INTERNAL_ERROR;
+    rr.error_message = "need at least 2 waypoints";
+    return rr;
   }
 
-  static double edgeTraversalTimeSec(const Routing::Edge* e, const ProfileSettings& profile) {
-    auto rc = static_cast<int>(e->road_class());
-    double speed = profile.speeds_mps[rc];
-    if (speed <= 0.0) return std::numeric_limits<double>::infinity();
-    return e->length_m() / speed;
+  // Кэш результатов: повтор с теми же координатами отдаётся без чтения тайлов и привязки
+  const uint64_t generation = resultCache ? store.generation() : 0;
+  WaypointCacheKey wpKey;
+  RouteCacheKey cacheKey;
+  auto fromCache = [&](RouteResult&& cached) {
+    stats.cacheHit();
+    applyRouteOutput(cached, output);
+    return std::move(cached);
+  };
+  if (resultCache) {
+    cacheKey.profile = RouteResultCache::profileHash(profile);
+    wpKey = RouteResultCache::waypointKey(cacheKey.profile, waypoints.front(), waypoints.back());
+    if (auto hit = resultCache->find(wpKey, generation)) return fromCache(std::move(*hit));
   }
 
-  // --- виртуальные рёбра/узлы для снапа ---
-  struct VirtualEdge {
-    int from{-1};
-    int to{-1};
-    double length_m{0.0};
-    double duration_s{0.0};
-    uint32_t access_mask{0};
-    bool oneway{false};
-    // простая геометрия (две точки), чтобы собрать polyline
-    Coord a{}, b{};
-    // индекс реального ребра в тайле, к которому относится виртуальный сегмент
-    int realEdgeIdx{-1};
+  // Временные структуры запроса — в арене, освобождаются разом при выходе
+  auto arenaLease = arenas.acquire();
+  std::pmr::memory_resource* arena = arenaLease.resource();
+
+  std::vector<TileKey> trefs; std::vector<std::pair<TileKey,double>> order;
+  planTiles(waypoints.front(), waypoints.back(), trefs, order);
+
+  // Слой геометрии (если хранится отдельно) читается лениво: только для тайлов,
+  // где ищется снап, и для тайлов с рёбрами найденного пути.
+  auto ensureGeometry = [&](std::pair<TileKey,TileView>& tv){
+    if (tv.second.hasGeometry()) return;
+    // время чтения входит в фазу снапа/сборки, откуда слой запрошен
+    ROUTING_TRACE_SCOPE("route", "geometry_io");
+    auto g = store.loadGeometry(tv.first.z, tv.first.x, tv.first.y, stats.geometryStats());
+    if (g) tv.second.attachGeometry(g, g->data);
+  };
+  auto usableTile = [](const TileView& v) { return v.valid() && v.edgeCount() > 0 && v.nodeCount() >= 2; };
+  // Ключ кэша — привязка концов: ребро, место на нём и ближний к точке конец ребра (pickClosest ниже)
+  auto snapKey = [&](const std::pair<TileKey,TileView>& tv, const EdgeSnap& snap, const Coord& c, uint64_t& edge,
+                     uint64_t& pos, uint64_t& t) {
+    const TileView& v = tv.second;
+    const bool toEnd = haversine(v.nodeLat(snap.fromNode), v.nodeLon(snap.fromNode), c.lat, c.lon) >
+                       haversine(v.nodeLat(snap.toNode), v.nodeLon(snap.toNode), c.lat, c.lon);
+    edge = makeEdgeId(tv.first.z, static_cast<uint32_t>(tv.first.x), static_cast<uint32_t>(tv.first.y), snap.edgeIdx);
+    pos = RouteResultCache::snapPosition(snap.segIndex, toEnd);
+    t = RouteResultCache::snapT(snap.t);
   };
 
-  // bi-A* внутри одного тайла + виртуальные узлы
-  RouteResult routeSingleTile(const ProfileSettings& profile,
-                              const TileKey& key,
-                              TileView& view,
-                              const EdgeSnap& startSnap,
-                              const EdgeSnap& endSnap) {
-    RouteResult rr;
-
-    const int N = view.nodeCount();
-    if (N < 2 || view.edgeCount() == 0) {
-      rr.status = RouteStatus::NO_ROUTE;
-      rr.error_message = "empty tile";
-      return rr;
-    }
-
-    // Построим виртуальные узлы
-    const int vStart = N;     // виртуальный узел старта
-    const int vEnd   = N + 1; // виртуальный узел финиша
-    const int VN     = N + 2; // общее число узлов в вычислении
-
-    auto* eStart = view.edgeAt(startSnap.edgeIdx);
-    auto* eEnd   = view.edgeAt(endSnap.edgeIdx);
-
-    auto speedOf = [&](const Routing::Edge* e)->double {
-      int rc = static_cast<int>(e->road_class());
-      return profile.speeds_mps[rc];
-    };
-
-    // длины/времена долей ребра
-    auto lenStart  = eStart->length_m();
-    auto durStart  = (speedOf(eStart) > 0.0) ? (lenStart / speedOf(eStart)) : std::numeric_limits<double>::infinity();
-    auto tS = std::clamp(startSnap.t, 0.0, 1.0);
-
-    auto lenEnd    = eEnd->length_m();
-    auto durEnd    = (speedOf(eEnd) > 0.0) ? (lenEnd / speedOf(eEnd)) : std::numeric_limits<double>::infinity();
-    auto tE = std::clamp(endSnap.t, 0.0, 1.0);
-
-    // Виртуальные рёбра для старта:
-    // 1) from -> vStart  (доля t)
-    // 2) vStart -> to    (доля 1-t)
-    VirtualEdge vs1{
-      startSnap.fromNode, vStart,
-      lenStart * tS,
-      durStart * tS,
-      eStart->access_mask(),
-      eStart->oneway(),
-      {view.nodeLat(startSnap.fromNode), view.nodeLon(startSnap.fromNode)},
-      {startSnap.projLat, startSnap.projLon},
-      static_cast<int>(startSnap.edgeIdx)
-    };
-    VirtualEdge vs2{
-      vStart, startSnap.toNode,
-      lenStart * (1.0 - tS),
-      durStart * (1.0 - tS),
-      eStart->access_mask(),
-      eStart->oneway(),
-      {startSnap.projLat, startSnap.projLon},
-      {view.nodeLat(startSnap.toNode), view.nodeLon(startSnap.toNode)},
-      static_cast<int>(startSnap.edgeIdx)
-    };
-
-    // Виртуальные рёбра для финиша:
-    // 1) from -> vEnd   (доля t)
-    // 2) vEnd  -> to    (доля 1-t)
-    VirtualEdge ve1{
-      endSnap.fromNode, vEnd,
-      lenEnd * tE,
-      durEnd * tE,
-      eEnd->access_mask(),
-      eEnd->oneway(),
-      {view.nodeLat(endSnap.fromNode), view.nodeLon(endSnap.fromNode)},
-      {endSnap.projLat, endSnap.projLon},
-      static_cast<int>(endSnap.edgeIdx)
-    };
-    VirtualEdge ve2{
-      vEnd, endSnap.toNode,
-      lenEnd * (1.0 - tE),
-      durEnd * (1.0 - tE),
-      eEnd->access_mask(),
-      eEnd->oneway(),
-      {endSnap.projLat, endSnap.projLon},
-      {view.nodeLat(endSnap.toNode), view.nodeLon(endSnap.toNode)},
-      static_cast<int>(endSnap.edgeIdx)
-    };
-
-    // Собираем список виртуальных рёбер (учитываем oneway: если oneway=true, vs1 допустим только from->vStart, a vStart->from не допускаем)
-    std::vector<VirtualEdge> virt;
-    virt.reserve(4);
-    virt.push_back(vs1);
-    virt.push_back(vs2);
-    virt.push_back(ve1);
-    virt.push_back(ve2);
-
-    // Мелкая утилита доступа к «исходящим» виртуальным рёбрам из узла u
-    auto virtOutEdges = [&](int u, std::vector<int>& outIdxs) {
-      outIdxs.clear();
-      for (int i = 0; i < static_cast<int>(virt.size()); ++i) {
-        if (virt[i].from == u) outIdxs.push_back(i);
-      }
-    };
-    // И входящие для обратного фронта
-    auto virtInEdges = [&](int u, std::vector<int>& outIdxs) {
-      outIdxs.clear();
-      for (int i = 0; i < static_cast<int>(virt.size()); ++i) {
-        if (virt[i].to == u) outIdxs.push_back(i);
-      }
-    };
-
-    // --- bi-A* между vStart и vEnd ---
-    struct QNode { int v; double f; };
-    struct Cmp { bool operator()(const QNode& a, const QNode& b) const { return a.f > b.f; } };
-
-    struct Label {
-      double g{std::numeric_limits<double>::infinity()};
-      int prevNode{-1};
-      uint32_t prevEdge{std::numeric_limits<uint32_t>::max()}; // индекс реального ребра (если брали real-edge)
-      int prevVirt{-1}; // индекс виртуального ребра (если брали виртуальный)
-    };
-
-    std::vector<Label> F(VN), B(VN);
-
-    double speedHeur = 0.0;
-    for (double v : profile.speeds_mps) { if (v > speedHeur) speedHeur = v; }
-    if (speedHeur <= 0.0) speedHeur = 1.0;
-    auto h = [&](int v, const Coord& target)->double {
-      double lv = (v < N) ? view.nodeLat(v) : (v == vStart ? startSnap.projLat : endSnap.projLat);
-      double lo = (v < N) ? view.nodeLon(v) : (v == vStart ? startSnap.projLon : endSnap.projLon);
-      return haversine(lv, lo, target.lat, target.lon) / speedHeur;
-    };
-
-    std::priority_queue<QNode, std::vector<QNode>, Cmp> pqF, pqB;
-
-    Coord targetF{endSnap.projLat, endSnap.projLon};
-    Coord targetB{startSnap.projLat, startSnap.projLon};
-
-    F[vStart].g = 0.0;
-    pqF.push({vStart, h(vStart, targetF)});
-
-    B[vEnd].g = 0.0;
-    pqB.push({vEnd, h(vEnd, targetB)});
-
-    double bestMu = std::numeric_limits<double>::infinity();
-    int meet = -1;
-
-    std::vector<int> tmpIdx;
-
-    auto relaxForward = [&](int u) {
-      // 1) реальные исходящие рёбра
-      if (u < N) {
-        uint32_t start = view.firstEdge(u);
-        uint16_t cnt   = view.edgeCountFrom(u);
-        for (uint32_t k = 0; k < cnt; ++k) {
-          uint32_t ei = start + k;
-          const auto* e = view.edgeAt(ei);
-          if (!edgeAllowed(e, profile, u)) continue;
-          int v = static_cast<int>(e->to_node());
-          double w = edgeTraversalTimeSec(e, profile);
-          if (!std::isfinite(w)) continue;
-          double cand = F[u].g + w;
-          if (cand < F[v].g) {
-            F[v].g = cand;
-            F[v].prevNode = u;
-            F[v].prevEdge = ei;
-            F[v].prevVirt = -1;
-            pqF.push({v, cand + h(v, targetF)});
-            if (B[v].g < std::numeric_limits<double>::infinity()) {
-              double mu = cand + B[v].g;
-              if (mu < bestMu) { bestMu = mu; meet = v; }
-            }
-          }
-        }
-      }
-      // 2) виртуальные исходящие
-      virtOutEdges(u, tmpIdx);
-      for (int idx : tmpIdx) {
-        const auto& e = virt[idx];
-        // доступ/oneway — берём как есть, т.к. уже "направили" from→to
-        if (e.duration_s == std::numeric_limits<double>::infinity()) continue;
-        int v = e.to;
-        double cand = F[u].g + e.duration_s;
-        if (cand < F[v].g) {
-          F[v].g = cand;
-          F[v].prevNode = u;
-          F[v].prevEdge = std::numeric_limits<uint32_t>::max();
-          F[v].prevVirt = idx;
-          pqF.push({v, cand + h(v, targetF)});
-          if (B[v].g < std::numeric_limits<double>::infinity()) {
-            double mu = cand + B[v].g;
-            if (mu < bestMu) { bestMu = mu; meet = v; }
-          }
+  // Кэш результатов: привязка концов до загрузки коридора. Если рамки всех тайлов плана
+  // известны по прошлым запросам, читаются только тайлы, где может лежать ближайшее ребро
+  // (обычно тайлы концов), и попадание обходится без чтения и подготовки остальных. Та же
+  // привязка получилась бы и после загрузки всех тайлов: рамка — нижняя оценка расстояния.
+  std::pmr::vector<std::shared_ptr<TileBlob>> blobs(trefs.size(), arena);
+  std::pmr::vector<uint8_t> fetched(trefs.size(), 0, arena);
+  bool keyed = false;
+  if (resultCache) {
+    typename QueryStats<kStats>::Phase phase(stats, &RouteStats::snap_ms, "snap");  // с чтением тайлов концов
+    std::pmr::vector<std::optional<std::pair<TileKey,TileView>>> early(trefs.size(), arena);
+    auto earlyTile = [&](int i) -> std::pair<TileKey,TileView>* {
+      if (!fetched[i]) {
+        TileLoadStats io;
+        blobs[i] = store.load(trefs[i].z, trefs[i].x, trefs[i].y, kStats ? &io : nullptr);
+        stats.addTileStats(io);
+        fetched[i] = 1;
+        if (const auto& b = blobs[i]) {
+          TileView v(b, b->data, b->size, b->inIndex, b->schemaVersion);
+          if (usableTile(v)) early[i].emplace(trefs[i], std::move(v));
         }
       }
+      return early[i] ? &*early[i] : nullptr;
     };
-
-    auto relaxBackward = [&](int u) {
-      // 1) реальные входящие рёбра
-      if (u < N) {
-        const auto& inE = view.inEdgesOf(u);
-        for (auto ei : inE) {
-          const auto* e = view.edgeAt(ei);
-          int from = static_cast<int>(e->from_node());
-          if (!edgeAllowed(e, profile, from)) continue;
-          double w = edgeTraversalTimeSec(e, profile);
-          if (!std::isfinite(w)) continue;
-          double cand = B[u].g + w;
-          if (cand < B[from].g) {
-            B[from].g = cand;
-            B[from].prevNode = u;
-            B[from].prevEdge = ei;
-            B[from].prevVirt = -1;
-            pqB.push({from, cand + h(from, targetB)});
-            if (F[from].g < std::numeric_limits<double>::infinity()) {
-              double mu = cand + F[from].g;
-              if (mu < bestMu) { bestMu = mu; meet = from; }
-            }
-          }
-        }
+    auto snapEarly = [&](const Coord& c, std::optional<EdgeSnap>& best, int& bestTile) {
+      std::pmr::vector<std::pair<double,int>> cand(arena);
+      cand.reserve(trefs.size());
+      for (int i = 0; i < static_cast<int>(trefs.size()); ++i) {
+        const auto box = knownTileBox(trefs[i], generation);
+        if (!box) return false;
+        cand.emplace_back(distanceToBox(*box, c.lat, c.lon), i);
       }
-      // 2) виртуальные входящие
-      virtInEdges(u, tmpIdx);
-      for (int idx : tmpIdx) {
-        const auto& e = virt[idx];
-        if (e.duration_s == std::numeric_limits<double>::infinity()) continue;
-        int from = e.from;
-        double cand = B[u].g + e.duration_s;
-        if (cand < B[from].g) {
-          B[from].g = cand;
-          B[from].prevNode = u;
-          B[from].prevEdge = std::numeric_limits<uint32_t>::max();
-          B[from].prevVirt = idx;
-          pqB.push({from, cand + h(from, targetB)});
-          if (F[from].g < std::numeric_limits<double>::infinity()) {
-            double mu = cand + F[from].g;
-            if (mu < bestMu) { bestMu = mu; meet = from; }
-          }
-        }
+      std::sort(cand.begin(), cand.end());
+      double bestD = std::numeric_limits<double>::infinity();
+      for (const auto& [boxD, i] : cand) {
+        if (boxD > bestD) break;
+        auto* tv = earlyTile(i);
+        if (!tv) continue;
+        ensureGeometry(*tv);
+        auto s = snapToEdge(tv->second, c.lat, c.lon, profile, arena);
+        if (s && (s->dist_m<bestD || (s->dist_m==bestD && i<bestTile))) { best=s; bestD=s->dist_m; bestTile=i; }
       }
+      return best.has_value();
     };
-
-    // Основной цикл
-    while (!pqF.empty() || !pqB.empty()) {
-      if (!pqF.empty()) {
-        auto q = pqF.top(); pqF.pop();
-        if (F[q.v].g + h(q.v, targetF) > bestMu) break;
-        relaxForward(q.v);
-      }
-      if (!pqB.empty()) {
-        auto q = pqB.top(); pqB.pop();
-        if (B[q.v].g + h(q.v, targetB) > bestMu) break;
-        relaxBackward(q.v);
+    std::optional<EdgeSnap> s0, t0; int si = -1, ti = -1;
+    keyed = snapEarly(waypoints.front(), s0, si) && snapEarly(waypoints.back(), t0, ti);
+    if (keyed) {
+      snapKey(*early[si], *s0, waypoints.front(), cacheKey.startEdge, cacheKey.startPos, cacheKey.startT);
+      snapKey(*early[ti], *t0, waypoints.back(), cacheKey.endEdge, cacheKey.endPos, cacheKey.endT);
+      if (auto hit = resultCache->find(cacheKey, generation)) {
+        resultCache->alias(wpKey, cacheKey, generation);
+        return fromCache(std::move(*hit));
       }
     }
+  }
 
-    if (meet < 0 && vStart != vEnd) {
-      rr.status = RouteStatus::NO_ROUTE;
-      rr.error_message = "no path within tile";
-      return rr;
+  // Пак с пакетным чтением: холодные тайлы плана уходят ядру одним пакетом, и диск
+  // обслуживает их параллельно. Иначе префетчер читает тайлы впереди потока запроса в том
+  // же порядке, а поток запроса сразу вливает готовые тайлы в граф.
+  if (store.readsInBatches()) {
+    typename QueryStats<kStats>::Phase phase(stats, &RouteStats::tile_io_ms, "tile_io");
+    std::vector<TileKey> rest;
+    for (size_t i = 0; i < trefs.size(); ++i) {
+      if (!fetched[i]) rest.push_back(trefs[i]);
     }
-
-    // Восстановление пути: vStart -> meet по F, meet -> vEnd по B
-    std::vector<std::pair<bool,uint64_t>> used; // (isVirt, id/edgeIdx)
-    auto pushForward = [&](int v) {
-      while (v != vStart && v >= 0) {
-        if (F[v].prevVirt >= 0) {
-          used.emplace_back(true, static_cast<uint64_t>(F[v].prevVirt));
-        } else {
-          used.emplace_back(false, static_cast<uint64_t>(F[v].prevEdge));
-        }
-        v = F[v].prevNode;
-      }
-    };
-    auto pushBackward = [&](int v) {
-      while (v != vEnd && v >= 0) {
-        if (B[v].prevVirt >= 0) {
-          used.emplace_back(true, static_cast<uint64_t>(B[v].prevVirt));
-        } else {
-          used.emplace_back(false, static_cast<uint64_t>(B[v].prevEdge));
-        }
-        v = B[v].prevNode;
-      }
-    };
-
-    pushForward(meet);
-    std::reverse(used.begin(), used.end());
-    pushBackward(meet);
-
-    // Сборка polyline и метрик
-    rr.polyline.clear();
-    rr.edge_ids.clear();
-    rr.distance_m = 0.0;
-    rr.duration_s = 0.0;
-
-    auto appendPoint = [&](double lat, double lon) {
-      if (!rr.polyline.empty()) {
-        auto& last = rr.polyline.back();
-        if (last.lat == lat && last.lon == lon) return;
-        rr.distance_m += haversine(last.lat, last.lon, lat, lon);
-      }
-      rr.polyline.push_back(Coord{lat, lon});
-    };
-
-    uint64_t lastEdgeIdPushed = std::numeric_limits<uint64_t>::max();
-    for (auto [isVirt, id] : used) {
-      if (isVirt) {
-        const auto& e = virt[static_cast<int>(id)];
-        // Виртуальные рёбра добавляем геометрией двух точек
-        if (rr.polyline.empty()) appendPoint(e.a.lat, e.a.lon);
-        else appendPoint(e.a.lat, e.a.lon); // возможно совпадёт и просто не добавится
-        appendPoint(e.b.lat, e.b.lon);
-        rr.duration_s += e.duration_s;
-        // Добавим соответствующий реальный edgeId (избегая дублей подряд)
-        if (e.realEdgeIdx >= 0) {
-          uint64_t eid = makeEdgeId(key.z, key.x, key.y, static_cast<uint32_t>(e.realEdgeIdx));
-          if (eid != lastEdgeIdPushed) {
-            rr.edge_ids.push_back(eid);
-            lastEdgeIdPushed = eid;
-          }
-        }
-      } else {
-        uint32_t ei = static_cast<uint32_t>(id);
-        // Реальное ребро: добавляем его shape
-        std::vector<std::pair<double,double>> pts;
-        view.appendEdgeShape(ei, pts, /*skipFirst*/!rr.polyline.empty());
-        for (auto& p : pts) appendPoint(p.first, p.second);
-        rr.duration_s += edgeTraversalTimeSec(view.edgeAt(ei), profile);
-        uint64_t eid = makeEdgeId(key.z, key.x, key.y, ei);
-        if (eid != lastEdgeIdPushed) {
-          rr.edge_ids.push_back(eid);
-          lastEdgeIdPushed = eid;
-        }
-      }
+    auto batch = store.loadBatch(rest, stats.tileStats());
+    for (size_t i = 0, k = 0; i < trefs.size(); ++i) {
+      if (!fetched[i]) { blobs[i] = std::move(batch[k++]); fetched[i] = 1; }
     }
-
-    rr.status = RouteStatus::OK;
-    return rr;
+  } else if (prefetcher) {
+    prefetcher->schedule(order);
   }
 
-  // ---- Мультитайловый граф (с коннекторами по lat_q/lon_q) ----
-  struct GlobalEdge { int to; double w; uint8_t isVirt; uint32_t tileX, tileY, edgeIdx; };
-  struct GlobalNode { double lat, lon; };
-
-  // key for quantized coordinate
-  struct QKey { int32_t lat_q; int32_t lon_q; };
-  struct QKeyHash { size_t operator()(const QKey& k) const noexcept { return (static_cast<size_t>(static_cast<uint32_t>(k.lat_q))<<32) ^ static_cast<size_t>(static_cast<uint32_t>(k.lon_q)); } };
-  struct QKeyEq { bool operator()(const QKey& a, const QKey& b) const noexcept { return a.lat_q==b.lat_q && a.lon_q==b.lon_q; } };
-
-  // Сбор прямоугольника тайлов (с рамкой)
-  void collectTileRange(const Coord& a, const Coord& b, int frame,
-                        std::vector<TileKey>& out) {
-    auto ka = webTileKeyFor(a.lat, a.lon, tileZoom);
-    auto kb = webTileKeyFor(b.lat, b.lon, tileZoom);
-    int minx = std::min(ka.x, kb.x) - frame;
-    int maxx = std::max(ka.x, kb.x) + frame;
-    int miny = std::min(ka.y, kb.y) - frame;
-    int maxy = std::max(ka.y, kb.y) + frame;
-    for (int y=miny;y<=maxy;++y) {
-      for (int x=minx;x<=maxx;++x) {
-        out.push_back(TileKey{tileZoom,x,y});
-      }
+  std::vector<std::pair<TileKey,TileView>> tiles;
+  tiles.reserve(trefs.size());
+  GlobalNodes nodes(arena); GlobalAdj adj(arena); GlobalRevAdj revAdj(arena); NodeIndex q2node(arena);
+  // Рамка тайла для отсечения снапа; с кэшем результатов запоминается для следующих запросов.
+  auto boxOf = [&](const std::pair<TileKey,TileView>& tv) {
+    if (!resultCache) return tileBox(tv.first, tv.second);
+    if (auto box = knownTileBox(tv.first, generation)) return *box;
+    const TileBox box = tileBox(tv.first, tv.second);
+    rememberTileBox(tv.first, box, generation);
+    return box;
+  };
+  // снап: ближайший edgeSnap среди загруженных тайлов. Тайлы перебираются по удалению
+  // их рамки от точки; дальше найденного расстояния тайлы не смотрим.
+  std::optional<EdgeSnap> sSnap, tSnap; int sTile=-1, tTile=-1;
+  auto snapNearest = [&](const Coord& c, std::optional<EdgeSnap>& best, int& bestTile){
+    std::pmr::vector<std::pair<double,int>> cand(arena);
+    cand.reserve(tiles.size());
+    for (int ti = 0; ti < static_cast<int>(tiles.size()); ++ti) {
+      cand.emplace_back(distanceToBox(boxOf(tiles[ti]), c.lat, c.lon), ti);
     }
-  }
-
-  // Построение глобального графа из набора тайлов
-  void buildGlobalGraph(const ProfileSettings& profile,
-                        const std::vector<std::pair<TileKey,TileView>>& tiles,
-                        std::vector<GlobalNode>& nodes,
-                        std::vector<std::vector<GlobalEdge>>& adj,
-                        std::vector<std::vector<std::pair<int,int>>>& revAdj,
-                        std::unordered_map<uint64_t,int>& q2node) {
-    nodes.clear(); adj.clear(); revAdj.clear(); q2node.clear();
-
-    auto nodeIdFor = [&](int32_t lat_q, int32_t lon_q, double lat, double lon) {
-      uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(lat_q))<<32) ^ static_cast<uint64_t>(static_cast<uint32_t>(lon_q));
-      auto it = q2node.find(key);
-      if (it!=q2node.end()) return it->second;
-      int id = static_cast<int>(nodes.size());
-      nodes.push_back(GlobalNode{lat,lon});
-      adj.emplace_back();
-      revAdj.emplace_back();
-      q2node.emplace(key,id);
-      return id;
-    };
-
-    for (auto& tv : tiles) {
-      const auto& tref = tv.first; const auto& view = tv.second;
-      int N = view.nodeCount(); int E = view.edgeCount();
-      // предварительно создать все ноды
-      std::vector<int> local2global(N, -1);
-      for (int i=0;i<N;++i) {
-        local2global[i] = nodeIdFor(view.nodeLatQ(i), view.nodeLonQ(i), view.nodeLat(i), view.nodeLon(i));
-      }
-      // добавить рёбра
-      for (int ei=0; ei<E; ++ei) {
-        const auto* e = view.edgeAt(static_cast<uint32_t>(ei));
-        if (!edgeAllowed(e, profile, static_cast<int>(e->from_node()))) continue;
-        double w = edgeTraversalTimeSec(e, profile);
-        if (!std::isfinite(w)) continue;
-        int u = local2global[static_cast<int>(e->from_node())];
-        int v = local2global[static_cast<int>(e->to_node())];
-        adj[u].push_back(GlobalEdge{v, w, 0u, static_cast<uint32_t>(tref.x), static_cast<uint32_t>(tref.y), static_cast<uint32_t>(ei)});
-        revAdj[v].push_back({u, static_cast<int>(adj[u].size()-1)});
-        // если не oneway — добавить обратное ребро
-        if (!e->oneway()) {
-          // обратный проход допустим только если профилю разрешено
-          if (edgeAllowed(e, profile, static_cast<int>(e->to_node()))) {
-            adj[v].push_back(GlobalEdge{u, w, 0u, static_cast<uint32_t>(tref.x), static_cast<uint32_t>(tref.y), static_cast<uint32_t>(ei)});
-            revAdj[u].push_back({v, static_cast<int>(adj[v].size()-1)});
-          }
-        }
-      }
+    std::sort(cand.begin(), cand.end());
+    double bestD = std::numeric_limits<double>::infinity();
+    for (const auto& [boxD, ti] : cand) {
+      if (boxD > bestD) break;
+      ensureGeometry(tiles[ti]);
+      auto s=snapToEdge(tiles[ti].second,c.lat,c.lon, profile, arena);
+      if (s && (s->dist_m<bestD || (s->dist_m==bestD && ti<bestTile))) { best=s; bestD=s->dist_m; bestTile=ti; }
     }
-  }
+  };
 
-  // bi-A* по глобальному графу
-bool astarGlobalBi(const std::vector<GlobalNode>& nodes,
-                     const std::vector<std::vector<GlobalEdge>>& adj,
-                     const std::vector<std::vector<std::pair<int,int>>>& revAdj,
-                     int s, int t,
-                     std::vector<int>& meetPath, std::vector<uint64_t>& usedEdgeIds) {
-    struct L { double g{std::numeric_limits<double>::infinity()}; int prev{-1}; int prevEdge{-1}; };
-    struct Q { int v; double f; }; struct C { bool operator()(const Q&a,const Q&b)const{return a.f>b.f;}};
-    std::vector<L> F(nodes.size()), B(nodes.size());
-    std::priority_queue<Q,std::vector<Q>,C> pqF, pqB;
-    auto hF=[&](int v){ return haversine(nodes[v].lat,nodes[v].lon,nodes[t].lat,nodes[t].lon)/13.9; };
-    auto hB=[&](int v){ return haversine(nodes[v].lat,nodes[v].lon,nodes[s].lat,nodes[s].lon)/13.9; };
-    F[s].g=0.0; B[t].g=0.0; pqF.push({s,hF(s)}); pqB.push({t,hB(t)});
-    double bestMu = std::numeric_limits<double>::infinity(); int meet=-1;
-    while(!pqF.empty() || !pqB.empty()){
-      if(!pqF.empty()){
-        auto q=pqF.top(); pqF.pop();
-        if (F[q.v].g + hF(q.v) > bestMu) break;
-        for(size_t i=0;i<adj[q.v].size();++i){ const auto& e=adj[q.v][i]; double cand=F[q.v].g+e.w; if(cand<F[e.to].g){ F[e.to].g=cand; F[e.to].prev=q.v; F[e.to].prevEdge=static_cast<int>(i); pqF.push({e.to, cand + hF(e.to)}); if (B[e.to].g< std::numeric_limits<double>::infinity()){ double mu=cand+B[e.to].g; if(mu<bestMu){ bestMu=mu; meet=e.to; } } } }
-      }
-      if(!pqB.empty()){
-        auto q=pqB.top(); pqB.pop();
-        if (B[q.v].g + hB(q.v) > bestMu) break;
-        for(const auto& re : revAdj[q.v]){ int from=re.first; int idx=re.second; const auto& e=adj[from][static_cast<size_t>(idx)]; double cand=B[q.v].g + e.w; if(cand<B[from].g){ B[from].g=cand; B[from].prev=q.v; B[from].prevEdge=idx; pqB.push({from, cand + hB(from)}); if (F[from].g< std::numeric_limits<double>::infinity()){ double mu=cand+F[from].g; if(mu<bestMu){ bestMu=mu; meet=from; } } } }
-      }
+  // Тайл-локальная работа (чтение блоба, TileView, узлы и рёбра профиля) идёт в пуле
+  // graphThreads, если он есть; склейка в общий граф — в потоке запроса по порядку trefs.
+  struct LoadedTile {
+    std::optional<TileView> view;
+    std::optional<TileGraphPart> part;
+    TileLoadStats io;
+    double ioMs {0.0}, prepareMs {0.0};
+  };
+  std::pmr::vector<LoadedTile> loaded(trefs.size(), arena);
+  // задачи пула не трогают арену (она однопоточная)
+  std::pmr::memory_resource* partResource = graphPool ? std::pmr::get_default_resource() : arena;
+  auto prepareTile = [&](size_t i) {
+    LoadedTile& l = loaded[i];
+    const TileKey& tr = trefs[i];
+    std::shared_ptr<TileBlob> b;
+    if (fetched[i]) {
+      b = std::move(blobs[i]);
+    } else {
+      typename QueryStats<kStats>::Lap lap("tile_io");
+      b = store.load(tr.z, tr.x, tr.y, kStats ? &l.io : nullptr);
+      l.ioMs = lap.stop();
     }
-    if (meet<0) return false;
-    // Восстановление пути F: s->meet, B: meet->t
-    std::vector<std::pair<int,int>> seq; // (u, edgeIdxInAdj)
-    for(int v=meet; v!=s; v=F[v].prev){ int u=F[v].prev; seq.emplace_back(u, F[v].prevEdge); }
-    std::reverse(seq.begin(), seq.end());
-    for(int v=meet; v!=t; v=B[v].prev){ int u=v; int idx=B[u].prevEdge; seq.emplace_back(u, idx); // edge u->B[u].prev
+    // тайл без рёбер: рамка пустая, привязка до загрузки коридора его не читает
+    auto skip = [&] { if (resultCache) rememberTileBox(tr, kEmptyTileBox, generation); };
+    if (!b) return skip();
+    TileView v(b, b->data, b->size, b->inIndex, b->schemaVersion);
+    if (!usableTile(v)) return skip();
+    typename QueryStats<kStats>::Lap lap("graph_build");
+    prepareTileGraph(profile, v, l.part.emplace(partResource));
+    l.view.emplace(std::move(v));
+    l.prepareMs = lap.stop();
+  };
+  auto stitchTile = [&](size_t i) {
+    LoadedTile& l = loaded[i];
+    stats.addTileStats(l.io);
+    stats.add(&RouteStats::tile_io_ms, l.ioMs);
+    stats.add(&RouteStats::graph_build_ms, l.prepareMs);
+    if (!l.view) return;
+    tiles.emplace_back(trefs[i], std::move(*l.view));
+    typename QueryStats<kStats>::Phase phase(stats, &RouteStats::graph_build_ms, "graph_stitch");
+    stitchTileGraph(trefs[i], *l.part, nodes, adj, revAdj, q2node);
+    l.part.reset();
+  };
+  if (graphPool) {
+    graphPool->orderedFor(trefs.size(), prepareTile, stitchTile);
+  } else {
+    for (size_t i = 0; i < trefs.size(); ++i) {
+      prepareTile(i);
+      stitchTile(i);
     }
-    usedEdgeIds.clear(); uint64_t lastE=std::numeric_limits<uint64_t>::max();
-    for(auto& p: seq){ int u=p.first; int idx=p.second; if (idx<0) continue; const auto& ge=adj[u][static_cast<size_t>(idx)]; uint64_t id=makeEdgeId(tileZoom, ge.tileX, ge.tileY, ge.edgeIdx); if(id!=lastE){ usedEdgeIds.push_back(id); lastE=id; } }
-    // meetPath возвращать не обязательно для polyline, но заполним
-    meetPath.clear(); meetPath.push_back(s); meetPath.push_back(meet); meetPath.push_back(t);
-    return true;
   }
-
-}; // Impl
-
-Router::Router(const std::string& db_path, RouterOptions opt)
-  : impl_(std::make_unique<Impl>(db_path, opt)) {}
-
-Router::~Router() = default;
-
-RouteResult Router::route(const ProfileSettings& profile, const std::vector<Coord>& waypoints) {
-  RouteResult rr;
-  if (waypoints.size() < 2) {
-    rr.status = RouteStatus::INTERNAL_ERROR;
-    rr.error_message = "need at least 2 waypoints";
-    return rr;
+  if (tiles.empty()) { rr.status = RouteStatus::NO_TILE; rr.error_message = "no tiles in range"; return rr; }
+  {
+    typename QueryStats<kStats>::Phase phase(stats, &RouteStats::snap_ms, "snap");
+    snapNearest(waypoints.front(), sSnap, sTile);
+    snapNearest(waypoints.back(), tSnap, tTile);
   }
+  if (!sSnap || !tSnap) { rr.status=RouteStatus::NO_ROUTE; rr.error_message="failed to snap (multi-tile)"; return rr; }
 
-  // Мультитайловая версия v1: прямоугольник тайлов + динамическая рамка по расстоянию
-  double dist_m_straight = Impl::haversine(waypoints.front().lat, waypoints.front().lon,
-                                           waypoints.back().lat,  waypoints.back().lon);
-  double dist_km = dist_m_straight / 1000.0;
-  // Эвристика: размер тайла ~4 км на экваторе; возьмём запас +1 и лимит сверху
-  int dyn_frame = static_cast<int>(std::ceil(dist_km / 4.0)) + 1;
-  if (dyn_frame < 1) dyn_frame = 1;
-  if (dyn_frame > 8) dyn_frame = 8;
-  std::vector<TileKey> trefs; impl_->collectTileRange(waypoints.front(), waypoints.back(), dyn_frame, trefs);
-  std::vector<std::pair<TileKey,TileView>> tiles;
-  tiles.reserve(trefs.size());
-  for (auto& tr : trefs) {
-    auto b = impl_->store.load(tr.z, tr.x, tr.y);
-    if (!b) continue;
-    TileView v(b->buffer);
-    if (!v.valid() || v.edgeCount()==0 || v.nodeCount()<2) continue;
-    tiles.emplace_back(tr, std::move(v));
+  if (resultCache && !keyed) {
+    // рамки тайлов ещё не были известны: ключ — по привязке на собранном графе
+    snapKey(tiles[sTile], *sSnap, waypoints.front(), cacheKey.startEdge, cacheKey.startPos, cacheKey.startT);
+    snapKey(tiles[tTile], *tSnap, waypoints.back(), cacheKey.endEdge, cacheKey.endPos, cacheKey.endT);
+    if (auto hit = resultCache->find(cacheKey, generation)) {
+      resultCache->alias(wpKey, cacheKey, generation);
+      return fromCache(std::move(*hit));
+    }
   }
-  if (tiles.empty()) { rr.status = RouteStatus::NO_TILE; rr.error_message = "no tiles in range"; return rr; }
-
-  std::vector<Impl::GlobalNode> nodes; std::vector<std::vector<Impl::GlobalEdge>> adj; std::vector<std::vector<std::pair<int,int>>> revAdj; std::unordered_map<uint64_t,int> q2node;
-  impl_->buildGlobalGraph(profile, tiles, nodes, adj, revAdj, q2node);
-
-  // снап по всем тайлам: просто выберем ближайший edgeSnap среди tiles[0..]
-  auto bestSnap = [&](const Coord& c){
-    std::optional<Impl::EdgeSnap> best; double bestD=std::numeric_limits<double>::infinity(); int bestTile=-1;
-    for (int i=0;i<(int)tiles.size();++i){ auto s=Impl::snapToEdge(tiles[i].second,c.lat,c.lon, profile); if(!s) continue; if(s->dist_m<bestD){ best= s; bestD=s->dist_m; bestTile=i; } }
-    return std::tuple{best, bestTile}; };
-
-  auto [sSnap, sTile] = bestSnap(waypoints.front());
-  auto [tSnap, tTile] = bestSnap(waypoints.back());
-  if (!sSnap || !tSnap) { rr.status=RouteStatus::NO_ROUTE; rr.error_message="failed to snap (multi-tile)"; return rr; }
+  stats.graph(nodes, adj);
 
   // глобальные узлы для старта/финиша — привяжем к ближайшим реальным узлам (from/to соответствующих рёбер)
   auto& sView = tiles[sTile].second; auto& tView = tiles[tTile].second;
@@ -652,84 +307,136 @@ RouteResult Router::route(const ProfileSettings& profile, const std::vector<Coor
   int tTo   = q2node[(static_cast<uint64_t>(static_cast<uint32_t>(tView.nodeLatQ(tSnap->toNode)))<<32) ^ static_cast<uint64_t>(static_cast<uint32_t>(tView.nodeLonQ(tSnap->toNode)))];
 
   // выберем стартовый и конечный глобальные узлы как ближайшие из пары (from/to) по геометрии
-  auto pickClosest = [&](int a, int b, const Coord& c){ double da=Impl::haversine(nodes[a].lat,nodes[a].lon,c.lat,c.lon); double db=Impl::haversine(nodes[b].lat,nodes[b].lon,c.lat,c.lon); return (da<=db)?a:b; };
+  auto pickClosest = [&](int a, int b, const Coord& c){ double da=haversine(nodes[a].lat,nodes[a].lon,c.lat,c.lon); double db=haversine(nodes[b].lat,nodes[b].lon,c.lat,c.lon); return (da<=db)?a:b; };
   int sNode = pickClosest(sFrom, sTo, waypoints.front());
   int tNode = pickClosest(tFrom, tTo, waypoints.back());
 
   std::vector<int> gpath; std::vector<uint64_t> eids;
   // Добавим виртуальные узлы vS,vE и полу-рёбра до ближайших узлов snapped-ребёр с учётом oneway
   int vS = static_cast<int>(nodes.size());
-  nodes.push_back(Impl::GlobalNode{sSnap->projLat, sSnap->projLon});
+  nodes.push_back(GlobalNode{sSnap->projLat, sSnap->projLon});
   adj.emplace_back();
   int vE = static_cast<int>(nodes.size());
-  nodes.push_back(Impl::GlobalNode{tSnap->projLat, tSnap->projLon});
+  nodes.push_back(GlobalNode{tSnap->projLat, tSnap->projLon});
   adj.emplace_back();
+  revAdj.resize(nodes.size());
+  // виртуальное полу-ребро: в adj и зеркально в revAdj (иначе обратный фронт их не видит)
+  auto addVirt = [&](int u, int v, double w){
+    adj[u].push_back(GlobalEdge{v, w, 1u, 0,0,0});
+    revAdj[v].emplace_back(u, static_cast<int>(adj[u].size()) - 1);
+  };
 
-  auto addVS = [&](const TileView& view, const Impl::EdgeSnap& snap){
-    const auto* e = view.edgeAt(snap.edgeIdx);
-    double speed = profile.speeds_mps[static_cast<int>(e->road_class())];
+  auto addVS = [&](const TileView& view, const EdgeSnap& snap){
+    const auto e = view.edgeAt(snap.edgeIdx);
+    double speed = profile.speeds_mps[static_cast<int>(e.road_class())];
     if (speed<=0.0) return;
-    double w = e->length_m()/speed;
-    double t = std::clamp(snap.t, 0.0, 1.0);
+    double w = e.length_m()/speed;
+    double t = std::clamp(snap.edgeFrac, 0.0, 1.0);  // доля ребра, не сегмента snap.segIndex
     // fromNode -> vS (доля t)
-    if (!e->oneway()) {
-      adj[sNode].push_back(Impl::GlobalEdge{vS, t*w, 1u, 0,0,0});
+    if (!e.oneway()) {
+      addVirt(sNode, vS, t*w);
     } else {
       // oneway: допускаем вход в vS только если направление from->to
       uint64_t kFrom = (static_cast<uint64_t>(static_cast<uint32_t>(view.nodeLatQ(snap.fromNode)))<<32) ^ static_cast<uint64_t>(static_cast<uint32_t>(view.nodeLonQ(snap.fromNode)));
       int fromGlobal = q2node[kFrom];
-      if (fromGlobal==sNode) adj[sNode].push_back(Impl::GlobalEdge{vS, t*w, 1u, 0,0,0});
+      if (fromGlobal==sNode) addVirt(sNode, vS, t*w);
     }
     // vS -> toNode (доля 1-t) всегда по направлению ребра
     uint64_t kTo = (static_cast<uint64_t>(static_cast<uint32_t>(view.nodeLatQ(snap.toNode)))<<32) ^ static_cast<uint64_t>(static_cast<uint32_t>(view.nodeLonQ(snap.toNode)));
     int toGlobal = q2node[kTo];
-    adj[vS].push_back(Impl::GlobalEdge{toGlobal, (1.0-t)*w, 1u, 0,0,0});
+    addVirt(vS, toGlobal, (1.0-t)*w);
     // если не oneway — позволяем обратный ход vS->fromNode
-    if (!e->oneway()) {
+    if (!e.oneway()) {
       uint64_t kFrom2 = (static_cast<uint64_t>(static_cast<uint32_t>(view.nodeLatQ(snap.fromNode)))<<32) ^ static_cast<uint64_t>(static_cast<uint32_t>(view.nodeLonQ(snap.fromNode)));
       int fromGlobal = q2node[kFrom2];
-      adj[vS].push_back(Impl::GlobalEdge{fromGlobal, t*w, 1u, 0,0,0});
+      addVirt(vS, fromGlobal, t*w);
     }
   };
 
-  auto addVE = [&](const TileView& view, const Impl::EdgeSnap& snap){
-    const auto* e = view.edgeAt(snap.edgeIdx);
-    double speed = profile.speeds_mps[static_cast<int>(e->road_class())];
+  auto addVE = [&](const TileView& view, const EdgeSnap& snap){
+    const auto e = view.edgeAt(snap.edgeIdx);
+    double speed = profile.speeds_mps[static_cast<int>(e.road_class())];
     if (speed<=0.0) return;
-    double w = e->length_m()/speed;
-    double t = std::clamp(snap.t, 0.0, 1.0);
+    double w = e.length_m()/speed;
+    double t = std::clamp(snap.edgeFrac, 0.0, 1.0);  // доля ребра, не сегмента snap.segIndex
     // fromNode -> vE (доля t) по направлению ребра
     uint64_t kFrom3 = (static_cast<uint64_t>(static_cast<uint32_t>(view.nodeLatQ(snap.fromNode)))<<32) ^ static_cast<uint64_t>(static_cast<uint32_t>(view.nodeLonQ(snap.fromNode)));
     int fromGlobal = q2node[kFrom3];
-    adj[fromGlobal].push_back(Impl::GlobalEdge{vE, t*w, 1u, 0,0,0});
+    addVirt(fromGlobal, vE, t*w);
     // если не oneway — toNode -> vE (доля 1-t)
-    if (!e->oneway()) {
+    if (!e.oneway()) {
       uint64_t kTo2 = (static_cast<uint64_t>(static_cast<uint32_t>(view.nodeLatQ(snap.toNode)))<<32) ^ static_cast<uint64_t>(static_cast<uint32_t>(view.nodeLonQ(snap.toNode)));
       int toGlobal = q2node[kTo2];
-      adj[toGlobal].push_back(Impl::GlobalEdge{vE, (1.0-t)*w, 1u, 0,0,0});
+      addVirt(toGlobal, vE, (1.0-t)*w);
     }
   };
 
   addVS(sView, *sSnap);
   addVE(tView, *tSnap);
 
-  if (!impl_->astarGlobalBi(nodes, adj, revAdj, vS, vE, gpath, eids)) { rr.status=RouteStatus::NO_ROUTE; rr.error_message="no path in multi-tile"; return rr; }
+  bool found;
+  {
+    typename QueryStats<kStats>::Phase phase(stats, &RouteStats::search_ms, "search");
+    found = parallelSearchMinNodes > 0 && nodes.size() >= parallelSearchMinNodes
+              ? astarGlobalBiParallel(nodes, adj, revAdj, vS, vE, gpath, eids, stats)
+              : astarGlobalBi(nodes, adj, revAdj, vS, vE, gpath, eids, stats);
+  }
+  // построенные за запрос индексы входящих рёбер оставляем в кэше тайлов (в его бюджете)
+  for (const auto& [key, view] : tiles) {
+    if (view.inIndex()) store.attachInIndex(key, view.inIndex());
+  }
+  if (!found) {
+    rr.status=RouteStatus::NO_ROUTE; rr.error_message="no path in multi-tile";
+    if (resultCache) resultCache->insert(wpKey, cacheKey, rr, generation);
+    return rr;
+  }
 
-  // собрать polyline по edgeIds
+  // собрать polyline: полуребро снапа старта, рёбра edgeIds, полуребро снапа финиша
+  typename QueryStats<kStats>::Phase assemblePhase(stats, &RouteStats::assemble_ms, "assemble");
   rr.polyline.clear(); rr.edge_ids = eids; rr.distance_m=0; rr.duration_s=0;
-  auto appendPoint=[&](double la,double lo){ if(!rr.polyline.empty()){ auto& L=rr.polyline.back(); rr.distance_m+=Impl::haversine(L.lat,L.lon,la,lo);} rr.polyline.push_back(Coord{la,lo}); };
+  auto appendPoint=[&](double la,double lo){ if(!rr.polyline.empty()){ auto& L=rr.polyline.back(); rr.distance_m+=haversine(L.lat,L.lon,la,lo);} rr.polyline.push_back(Coord{la,lo}); };
+  std::pmr::vector<std::pair<double,double>> pts(arena);
+  // Полуребро снапа между проекцией и узлом пути node (соседом vS или vE в gpath): вес —
+  // доля edgeFrac ребра, как у виртуального ребра в поиске; точки — часть формы ребра.
+  auto appendSnapPart = [&](std::pair<TileKey,TileView>& tv, const EdgeSnap& snap, int toGlobal, int node, bool atStart){
+    ensureGeometry(tv);
+    const TileView& view = tv.second;
+    const bool towardTo = node == toGlobal;
+    const double f = std::clamp(snap.edgeFrac, 0.0, 1.0);
+    rr.duration_s += (towardTo ? 1.0 - f : f) * edgeTraversalTimeSec(view.edgeAt(snap.edgeIdx), profile);
+    pts.clear();
+    view.appendEdgeShape(snap.edgeIdx, pts, /*skipFirst*/false);
+    // точки от проекции к узлу: вперёд после сегмента снапа или назад до его начала
+    const int n = static_cast<int>(pts.size());
+    const int first = towardTo ? std::min(snap.segIndex + 1, n - 1) : std::max(snap.segIndex, 0);
+    const int last = towardTo ? n - 1 : 0;
+    const int step = towardTo ? 1 : -1;
+    if (atStart) {
+      appendPoint(snap.projLat, snap.projLon);
+      for (int k = first; k != last + step; k += step) appendPoint(pts[k].first, pts[k].second);
+    } else {
+      // узел уже в polyline: им закончилось предыдущее ребро
+      for (int k = last - (rr.polyline.empty() ? 0 : step); k != first - step; k -= step) appendPoint(pts[k].first, pts[k].second);
+      appendPoint(snap.projLat, snap.projLon);
+    }
+  };
+  appendSnapPart(tiles[sTile], *sSnap, sTo, gpath[1], /*atStart*/true);
   for (auto id : eids){
-    int z; uint32_t x,y,ei; Impl::parseEdgeId(id, z, x, y, ei);
+    int z; uint32_t x,y,ei; parseEdgeId(id, z, x, y, ei);
     // найдём view по (x,y)
     TileView const* vptr=nullptr;
-    for (auto& pr: tiles){ if (pr.first.x==(int)x && pr.first.y==(int)y){ vptr=&pr.second; break; } }
+    for (auto& pr: tiles){ if (pr.first.x==(int)x && pr.first.y==(int)y){ ensureGeometry(pr); vptr=&pr.second; break; } }
     if (!vptr) continue;
-    std::vector<std::pair<double,double>> pts;
+    pts.clear();
     vptr->appendEdgeShape(static_cast<uint32_t>(ei), pts, /*skipFirst*/!rr.polyline.empty());
     for (auto& p:pts) appendPoint(p.first,p.second);
-    rr.duration_s += Impl::edgeTraversalTimeSec(vptr->edgeAt(static_cast<uint32_t>(ei)), profile);
+    rr.duration_s += edgeTraversalTimeSec(vptr->edgeAt(static_cast<uint32_t>(ei)), profile);
   }
+  appendSnapPart(tiles[tTile], *tSnap, tTo, gpath[gpath.size() - 2], /*atStart*/false);
   rr.status = RouteStatus::OK;
+  if (resultCache) resultCache->insert(wpKey, cacheKey, rr, generation);
+  // distance_m уже посчитан по полной геометрии — дальше её можно упростить/закодировать
+  applyRouteOutput(rr, output);
   return rr;
 }
 
@@ -0,0 +1,697 @@
+#pragma once
+
+// Внутреннее устройство Router (не публичный API).
+// Вынесено в отдельный заголовок, чтобы примитивы поиска были доступны бенчмаркам.
+
+#include "routing_core/router.h"
+#include "routing_core/tile_store.h"
+
+#include <flatbuffers/flatbuffers.h>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <queue>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <map>
+
+#include "land_tile_generated.h"
+#include "routing_core/tile_view.h"
+#include "routing_core/tiler.h"
+#include "routing_core/edge_id.h"
+#include "routing_core/flat_hash_map.h"
+#include "routing_core/profile.h"
+#include "routing_core/trace.h"
+#include "query_arena.h"
+#include "route_cache.h"
+#include "task_pool.h"
+#include "tile_prefetcher.h"
+
+namespace routing_core {
+
+// --- сбор статистики запроса (RouterOptions::collectStats) ---
+// QueryStats<false> — пустышка: все методы пустые, инстанцирование без статистики
+// не содержит ни таймеров, ни счётчиков.
+template <bool Enabled>
+struct QueryStats {
+  // Фаза запроса: без статистики — только спан трассировки.
+  struct Phase {
+    trace::Span span;
+    Phase(QueryStats&, double RouteStats::*, const char* name) : span("route", name) {}
+    void stop() { span.end(); }
+  };
+  // Замер вне потока запроса (задачи пула): время возвращается, в RouteStats кладёт add().
+  struct Lap {
+    trace::Span span;
+    explicit Lap(const char* name) : span("route", name) {}
+    double stop() { span.end(); return 0.0; }
+  };
+  void add(double RouteStats::*, double) {}
+  TileLoadStats* tileStats() { return nullptr; }
+  void addTileStats(const TileLoadStats&) {}
+  TileLoadStats* geometryStats() { return nullptr; }
+  template <class N, class A> void graph(const N&, const A&) {}
+  void cacheHit() {}
+  void push(bool /*forward*/) {}
+  void pop(bool /*forward*/, bool /*settled*/) {}
+};
+
+template <>
+struct QueryStats<true> {
+  using clock = std::chrono::steady_clock;
+
+  // Таймер фазы: добавляет прошедшее время в поле RouteStats при stop()/разрушении.
+  struct Phase {
+    QueryStats& q;
+    double RouteStats::* field;
+    trace::Span span;
+    clock::time_point t0;
+    bool running {true};
+    Phase(QueryStats& qs, double RouteStats::* f, const char* name)
+      : q(qs), field(f), span("route", name), t0(clock::now()) {}
+    ~Phase() { stop(); }
+    void stop() {
+      if (!running) return;
+      running = false;
+      span.end();
+      q.s.*field += std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+    }
+  };
+
+  struct Lap {
+    trace::Span span;
+    clock::time_point t0;
+    explicit Lap(const char* name) : span("route", name), t0(clock::now()) {}
+    double stop() {
+      span.end();
+      return std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+    }
+  };
+
+  RouteStats s;
+  TileLoadStats tiles;
+  TileLoadStats geometry;
+  clock::time_point started {clock::now()};
+
+  void add(double RouteStats::* field, double ms) { s.*field += ms; }
+  TileLoadStats* tileStats() { return &tiles; }
+  void addTileStats(const TileLoadStats& t) {
+    tiles.requested += t.requested;
+    tiles.hits += t.hits;
+    tiles.misses += t.misses;
+    tiles.bytesRead += t.bytesRead;
+  }
+  TileLoadStats* geometryStats() { return &geometry; }
+  template <class N, class A> void graph(const N& nodes, const A& adj) {
+    s.graph_nodes = static_cast<uint32_t>(nodes.size());
+    s.graph_edges = 0;
+    for (const auto& out : adj) s.graph_edges += out.size();
+  }
+  void cacheHit() { s.result_cache_hit = true; }
+  void push(bool forward) { ++(forward ? s.forward : s.backward).heap_pushes; }
+  void pop(bool forward, bool settled) {
+    auto& d = forward ? s.forward : s.backward;
+    ++d.heap_pops;
+    if (settled) ++d.settled;
+  }
+  void attach(RouteResult& rr) {
+    s.tiles_requested = tiles.requested;
+    s.tiles_hit = tiles.hits;
+    s.tiles_missed = tiles.misses;
+    s.bytes_read = tiles.bytesRead;
+    s.geometry_tiles = geometry.requested;
+    s.geometry_bytes_read = geometry.bytesRead;
+    s.total_ms = std::chrono::duration<double, std::milli>(clock::now() - started).count();
+    rr.stats = s;
+  }
+};
+
+struct Router::Impl {
+  TileStore store;
+  int tileZoom;
+  bool collectStats;
+  size_t parallelSearchMinNodes;
+  std::unique_ptr<TilePrefetcher> prefetcher; // после store: останавливается раньше него
+  std::unique_ptr<RouteResultCache> resultCache;
+  std::unique_ptr<TaskPool> graphPool;  // загрузка и подготовка тайлов запроса (graphThreads)
+  std::unique_ptr<TaskPool> searchPool; // второе направление параллельного bi-A*, если нет graphPool
+  QueryArenaPool arenas;                // буферы арен временных структур запроса
+
+  explicit Impl(const std::string& db, const RouterOptions& opt)
+    : store(db, opt.tileCacheCapacity, opt.tileCacheBytes), tileZoom(opt.tileZoom), collectStats(opt.collectStats),
+      parallelSearchMinNodes(opt.parallelSearchMinNodes), arenas(opt.queryArenaBytes) {
+    store.setZoom(tileZoom);
+    store.setChecksumVerification(opt.verifyTileChecksums);
+    // без кэша подгруженное некуда положить
+    if (opt.prefetchThreads > 0 && opt.tileCacheCapacity > 0) {
+      prefetcher = std::make_unique<TilePrefetcher>(store, opt.prefetchThreads);
+    }
+    if (opt.resultCacheEntries > 0) resultCache = std::make_unique<RouteResultCache>(opt.resultCacheEntries);
+    if (opt.graphThreads > 0) graphPool = std::make_unique<TaskPool>(opt.graphThreads);
+    if (opt.parallelSearchMinNodes > 0 && !graphPool) searchPool = std::make_unique<TaskPool>(1);
+    // без io_uring пакет не включаем: холодные тайлы читает префетчер, своего пула pread нет
+    if (opt.batchTileReads) store.enableIoUringBatchReads();
+  }
+
+  // Сборщик статистики запроса (см. QueryStats ниже по namespace).
+  template <bool Enabled> using QueryStats = routing_core::QueryStats<Enabled>;
+
+  // Мультитайловый маршрут (тело Router::route), инстанцируется со статистикой и без.
+  template <bool kStats>
+  RouteResult routeMulti(const ProfileSettings& profile,
+                         const std::vector<Coord>& waypoints,
+                         const RouteOutputOptions& output,
+                         QueryStats<kStats>& stats);
+
+  // --- геодезия ---
+  static double haversine(double lat1, double lon1, double lat2, double lon2) {
+    constexpr double R = 6371000.0;
+    const double p1 = lat1 * M_PI/180.0;
+    const double p2 = lat2 * M_PI/180.0;
+    const double dphi = (lat2 - lat1) * M_PI/180.0;
+    const double dl = (lon2 - lon1) * M_PI/180.0;
+    const double a = std::sin(dphi/2)*std::sin(dphi/2) + std::cos(p1)*std::cos(p2)*std::sin(dl/2)*std::sin(dl/2);
+    const double c = 2 * std::atan2(std::sqrt(a), std::sqrt(1-a));
+    return R * c;
+  }
+
+  // --- упаковка/распаковка edge_id: 64 бита = [z:8][x:20][y:20][ei:16]
+  static uint64_t makeEdgeId(int z, uint32_t x, uint32_t y, uint32_t edgeIdx) { return edgeid::make(z,x,y,edgeIdx); }
+  static void parseEdgeId(uint64_t id, int& z, uint32_t& x, uint32_t& y, uint32_t& edgeIdx) { edgeid::parse(id,z,x,y,edgeIdx); }
+
+  // --- снап к ребру ---
+  struct EdgeSnap {
+    uint32_t edgeIdx{0};
+    int fromNode{-1};
+    int toNode{-1};
+    int segIndex{-1};           // индекс сегмента внутри формы (если форма есть)
+    double t{0.0};              // параметр проекции на сегмент [0..1]
+    double edgeFrac{0.0};       // доля длины ребра от from_node до проекции [0..1] (веса полурёбер)
+    double projLat{0.0};
+    double projLon{0.0};
+    double dist_m{std::numeric_limits<double>::infinity()};
+  };
+
+  static void projectPointToSegment(double ax, double ay, double bx, double by,
+                                    double px, double py, double& outX, double& outY, double& t) {
+    // проекция в евклидовой метрике; для малых сегментов ок
+    const double vx = bx - ax, vy = by - ay;
+    const double wx = px - ax, wy = py - ay;
+    double c1 = vx*wx + vy*wy;
+    double c2 = vx*vx + vy*vy;
+    t = (c2 <= 1e-12) ? 0.0 : std::max(0.0, std::min(1.0, c1 / c2));
+    outX = ax + t*vx;
+    outY = ay + t*vy;
+  }
+
+  static std::optional<EdgeSnap> snapToEdge(const TileView& view, double lat, double lon, const ProfileSettings& profile,
+                                            std::pmr::memory_resource* mr = std::pmr::get_default_resource()) {
+    if (!view.valid() || view.edgeCount() == 0) return std::nullopt;
+    EdgeSnap best;
+    bool has = false;
+
+    std::pmr::vector<std::pair<double,double>> tmp(mr);
+    tmp.reserve(64);
+
+    for (int ei = 0; ei < view.edgeCount(); ++ei) {
+      tmp.clear();
+      const auto e = view.edgeAt(static_cast<uint32_t>(ei));
+      // профильная доступность: должна быть скорость > 0 и доступен профиль
+      auto rc = static_cast<int>(e.road_class());
+      double sp = profile.speeds_mps[rc];
+      bool allowed = (profile.access_mask & e.access_mask()) != 0;
+      if (!allowed || sp <= 0.0) continue;
+      view.appendEdgeShape(static_cast<uint32_t>(ei), tmp, /*skipFirst*/false);
+      if (tmp.size() < 2) continue;
+      bool improved = false;
+      for (int k = 0; k+1 < static_cast<int>(tmp.size()); ++k) {
+        // Работать в плоскости (lon=x, lat=y), затем обратно
+        double projLon, projLat, t;
+        projectPointToSegment(
+          /*ax=*/tmp[k].second,      /*ay=*/tmp[k].first,
+          /*bx=*/tmp[k+1].second,    /*by=*/tmp[k+1].first,
+          /*px=*/lon,                /*py=*/lat,
+          /*outX=*/projLon,          /*outY=*/projLat,
+          t);
+        double d = haversine(lat, lon, projLat, projLon);
+        if (d < best.dist_m) {
+          has = true;
+          best.edgeIdx = static_cast<uint32_t>(ei);
+          best.fromNode = static_cast<int>(e.from_node());
+          best.toNode   = static_cast<int>(e.to_node());
+          best.segIndex = k;
+          best.t = t;
+          best.projLat = projLat;
+          best.projLon = projLon;
+          best.dist_m = d;
+          improved = true;
+        }
+      }
+      // после сжатия цепочек в ребре много сегментов: t — доля сегмента, не ребра
+      if (improved) best.edgeFrac = shapeFraction(tmp, best.segIndex, best.t);
+    }
+    if (!has) return std::nullopt;
+    return best;
+  }
+
+  // Доля длины формы pts от начала до точки с параметром t на сегменте seg.
+  template <class Points>
+  static double shapeFraction(const Points& pts, int seg, double t) {
+    double before = 0.0, total = 0.0, segLen = 0.0;
+    for (int k = 0; k + 1 < static_cast<int>(pts.size()); ++k) {
+      const double len = haversine(pts[k].first, pts[k].second, pts[k + 1].first, pts[k + 1].second);
+      if (k < seg) before += len;
+      if (k == seg) segLen = len;
+      total += len;
+    }
+    if (total <= 0.0) return std::clamp(t, 0.0, 1.0);
+    return std::clamp((before + std::clamp(t, 0.0, 1.0) * segLen) / total, 0.0, 1.0);
+  }
+
+  // Нижняя оценка расстояния от точки до рёбер тайла: до рамки, в которой лежат все формы.
+  // Форма ребра может выходить за рамку тайла и его узлов, но каждая её точка — не дальше
+  // половины длины ребра (по самой форме) от одного из концов. Поэтому рамка — границы
+  // тайла и концы каждого ребра, раздвинутые на половину его длины.
+  struct TileBox { double latMin, lonMin, latMax, lonMax; };
+  // рамка тайла без рёбер: до неё бесконечно далеко
+  static constexpr TileBox kEmptyTileBox {std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(),
+                                          -std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+
+  static double distanceToTileBox(const TileKey& key, const TileView& view, double lat, double lon) {
+    return distanceToBox(tileBox(key, view), lat, lon);
+  }
+
+  static double distanceToBox(const TileBox& box, double lat, double lon) {
+    if (box.latMin > box.latMax) return std::numeric_limits<double>::infinity();
+    return haversine(lat, lon, std::clamp(lat, box.latMin, box.latMax), std::clamp(lon, box.lonMin, box.lonMax));
+  }
+
+  static TileBox tileBox(const TileKey& key, const TileView& view) {
+    constexpr double kMetersPerDegree = 6371000.0 * M_PI / 180.0;
+    double latMin, lonMin, latMax, lonMax;
+    webTileBounds(key.z, key.x, key.y, latMin, lonMin, latMax, lonMax);
+    double maxLen = 0.0;
+    for (int e = 0; e < view.edgeCount(); ++e) maxLen = std::max(maxLen, static_cast<double>(view.edgeAt(static_cast<uint32_t>(e)).length_m()));
+    // градус долготы короче всего на самой дальней от экватора широте, куда достаёт форма
+    const double polarLat = std::min(89.0, std::max(std::abs(latMin), std::abs(latMax)) + maxLen / kMetersPerDegree);
+    const double lonMetersPerDegree = kMetersPerDegree * std::cos(polarLat * M_PI / 180.0);
+    for (int e = 0; e < view.edgeCount(); ++e) {
+      const EdgeRef edge = view.edgeAt(static_cast<uint32_t>(e));
+      const int a = static_cast<int>(edge.from_node()), b = static_cast<int>(edge.to_node());
+      const double half = 0.5 * edge.length_m();
+      const double dLat = half / kMetersPerDegree, dLon = half / lonMetersPerDegree;
+      latMin = std::min(latMin, std::min(view.nodeLat(a), view.nodeLat(b)) - dLat);
+      latMax = std::max(latMax, std::max(view.nodeLat(a), view.nodeLat(b)) + dLat);
+      lonMin = std::min(lonMin, std::min(view.nodeLon(a), view.nodeLon(b)) - dLon);
+      lonMax = std::max(lonMax, std::max(view.nodeLon(a), view.nodeLon(b)) + dLon);
+    }
+    return TileBox{latMin, lonMin, latMax, lonMax};
+  }
+
+  // Рамки тайлов, прочитанных прошлыми запросами этого поколения данных (с кэшем
+  // результатов): по ним привязка концов читает только тайлы, где может лежать ближайшее
+  // ребро, и ключ кэша проверяется до загрузки коридора.
+  std::mutex tileBoxMu;
+  FlatHashMap<TileKey, TileBox, TileKeyHash> tileBoxes;
+  uint64_t tileBoxGeneration {0};
+
+  std::optional<TileBox> knownTileBox(const TileKey& key, uint64_t generation) {
+    std::lock_guard<std::mutex> lock(tileBoxMu);
+    if (generation != tileBoxGeneration) return std::nullopt;
+    auto it = tileBoxes.find(key);
+    if (it == tileBoxes.end()) return std::nullopt;
+    return it->second;
+  }
+  void rememberTileBox(const TileKey& key, const TileBox& box, uint64_t generation) {
+    constexpr size_t kMaxTileBoxes = 1u << 16;
+    std::lock_guard<std::mutex> lock(tileBoxMu);
+    if (generation < tileBoxGeneration) return;
+    if (generation != tileBoxGeneration || tileBoxes.size() >= kMaxTileBoxes) {
+      tileBoxes.clear();
+      tileBoxGeneration = generation;
+    }
+    tileBoxes[key] = box;
+  }
+
+  // --- утилиты доступа/веса ---
+  static bool edgeAllowed(EdgeRef e, const ProfileSettings& profile, int fromNode) {
+    if ((profile.access_mask & e.access_mask()) == 0) return false;
+    bool oneway = e.oneway();
+    if (oneway && fromNode != static_cast<int>(e.from_node())) return false;
+    return true;
+  }
+
+  static double edgeTraversalTimeSec(EdgeRef e, const ProfileSettings& profile) {
+    auto rc = static_cast<int>(e.road_class());
+    double speed = profile.speeds_mps[rc];
+    if (speed <= 0.0) return std::numeric_limits<double>::infinity();
+    return e.length_m() / speed;
+  }
+
+  // ---- Мультитайловый граф (с коннекторами по lat_q/lon_q) ----
+  struct GlobalEdge { int to; double w; uint8_t isVirt; uint32_t tileX, tileY, edgeIdx; };
+  struct GlobalNode { double lat, lon; };
+  // Граф запроса живёт в арене запроса (QueryArenaPool); вложенные векторы берут её
+  // ресурс от внешних. Без явного ресурса — обычная куча (бенчмарки).
+  using GlobalNodes = std::pmr::vector<GlobalNode>;
+  using GlobalAdj = std::pmr::vector<std::pmr::vector<GlobalEdge>>;
+  using GlobalRevAdj = std::pmr::vector<std::pmr::vector<std::pair<int,int>>>;
+  using NodeIndex = FlatHashMap<uint64_t, int, FlatHash<uint64_t>, std::equal_to<uint64_t>,
+                                std::pmr::polymorphic_allocator<std::pair<uint64_t, int>>>;
+
+  // key for quantized coordinate
+  struct QKey { int32_t lat_q; int32_t lon_q; };
+  struct QKeyHash { size_t operator()(const QKey& k) const noexcept { return (static_cast<size_t>(static_cast<uint32_t>(k.lat_q))<<32) ^ static_cast<size_t>(static_cast<uint32_t>(k.lon_q)); } };
+  struct QKeyEq { bool operator()(const QKey& a, const QKey& b) const noexcept { return a.lat_q==b.lat_q && a.lon_q==b.lon_q; } };
+
+  // Сбор прямоугольника тайлов (с рамкой)
+  void collectTileRange(const Coord& a, const Coord& b, int frame,
+                        std::vector<TileKey>& out) {
+    auto ka = webTileKeyFor(a.lat, a.lon, tileZoom);
+    auto kb = webTileKeyFor(b.lat, b.lon, tileZoom);
+    int minx = std::min(ka.x, kb.x) - frame;
+    int maxx = std::max(ka.x, kb.x) + frame;
+    int miny = std::min(ka.y, kb.y) - frame;
+    int maxy = std::max(ka.y, kb.y) + frame;
+    for (int y=miny;y<=maxy;++y) {
+      for (int x=minx;x<=maxx;++x) {
+        out.push_back(TileKey{tileZoom,x,y});
+      }
+    }
+  }
+
+  // Тайлы для маршрута A–B в порядке загрузки.
+  // Мультитайловая версия v1: прямоугольник тайлов + динамическая рамка по расстоянию
+  void planTiles(const Coord& a, const Coord& b, std::vector<TileKey>& trefs,
+                 std::vector<std::pair<TileKey,double>>& order) {
+    double dist_km = haversine(a.lat, a.lon, b.lat, b.lon) / 1000.0;
+    // Эвристика: размер тайла ~4 км на экваторе; возьмём запас +1 и лимит сверху
+    int dyn_frame = static_cast<int>(std::ceil(dist_km / 4.0)) + 1;
+    if (dyn_frame < 1) dyn_frame = 1;
+    if (dyn_frame > 8) dyn_frame = 8;
+    trefs.clear();
+    collectTileRange(a, b, dyn_frame, trefs);
+    prioritizeTiles(a, b, trefs, order);
+  }
+
+  // Порядок загрузки тайлов: сначала тайлы концов маршрута, затем по удалению
+  // центра тайла от отрезка A–B (коридор), в единицах тайлов.
+  void prioritizeTiles(const Coord& a, const Coord& b, std::vector<TileKey>& trefs,
+                       std::vector<std::pair<TileKey,double>>& out) const {
+    double ax, ay, bx, by;
+    webTileXY(a.lat, a.lon, tileZoom, ax, ay);
+    webTileXY(b.lat, b.lon, tileZoom, bx, by);
+    const double dx = bx - ax, dy = by - ay, len2 = dx*dx + dy*dy;
+    out.clear();
+    out.reserve(trefs.size());
+    for (const auto& k : trefs) {
+      const double cx = k.x + 0.5, cy = k.y + 0.5;
+      double t = len2 > 0.0 ? ((cx - ax)*dx + (cy - ay)*dy) / len2 : 0.0;
+      t = std::clamp(t, 0.0, 1.0);
+      const double px = ax + t*dx - cx, py = ay + t*dy - cy;
+      double pr = std::sqrt(px*px + py*py);
+      const bool endpoint = (k.x == static_cast<int>(std::floor(ax)) && k.y == static_cast<int>(std::floor(ay))) ||
+                            (k.x == static_cast<int>(std::floor(bx)) && k.y == static_cast<int>(std::floor(by)));
+      if (endpoint) pr = -1.0;
+      out.emplace_back(k, pr);
+    }
+    std::stable_sort(out.begin(), out.end(), [](const auto& l, const auto& r){ return l.second < r.second; });
+    for (size_t i = 0; i < out.size(); ++i) trefs[i] = out[i].first;
+  }
+
+  // Построение глобального графа из набора тайлов
+  void buildGlobalGraph(const ProfileSettings& profile,
+                        const std::vector<std::pair<TileKey,TileView>>& tiles,
+                        GlobalNodes& nodes,
+                        GlobalAdj& adj,
+                        GlobalRevAdj& revAdj,
+                        NodeIndex& q2node) {
+    nodes.clear(); adj.clear(); revAdj.clear(); q2node.clear();
+    for (auto& tv : tiles) appendTileToGraph(profile, tv.first, tv.second, nodes, adj, revAdj, q2node);
+  }
+
+  // Тайл-локальная часть графа: узлы тайла и допустимые профилем рёбра с весами.
+  // Не трогает общий граф, поэтому готовится в пуле (RouterOptions::graphThreads);
+  // там — в куче, без пула — в арене запроса.
+  struct TileGraphPart {
+    struct Edge { int from, to; double w; uint32_t edgeIdx; };  // from/to — локальные узлы
+    explicit TileGraphPart(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+      : nodeKeys(mr), nodeCoords(mr), edges(mr) {}
+    std::pmr::vector<uint64_t> nodeKeys;     // lat_q<<32 ^ lon_q
+    std::pmr::vector<GlobalNode> nodeCoords;
+    std::pmr::vector<Edge> edges;            // в порядке adj, обратные проходы сразу за прямыми
+  };
+
+  void prepareTileGraph(const ProfileSettings& profile, const TileView& view, TileGraphPart& part) const {
+    const int N = view.nodeCount(); const int E = view.edgeCount();
+    part.nodeKeys.resize(static_cast<size_t>(N));
+    part.nodeCoords.resize(static_cast<size_t>(N));
+    for (int i=0;i<N;++i) {
+      part.nodeKeys[i] = (static_cast<uint64_t>(static_cast<uint32_t>(view.nodeLatQ(i)))<<32) ^ static_cast<uint64_t>(static_cast<uint32_t>(view.nodeLonQ(i)));
+      part.nodeCoords[i] = GlobalNode{view.nodeLat(i), view.nodeLon(i)};
+    }
+    part.edges.clear();
+    part.edges.reserve(static_cast<size_t>(E) * 2);
+    for (int ei=0; ei<E; ++ei) {
+      const auto e = view.edgeAt(static_cast<uint32_t>(ei));
+      if (!edgeAllowed(e, profile, static_cast<int>(e.from_node()))) continue;
+      double w = edgeTraversalTimeSec(e, profile);
+      if (!std::isfinite(w)) continue;
+      const int u = static_cast<int>(e.from_node());
+      const int v = static_cast<int>(e.to_node());
+      part.edges.push_back({u, v, w, static_cast<uint32_t>(ei)});
+      // если не oneway — добавить обратное ребро; обратный проход допустим только если профилю разрешено
+      if (!e.oneway() && edgeAllowed(e, profile, v)) part.edges.push_back({v, u, w, static_cast<uint32_t>(ei)});
+    }
+  }
+
+  // Склейка подготовленного тайла с общим графом (узлы на границах — по lat_q/lon_q).
+  // Последовательная: порядок тайлов задаёт нумерацию узлов.
+  void stitchTileGraph(const TileKey& tref, const TileGraphPart& part,
+                       GlobalNodes& nodes,
+                       GlobalAdj& adj,
+                       GlobalRevAdj& revAdj,
+                       NodeIndex& q2node) const {
+    std::pmr::memory_resource* mr = adj.get_allocator().resource();
+    const size_t n = part.nodeKeys.size();
+    std::pmr::vector<int> local2global(n, -1, mr);
+    // степени узлов тайла: списки смежности выделяются один раз под нужный размер
+    // (в монотонной арене каждый перерост вектора — потерянный блок)
+    std::pmr::vector<uint32_t> outDeg(n, 0u, mr), inDeg(n, 0u, mr);
+    for (const auto& e : part.edges) { ++outDeg[static_cast<size_t>(e.from)]; ++inDeg[static_cast<size_t>(e.to)]; }
+    for (size_t i=0;i<n;++i) {
+      auto [it, inserted] = q2node.try_emplace(part.nodeKeys[i], static_cast<int>(nodes.size()));
+      if (inserted) {
+        nodes.push_back(part.nodeCoords[i]);
+        adj.emplace_back();
+        revAdj.emplace_back();
+      }
+      local2global[i] = it->second;
+      auto& out = adj[static_cast<size_t>(it->second)];
+      auto& in = revAdj[static_cast<size_t>(it->second)];
+      if (outDeg[i]) out.reserve(out.size() + outDeg[i]);
+      if (inDeg[i]) in.reserve(in.size() + inDeg[i]);
+    }
+    for (const auto& e : part.edges) {
+      const int u = local2global[static_cast<size_t>(e.from)];
+      const int v = local2global[static_cast<size_t>(e.to)];
+      adj[u].push_back(GlobalEdge{v, e.w, 0u, static_cast<uint32_t>(tref.x), static_cast<uint32_t>(tref.y), e.edgeIdx});
+      revAdj[v].push_back({u, static_cast<int>(adj[u].size()-1)});
+    }
+  }
+
+  // Добавляет тайл в глобальный граф.
+  void appendTileToGraph(const ProfileSettings& profile,
+                         const TileKey& tref, const TileView& view,
+                         GlobalNodes& nodes,
+                         GlobalAdj& adj,
+                         GlobalRevAdj& revAdj,
+                         NodeIndex& q2node) {
+    TileGraphPart part(adj.get_allocator().resource());
+    prepareTileGraph(profile, view, part);
+    stitchTileGraph(tref, part, nodes, adj, revAdj, q2node);
+  }
+
+  // bi-A* по глобальному графу
+  bool astarGlobalBi(const GlobalNodes& nodes,
+                     const GlobalAdj& adj,
+                     const GlobalRevAdj& revAdj,
+                     int s, int t,
+                     std::vector<int>& meetPath, std::vector<uint64_t>& usedEdgeIds) {
+    QueryStats<false> none;
+    return astarGlobalBi(nodes, adj, revAdj, s, t, meetPath, usedEdgeIds, none);
+  }
+
+  template <bool kStats>
+  bool astarGlobalBi(const GlobalNodes& nodes,
+                     const GlobalAdj& adj,
+                     const GlobalRevAdj& revAdj,
+                     int s, int t,
+                     std::vector<int>& meetPath, std::vector<uint64_t>& usedEdgeIds,
+                     QueryStats<kStats>& stats) {
+    struct L { double g{std::numeric_limits<double>::infinity()}; int prev{-1}; int prevEdge{-1}; };
+    struct Q { int v; double f; }; struct C { bool operator()(const Q&a,const Q&b)const{return a.f>b.f;}};
+    std::pmr::memory_resource* mr = adj.get_allocator().resource();  // арена запроса, если граф в ней
+    std::pmr::vector<L> F(nodes.size(), mr), B(nodes.size(), mr);
+    std::priority_queue<Q,std::pmr::vector<Q>,C> pqF{C{}, std::pmr::vector<Q>(mr)}, pqB{C{}, std::pmr::vector<Q>(mr)};
+    auto hF=[&](int v){ return haversine(nodes[v].lat,nodes[v].lon,nodes[t].lat,nodes[t].lon)/13.9; };
+    auto hB=[&](int v){ return haversine(nodes[v].lat,nodes[v].lon,nodes[s].lat,nodes[s].lon)/13.9; };
+    F[s].g=0.0; B[t].g=0.0; pqF.push({s,hF(s)}); pqB.push({t,hB(t)});
+    stats.push(true); stats.push(false);
+    double bestMu = std::numeric_limits<double>::infinity(); int meet=-1;
+    while(!pqF.empty() || !pqB.empty()){
+      if(!pqF.empty()){
+        auto q=pqF.top(); pqF.pop();
+        double key = F[q.v].g + hF(q.v);
+        stats.pop(true, key >= q.f);
+        if (key > bestMu) break;
+        for(size_t i=0;i<adj[q.v].size();++i){ const auto& e=adj[q.v][i]; double cand=F[q.v].g+e.w; if(cand<F[e.to].g){ F[e.to].g=cand; F[e.to].prev=q.v; F[e.to].prevEdge=static_cast<int>(i); pqF.push({e.to, cand + hF(e.to)}); stats.push(true); if (B[e.to].g< std::numeric_limits<double>::infinity()){ double mu=cand+B[e.to].g; if(mu<bestMu){ bestMu=mu; meet=e.to; } } } }
+      }
+      if(!pqB.empty()){
+        auto q=pqB.top(); pqB.pop();
+        double key = B[q.v].g + hB(q.v);
+        stats.pop(false, key >= q.f);
+        if (key > bestMu) break;
+        for(const auto& re : revAdj[q.v]){ int from=re.first; int idx=re.second; const auto& e=adj[from][static_cast<size_t>(idx)]; double cand=B[q.v].g + e.w; if(cand<B[from].g){ B[from].g=cand; B[from].prev=q.v; B[from].prevEdge=idx; pqB.push({from, cand + hB(from)}); stats.push(false); if (F[from].g< std::numeric_limits<double>::infinity()){ double mu=cand+F[from].g; if(mu<bestMu){ bestMu=mu; meet=from; } } } }
+      }
+    }
+    if (meet<0) return false;
+    unwindBiPath(adj, s, t, meet, F, B, meetPath, usedEdgeIds);
+    return true;
+  }
+
+  // bi-A*, прямое направление — в потоке вызова, обратное — в свободном потоке пула
+  // (graphPool, иначе searchPool). Если свободного потока сейчас нет, ищет последовательный
+  // astarGlobalBi: без меток второго направления первое не знает, когда встать, и обошло бы
+  // весь граф. Потоки пишут только свои метки; g другого
+  // направления читается атомарно (запись своей g и чтение чужой — seq_cst, так что
+  // встречу в общем узле увидит хотя бы один поток). Лучшая встреча
+  // обновляется под мьютексом. Останов тот же, что у последовательной версии: ключ
+  // вершины очереди одного из направлений больше лучшей встречи — тогда встают оба.
+  // Опустевшая очередь останавливает только своё направление. Исключение одного
+  // направления останавливает и другое и пробрасывается, когда оба вышли.
+  template <bool kStats>
+  bool astarGlobalBiParallel(const GlobalNodes& nodes,
+                             const GlobalAdj& adj,
+                             const GlobalRevAdj& revAdj,
+                             int s, int t,
+                             std::vector<int>& meetPath, std::vector<uint64_t>& usedEdgeIds,
+                             QueryStats<kStats>& stats) {
+    const double kInf = std::numeric_limits<double>::infinity();
+    struct L { std::atomic<double> g{std::numeric_limits<double>::infinity()}; int prev{-1}; int prevEdge{-1}; };
+    struct Q { int v; double f; }; struct C { bool operator()(const Q&a,const Q&b)const{return a.f>b.f;}};
+    // Метки — в арене запроса до старта потока. Монотонная арена не потокобезопасна, поэтому
+    // очередь прямого направления растёт в арене запроса (пока идёт поиск, из неё выделяет
+    // только поток вызова), а обратного — в своей арене из пула.
+    std::pmr::memory_resource* mr = adj.get_allocator().resource();
+    std::pmr::vector<L> F(nodes.size(), mr), B(nodes.size(), mr);
+    auto backwardArena = arenas.acquire();
+    std::atomic<double> bestMu{kInf};
+    std::atomic<bool> done{false};
+    std::mutex meetMu;
+    int meet = -1;
+    auto offer = [&](double mu, int v) {
+      if (mu >= bestMu.load(std::memory_order_relaxed)) return;
+      std::lock_guard<std::mutex> lock(meetMu);
+      if (mu < bestMu.load(std::memory_order_relaxed)) { bestMu.store(mu); meet = v; }
+    };
+    // stats: прямое направление трогает только s.forward, обратное — s.backward
+    auto run = [&](bool forward, std::pmr::memory_resource* queueResource) {
+      auto& own = forward ? F : B;
+      const auto& other = forward ? B : F;
+      const int src = forward ? s : t;
+      const GlobalNode& goal = nodes[forward ? t : s];
+      auto h = [&](int v){ return haversine(nodes[v].lat, nodes[v].lon, goal.lat, goal.lon)/13.9; };
+      std::priority_queue<Q,std::pmr::vector<Q>,C> pq{C{}, std::pmr::vector<Q>(queueResource)};
+      own[src].g.store(0.0); pq.push({src, h(src)});
+      stats.push(forward);
+      while (!pq.empty() && !done.load(std::memory_order_relaxed)) {
+        auto q = pq.top(); pq.pop();
+        const double g = own[q.v].g.load(std::memory_order_relaxed);
+        const double key = g + h(q.v);
+        stats.pop(forward, key >= q.f);
+        if (key > bestMu.load()) { done.store(true); break; }
+        auto relax = [&](int to, int idx, double w) {
+          const double cand = g + w;
+          if (cand >= own[to].g.load(std::memory_order_relaxed)) return;
+          own[to].g.store(cand);
+          own[to].prev = q.v; own[to].prevEdge = idx;
+          pq.push({to, cand + h(to)});
+          stats.push(forward);
+          const double og = other[to].g.load();
+          if (og < kInf) offer(cand + og, to);
+        };
+        if (forward) {
+          for (size_t i = 0; i < adj[q.v].size(); ++i) relax(adj[q.v][i].to, static_cast<int>(i), adj[q.v][i].w);
+        } else {
+          for (const auto& re : revAdj[q.v]) relax(re.first, re.second, adj[re.first][static_cast<size_t>(re.second)].w);
+        }
+      }
+    };
+    std::mutex joinMu;
+    std::condition_variable joinCv;
+    bool backwardDone = false;
+    std::exception_ptr backwardError;
+    auto backward = [&] {
+      try {
+        run(false, backwardArena.resource());
+      } catch (...) {
+        done.store(true);
+        backwardError = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock(joinMu);
+      backwardDone = true;
+      joinCv.notify_all();
+    };
+    TaskPool* pool = graphPool ? graphPool.get() : searchPool.get();
+    if (!pool || !pool->tryStart(backward)) return astarGlobalBi(nodes, adj, revAdj, s, t, meetPath, usedEdgeIds, stats);
+    std::exception_ptr forwardError;
+    try {
+      run(true, mr);
+    } catch (...) {
+      done.store(true);
+      forwardError = std::current_exception();
+    }
+    {
+      std::unique_lock<std::mutex> lock(joinMu);
+      joinCv.wait(lock, [&] { return backwardDone; });
+    }
+    if (forwardError) std::rethrow_exception(forwardError);
+    if (backwardError) std::rethrow_exception(backwardError);
+    if (meet<0) return false;
+    unwindBiPath(adj, s, t, meet, F, B, meetPath, usedEdgeIds);
+    return true;
+  }
+
+  // Путь по меткам bi-A*: F — s->meet, B — meet->t (prevEdge — индекс в adj[u]).
+  template <class Labels>
+  void unwindBiPath(const GlobalAdj& adj, int s, int t, int meet,
+                    const Labels& F, const Labels& B,
+                    std::vector<int>& meetPath, std::vector<uint64_t>& usedEdgeIds) const {
+    std::pmr::vector<std::pair<int,int>> seq(adj.get_allocator().resource()); // (u, edgeIdxInAdj)
+    for(int v=meet; v!=s; v=F[v].prev){ int u=F[v].prev; seq.emplace_back(u, F[v].prevEdge); }
+    std::reverse(seq.begin(), seq.end());
+    for(int v=meet; v!=t; v=B[v].prev){ int u=v; int idx=B[u].prevEdge; seq.emplace_back(u, idx); // edge u->B[u].prev
+    }
+    // meetPath — узлы пути s..t: по соседям s и t видно, в какую сторону ушли полурёбра снапа;
+    // виртуальные рёбра в usedEdgeIds не попадают
+    usedEdgeIds.clear(); meetPath.clear(); meetPath.push_back(s); uint64_t lastE=std::numeric_limits<uint64_t>::max();
+    for(auto& p: seq){ int u=p.first; int idx=p.second; if (idx<0) continue; const auto& ge=adj[u][static_cast<size_t>(idx)]; meetPath.push_back(ge.to); if (ge.isVirt) continue; uint64_t id=makeEdgeId(tileZoom, ge.tileX, ge.tileY, ge.edgeIdx); if(id!=lastE){ usedEdgeIds.push_back(id); lastE=id; } }
+  }
+
+}; // Impl
+
+// Router::Impl для бенчмарков и модульных тестов (не публичный API).
+struct RouterInternals {
+  using Impl = Router::Impl;
+  static Impl& impl(Router& router) { return *router.impl_; }
+};
+
+} // namespace routing_core
@@ -0,0 +1,151 @@
+#include "task_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace routing_core {
+
+TaskPool::TaskPool(int threads) {
+  threads_.reserve(static_cast<size_t>(threads));
+  for (int i = 0; i < threads; ++i) threads_.emplace_back([this] { worker(); });
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+    queue_.clear();
+  }
+  cv_.notify_all();
+  for (auto& t : threads_) t.join();
+}
+
+void TaskPool::worker() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      ++idle_;
+      cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+      --idle_;
+      if (stop_) return;
+      task = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    task();
+  }
+}
+
+bool TaskPool::tryStart(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    // задачи в очереди разберут простаивающие потоки раньше этой
+    if (stop_ || idle_ <= queue_.size()) return false;
+    queue_.push_back(std::move(task));
+  }
+  cv_.notify_one();
+  return true;
+}
+
+namespace {
+
+// Состояние одного orderedFor. Живёт, пока на него ссылается хоть одна задача пула:
+// задача, взятая после выхода из orderedFor, видит closed и сразу выходит.
+struct Batch {
+  size_t n {0};
+  const std::function<void(size_t)>* fn {nullptr};  // валиден, пока !closed
+  std::atomic<size_t> next {0};
+  std::mutex mu;
+  std::condition_variable cv;
+  std::vector<uint8_t> ready;
+  std::vector<std::exception_ptr> errors;
+  int active {0};       // потоков пула внутри fn
+  bool closed {false};
+
+  void run(size_t i) {
+    std::exception_ptr error;
+    try {
+      (*fn)(i);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mu);
+    errors[i] = error;
+    ready[i] = 1;
+    cv.notify_all();
+  }
+
+  void help() {
+    {
+      std::lock_guard<std::mutex> lock(mu);
+      if (closed) return;
+      ++active;
+    }
+    for (size_t i = next.fetch_add(1); i < n; i = next.fetch_add(1)) run(i);
+    std::lock_guard<std::mutex> lock(mu);
+    --active;
+    cv.notify_all();
+  }
+
+  // Больше не раздавать индексы и дождаться потоков пула, уже вошедших в fn.
+  void close() {
+    next.store(n);
+    std::unique_lock<std::mutex> lock(mu);
+    closed = true;
+    cv.wait(lock, [&] { return active == 0; });
+  }
+};
+
+} // namespace
+
+void TaskPool::orderedFor(size_t n, const std::function<void(size_t)>& fn,
+                          const std::function<void(size_t)>& done) {
+  if (n == 0) return;
+  auto batch = std::make_shared<Batch>();
+  batch->n = n;
+  batch->fn = &fn;
+  batch->ready.assign(n, 0);
+  batch->errors.assign(n, nullptr);
+  const size_t helpers = std::min(threads_.size(), n - 1);
+  if (helpers > 0) {
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      for (size_t k = 0; k < helpers; ++k) queue_.emplace_back([batch] { batch->help(); });
+    }
+    cv_.notify_all();
+  }
+
+  try {
+    for (size_t i = 0; i < n; ++i) {
+      for (;;) {
+        {
+          std::unique_lock<std::mutex> lock(batch->mu);
+          if (batch->ready[i]) break;
+        }
+        const size_t j = batch->next.fetch_add(1);
+        if (j < n) {
+          batch->run(j);
+          continue;
+        }
+        std::unique_lock<std::mutex> lock(batch->mu);
+        batch->cv.wait(lock, [&] { return batch->ready[i] != 0; });
+        break;
+      }
+      std::exception_ptr error;
+      {
+        std::lock_guard<std::mutex> lock(batch->mu);
+        error = batch->errors[i];
+      }
+      if (error) std::rethrow_exception(error);
+      done(i);
+    }
+  } catch (...) {
+    batch->close();
+    throw;
+  }
+  batch->close();
+}
+
+} // namespace routing_core
@@ -0,0 +1,50 @@
+#pragma once
+
+// Пул потоков для тайл-локальной работы запроса (не публичный API,
+// RouterOptions::graphThreads).
+//
+// orderedFor раздаёт индексы по возрастанию; поток вызова тоже берёт индексы, пока
+// ждёт очередной результат, так что пул, занятый другими запросами, запрос не держит.
+// Последовательная часть (done) идёт в потоке вызова строго по порядку индексов
+// параллельно с ещё не законченными fn — граф склеивается так же, как без пула.
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace routing_core {
+
+class TaskPool {
+public:
+  explicit TaskPool(int threads);
+  ~TaskPool();
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+
+  int size() const { return static_cast<int>(threads_.size()); }
+
+  // fn(i) для i в [0, n) — в пуле и в потоке вызова; done(i) — в потоке вызова по порядку.
+  // Исключение из fn(i) пробрасывается вместо done(i); из fn и done — после того, как
+  // потоки пула вышли из fn (fn и done можно держать на стеке вызова).
+  void orderedFor(size_t n, const std::function<void(size_t)>& fn, const std::function<void(size_t)>& done);
+
+  // Отдать task простаивающему потоку пула; false — все заняты или разобраны очередью,
+  // task не запущен. Дождаться конца task вызывающий должен сам.
+  bool tryStart(std::function<void()> task);
+
+private:
+  void worker();
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> queue_;
+  bool stop_ {false};
+  size_t idle_ {0};  // потоков пула в ожидании задачи
+  std::vector<std::thread> threads_;
+};
+
+} // namespace routing_core
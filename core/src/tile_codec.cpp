@@ -0,0 +1,73 @@
+#include "tile_codec.h"
+
+#include <stdexcept>
+#include <string>
+
+#include "routing_core/tile_store.h"
+#include "routing_core/trace.h"
+
+#ifdef ROUTING_CORE_HAVE_ZSTD
+#  include <zstd.h>
+#endif
+
+namespace routing_core {
+
+#ifdef ROUTING_CORE_HAVE_ZSTD
+
+namespace {
+
+struct DCtxDeleter {
+  void operator()(ZSTD_DCtx* c) const { ZSTD_freeDCtx(c); }
+};
+
+ZSTD_DCtx* threadDCtx() {
+  thread_local std::unique_ptr<ZSTD_DCtx, DCtxDeleter> ctx(ZSTD_createDCtx());
+  return ctx.get();
+}
+
+} // namespace
+
+TileDecompressor::TileDecompressor(const std::vector<uint8_t>& dict) {
+  if (!dict.empty()) {
+    ddict_ = ZSTD_createDDict(dict.data(), dict.size());
+    if (!ddict_) throw std::runtime_error("Invalid zstd dictionary in routingdb metadata");
+  }
+}
+
+TileDecompressor::~TileDecompressor() {
+  ZSTD_freeDDict(static_cast<ZSTD_DDict*>(ddict_));
+}
+
+std::shared_ptr<std::vector<uint8_t>> TileDecompressor::decompress(const uint8_t* data, size_t size) const {
+  ROUTING_TRACE_SCOPE_ARG("tile_store", "decompress", "bytes", size);
+  const unsigned long long raw = ZSTD_getFrameContentSize(data, size);
+  if (raw == ZSTD_CONTENTSIZE_ERROR || raw == ZSTD_CONTENTSIZE_UNKNOWN) {
+    throw TileDataError("Compressed tile has no content size");
+  }
+  auto out = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(raw));
+  const size_t n = ddict_
+      ? ZSTD_decompress_usingDDict(threadDCtx(), out->data(), out->size(), data, size,
+                                   static_cast<const ZSTD_DDict*>(ddict_))
+      : ZSTD_decompressDCtx(threadDCtx(), out->data(), out->size(), data, size);
+  if (ZSTD_isError(n) || n != out->size()) {
+    throw TileDataError(std::string("Failed to decompress tile: ") +
+                        (ZSTD_isError(n) ? ZSTD_getErrorName(n) : "size mismatch"));
+  }
+  return out;
+}
+
+#else
+
+TileDecompressor::TileDecompressor(const std::vector<uint8_t>&) {
+  throw std::runtime_error("routingdb uses zstd-compressed tiles, but routing_core was built without zstd");
+}
+
+TileDecompressor::~TileDecompressor() = default;
+
+std::shared_ptr<std::vector<uint8_t>> TileDecompressor::decompress(const uint8_t*, size_t) const {
+  return nullptr;
+}
+
+#endif
+
+} // namespace routing_core
@@ -0,0 +1,36 @@
+#pragma once
+
+// Распаковка сжатых блобов тайлов (не публичный API).
+//
+// Конвертер с --zstd сжимает блобы zstd со словарём, обученным на выборке тайлов;
+// в metadata пишутся tile_compression=zstd и zstd_dict (base64, может отсутствовать).
+// Сжатый блоб узнаётся по магии кадра zstd: корневое смещение FlatBuffers с таким
+// значением (~680 МБ) в тайле невозможно, поэтому несжатые блобы в той же базе допустимы.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace routing_core {
+
+class TileDecompressor {
+public:
+  // dict — сырой zstd-словарь (пустой — без словаря). Бросает, если ядро собрано без zstd.
+  explicit TileDecompressor(const std::vector<uint8_t>& dict);
+  ~TileDecompressor();
+  TileDecompressor(const TileDecompressor&) = delete;
+  TileDecompressor& operator=(const TileDecompressor&) = delete;
+
+  static bool isCompressed(const uint8_t* data, size_t size) {
+    return size >= 4 && data[0] == 0x28 && data[1] == 0xB5 && data[2] == 0x2F && data[3] == 0xFD;
+  }
+
+  // Потокобезопасно (контекст распаковки — на поток). Бросает при повреждённых данных.
+  std::shared_ptr<std::vector<uint8_t>> decompress(const uint8_t* data, size_t size) const;
+
+private:
+  void* ddict_ {nullptr};  // ZSTD_DDict*
+};
+
+} // namespace routing_core
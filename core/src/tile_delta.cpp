@@ -0,0 +1,356 @@
+#include "routing_core/tile_delta.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <sqlite3.h>
+
+#include "routing_core/tile_pack.h"
+#include "routing_core/trace.h"
+#include "routing_core/xxhash64.h"
+
+namespace routing_core {
+
+namespace {
+
+// Диф: последовательность операций varint(len << 1 | copy); копия — затем varint(смещение
+// в base), вставка — затем len байт.
+constexpr size_t kDiffBlock = 16;
+
+void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<uint8_t>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+uint64_t getVarint(const uint8_t*& p, const uint8_t* end) {
+  uint64_t v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (p == end) throw std::runtime_error("Tile delta: truncated diff");
+    const uint8_t b = *p++;
+    v |= static_cast<uint64_t>(b & 0x7F) << shift;
+    if (!(b & 0x80)) return v;
+  }
+  throw std::runtime_error("Tile delta: malformed varint");
+}
+
+void putInsert(std::vector<uint8_t>& out, const uint8_t* data, size_t len) {
+  if (len == 0) return;
+  putVarint(out, static_cast<uint64_t>(len) << 1);
+  out.insert(out.end(), data, data + len);
+}
+
+// Исключение с текстом ошибки SQLite
+[[noreturn]] void fail(sqlite3* db, const std::string& what) {
+  throw std::runtime_error("Tile delta: " + what + ": " + sqlite3_errmsg(db));
+}
+
+} // namespace
+
+uint64_t deltaBlobHash(const uint8_t* data, size_t size) {
+  uint64_t h = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    h ^= data[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+std::vector<uint8_t> makeBlobDiff(const std::vector<uint8_t>& base, const std::vector<uint8_t>& newer) {
+  // Блоки base по kDiffBlock байт: хэш -> первое смещение
+  std::unordered_map<uint64_t, uint32_t> blocks;
+  blocks.reserve(base.size() / kDiffBlock + 1);
+  for (size_t off = 0; off + kDiffBlock <= base.size(); off += kDiffBlock) {
+    blocks.emplace(deltaBlobHash(base.data() + off, kDiffBlock), static_cast<uint32_t>(off));
+  }
+
+  std::vector<uint8_t> out;
+  size_t literal = 0;  // начало ещё не записанной вставки
+  size_t i = 0;
+  while (i + kDiffBlock <= newer.size()) {
+    auto it = blocks.find(deltaBlobHash(newer.data() + i, kDiffBlock));
+    if (it == blocks.end() || std::memcmp(base.data() + it->second, newer.data() + i, kDiffBlock) != 0) {
+      ++i;
+      continue;
+    }
+    // Совпадение: расширить назад (за счёт вставки) и вперёд
+    size_t from = it->second, to = i;
+    while (to > literal && from > 0 && base[from - 1] == newer[to - 1]) { --from; --to; }
+    size_t len = i - to + kDiffBlock;
+    while (to + len < newer.size() && from + len < base.size() && base[from + len] == newer[to + len]) ++len;
+    putInsert(out, newer.data() + literal, to - literal);
+    putVarint(out, (static_cast<uint64_t>(len) << 1) | 1);
+    putVarint(out, from);
+    i = to + len;
+    literal = i;
+  }
+  putInsert(out, newer.data() + literal, newer.size() - literal);
+  return out;
+}
+
+std::vector<uint8_t> applyBlobDiff(const uint8_t* base, size_t baseSize, const std::vector<uint8_t>& diff) {
+  std::vector<uint8_t> out;
+  const uint8_t* p = diff.data();
+  const uint8_t* end = p + diff.size();
+  while (p < end) {
+    const uint64_t op = getVarint(p, end);
+    const uint64_t len = op >> 1;
+    if (op & 1) {
+      const uint64_t from = getVarint(p, end);
+      if (from > baseSize || len > baseSize - from) throw std::runtime_error("Tile delta: diff copy out of range");
+      out.insert(out.end(), base + from, base + from + len);
+    } else {
+      if (len > static_cast<uint64_t>(end - p)) throw std::runtime_error("Tile delta: truncated diff");
+      out.insert(out.end(), p, p + len);
+      p += len;
+    }
+  }
+  return out;
+}
+
+// ---------------- TileDeltaWriter ----------------
+
+TileDeltaWriter::TileDeltaWriter(std::string path) : path_(std::move(path)) {
+  out_.open(path_, std::ios::binary | std::ios::trunc);
+  if (!out_) throw std::runtime_error("Failed to create tile delta: " + path_);
+}
+
+TileDeltaWriter::~TileDeltaWriter() {
+  if (out_.is_open()) out_.close();
+  if (!finished_) std::remove(path_.c_str());
+}
+
+void TileDeltaWriter::setMetadata(const std::string& key, const std::string& value) {
+  if (headerWritten_) throw std::runtime_error("TileDeltaWriter: setMetadata after entries");
+  meta_.append(key).push_back('\0');
+  meta_.append(value).push_back('\0');
+}
+
+void TileDeltaWriter::writeHeader() {
+  DeltaHeader h {};
+  std::memcpy(h.magic, kTileDeltaMagic, sizeof(h.magic));
+  h.formatVersion = kTileDeltaFormatVersion;
+  h.entryCount = count_;
+  h.metaSize = static_cast<uint32_t>(meta_.size());
+  out_.seekp(0);
+  out_.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  if (!headerWritten_) {
+    out_.write(meta_.data(), static_cast<std::streamsize>(meta_.size()));
+    bytes_ = sizeof(h) + meta_.size();
+    headerWritten_ = true;
+  }
+}
+
+void TileDeltaWriter::add(const TileDeltaEntry& entry) {
+  if (finished_) throw std::runtime_error("TileDeltaWriter: add after finish");
+  if (!headerWritten_) writeHeader();
+  if (entry.payload.size() > UINT32_MAX || entry.checksum.size() > UINT16_MAX) {
+    throw std::runtime_error("TileDeltaWriter: entry too large");
+  }
+  DeltaEntryHeader e {};
+  e.z = static_cast<uint32_t>(entry.z);
+  e.x = static_cast<uint32_t>(entry.x);
+  e.y = static_cast<uint32_t>(entry.y);
+  e.version = entry.version;
+  e.profileMask = entry.profileMask;
+  e.payloadSize = static_cast<uint32_t>(entry.payload.size());
+  e.baseHash = entry.baseHash;
+  e.baseSize = entry.baseSize;
+  e.checksumSize = static_cast<uint16_t>(entry.checksum.size());
+  e.op = static_cast<uint8_t>(entry.op);
+  std::memcpy(e.bbox, entry.bbox, sizeof(e.bbox));
+  out_.write(reinterpret_cast<const char*>(&e), sizeof(e));
+  out_.write(entry.checksum.data(), static_cast<std::streamsize>(entry.checksum.size()));
+  out_.write(reinterpret_cast<const char*>(entry.payload.data()), static_cast<std::streamsize>(entry.payload.size()));
+  if (!out_) throw std::runtime_error("Failed to write tile delta: " + path_);
+  bytes_ += sizeof(e) + entry.checksum.size() + entry.payload.size();
+  ++count_;
+}
+
+void TileDeltaWriter::finish() {
+  if (finished_) return;
+  writeHeader();  // число записей
+  out_.flush();
+  if (!out_) throw std::runtime_error("Failed to write tile delta: " + path_);
+  out_.close();
+  finished_ = true;
+}
+
+// ---------------- applyTileDelta ----------------
+
+TileDeltaStats applyTileDelta(const std::string& dbPath, const std::string& deltaPath, std::vector<TileKey>* changed) {
+  ROUTING_TRACE_SCOPE("tile_store", "applyTileDelta");
+  std::ifstream in(deltaPath, std::ios::binary);
+  if (!in) throw std::runtime_error("Failed to open tile delta: " + deltaPath);
+  DeltaHeader h {};
+  if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)) ||
+      std::memcmp(h.magic, kTileDeltaMagic, sizeof(h.magic)) != 0 || h.formatVersion != kTileDeltaFormatVersion) {
+    throw std::runtime_error("Invalid tile delta header: " + deltaPath);
+  }
+  std::string meta(h.metaSize, '\0');
+  if (!in.read(meta.data(), static_cast<std::streamsize>(meta.size()))) {
+    throw std::runtime_error("Tile delta is truncated: " + deltaPath);
+  }
+
+  sqlite3* db = nullptr;
+  if (sqlite3_open_v2(dbPath.c_str(), &db, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK) {
+    std::string msg = std::string("Failed to open routingdb: ") + sqlite3_errmsg(db);
+    sqlite3_close(db);
+    throw std::runtime_error(msg);
+  }
+  // Писатель ждёт, пока конкурирующие соединения отпустят БД; читатели WAL не блокируют
+  sqlite3_busy_timeout(db, 5000);
+
+  struct Statements {
+    sqlite3_stmt* select[2] {nullptr, nullptr};  // [geometry]
+    sqlite3_stmt* upsertTile {nullptr};
+    sqlite3_stmt* upsertGeometry {nullptr};
+    sqlite3_stmt* remove[2] {nullptr, nullptr};
+    sqlite3_stmt* meta {nullptr};
+    ~Statements() {
+      for (auto* s : {select[0], select[1], upsertTile, upsertGeometry, remove[0], remove[1], meta}) sqlite3_finalize(s);
+    }
+  };
+
+  TileDeltaStats stats;
+  std::vector<TileKey> keys;
+  bool inTransaction = false;
+  try {
+    Statements st;
+    auto prepare = [&](sqlite3_stmt*& s, const char* sql) {
+      if (sqlite3_prepare_v2(db, sql, -1, &s, nullptr) != SQLITE_OK) fail(db, "prepare");
+    };
+    prepare(st.select[0], "SELECT data FROM land_tiles WHERE z=? AND x=? AND y=?;");
+    prepare(st.select[1], "SELECT data FROM land_geometry WHERE z=? AND x=? AND y=?;");
+    prepare(st.upsertTile,
+        "INSERT INTO land_tiles(z,x,y,lat_min,lon_min,lat_max,lon_max,version,checksum,profile_mask,data)\n"
+        "VALUES(?,?,?,?,?,?,?,?,?,?,?)\n"
+        "ON CONFLICT(z,x,y) DO UPDATE SET lat_min=excluded.lat_min, lon_min=excluded.lon_min,\n"
+        "  lat_max=excluded.lat_max, lon_max=excluded.lon_max, version=excluded.version,\n"
+        "  checksum=excluded.checksum, profile_mask=excluded.profile_mask, data=excluded.data;");
+    prepare(st.upsertGeometry,
+        "INSERT INTO land_geometry(z,x,y,data) VALUES(?,?,?,?)\n"
+        "ON CONFLICT(z,x,y) DO UPDATE SET data=excluded.data;");
+    prepare(st.remove[0], "DELETE FROM land_tiles WHERE z=? AND x=? AND y=?;");
+    prepare(st.remove[1], "DELETE FROM land_geometry WHERE z=? AND x=? AND y=?;");
+    prepare(st.meta,
+        "INSERT INTO metadata(key, value) VALUES(?, ?)\n"
+        "ON CONFLICT(key) DO UPDATE SET value=excluded.value;");
+
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK) fail(db, "begin");
+    inTransaction = true;
+
+    auto run = [&](sqlite3_stmt* s, const char* what) {
+      const int rc = sqlite3_step(s);
+      sqlite3_reset(s);
+      sqlite3_clear_bindings(s);
+      if (rc != SQLITE_DONE) fail(db, what);
+    };
+
+    for (const char* p = meta.data(), *end = meta.data() + meta.size(); p < end;) {
+      const char* kEnd = static_cast<const char*>(std::memchr(p, '\0', static_cast<size_t>(end - p)));
+      if (!kEnd) throw std::runtime_error("Tile delta: malformed metadata");
+      const char* vEnd = static_cast<const char*>(std::memchr(kEnd + 1, '\0', static_cast<size_t>(end - kEnd - 1)));
+      if (!vEnd) throw std::runtime_error("Tile delta: malformed metadata");
+      sqlite3_bind_text(st.meta, 1, p, static_cast<int>(kEnd - p), SQLITE_STATIC);
+      sqlite3_bind_text(st.meta, 2, kEnd + 1, static_cast<int>(vEnd - kEnd - 1), SQLITE_STATIC);
+      run(st.meta, "metadata");
+      p = vEnd + 1;
+    }
+
+    std::string checksum;
+    std::vector<uint8_t> payload;
+    for (uint32_t i = 0; i < h.entryCount; ++i) {
+      DeltaEntryHeader e {};
+      checksum.resize(0);
+      if (!in.read(reinterpret_cast<char*>(&e), sizeof(e))) throw std::runtime_error("Tile delta is truncated: " + deltaPath);
+      checksum.resize(e.checksumSize);
+      payload.resize(e.payloadSize);
+      if (!in.read(checksum.data(), static_cast<std::streamsize>(checksum.size())) ||
+          !in.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(payload.size()))) {
+        throw std::runtime_error("Tile delta is truncated: " + deltaPath);
+      }
+      const bool geometry = (e.z & kGeometryLayerBit) != 0;
+      const int z = static_cast<int>(e.z & ~static_cast<uint32_t>(kGeometryLayerBit));
+      const int x = static_cast<int>(e.x), y = static_cast<int>(e.y);
+      auto bindKey = [&](sqlite3_stmt* s) {
+        sqlite3_bind_int(s, 1, z);
+        sqlite3_bind_int(s, 2, x);
+        sqlite3_bind_int(s, 3, y);
+      };
+
+      const auto op = static_cast<TileDeltaOp>(e.op);
+      if (op == TileDeltaOp::Remove) {
+        bindKey(st.remove[geometry]);
+        run(st.remove[geometry], "remove");
+        ++stats.removed;
+      } else {
+        std::vector<uint8_t> patched;
+        const std::vector<uint8_t>* blob = &payload;
+        if (op == TileDeltaOp::Patch) {
+          // База — текущий блоб в БД; диф применим только к той, по которой построен
+          sqlite3_stmt* sel = st.select[geometry];
+          bindKey(sel);
+          const int rc = sqlite3_step(sel);
+          const uint8_t* base = nullptr;
+          size_t baseSize = 0;
+          if (rc == SQLITE_ROW) {
+            base = static_cast<const uint8_t*>(sqlite3_column_blob(sel, 0));
+            baseSize = static_cast<size_t>(sqlite3_column_bytes(sel, 0));
+          }
+          if (rc != SQLITE_ROW || baseSize != e.baseSize || deltaBlobHash(base, baseSize) != e.baseHash) {
+            sqlite3_reset(sel);
+            throw std::runtime_error("Tile delta does not match the routingdb (tile " + std::to_string(z) + "/" +
+                                     std::to_string(x) + "/" + std::to_string(y) + ")");
+          }
+          patched = applyBlobDiff(base, baseSize, payload);
+          sqlite3_reset(sel);
+          sqlite3_clear_bindings(sel);
+          // Контрольная сумма xxh64 (16 hex) у тайла есть — сверяем собранный блоб с ней
+          if (checksum.size() == 16 && xxh64Hex(patched.data(), patched.size()) != checksum) {
+            throw std::runtime_error("Tile delta produced a blob with a wrong checksum (tile " + std::to_string(z) +
+                                     "/" + std::to_string(x) + "/" + std::to_string(y) + ")");
+          }
+          blob = &patched;
+          ++stats.patched;
+        } else if (op == TileDeltaOp::Put) {
+          ++stats.put;
+        } else {
+          throw std::runtime_error("Tile delta: unknown entry op");
+        }
+
+        if (geometry) {
+          bindKey(st.upsertGeometry);
+          sqlite3_bind_blob(st.upsertGeometry, 4, blob->data(), static_cast<int>(blob->size()), SQLITE_STATIC);
+          run(st.upsertGeometry, "geometry upsert");
+        } else {
+          sqlite3_stmt* s = st.upsertTile;
+          bindKey(s);
+          for (int k = 0; k < 4; ++k) sqlite3_bind_double(s, 4 + k, e.bbox[k]);
+          sqlite3_bind_int64(s, 8, e.version);
+          sqlite3_bind_text(s, 9, checksum.data(), static_cast<int>(checksum.size()), SQLITE_STATIC);
+          sqlite3_bind_int64(s, 10, e.profileMask);
+          sqlite3_bind_blob(s, 11, blob->data(), static_cast<int>(blob->size()), SQLITE_STATIC);
+          run(s, "tile upsert");
+        }
+      }
+      keys.push_back(TileKey{static_cast<int>(e.z), x, y});
+    }
+
+    if (sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK) fail(db, "commit");
+    inTransaction = false;
+  } catch (...) {
+    if (inTransaction) sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    sqlite3_close(db);
+    throw;
+  }
+  sqlite3_close(db);
+  if (changed) *changed = std::move(keys);
+  return stats;
+}
+
+} // namespace routing_core
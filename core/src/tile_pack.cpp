@@ -0,0 +1,206 @@
+#include "routing_core/tile_pack.h"
+#include "routing_core/xxhash64.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace routing_core {
+
+namespace {
+
+bool keyLess(const PackEntry& a, const PackEntry& b) {
+  return std::tie(a.z, a.x, a.y) < std::tie(b.z, b.x, b.y);
+}
+
+uint64_t alignUp(uint64_t v, uint64_t a) { return (v + a - 1) / a * a; }
+
+} // namespace
+
+bool isTilePack(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[sizeof(kTilePackMagic)] = {};
+  if (!in.read(magic, sizeof(magic))) return false;
+  return std::memcmp(magic, kTilePackMagic, sizeof(magic)) == 0;
+}
+
+// ---------------- TilePackReader ----------------
+
+TilePackReader::TilePackReader(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("Failed to open tile pack: " + path + ": " + std::strerror(errno));
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(PackHeader))) {
+    ::close(fd);
+    throw std::runtime_error("Tile pack is truncated: " + path);
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) throw std::runtime_error("Failed to mmap tile pack: " + path + ": " + std::strerror(errno));
+  base_ = static_cast<const uint8_t*>(p);
+  // доступ к тайлам случайный: отключаем агрессивный readahead, нужные страницы
+  // запрашиваем точечно через willNeed()
+  ::madvise(p, size_, MADV_RANDOM);
+
+  header_ = reinterpret_cast<const PackHeader*>(base_);
+  const auto& h = *header_;
+  const bool ok = std::memcmp(h.magic, kTilePackMagic, sizeof(kTilePackMagic)) == 0 &&
+                  h.formatVersion == kTilePackFormatVersion &&
+                  h.fileSize == size_ &&
+                  h.indexOffset + static_cast<uint64_t>(h.tileCount) * sizeof(PackEntry) <= size_ &&
+                  h.metaOffset + h.metaSize <= size_ &&
+                  h.indexOffset % alignof(PackEntry) == 0;
+  if (!ok) {
+    ::munmap(p, size_);
+    throw std::runtime_error("Invalid tile pack header: " + path);
+  }
+  entries_ = reinterpret_cast<const PackEntry*>(base_ + h.indexOffset);
+  for (uint32_t i = 0; i < h.tileCount; ++i) {
+    if (entries_[i].offset + entries_[i].length > size_) {
+      ::munmap(p, size_);
+      throw std::runtime_error("Tile pack entry out of bounds: " + path);
+    }
+  }
+}
+
+TilePackReader::~TilePackReader() {
+  if (base_) ::munmap(const_cast<uint8_t*>(base_), size_);
+}
+
+const PackEntry* TilePackReader::find(int z, int x, int y) const {
+  PackEntry probe {};
+  probe.z = static_cast<uint32_t>(z);
+  probe.x = static_cast<uint32_t>(x);
+  probe.y = static_cast<uint32_t>(y);
+  const PackEntry* end = entries_ + header_->tileCount;
+  const PackEntry* it = std::lower_bound(entries_, end, probe, keyLess);
+  if (it == end || keyLess(probe, *it)) return nullptr;
+  return it;
+}
+
+void TilePackReader::willNeed(const PackEntry& e) const {
+  const uint64_t page = header_->pageSize;
+  const uint64_t begin = e.offset / page * page;
+  ::madvise(const_cast<uint8_t*>(base_) + begin, static_cast<size_t>(e.offset + e.length - begin), MADV_WILLNEED);
+}
+
+void TilePackReader::releasePages() const {
+  ::madvise(const_cast<uint8_t*>(base_), size_, MADV_DONTNEED);
+}
+
+std::optional<std::string> TilePackReader::metadata(const std::string& key) const {
+  const char* p = reinterpret_cast<const char*>(base_ + header_->metaOffset);
+  const char* end = p + header_->metaSize;
+  while (p < end) {
+    const char* k = p;
+    const char* kEnd = static_cast<const char*>(std::memchr(k, '\0', static_cast<size_t>(end - k)));
+    if (!kEnd) break;
+    const char* v = kEnd + 1;
+    const char* vEnd = static_cast<const char*>(std::memchr(v, '\0', static_cast<size_t>(end - v)));
+    if (!vEnd) break;
+    if (key.compare(0, std::string::npos, k, static_cast<size_t>(kEnd - k)) == 0) return std::string(v, vEnd);
+    p = vEnd + 1;
+  }
+  return std::nullopt;
+}
+
+// ---------------- TilePackWriter ----------------
+
+TilePackWriter::TilePackWriter(std::string path, uint32_t pageSize)
+  : path_(std::move(path)), tmpPath_(path_ + ".blobs.tmp"), pageSize_(pageSize) {
+  if (pageSize_ == 0 || (pageSize_ & (pageSize_ - 1)) != 0) throw std::runtime_error("Tile pack page size must be a power of two");
+  data_.open(tmpPath_, std::ios::binary | std::ios::trunc);
+  if (!data_) throw std::runtime_error("Failed to create temp file: " + tmpPath_);
+}
+
+TilePackWriter::~TilePackWriter() {
+  if (data_.is_open()) data_.close();
+  if (!finished_) std::remove(tmpPath_.c_str());
+}
+
+void TilePackWriter::addTile(int z, int x, int y, uint32_t version, const void* data, size_t size) {
+  if (finished_) throw std::runtime_error("TilePackWriter: addTile after finish");
+  if (size > UINT32_MAX) throw std::runtime_error("TilePackWriter: tile blob too large");
+  // каждый блоб — с границы страницы (смещения относительные, область блобов тоже выровнена)
+  const uint64_t offset = alignUp(dataSize_, pageSize_);
+  static const char zeros[4096] = {};
+  for (uint64_t pad = offset - dataSize_; pad > 0;) {
+    const auto n = static_cast<std::streamsize>(std::min<uint64_t>(pad, sizeof(zeros)));
+    data_.write(zeros, n);
+    pad -= static_cast<uint64_t>(n);
+  }
+  data_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+  if (!data_) throw std::runtime_error("Failed to write tile pack blob");
+  dataSize_ = offset + size;
+  entries_.push_back(PackEntry{static_cast<uint32_t>(z), static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+                               version, offset, static_cast<uint32_t>(size),
+                               static_cast<uint32_t>(xxh64(data, size))});
+}
+
+void TilePackWriter::setMetadata(const std::string& key, const std::string& value) {
+  for (auto& kv : meta_) {
+    if (kv.first == key) { kv.second = value; return; }
+  }
+  meta_.emplace_back(key, value);
+}
+
+void TilePackWriter::finish() {
+  if (finished_) return;
+  data_.close();
+
+  std::sort(entries_.begin(), entries_.end(), keyLess);
+  for (size_t i = 1; i < entries_.size(); ++i) {
+    if (!keyLess(entries_[i - 1], entries_[i])) throw std::runtime_error("TilePackWriter: duplicate tile key");
+  }
+
+  setMetadata("tile_checksum", "xxh64");  // у каждой записи заполнено поле checksum
+  std::string meta;
+  for (const auto& kv : meta_) {
+    meta.append(kv.first).push_back('\0');
+    meta.append(kv.second).push_back('\0');
+  }
+
+  PackHeader h {};
+  std::memcpy(h.magic, kTilePackMagic, sizeof(h.magic));
+  h.formatVersion = kTilePackFormatVersion;
+  h.pageSize = pageSize_;
+  h.tileCount = static_cast<uint32_t>(entries_.size());
+  h.metaSize = static_cast<uint32_t>(meta.size());
+  h.indexOffset = sizeof(PackHeader);
+  h.metaOffset = h.indexOffset + entries_.size() * sizeof(PackEntry);
+  h.dataOffset = alignUp(h.metaOffset + meta.size(), pageSize_);
+  h.fileSize = h.dataOffset + dataSize_;
+  for (auto& e : entries_) e.offset += h.dataOffset;
+
+  std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+  if (!out) throw std::runtime_error("Failed to create tile pack: " + path_);
+  out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  out.write(reinterpret_cast<const char*>(entries_.data()), static_cast<std::streamsize>(entries_.size() * sizeof(PackEntry)));
+  out.write(meta.data(), static_cast<std::streamsize>(meta.size()));
+  std::string pad(static_cast<size_t>(h.dataOffset - h.metaOffset - meta.size()), '\0');
+  out.write(pad.data(), static_cast<std::streamsize>(pad.size()));
+
+  std::ifstream in(tmpPath_, std::ios::binary);
+  std::vector<char> buf(1 << 20);
+  while (in) {
+    in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+    out.write(buf.data(), in.gcount());
+  }
+  out.flush();
+  if (!out) throw std::runtime_error("Failed to write tile pack: " + path_);
+  out.close();
+  in.close();
+  std::remove(tmpPath_.c_str());
+  finished_ = true;
+}
+
+} // namespace routing_core
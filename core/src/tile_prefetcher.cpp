@@ -0,0 +1,73 @@
+#include "tile_prefetcher.h"
+
+#include <unordered_set>
+
+#include "routing_core/trace.h"
+
+namespace routing_core {
+
+TilePrefetcher::TilePrefetcher(TileStore& store, int threads) : store_(store) {
+  threads_.reserve(static_cast<size_t>(threads));
+  for (int i = 0; i < threads; ++i) threads_.emplace_back([this] { worker(); });
+}
+
+TilePrefetcher::~TilePrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+    queue_ = {};
+  }
+  cv_.notify_all();
+  for (auto& t : threads_) t.join();
+}
+
+uint64_t TilePrefetcher::schedule(const std::vector<std::pair<TileKey, double>>& tiles) {
+  ROUTING_TRACE_SCOPE_ARG("prefetch", "schedule", "tiles", tiles.size());
+  std::unordered_set<TileKey, TileKeyHash> seen;
+  std::vector<Item> items;
+  items.reserve(tiles.size());
+  for (const auto& [key, priority] : tiles) {
+    if (!seen.insert(key).second) continue;
+    if (store_.cachedOrLoading(key.z, key.x, key.y)) continue;
+    items.push_back(Item{priority, 0, key});
+  }
+  uint64_t gen;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    gen = ++generation_;
+    queue_ = {};  // прошлые поколения устарели
+    for (auto& it : items) {
+      it.seq = seq_++;
+      queue_.push(it);
+    }
+  }
+  cv_.notify_all();
+  return gen;
+}
+
+void TilePrefetcher::cancel() {
+  std::lock_guard<std::mutex> lock(mu_);
+  ++generation_;
+  queue_ = {};
+}
+
+void TilePrefetcher::worker() {
+  for (;;) {
+    Item item;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+      if (stop_) return;
+      item = queue_.top();
+      queue_.pop();
+    }
+    ROUTING_TRACE_SCOPE("prefetch", "load");
+    try {
+      store_.load(item.key.z, item.key.x, item.key.y);
+    } catch (...) {
+      // ошибка чтения всплывёт в потоке запроса при синхронной загрузке
+    }
+  }
+}
+
+} // namespace routing_core
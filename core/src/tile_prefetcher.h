@@ -0,0 +1,60 @@
+#pragma once
+
+// Фоновая подгрузка тайлов (не публичный API).
+//
+// Пул потоков читает тайлы через TileStore::load заранее, пока поток запроса
+// занят построением графа по уже загруженным тайлам. Запросы:
+//   - дедуплицируются (тайл в кэше, уже в очереди или читается — пропускаем);
+//   - приоритизируются (меньше priority — раньше);
+//   - отменяются при устаревании: schedule() начинает новое поколение, и всё,
+//     что осталось в очереди от прошлых, выбрасывается.
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "routing_core/tile_store.h"
+
+namespace routing_core {
+
+class TilePrefetcher {
+public:
+  TilePrefetcher(TileStore& store, int threads);
+  ~TilePrefetcher();
+  TilePrefetcher(const TilePrefetcher&) = delete;
+  TilePrefetcher& operator=(const TilePrefetcher&) = delete;
+
+  // Новое поколение запросов: (тайл, приоритет). Возвращает номер поколения.
+  uint64_t schedule(const std::vector<std::pair<TileKey, double>>& tiles);
+  // Отменить всё, что ещё не начали читать.
+  void cancel();
+
+private:
+  struct Item {
+    double priority;
+    uint64_t seq;  // порядок постановки — при равных приоритетах FIFO
+    TileKey key;
+  };
+  struct Later {
+    bool operator()(const Item& a, const Item& b) const {
+      return a.priority != b.priority ? a.priority > b.priority : a.seq > b.seq;
+    }
+  };
+
+  void worker();
+
+  TileStore& store_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::priority_queue<Item, std::vector<Item>, Later> queue_;
+  uint64_t generation_ {0};
+  uint64_t seq_ {0};
+  bool stop_ {false};
+  std::vector<std::thread> threads_;
+};
+
+} // namespace routing_core
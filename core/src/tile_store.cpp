@@ -1,49 +1,218 @@
 #include "routing_core/tile_store.h"
+#include "routing_core/base64.h"
+#include "routing_core/tile_pack.h"
+#include "routing_core/tile_view.h"
+#include "routing_core/trace.h"
+#include "routing_core/xxhash64.h"
+#include "batch_file_reader.h"
+#include "tile_codec.h"
 
 #include <stdexcept>
+#include <cstdlib>
 #include <cstring>
+#include <string>
 
 using namespace routing_core;
 
-TileStore::TileStore(const std::string& db_path, size_t cacheCapacity)
-  : capacity_(cacheCapacity) {
+namespace {
+
+// Хранимых байт в одном пакете чтения: буфер пакета не растёт с размером запроса.
+constexpr size_t kBatchReadBytes = 16u << 20;
+
+[[noreturn]] void throwChecksumMismatch(int z, int x, int y) {
+  const char* layer = (z & kGeometryLayerBit) ? " (geometry)" : "";
+  throw TileDataError("Tile checksum mismatch: " + std::to_string(z & ~kGeometryLayerBit) + "/" +
+                      std::to_string(x) + "/" + std::to_string(y) + layer + ", routingdb is corrupted");
+}
+
+} // namespace
+
+TileStore::TileStore(const std::string& db_path, size_t cacheCapacity, size_t cacheBytes)
+  : capacity_(cacheCapacity), budget_(cacheBytes) {
+  if (isTilePack(db_path)) {
+    pack_ = std::make_shared<TilePackReader>(db_path);
+    packPath_ = db_path;
+    initFormat();
+    return;
+  }
+  dbPath_ = db_path;
   if (sqlite3_open(db_path.c_str(), &db_) != SQLITE_OK) {
     throw std::runtime_error(std::string("Failed to open routingdb: ") + sqlite3_errmsg(db_));
   }
   sqlite3_exec(db_, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
   sqlite3_exec(db_, "PRAGMA synchronous=NORMAL;", nullptr, nullptr, nullptr);
   sqlite3_exec(db_, "PRAGMA temp_store=MEMORY;", nullptr, nullptr, nullptr);
+  try {
+    initFormat();
+  } catch (...) {
+    sqlite3_close(db_);
+    db_ = nullptr;
+    throw;
+  }
+}
+
+// Формат тайлов из метаданных: версия схемы и сжатие блобов.
+void TileStore::initFormat() {
+  if (auto v = metadata("schema_version"); v && !v->empty()) {
+    schemaVersion_ = std::atoi(v->c_str());
+    if (schemaVersion_ < 1 || schemaVersion_ > 2) {
+      throw std::runtime_error("Unsupported routingdb schema_version: " + *v);
+    }
+  }
+  auto layer = metadata("geometry_layer");
+  geometryLayer_ = schemaVersion_ >= 2 && layer && *layer == "separate";
+  auto checksum = metadata("tile_checksum");
+  hasChecksums_ = checksum && *checksum == "xxh64";
+  auto compression = metadata("tile_compression");
+  if (!compression || compression->empty() || *compression == "none") return;
+  if (*compression != "zstd") throw std::runtime_error("Unsupported tile compression: " + *compression);
+  std::vector<uint8_t> dict;
+  if (auto enc = metadata("zstd_dict")) {
+    auto dec = base64Decode(*enc);
+    if (!dec) throw std::runtime_error("Malformed zstd_dict in routingdb metadata");
+    dict = std::move(*dec);
+  }
+  codec_ = std::make_unique<TileDecompressor>(dict);
+}
+
+// Блоб из байтов хранилища: сжатый распаковывается в собственный буфер, иначе копируется.
+std::shared_ptr<TileBlob> TileStore::makeBlob(int z, int x, int y, const uint8_t* data, size_t size) {
+  std::shared_ptr<std::vector<uint8_t>> vec;
+  if (codec_ && TileDecompressor::isCompressed(data, size)) {
+    vec = codec_->decompress(data, size);
+  } else {
+    vec = std::make_shared<std::vector<uint8_t>>(data, data + size);
+  }
+  auto out = std::make_shared<TileBlob>();
+  out->key = TileKey{z, x, y};
+  out->data = vec->data();
+  out->size = vec->size();
+  out->storedSize = size;
+  out->schemaVersion = schemaVersion_;
+  out->owner = std::move(vec);
+  return out;
 }
 
 TileStore::~TileStore() {
+  for (auto& r : readers_) {
+    sqlite3_finalize(r.stmt);
+    sqlite3_finalize(r.geomStmt);
+    sqlite3_close(r.db);
+  }
   if (db_) sqlite3_close(db_);
 }
 
-std::shared_ptr<TileBlob> TileStore::load(int z, int x, int y) {
-  TileKey key{z,x,y};
-  auto it = map_.find(key);
-  if (it != map_.end()) {
-    // move to front
-    lru_.erase(it->second.it);
-    lru_.push_front(key);
-    it->second.it = lru_.begin();
-    return it->second.blob;
+TileStore::Reader TileStore::acquireReader() {
+  {
+    std::lock_guard<std::mutex> lock(readersMu_);
+    if (!readers_.empty()) {
+      Reader r = readers_.back();
+      readers_.pop_back();
+      return r;
+    }
+  }
+  Reader r;
+  if (sqlite3_open_v2(dbPath_.c_str(), &r.db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+    std::string msg = std::string("Failed to open routingdb: ") + sqlite3_errmsg(r.db);
+    sqlite3_close(r.db);
+    throw std::runtime_error(msg);
+  }
+  static const char* sql =
+      "SELECT data, checksum FROM land_tiles WHERE z=? AND x=? AND y=? LIMIT 1;";
+  if (sqlite3_prepare_v2(r.db, sql, -1, &r.stmt, nullptr) != SQLITE_OK) {
+    std::string msg = std::string("Failed to prepare tile query: ") + sqlite3_errmsg(r.db);
+    sqlite3_close(r.db);
+    throw std::runtime_error(msg);
+  }
+  if (geometryLayer_) {
+    static const char* geomSql =
+        "SELECT data FROM land_geometry WHERE z=? AND x=? AND y=? LIMIT 1;";
+    if (sqlite3_prepare_v2(r.db, geomSql, -1, &r.geomStmt, nullptr) != SQLITE_OK) {
+      std::string msg = std::string("Failed to prepare geometry query: ") + sqlite3_errmsg(r.db);
+      sqlite3_finalize(r.stmt);
+      sqlite3_close(r.db);
+      throw std::runtime_error(msg);
+    }
   }
+  return r;
+}
 
-  auto blob = loadFromDb(z,x,y);
-  if (!blob) return nullptr;
-  insertLRU(key, blob);
-  return blob;
+void TileStore::releaseReader(Reader r) {
+  sqlite3_reset(r.stmt);
+  if (r.geomStmt) sqlite3_reset(r.geomStmt);
+  std::lock_guard<std::mutex> lock(readersMu_);
+  readers_.push_back(r);
 }
 
-std::shared_ptr<TileBlob> TileStore::loadFromDb(int z, int x, int y) {
-  static const char* sql =
-      "SELECT data FROM land_tiles WHERE z=? AND x=? AND y=? LIMIT 1;";
-  sqlite3_stmt* stmt = nullptr;
-  if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-    return nullptr;
+std::shared_ptr<TileBlob> TileStore::load(int z, int x, int y, TileLoadStats* stats) {
+  return loadKey(TileKey{z, x, y}, stats);
+}
+
+std::shared_ptr<TileBlob> TileStore::loadGeometry(int z, int x, int y, TileLoadStats* stats) {
+  if (!geometryLayer_) return nullptr;
+  return loadKey(TileKey{z | kGeometryLayerBit, x, y}, stats);
+}
+
+// Общий путь загрузки; слой геометрии — ключи с z | kGeometryLayerBit в том же кэше.
+std::shared_ptr<TileBlob> TileStore::loadKey(const TileKey& key, TileLoadStats* stats) {
+  const int z = key.z, x = key.x, y = key.y;
+  if (stats) ++stats->requested;
+  std::unique_lock<std::mutex> lock(mu_);
+  for (;;) {
+    auto it = map_.find(key);
+    if (it != map_.end()) {
+      if (stats) ++stats->hits;
+      // move to front
+      lru_.erase(it->second.it);
+      lru_.push_front(key);
+      it->second.it = lru_.begin();
+      return it->second.blob;
+    }
+    if (!inflight_.count(key)) break;
+    // тайл уже читает другой поток (префетчер) — дождаться и перепроверить кэш
+    loaded_.wait(lock);
+  }
+  inflight_.insert(key);
+  const uint64_t generation = generation_;
+  const bool verify = verify_ && !verified_.count(key);
+  lock.unlock();
+
+  std::shared_ptr<TileBlob> blob;
+  try {
+    blob = pack_ ? loadFromPack(z,x,y,verify) : loadFromDb(z,x,y,verify);
+  } catch (...) {
+    lock.lock();
+    inflight_.erase(key);
+    loaded_.notify_all();
+    throw;
+  }
+  if (stats) {
+    ++stats->misses;
+    if (blob) stats->bytesRead += blob->storedSize;
   }
-  sqlite3_bind_int(stmt, 1, z);
+
+  lock.lock();
+  // Тайл изменили, пока он читался: прочитанное могло устареть — не кэшируем
+  if (generation == generation_) {
+    insertLRU(key, blob);
+    if (verify && blob) verified_.insert(key);
+  }
+  inflight_.erase(key);
+  loaded_.notify_all();
+  return blob;
+}
+
+bool TileStore::cachedOrLoading(int z, int x, int y) const {
+  TileKey key{z,x,y};
+  std::lock_guard<std::mutex> lock(mu_);
+  return map_.count(key) != 0 || inflight_.count(key) != 0;
+}
+
+std::shared_ptr<TileBlob> TileStore::loadFromDb(int z, int x, int y, bool verify) {
+  ROUTING_TRACE_SCOPE("tile_store", "load_db");
+  Reader reader = acquireReader();
+  sqlite3_stmt* stmt = (z & kGeometryLayerBit) ? reader.geomStmt : reader.stmt;
+  sqlite3_bind_int(stmt, 1, z & ~kGeometryLayerBit);
   sqlite3_bind_int(stmt, 2, x);
   sqlite3_bind_int(stmt, 3, y);
 
@@ -52,25 +221,284 @@ std::shared_ptr<TileBlob> TileStore::loadFromDb(int z, int x, int y) {
   if (rc == SQLITE_ROW) {
     const void* blob = sqlite3_column_blob(stmt, 0);
     int size = sqlite3_column_bytes(stmt, 0);
+    // Сверяем хранимые байты (до распаковки); у land_geometry контрольных сумм нет
+    if (verify && blob && size > 0 && !(z & kGeometryLayerBit)) {
+      ROUTING_TRACE_SCOPE("tile_store", "verify");
+      const auto* stored = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+      if (!stored || xxh64Hex(blob, static_cast<size_t>(size)) != stored) {
+        releaseReader(reader);
+        throwChecksumMismatch(z, x, y);
+      }
+    }
     if (blob && size > 0) {
-      auto vec = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(size));
-      std::memcpy(vec->data(), blob, static_cast<size_t>(size));
-      out = std::make_shared<TileBlob>();
-      out->key = TileKey{z, x, y};
-      out->buffer = std::move(vec);
+      try {
+        out = makeBlob(z, x, y, static_cast<const uint8_t*>(blob), static_cast<size_t>(size));
+      } catch (...) {
+        releaseReader(reader);
+        throw;
+      }
+    }
+  }
+  releaseReader(reader);
+  return out;
+}
+
+std::shared_ptr<TileBlob> TileStore::loadFromPack(int z, int x, int y, bool verify) {
+  ROUTING_TRACE_SCOPE("tile_store", "load_pack");
+  const PackEntry* e = pack_->find(z, x, y);
+  if (!e || e->length == 0) return nullptr;
+  pack_->willNeed(*e);
+  return packBlob(TileKey{z, x, y}, *e, pack_->data(*e), verify);
+}
+
+// Блоб записи пака. stored — её байты: отображение или буфер пакетного чтения. Несжатый
+// блоб всегда отдаётся из отображения: после пакетного чтения его страницы уже в page cache.
+std::shared_ptr<TileBlob> TileStore::packBlob(const TileKey& key, const PackEntry& e, const uint8_t* stored,
+                                              bool verify) {
+  if (verify) {
+    // Хэш читает блоб целиком: страницы, которые TileView всё равно бы тронул
+    ROUTING_TRACE_SCOPE("tile_store", "verify");
+    if (static_cast<uint32_t>(xxh64(stored, e.length)) != e.checksum) throwChecksumMismatch(key.z, key.x, key.y);
+  }
+  if (codec_ && TileDecompressor::isCompressed(stored, e.length)) {
+    return makeBlob(key.z, key.x, key.y, stored, e.length);
+  }
+  auto out = std::make_shared<TileBlob>();
+  out->key = key;
+  out->data = pack_->data(e);
+  out->size = e.length;
+  out->owner = pack_;  // без копирования: блоб живёт в отображении
+  out->mapped = true;
+  out->storedSize = e.length;
+  out->schemaVersion = schemaVersion_;
+  return out;
+}
+
+void TileStore::enableBatchReads(int fallbackThreads, bool ioUring) {
+  if (!pack_) return;
+  batch_ = std::make_unique<BatchFileReader>(packPath_, fallbackThreads, ioUring);
+}
+
+bool TileStore::enableIoUringBatchReads() {
+  if (!pack_) return false;
+  auto reader = std::make_unique<BatchFileReader>(packPath_, 0);
+  if (!reader->usesIoUring()) return false;
+  batch_ = std::move(reader);
+  return true;
+}
+
+std::vector<std::shared_ptr<TileBlob>> TileStore::loadBatch(const std::vector<TileKey>& keys, TileLoadStats* stats) {
+  std::vector<std::shared_ptr<TileBlob>> out(keys.size());
+  if (!batch_) {
+    for (size_t i = 0; i < keys.size(); ++i) out[i] = loadKey(keys[i], stats);
+    return out;
+  }
+  ROUTING_TRACE_SCOPE_ARG("tile_store", "load_batch", "tiles", keys.size());
+  // Под блокировкой: попадания отдаём сразу, свои промахи помечаем в inflight_ (как loadKey).
+  // Тайлы, которые читает другой поток, и повторы ключей — после пакета через loadKey.
+  struct Miss {
+    size_t index;
+    bool verify;
+    const PackEntry* entry;
+  };
+  std::vector<Miss> misses;
+  std::vector<size_t> waits;
+  uint64_t generation = 0;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    generation = generation_;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const TileKey& key = keys[i];
+      if (inflight_.count(key)) {
+        waits.push_back(i);
+        continue;
+      }
+      if (stats) ++stats->requested;
+      auto it = map_.find(key);
+      if (it != map_.end()) {
+        if (stats) ++stats->hits;
+        lru_.splice(lru_.begin(), lru_, it->second.it);
+        out[i] = it->second.blob;
+        continue;
+      }
+      inflight_.insert(key);
+      misses.push_back(Miss{i, verify_ && !verified_.count(key), nullptr});
     }
   }
+
+  size_t published = 0;  // misses[0, published) уже в кэше и сняты с inflight_
+  try {
+    std::unique_ptr<uint8_t[]> buffer;
+    size_t bufferSize = 0;
+    std::vector<FileReadRequest> requests;
+    while (published < misses.size()) {
+      // пакет: до kBatchReadBytes хранимых байт, но хотя бы один тайл
+      size_t end = published, bytes = 0;
+      for (; end < misses.size(); ++end) {
+        Miss& m = misses[end];
+        const TileKey& key = keys[m.index];
+        m.entry = pack_->find(key.z, key.x, key.y);
+        const size_t length = m.entry ? m.entry->length : 0;
+        if (end > published && bytes + length > kBatchReadBytes) break;
+        bytes += length;
+      }
+      if (bytes > bufferSize) {
+        buffer = std::make_unique_for_overwrite<uint8_t[]>(bytes);
+        bufferSize = bytes;
+      }
+      requests.clear();
+      for (size_t k = published, pos = 0; k < end; ++k) {
+        const PackEntry* e = misses[k].entry;
+        if (!e || e->length == 0) continue;
+        requests.push_back(FileReadRequest{e->offset, e->length, buffer.get() + pos});
+        pos += e->length;
+      }
+      {
+        ROUTING_TRACE_SCOPE_ARG("tile_store", "batch_read", "tiles", requests.size());
+        batch_->read(requests);
+      }
+      for (size_t k = published, pos = 0; k < end; ++k) {
+        const Miss& m = misses[k];
+        if (!m.entry || m.entry->length == 0) continue;
+        out[m.index] = packBlob(keys[m.index], *m.entry, buffer.get() + pos, m.verify);
+        pos += m.entry->length;
+      }
+
+      std::lock_guard<std::mutex> lock(mu_);
+      for (; published < end; ++published) {
+        const Miss& m = misses[published];
+        const TileKey& key = keys[m.index];
+        const auto& blob = out[m.index];
+        // Тайл изменили, пока он читался: прочитанное могло устареть — не кэшируем
+        if (generation == generation_) {
+          insertLRU(key, blob);
+          if (m.verify && blob) verified_.insert(key);
+        }
+        inflight_.erase(key);
+        if (stats) {
+          ++stats->misses;
+          if (blob) stats->bytesRead += blob->storedSize;
+        }
+      }
+      loaded_.notify_all();
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mu_);
+    for (size_t k = published; k < misses.size(); ++k) inflight_.erase(keys[misses[k].index]);
+    loaded_.notify_all();
+    throw;
+  }
+
+  for (size_t i : waits) out[i] = loadKey(keys[i], stats);
+  return out;
+}
+
+std::optional<std::string> TileStore::metadata(const std::string& key) const {
+  if (pack_) return pack_->metadata(key);
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v2(db_, "SELECT value FROM metadata WHERE key=? LIMIT 1;", -1, &stmt, nullptr) != SQLITE_OK) {
+    return std::nullopt;
+  }
+  sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
+  std::optional<std::string> out;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    const auto* v = sqlite3_column_text(stmt, 0);
+    if (v) out = std::string(reinterpret_cast<const char*>(v));
+  }
   sqlite3_finalize(stmt);
   return out;
 }
 
-void TileStore::insertLRU(const TileKey& key, std::shared_ptr<TileBlob> blob) {
-  if (capacity_ == 0) return;
-  if (lru_.size() >= capacity_) {
+// Стоимость записи: служебные структуры + собственные байты блоба + производные индексы.
+// Страницы mmap пака не считаем: они файловые и чистые, ОС вытесняет их сама.
+size_t TileStore::entryCost(const TileBlob* blob) {
+  size_t cost = 128;  // узел списка, слот хэш-таблицы, TileBlob
+  if (blob) {
+    if (!blob->mapped) cost += blob->size;
+    if (blob->inIndex) cost += blob->inIndex->bytes();
+  }
+  return cost;
+}
+
+void TileStore::evictOverBudget(size_t targetBytes, size_t targetCount) {
+  // size-aware LRU: снимаем с хвоста, пока не уложимся и по байтам, и по числу записей
+  while (!lru_.empty() && (bytes_ > targetBytes || lru_.size() > targetCount)) {
     auto last = lru_.back();
     lru_.pop_back();
-    map_.erase(last);
+    auto it = map_.find(last);
+    bytes_ -= it->second.cost;
+    map_.erase(it);
   }
+}
+
+void TileStore::insertLRU(const TileKey& key, std::shared_ptr<TileBlob> blob) {
+  if (capacity_ == 0) return;
+  const size_t cost = entryCost(blob.get());
+  if (cost > budget_) return;  // тайл больше всего бюджета не кэшируем
+  evictOverBudget(budget_ - cost, capacity_ - 1);
   lru_.push_front(key);
-  map_[key] = CacheEntry{std::move(blob), lru_.begin()};
+  map_[key] = CacheEntry{std::move(blob), lru_.begin(), cost};
+  bytes_ += cost;
+}
+
+void TileStore::attachInIndex(const TileKey& key, std::shared_ptr<const TileInIndex> index) {
+  if (!index) return;
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = map_.find(key);
+  if (it == map_.end() || !it->second.blob || it->second.blob->inIndex) return;
+  // блобы неизменяемы (их могут читать другие потоки) — подменяем запись копией с индексом
+  auto blob = std::make_shared<TileBlob>(*it->second.blob);
+  blob->inIndex = std::move(index);
+  const size_t cost = entryCost(blob.get());
+  bytes_ += cost - it->second.cost;
+  it->second.cost = cost;
+  it->second.blob = std::move(blob);
+  // свежая запись в голове списка; если бюджет превышен — вытесняем с хвоста
+  lru_.erase(it->second.it);
+  lru_.push_front(key);
+  it->second.it = lru_.begin();
+  evictOverBudget(budget_, capacity_);
+}
+
+void TileStore::invalidate(const std::vector<TileKey>& keys) {
+  std::lock_guard<std::mutex> lock(mu_);
+  ++generation_;
+  for (const auto& key : keys) {
+    verified_.erase(key);
+    auto it = map_.find(key);
+    if (it == map_.end()) continue;
+    bytes_ -= it->second.cost;
+    lru_.erase(it->second.it);
+    map_.erase(it);
+  }
+}
+
+uint64_t TileStore::generation() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return generation_;
+}
+
+void TileStore::trimCache(size_t targetBytes) {
+  std::lock_guard<std::mutex> lock(mu_);
+  evictOverBudget(targetBytes, capacity_);
+}
+
+size_t TileStore::cachedBytes() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return bytes_;
+}
+
+void TileStore::releaseBackendMemory() {
+  if (pack_) pack_->releasePages();
+  std::vector<Reader> idle;
+  {
+    std::lock_guard<std::mutex> lock(readersMu_);
+    idle.swap(readers_);
+  }
+  for (auto& r : idle) {
+    sqlite3_finalize(r.stmt);
+    sqlite3_finalize(r.geomStmt);
+    sqlite3_close(r.db);
+  }
+  if (db_) sqlite3_db_release_memory(db_);
 }
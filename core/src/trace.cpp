@@ -0,0 +1,153 @@
+#include "routing_core/trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace routing_core::trace {
+
+namespace {
+
+struct Event {
+  const char* cat;
+  const char* name;
+  const char* argName;
+  int64_t arg;
+  uint64_t startNs;
+  uint64_t durNs;
+  uint32_t tid;
+  std::atomic<uint32_t> seq {0}; // номер записи + 1; 0 — слот пуст
+};
+
+struct Ring {
+  std::unique_ptr<Event[]> events;
+  size_t mask {0};
+  std::atomic<uint64_t> head {0};
+};
+
+Ring g_ring;
+std::mutex g_ringMutex; // enable()/dump()/clear(); на горячем пути не берётся
+std::string g_envPath;
+
+uint32_t threadIndex() {
+  static std::atomic<uint32_t> next {1};
+  thread_local uint32_t tid = next.fetch_add(1, std::memory_order_relaxed);
+  return tid;
+}
+
+const uint64_t g_epochNs = static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+
+void writeEscaped(std::FILE* f, const char* s) {
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\') std::fputc('\\', f);
+    std::fputc(*s, f);
+  }
+}
+
+void dumpAtExit() {
+  if (!g_envPath.empty()) dump(g_envPath);
+}
+
+} // namespace
+
+namespace detail {
+
+std::atomic<bool> g_enabled {false};
+
+uint64_t nowNs() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count()) - g_epochNs;
+}
+
+void record(const char* cat, const char* name, uint64_t startNs, uint64_t durNs,
+            const char* argName, int64_t argValue) {
+  if (!g_ring.events) return;
+  const uint64_t n = g_ring.head.fetch_add(1, std::memory_order_relaxed);
+  Event& e = g_ring.events[n & g_ring.mask];
+  e.seq.store(0, std::memory_order_relaxed);
+  e.cat = cat; e.name = name; e.argName = argName; e.arg = argValue;
+  e.startNs = startNs; e.durNs = durNs; e.tid = threadIndex();
+  e.seq.store(static_cast<uint32_t>(n) + 1, std::memory_order_release);
+}
+
+} // namespace detail
+
+void enable(size_t capacity) {
+  std::lock_guard<std::mutex> lock(g_ringMutex);
+  if (!g_ring.events) {
+    size_t cap = 1;
+    while (cap < capacity) cap <<= 1;
+    g_ring.events.reset(new Event[cap]);
+    g_ring.mask = cap - 1;
+  }
+  detail::g_enabled.store(true, std::memory_order_release);
+}
+
+void disable() {
+  detail::g_enabled.store(false, std::memory_order_relaxed);
+}
+
+bool enableFromEnv() {
+  static std::once_flag once;
+  static bool on = false;
+  std::call_once(once, [] {
+    const char* path = std::getenv("LOXX_TRACE");
+    if (!path || !*path) return;
+    g_envPath = path;
+    enable();
+    std::atexit(dumpAtExit);
+    on = true;
+  });
+  return on;
+}
+
+void clear() {
+  std::lock_guard<std::mutex> lock(g_ringMutex);
+  if (!g_ring.events) return;
+  for (size_t i = 0; i <= g_ring.mask; ++i) g_ring.events[i].seq.store(0, std::memory_order_relaxed);
+  g_ring.head.store(0, std::memory_order_relaxed);
+}
+
+bool dump(const std::string& path) {
+  std::lock_guard<std::mutex> lock(g_ringMutex);
+  std::FILE* f = std::fopen(path.c_str(), "w");
+  if (!f) return false;
+  const int pid = static_cast<int>(::getpid());
+  std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+  bool first = true;
+  if (g_ring.events) {
+    const uint64_t head = g_ring.head.load(std::memory_order_acquire);
+    const uint64_t cap = g_ring.mask + 1;
+    const uint64_t begin = head > cap ? head - cap : 0;
+    for (uint64_t n = begin; n < head; ++n) {
+      const Event& e = g_ring.events[n & g_ring.mask];
+      if (e.seq.load(std::memory_order_acquire) != static_cast<uint32_t>(n) + 1) continue;
+      std::fprintf(f, "%s{\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"cat\":\"",
+                   first ? "" : ",\n", pid, e.tid, e.startNs / 1000.0, e.durNs / 1000.0);
+      writeEscaped(f, e.cat);
+      std::fputs("\",\"name\":\"", f);
+      writeEscaped(f, e.name);
+      std::fputc('"', f);
+      if (e.argName) {
+        std::fputs(",\"args\":{\"", f);
+        writeEscaped(f, e.argName);
+        std::fprintf(f, "\":%lld}", static_cast<long long>(e.arg));
+      }
+      std::fputc('}', f);
+      first = false;
+    }
+  }
+  std::fputs("\n]}\n", f);
+  return std::fclose(f) == 0;
+}
+
+} // namespace routing_core::trace
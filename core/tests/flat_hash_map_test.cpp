@@ -0,0 +1,40 @@
+// FlatHashMap: поиск существующего ключа через try_emplace/operator[] не перестраивает таблицу.
+
+#include <cstdint>
+
+#include "routing_core/flat_hash_map.h"
+#include "test_check.h"
+
+using namespace routing_core;
+
+// 12 записей в 16 ячейках — ровно порог 3/4: следующая вставка растит таблицу.
+TEST(existing_key_at_full_load_keeps_references) {
+  FlatHashMap<uint64_t, int> map;
+  for (uint64_t k = 0; k < 12; ++k) map[k] = static_cast<int>(k);
+  int* ref = &map.at(5);
+  const auto [it, inserted] = map.try_emplace(5, 100);
+  CHECK(!inserted);
+  CHECK(&it->second == ref);
+  CHECK(&map[7] == &map.at(7));
+  CHECK(&map.at(5) == ref);
+  CHECK(map.size() == 12);
+}
+
+TEST(new_key_at_full_load_grows) {
+  FlatHashMap<uint64_t, int> map;
+  for (uint64_t k = 0; k < 12; ++k) map[k] = static_cast<int>(k);
+  const auto [it, inserted] = map.try_emplace(12, 12);
+  CHECK(inserted);
+  CHECK(it->first == 12 && it->second == 12);
+  CHECK(map.size() == 13);
+  for (uint64_t k = 0; k <= 12; ++k) CHECK(map.at(k) == static_cast<int>(k));
+}
+
+TEST(first_insert_into_empty_map) {
+  FlatHashMap<uint64_t, int> map;
+  CHECK(!map.contains(1));
+  map[1] = 10;
+  CHECK(map.size() == 1 && map.at(1) == 10);
+}
+
+int main() { return routing_test::runAll(); }
@@ -0,0 +1,130 @@
+// Повреждённые тайлы: Router::route отвечает RouteStatus::DATA_ERROR, а не исключением.
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "routing_core/router.h"
+#include "routing_core/tile_pack.h"
+#include "synthetic_tiles.h"
+#include "temp_db.h"
+#include "test_check.h"
+
+using namespace routing_core;
+using namespace routing_bench;
+using routing_test::SyntheticDb;
+using routing_test::TempFile;
+using routing_test::tempPath;
+
+namespace {
+
+// Перевернуть байт в середине data каждого тайла; checksum остаётся прежним.
+void corruptDbTiles(const std::string& path) {
+  sqlite3* db = nullptr;
+  sqlite3_open(path.c_str(), &db);
+  sqlite3_exec(db, "UPDATE land_tiles SET data = substr(data, 1, length(data) / 2) || x'5A' ||"
+                   " substr(data, length(data) / 2 + 2);", nullptr, nullptr, nullptr);
+  sqlite3_close(db);
+}
+
+// Обрезать data каждого тайла вдвое (сжатый кадр не распакуется).
+void truncateDbTiles(const std::string& path) {
+  sqlite3* db = nullptr;
+  sqlite3_open(path.c_str(), &db);
+  sqlite3_exec(db, "UPDATE land_tiles SET data = substr(data, 1, length(data) / 2);", nullptr, nullptr, nullptr);
+  sqlite3_close(db);
+}
+
+void corruptPackTiles(const std::string& path, const std::vector<SyntheticTile>& tiles) {
+  std::vector<uint64_t> offsets;
+  {
+    TilePackReader pack(path);
+    for (const auto& t : tiles) {
+      const PackEntry* e = pack.find(t.key.z, t.key.x, t.key.y);
+      if (e && e->length) offsets.push_back(e->offset + e->length / 2);
+    }
+  }
+  std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+  for (uint64_t off : offsets) {
+    f.seekg(static_cast<std::streamoff>(off));
+    const char c = static_cast<char>(f.get() ^ 0x5A);
+    f.seekp(static_cast<std::streamoff>(off));
+    f.put(c);
+  }
+}
+
+RouteResult routeAcross(const SyntheticSpec& spec, const std::string& path, RouterOptions opt = {}) {
+  opt.tileZoom = spec.z;
+  Router router(path, opt);
+  const auto a = syntheticPoint(spec, 0.1, 0.1);
+  const auto b = syntheticPoint(spec, 0.9, 0.9);
+  return router.route(makeCarProfile(), {{a.first, a.second}, {b.first, b.second}});
+}
+
+} // namespace
+
+TEST(intact_db_routes) {
+  SyntheticDb db(".routingdb");
+  CHECK(routeAcross(db.spec, db.path).status == RouteStatus::OK);
+}
+
+TEST(checksum_mismatch_in_db_is_data_error) {
+  SyntheticDb db(".routingdb");
+  corruptDbTiles(db.path);
+  RouterOptions opt;
+  opt.verifyTileChecksums = true;
+  RouteResult rr;
+  try {
+    rr = routeAcross(db.spec, db.path, opt);
+  } catch (const std::exception& e) {
+    std::printf("  route threw: %s\n", e.what());
+    REQUIRE(false);
+  }
+  CHECK(rr.status == RouteStatus::DATA_ERROR);
+  CHECK(rr.error_message.find("checksum") != std::string::npos);
+}
+
+TEST(checksum_mismatch_in_pack_is_data_error) {
+  SyntheticSpec spec;
+  const auto tiles = makeSyntheticTiles(spec);
+  for (bool batch : {false, true}) {
+    TempFile pack{tempPath(".routingpack")};
+    writeSyntheticRoutingPack(pack.path, tiles);
+    corruptPackTiles(pack.path, tiles);
+    RouterOptions opt;
+    opt.verifyTileChecksums = true;
+    opt.batchTileReads = batch;
+    RouteResult rr;
+    try {
+      rr = routeAcross(spec, pack.path, opt);
+    } catch (const std::exception& e) {
+      std::printf("  route threw (batch=%d): %s\n", batch, e.what());
+      REQUIRE(false);
+    }
+    CHECK(rr.status == RouteStatus::DATA_ERROR);
+  }
+}
+
+#ifdef ROUTING_CORE_HAVE_ZSTD
+TEST(broken_zstd_frame_is_data_error) {
+  SyntheticSpec spec;
+  auto [ztiles, zmeta] = compressSyntheticTiles(makeSyntheticTiles(spec));
+  TempFile db{tempPath("_zstd.routingdb")};
+  writeSyntheticRoutingDb(db.path, ztiles, zmeta);
+  truncateDbTiles(db.path);
+  RouteResult rr;
+  try {
+    rr = routeAcross(spec, db.path);
+  } catch (const std::exception& e) {
+    std::printf("  route threw: %s\n", e.what());
+    REQUIRE(false);
+  }
+  CHECK(rr.status == RouteStatus::DATA_ERROR);
+  CHECK(rr.error_message.find("decompress") != std::string::npos);
+}
+#endif
+
+int main() { return routing_test::runAll(); }
@@ -0,0 +1,99 @@
+// Параллельный bi-A* (parallelSearchMinNodes): тот же маршрут, что и в одном потоке.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <thread>
+
+#include "router_impl.h"
+#include "synthetic_tiles.h"
+#include "temp_db.h"
+#include "test_check.h"
+
+using namespace routing_core;
+using namespace routing_bench;
+using routing_test::SyntheticDb;
+
+namespace {
+
+constexpr const char* kDbSuffix = "_search.routingdb";
+
+RouteResult routeAcross(const SyntheticDb& db, Router& router) {
+  const auto a = syntheticPoint(db.spec, 0.1, 0.1);
+  const auto b = syntheticPoint(db.spec, 0.9, 0.9);
+  // пеший профиль: эвристика не завышает время, останов точный в обоих режимах
+  return router.route(makeFootProfile(), {{a.first, a.second}, {b.first, b.second}});
+}
+
+RouteResult routeWith(const SyntheticDb& db, RouterOptions opt) {
+  opt.tileZoom = db.spec.z;
+  Router router(db.path, opt);
+  return routeAcross(db, router);
+}
+
+// Держит поток пула, пока не отпустят (или до выхода из теста).
+struct PoolBlocker {
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  std::atomic<bool> started {false};
+
+  bool occupy(TaskPool& pool) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    // копия shared_future держит общее состояние, пока поток пула не выйдет из wait()
+    while (!pool.tryStart([this, gate = released] { started.store(true); gate.wait(); })) {
+      if (std::chrono::steady_clock::now() > deadline) return false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    while (!started.load()) std::this_thread::yield();
+    return true;
+  }
+  ~PoolBlocker() { release.set_value(); }
+};
+
+} // namespace
+
+TEST(parallel_search_matches_sequential) {
+  SyntheticDb db(kDbSuffix);
+  const RouteResult seq = routeWith(db, {});
+  REQUIRE(seq.status == RouteStatus::OK);
+  for (int graphThreads : {0, 2}) {
+    RouterOptions opt;
+    opt.parallelSearchMinNodes = 1;
+    opt.graphThreads = graphThreads;
+    for (int k = 0; k < 5; ++k) {
+      const RouteResult par = routeWith(db, opt);
+      REQUIRE(par.status == RouteStatus::OK);
+      if (std::abs(par.duration_s - seq.duration_s) > 1e-6) {
+        std::printf("  graphThreads=%d: %.3f s vs %.3f s\n", graphThreads, par.duration_s, seq.duration_s);
+        CHECK(false);
+        return;
+      }
+    }
+  }
+}
+
+// Поток пула занят другим запросом: поиск не ждёт его с одним направлением, а идёт
+// последовательно — тот же обход, что и без параллельного режима.
+TEST(busy_pool_falls_back_to_sequential_search) {
+  SyntheticDb db(kDbSuffix);
+  RouterOptions opt;
+  opt.collectStats = true;
+  const RouteResult seq = routeWith(db, opt);
+  REQUIRE(seq.status == RouteStatus::OK && seq.stats);
+
+  opt.tileZoom = db.spec.z;
+  opt.parallelSearchMinNodes = 1;
+  Router router(db.path, opt);
+  PoolBlocker blocker;  // после router: отпускает поток раньше, чем пул останавливается
+  auto& impl = RouterInternals::impl(router);
+  REQUIRE(impl.searchPool && blocker.occupy(*impl.searchPool));
+  const RouteResult par = routeAcross(db, router);
+  REQUIRE(par.status == RouteStatus::OK && par.stats);
+  CHECK(std::abs(par.duration_s - seq.duration_s) < 1e-6);
+  CHECK(par.stats->forward.settled == seq.stats->forward.settled);
+  CHECK(par.stats->backward.settled == seq.stats->backward.settled);
+}
+
+int main() { return routing_test::runAll(); }
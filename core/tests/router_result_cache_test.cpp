@@ -0,0 +1,88 @@
+// Кэш результатов (resultCacheEntries): попадание только при той же привязке концов.
+
+#include <cmath>
+
+#include "routing_core/router.h"
+#include "synthetic_tiles.h"
+#include "temp_db.h"
+#include "test_check.h"
+
+using namespace routing_core;
+using namespace routing_bench;
+using routing_test::SyntheticDb;
+
+namespace {
+
+constexpr const char* kDbSuffix = "_cache.routingdb";
+
+RouterOptions options(const SyntheticDb& db, size_t cacheEntries) {
+  RouterOptions opt;
+  opt.tileZoom = db.spec.z;
+  opt.collectStats = true;
+  opt.resultCacheEntries = cacheEntries;
+  return opt;
+}
+
+std::vector<Coord> pointsAt(const SyntheticDb& db, double fa, double fb, double shift = 0.0) {
+  const auto a = syntheticPoint(db.spec, fa, fa);
+  const auto b = syntheticPoint(db.spec, fb, fb);
+  return {{a.first + shift, a.second}, {b.first, b.second}};
+}
+
+bool sameRoute(const RouteResult& a, const RouteResult& b) {
+  return a.status == b.status && a.edge_ids == b.edge_ids && std::abs(a.distance_m - b.distance_m) < 1e-6 &&
+         std::abs(a.duration_s - b.duration_s) < 1e-6;
+}
+
+} // namespace
+
+// Соседняя точка на том же сегменте, но в другом месте: маршрут ищется заново.
+TEST(nearby_point_on_same_segment_is_not_a_hit) {
+  SyntheticDb db(kDbSuffix);
+  const auto car = makeCarProfile();
+  Router cached(db.path, options(db, 16));
+  Router plain(db.path, options(db, 0));
+  const auto first = cached.route(car, pointsAt(db, 0.1, 0.9));
+  REQUIRE(first.status == RouteStatus::OK);
+  REQUIRE(first.stats && !first.stats->result_cache_hit);
+  for (double shift : {1e-7, 2e-7, 3e-7}) {  // 1–3 см: та же доля сегмента с точностью 1/64
+    const auto wps = pointsAt(db, 0.1, 0.9, shift);
+    const auto rr = cached.route(car, wps);
+    REQUIRE(rr.stats);
+    CHECK(!rr.stats->result_cache_hit);
+    CHECK(sameRoute(rr, plain.route(car, wps)));
+  }
+}
+
+// Точки за углом решётки привязываются ровно к угловому узлу (t зажат в 0 или 1):
+// ответ общий.
+TEST(points_snapped_to_the_same_node_share_the_result) {
+  SyntheticDb db(kDbSuffix);
+  const auto car = makeCarProfile();
+  Router cached(db.path, options(db, 16));
+  Router plain(db.path, options(db, 0));
+  const auto first = cached.route(car, pointsAt(db, -0.01, 1.01));
+  REQUIRE(first.status == RouteStatus::OK);
+  const auto wps = pointsAt(db, -0.011, 1.01);
+  const auto rr = cached.route(car, wps);
+  REQUIRE(rr.stats && first.stats);
+  CHECK(rr.stats->result_cache_hit);
+  CHECK(sameRoute(rr, plain.route(car, wps)));
+  // попадание читает только тайлы у концов, а не весь коридор
+  CHECK(rr.stats->tiles_requested > 0 && rr.stats->tiles_requested <= 4);
+  CHECK(rr.stats->tiles_requested < first.stats->tiles_requested);
+}
+
+TEST(repeat_is_a_hit) {
+  SyntheticDb db(kDbSuffix);
+  const auto car = makeCarProfile();
+  Router cached(db.path, options(db, 16));
+  const auto wps = pointsAt(db, 0.1, 0.9);
+  const auto first = cached.route(car, wps);
+  const auto again = cached.route(car, wps);
+  REQUIRE(again.stats);
+  CHECK(again.stats->result_cache_hit);
+  CHECK(sameRoute(first, again));
+}
+
+int main() { return routing_test::runAll(); }
@@ -0,0 +1,137 @@
+// Снап на ребро из нескольких сегментов (после сжатия цепочек): доля ребра и полурёбра.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "router_impl.h"
+#include "synthetic_tiles.h"
+#include "temp_db.h"
+#include "test_check.h"
+
+using namespace routing_core;
+using namespace routing_bench;
+
+namespace {
+
+using Impl = RouterInternals::Impl;
+
+// Синтетический тайл: по 2 промежуточные точки на ребро — 3 сегмента.
+const SyntheticTile& syntheticTile() {
+  static const auto tiles = [] {
+    SyntheticSpec spec;
+    spec.tilesX = spec.tilesY = 1;
+    return makeSyntheticTiles(spec);
+  }();
+  return tiles.front();
+}
+
+TileView syntheticView() { return TileView(syntheticTile().buffer); }
+
+double shapeLength(const std::vector<std::pair<double,double>>& pts, int upTo) {
+  double len = 0.0;
+  for (int k = 0; k < upTo; ++k) len += Impl::haversine(pts[k].first, pts[k].second, pts[k + 1].first, pts[k + 1].second);
+  return len;
+}
+
+} // namespace
+
+TEST(snap_on_middle_segment_uses_fraction_of_whole_edge) {
+  const TileView view = syntheticView();
+  const auto car = makeCarProfile();
+  std::vector<std::pair<double,double>> pts;
+  view.appendEdgeShape(0, pts, /*skipFirst*/false);
+  REQUIRE(pts.size() == 4);
+
+  // точка на четверти среднего сегмента
+  const double lat = pts[1].first + 0.25 * (pts[2].first - pts[1].first);
+  const double lon = pts[1].second + 0.25 * (pts[2].second - pts[1].second);
+  const auto snap = Impl::snapToEdge(view, lat, lon, car);
+  REQUIRE(snap.has_value());
+  CHECK(snap->dist_m < 0.5);
+
+  pts.clear();
+  view.appendEdgeShape(snap->edgeIdx, pts, /*skipFirst*/false);
+  REQUIRE(snap->segIndex >= 0 && snap->segIndex + 1 < static_cast<int>(pts.size()));
+  const int seg = snap->segIndex;
+  const double segLen = shapeLength(pts, seg + 1) - shapeLength(pts, seg);
+  const double expected = (shapeLength(pts, seg) + snap->t * segLen) / shapeLength(pts, static_cast<int>(pts.size()) - 1);
+  CHECK(std::abs(snap->edgeFrac - expected) < 1e-9);
+  if (seg == 1) CHECK(std::abs(snap->edgeFrac - snap->t) > 0.1);  // доля сегмента ≠ доля ребра
+}
+
+// Старт на среднем сегменте сжатого ребра (маршрут через Router::route): полуребро до узла
+// стоит долю edgeFrac времени ребра, и polyline начинается в проекции.
+TEST(route_from_middle_segment_charges_fraction_of_edge) {
+  routing_test::SyntheticDb db("_snap.routingdb");
+  const auto tiles = makeSyntheticTiles(db.spec);
+  const TileView view(tiles[tiles.size() / 2].buffer);
+  const auto foot = makeFootProfile();
+  // ребро в обе стороны, доступное пешком, из трёх сегментов
+  std::vector<std::pair<double,double>> pts;
+  int edge = -1;
+  for (int e = 0; e < view.edgeCount() && edge < 0; ++e) {
+    const EdgeRef ref = view.edgeAt(static_cast<uint32_t>(e));
+    if (ref.oneway() || (ref.access_mask() & foot.access_mask) == 0) continue;
+    if (foot.speeds_mps[static_cast<int>(ref.road_class())] <= 0.0) continue;
+    pts.clear();
+    view.appendEdgeShape(static_cast<uint32_t>(e), pts, /*skipFirst*/false);
+    if (pts.size() == 4) edge = e;
+  }
+  REQUIRE(edge >= 0);
+  const double lat = pts[1].first + 0.25 * (pts[2].first - pts[1].first);
+  const double lon = pts[1].second + 0.25 * (pts[2].second - pts[1].second);
+  const auto snap = Impl::snapToEdge(view, lat, lon, foot);
+  REQUIRE(snap && snap->edgeIdx == static_cast<uint32_t>(edge) && snap->segIndex == 1);
+
+  RouterOptions opt;
+  opt.tileZoom = db.spec.z;
+  Router router(db.path, opt);
+  const auto goal = syntheticPoint(db.spec, 0.9, 0.9);
+  auto routeFrom = [&](double fromLat, double fromLon) {
+    return router.route(foot, {{fromLat, fromLon}, {goal.first, goal.second}});
+  };
+  const RouteResult rr = routeFrom(lat, lon);
+  const RouteResult viaFrom = routeFrom(view.nodeLat(snap->fromNode), view.nodeLon(snap->fromNode));
+  const RouteResult viaTo = routeFrom(view.nodeLat(snap->toNode), view.nodeLon(snap->toNode));
+  REQUIRE(rr.status == RouteStatus::OK && viaFrom.status == RouteStatus::OK && viaTo.status == RouteStatus::OK);
+
+  // пеший профиль: эвристика не завышает, маршруты кратчайшие
+  const double w = Impl::edgeTraversalTimeSec(view.edgeAt(static_cast<uint32_t>(edge)), foot);
+  const double expected = std::min(viaFrom.duration_s + snap->edgeFrac * w, viaTo.duration_s + (1.0 - snap->edgeFrac) * w);
+  if (std::abs(rr.duration_s - expected) > 1e-6) {
+    std::printf("  duration %.6f s, expected %.6f s (edgeFrac %.3f, t %.3f)\n", rr.duration_s, expected,
+                snap->edgeFrac, snap->t);
+    CHECK(false);
+  }
+  REQUIRE(!rr.polyline.empty());
+  CHECK(rr.polyline.front().lat == snap->projLat && rr.polyline.front().lon == snap->projLon);
+  CHECK(rr.distance_m > 0.0);
+}
+
+TEST(tile_box_bound_covers_overhanging_shapes) {
+  // граничные рёбра синтетического тайла «виляют» наружу за рамку тайла
+  const TileView view = syntheticView();
+  const TileKey key = syntheticTile().key;
+  const auto bb = syntheticTileBounds(key.z, key.x, key.y);
+  std::vector<std::pair<double,double>> pts;
+  int outside = 0;
+  for (int e = 0; e < view.edgeCount(); ++e) {
+    pts.clear();
+    view.appendEdgeShape(e, pts, /*skipFirst*/false);
+    for (const auto& [lat, lon] : pts) {
+      if (lat >= bb.lat_min && lat <= bb.lat_max && lon >= bb.lon_min && lon <= bb.lon_max) continue;
+      ++outside;
+      const double bound = Impl::distanceToTileBox(key, view, lat, lon);
+      if (bound > 0.0) {
+        std::printf("  edge %d: bound %.3f m at a point of its own shape\n", e, bound);
+        CHECK(bound <= 0.0);
+        return;
+      }
+    }
+  }
+  CHECK(outside > 0);
+}
+
+int main() { return routing_test::runAll(); }
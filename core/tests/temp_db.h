@@ -0,0 +1,42 @@
+#pragma once
+
+// Временные БД для модульных тестов ядра: файл во временном каталоге (pid процесса в
+// имени — тесты можно гонять параллельно), удаляется вместе с -shm/-wal SQLite.
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <utility>
+
+#include <unistd.h>
+
+#include "synthetic_tiles.h"
+
+namespace routing_test {
+
+inline std::string tempPath(const std::string& suffix) {
+  return (std::filesystem::temp_directory_path() /
+          ("routing_core_tests_" + std::to_string(::getpid()) + suffix)).string();
+}
+
+struct TempFile {
+  std::string path;
+  explicit TempFile(std::string p) : path(std::move(p)) {}
+  TempFile(const TempFile&) = delete;
+  TempFile& operator=(const TempFile&) = delete;
+  ~TempFile() {
+    std::remove(path.c_str());
+    std::remove((path + "-shm").c_str());
+    std::remove((path + "-wal").c_str());
+  }
+};
+
+// Синтетическая БД (synthetic_tiles.h) с настройками по умолчанию.
+struct SyntheticDb : TempFile {
+  routing_bench::SyntheticSpec spec;
+  explicit SyntheticDb(const std::string& suffix) : TempFile(tempPath(suffix)) {
+    routing_bench::writeSyntheticRoutingDb(path, routing_bench::makeSyntheticTiles(spec));
+  }
+};
+
+} // namespace routing_test
@@ -0,0 +1,78 @@
+#pragma once
+
+// Минимальные проверки для модульных тестов (без внешних фреймворков).
+//
+// TEST(name) регистрирует функцию; CHECK(cond) при провале печатает место и помечает
+// тест упавшим, но не прерывает его; REQUIRE(cond) к тому же выходит из теста (дальше
+// проверять нечего или нельзя). main() теста — `return routing_test::runAll();`.
+
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace routing_test {
+
+struct Case {
+  const char* name;
+  std::function<void()> fn;
+};
+
+inline std::vector<Case>& cases() {
+  static std::vector<Case> all;
+  return all;
+}
+
+inline int& failures() {
+  static int n = 0;
+  return n;
+}
+
+struct Register {
+  Register(const char* name, std::function<void()> fn) { cases().push_back(Case{name, std::move(fn)}); }
+};
+
+inline int runAll() {
+  int failed = 0;
+  for (const auto& c : cases()) {
+    const int before = failures();
+    try {
+      c.fn();
+    } catch (const std::exception& e) {
+      std::printf("  exception: %s\n", e.what());
+      ++failures();
+    }
+    const bool ok = failures() == before;
+    std::printf("[%s] %s\n", ok ? " ok " : "FAIL", c.name);
+    if (!ok) ++failed;
+  }
+  std::printf("%zu tests, %d failed\n", cases().size(), failed);
+  return failed == 0 ? 0 : 1;
+}
+
+} // namespace routing_test
+
+#define ROUTING_TEST_CAT2(a, b) a##b
+#define ROUTING_TEST_CAT(a, b) ROUTING_TEST_CAT2(a, b)
+#define TEST(name)                                                                          \
+  static void name();                                                                       \
+  static routing_test::Register ROUTING_TEST_CAT(name, _register)(#name, name);             \
+  static void name()
+
+#define CHECK(cond)                                                                         \
+  do {                                                                                      \
+    if (!(cond)) {                                                                          \
+      std::printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);                \
+      ++routing_test::failures();                                                           \
+    }                                                                                       \
+  } while (0)
+
+#define REQUIRE(cond)                                                                       \
+  do {                                                                                      \
+    if (!(cond)) {                                                                          \
+      std::printf("  %s:%d: REQUIRE(%s) failed\n", __FILE__, __LINE__, #cond);              \
+      ++routing_test::failures();                                                           \
+      return;                                                                               \
+    }                                                                                       \
+  } while (0)